@@ -37,6 +37,7 @@ ifeq ($(strip $(AUDIO_ENABLE)), yes)
     SRC += $(QUANTUM_DIR)/process_keycode/process_clicky.c
     ifeq ($(PLATFORM),AVR)
         SRC += $(QUANTUM_DIR)/audio/audio.c
+        SRC += $(QUANTUM_DIR)/audio/synth.c
     else
         SRC += $(QUANTUM_DIR)/audio/audio_arm.c
     endif
@@ -105,6 +106,7 @@ endif
 ifeq ($(strip $(RGBLIGHT_ENABLE)), yes)
     OPT_DEFS += -DRGBLIGHT_ENABLE
     SRC += $(QUANTUM_DIR)/rgblight.c
+    COLOR_MATH = yes
     CIE1931_CURVE = yes
     LED_BREATHING_TABLE = yes
     ifeq ($(strip $(RGBLIGHT_CUSTOM_DRIVER)), yes)
@@ -118,11 +120,16 @@ ifeq ($(strip $(RGB_MATRIX_ENABLE)), yes)
     OPT_DEFS += -DRGB_MATRIX_ENABLE
     SRC += is31fl3731.c
     SRC += TWIlib.c
-    SRC += $(QUANTUM_DIR)/color.c
     SRC += $(QUANTUM_DIR)/rgb_matrix.c
+    SRC += $(QUANTUM_DIR)/rgb_matrix_math.c
+    COLOR_MATH = yes
     CIE1931_CURVE = yes
 endif
 
+ifeq ($(strip $(COLOR_MATH)), yes)
+    SRC += $(QUANTUM_DIR)/color.c
+endif
+
 ifeq ($(strip $(TAP_DANCE_ENABLE)), yes)
     OPT_DEFS += -DTAP_DANCE_ENABLE
     SRC += $(QUANTUM_DIR)/process_keycode/process_tap_dance.c
@@ -153,6 +160,21 @@ ifeq ($(strip $(SERIAL_LINK_ENABLE)), yes)
     VAPTH += $(SERIAL_PATH)
 endif
 
+ifeq ($(strip $(SPLIT_TRANSPORT_ENABLE)), yes)
+    # the keyboard's serial.h sets the pin and the buffers
+    SRC += $(QUANTUM_DIR)/split_common/split_transport.c
+    SRC += $(QUANTUM_DIR)/split_common/split_delta.c
+    SRC += $(QUANTUM_DIR)/split_common/split_serial.c
+    VPATH += $(QUANTUM_PATH)/split_common
+endif
+
+ifeq ($(strip $(SPLIT_EVENTS_ENABLE)), yes)
+    # the slave sends its key events instead of its rows
+    OPT_DEFS += -DSPLIT_EVENTS_ENABLE
+    SRC += $(QUANTUM_DIR)/split_common/split_events.c
+    VPATH += $(QUANTUM_PATH)/split_common
+endif
+
 ifneq ($(strip $(VARIABLE_TRACE)),)
     SRC += $(QUANTUM_DIR)/variable_trace.c
     OPT_DEFS += -DNUM_TRACED_VARIABLES=$(strip $(VARIABLE_TRACE))
@@ -203,6 +225,17 @@ QUANTUM_SRC:= \
     $(QUANTUM_DIR)/keycode_config.c \
     $(QUANTUM_DIR)/process_keycode/process_leader.c
 
+DEBOUNCE_DIR := $(QUANTUM_DIR)/debounce
+DEBOUNCE_TYPE ?= sym_g
+VALID_DEBOUNCE_TYPES := sym_g sym_pk eager_pk eager_pr custom
+ifeq ($(filter $(strip $(DEBOUNCE_TYPE)),$(VALID_DEBOUNCE_TYPES)),)
+    $(error DEBOUNCE_TYPE="$(DEBOUNCE_TYPE)" is not a valid debounce algorithm)
+endif
+
 ifndef CUSTOM_MATRIX
     QUANTUM_SRC += $(QUANTUM_DIR)/matrix.c
+    # custom lets the keyboard provide its own debounce() implementation
+    ifneq ($(strip $(DEBOUNCE_TYPE)), custom)
+        QUANTUM_SRC += $(DEBOUNCE_DIR)/$(strip $(DEBOUNCE_TYPE)).c
+    endif
 endif
@@ -11,6 +11,14 @@
 #include "TWIlib.h"
 #include "util/delay.h"
 
+uint8_t TWITransmitBuffer[TXMAXBUFLEN];
+volatile uint8_t TWIReceiveBuffer[RXMAXBUFLEN];
+volatile int TXBuffIndex;
+int RXBuffIndex;
+int TXBuffLen;
+int RXBuffLen;
+TWIInfoStruct TWIInfo;
+
 void TWIInit()
 {
 	TWIInfo.mode = Ready;
@@ -18,15 +18,15 @@
 // Receive buffer length
 #define RXMAXBUFLEN 20
 // Global transmit buffer
-uint8_t TWITransmitBuffer[TXMAXBUFLEN];
+extern uint8_t TWITransmitBuffer[TXMAXBUFLEN];
 // Global receive buffer
-volatile uint8_t TWIReceiveBuffer[RXMAXBUFLEN];
+extern volatile uint8_t TWIReceiveBuffer[RXMAXBUFLEN];
 // Buffer indexes
-volatile int TXBuffIndex; // Index of the transmit buffer. Is volatile, can change at any time.
-int RXBuffIndex; // Current index in the receive buffer
+extern volatile int TXBuffIndex; // Index of the transmit buffer. Is volatile, can change at any time.
+extern int RXBuffIndex; // Current index in the receive buffer
 // Buffer lengths
-int TXBuffLen; // The total length of the transmit buffer
-int RXBuffLen; // The total number of bytes to read (should be less than RXMAXBUFFLEN)
+extern int TXBuffLen; // The total length of the transmit buffer
+extern int RXBuffLen; // The total number of bytes to read (should be less than RXMAXBUFFLEN)
 
 typedef enum {
 	Ready,
@@ -43,7 +43,7 @@ typedef enum {
 	uint8_t errorCode;
 	uint8_t repStart;	
 	}TWIInfoStruct;
-TWIInfoStruct TWIInfo;
+extern TWIInfoStruct TWIInfo;
 
 
 // TWI Status Codes
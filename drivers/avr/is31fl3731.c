@@ -16,12 +16,10 @@
  */
 
 #include "is31fl3731.h"
-#include <avr/interrupt.h>
-#include <avr/io.h>
-#include <util/delay.h>
 #include <string.h>
 #include "TWIlib.h"
 #include "progmem.h"
+#include "wait.h"
 
 // This is a 7-bit address, that gets left-shifted and bit 0
 // set to 0 for write, 1 for read (as per I2C protocol)
@@ -58,7 +56,12 @@ uint8_t g_twi_transfer_buffer[TXMAXBUFLEN];
 // buffers and the transfers in IS31FL3731_write_pwm_buffer() but it's
 // probably not worth the extra complexity.
 uint8_t g_pwm_buffer[DRIVER_COUNT][144];
-bool g_pwm_buffer_update_required = false;
+// One bit per 16 byte transfer of the buffers that has changed since it
+// was last sent
+uint16_t g_pwm_buffer_dirty[DRIVER_COUNT] = { 0 };
+// The transfer on the bus, driver * 9 + block
+#define NO_PWM_TRANSFER 0xFF
+uint8_t g_pwm_buffer_transfer = NO_PWM_TRANSFER;
 
 uint8_t g_led_control_registers[DRIVER_COUNT][18] = { { 0 }, { 0 } };
 bool g_led_control_registers_update_required = false;
@@ -93,36 +96,47 @@ void IS31FL3731_write_register( uint8_t addr, uint8_t reg, uint8_t data )
 	//}
 }
 
+// Starts sending 16 bytes of the PWM buffer, starting at offset. TWIlib
+// copies them and the interrupt sends them, this only waits for the bus
+// to be free.
+static void IS31FL3731_start_pwm_transfer( uint8_t addr, uint8_t *pwm_buffer, uint8_t offset )
+{
+	// set the I2C address
+	g_twi_transfer_buffer[0] = (addr << 1) | 0x00;
+	// set the first register, e.g. 0x24, 0x34, 0x44, etc.
+	g_twi_transfer_buffer[1] = 0x24 + offset;
+	// copy the data from offset to offset+15
+	// device will auto-increment register for data after the first byte
+	// thus this sets registers 0x24-0x33, 0x34-0x43, etc. in one transfer
+	for ( int j = 0; j < 16; j++ )
+	{
+		g_twi_transfer_buffer[2 + j] = pwm_buffer[offset + j];
+	}
+
+	// Set the error code to have no relevant information
+	TWIInfo.errorCode = TWI_NO_RELEVANT_INFO;
+	TWITransmitData( g_twi_transfer_buffer, 16 + 2, 0 );
+}
+
+// Sends 16 bytes of the PWM buffer, and retries until it goes through
+static void IS31FL3731_write_pwm_transfer( uint8_t addr, uint8_t *pwm_buffer, uint8_t offset )
+{
+	do
+	{
+		IS31FL3731_start_pwm_transfer( addr, pwm_buffer, offset );
+		while ( !isTWIReady() ) {}
+	} while ( TWIInfo.errorCode != TWI_SUCCESS );
+}
+
 void IS31FL3731_write_pwm_buffer( uint8_t addr, uint8_t *pwm_buffer )
 {
 	// assumes bank is already selected
 
 	// transmit PWM registers in 9 transfers of 16 bytes
 	// g_twi_transfer_buffer[] is 20 bytes
-
-	// set the I2C address
-	g_twi_transfer_buffer[0] = (addr << 1) | 0x00;
-
-	// iterate over the pwm_buffer contents at 16 byte intervals
 	for ( int i = 0; i < 144; i += 16 )
 	{
-		// set the first register, e.g. 0x24, 0x34, 0x44, etc.
-		g_twi_transfer_buffer[1] = 0x24 + i;
-		// copy the data from i to i+15
-		// device will auto-increment register for data after the first byte
-		// thus this sets registers 0x24-0x33, 0x34-0x43, etc. in one transfer
-		for ( int j = 0; j < 16; j++ )
-		{
-			g_twi_transfer_buffer[2 + j] = pwm_buffer[i + j];
-		}
-
-		// Set the error code to have no relevant information
-		TWIInfo.errorCode = TWI_NO_RELEVANT_INFO;
-		// Continuously attempt to transmit data until a successful transmission occurs
-		while ( TWIInfo.errorCode != 0xFF )
-		{
-			TWITransmitData( g_twi_transfer_buffer, 16 + 2, 0 );
-		}
+		IS31FL3731_write_pwm_transfer( addr, pwm_buffer, i );
 	}
 }
 
@@ -139,7 +153,7 @@ void IS31FL3731_init( uint8_t addr )
 	// enable software shutdown
 	IS31FL3731_write_register( addr, ISSI_REG_SHUTDOWN, 0x00 );
 	// this delay was copied from other drivers, might not be needed
-	_delay_ms( 10 );
+	wait_ms( 10 );
 
 	// picture mode
 	IS31FL3731_write_register( addr, ISSI_REG_CONFIG, ISSI_REG_CONFIG_PICTUREMODE );
@@ -181,16 +195,25 @@ void IS31FL3731_init( uint8_t addr )
 	IS31FL3731_write_register( addr, ISSI_COMMANDREGISTER, 0 );
 }
 
+// Sets a PWM register, and marks its transfer as changed
+static void IS31FL3731_set_pwm( uint8_t driver, uint8_t reg, uint8_t value )
+{
+	uint8_t i = reg - 0x24;
+	if ( g_pwm_buffer[driver][i] != value )
+	{
+		g_pwm_buffer[driver][i] = value;
+		g_pwm_buffer_dirty[driver] |= 1 << ( i / 16 );
+	}
+}
+
 void IS31FL3731_set_color( int index, uint8_t red, uint8_t green, uint8_t blue )
 {
 	if ( index >= 0 && index < DRIVER_LED_TOTAL ) {
 		is31_led led = g_is31_leds[index];
 
-		// Subtract 0x24 to get the second index of g_pwm_buffer
-		g_pwm_buffer[led.driver][led.r - 0x24] = red;
-		g_pwm_buffer[led.driver][led.g - 0x24] = green;
-		g_pwm_buffer[led.driver][led.b - 0x24] = blue;
-		g_pwm_buffer_update_required = true;
+		IS31FL3731_set_pwm( led.driver, led.r, red );
+		IS31FL3731_set_pwm( led.driver, led.g, green );
+		IS31FL3731_set_pwm( led.driver, led.b, blue );
 	}
 }
 
@@ -234,14 +257,44 @@ void IS31FL3731_set_led_control_register( uint8_t index, bool red, bool green, b
 
 }
 
-void IS31FL3731_update_pwm_buffers( uint8_t addr1, uint8_t addr2 )
+bool IS31FL3731_flush_pwm_buffers( uint8_t addr1, uint8_t addr2 )
 {
-	if ( g_pwm_buffer_update_required )
+	if ( g_pwm_buffer_transfer != NO_PWM_TRANSFER )
+	{
+		if ( !isTWIReady() )
+		{
+			return false;
+		}
+		// the chip didn't get it, send it again
+		if ( TWIInfo.errorCode != TWI_SUCCESS )
+		{
+			g_pwm_buffer_dirty[g_pwm_buffer_transfer / 9] |= 1 << ( g_pwm_buffer_transfer % 9 );
+		}
+		g_pwm_buffer_transfer = NO_PWM_TRANSFER;
+	}
+	for ( uint8_t driver = 0; driver < DRIVER_COUNT; driver++ )
 	{
-		IS31FL3731_write_pwm_buffer( addr1, g_pwm_buffer[0] );
-		IS31FL3731_write_pwm_buffer( addr2, g_pwm_buffer[1] );
+		uint16_t dirty = g_pwm_buffer_dirty[driver];
+		if ( dirty )
+		{
+			uint8_t block = 0;
+			while ( !( dirty & 1 ) )
+			{
+				dirty >>= 1;
+				block++;
+			}
+			g_pwm_buffer_dirty[driver] &= ~( 1 << block );
+			g_pwm_buffer_transfer = driver * 9 + block;
+			IS31FL3731_start_pwm_transfer( driver ? addr2 : addr1, g_pwm_buffer[driver], block * 16 );
+			return false;
+		}
 	}
-	g_pwm_buffer_update_required = false;
+	return true;
+}
+
+void IS31FL3731_update_pwm_buffers( uint8_t addr1, uint8_t addr2 )
+{
+	while ( !IS31FL3731_flush_pwm_buffers( addr1, addr2 ) ) {}
 }
 
 void IS31FL3731_update_led_control_registers( uint8_t addr1, uint8_t addr2 )
@@ -254,5 +307,6 @@ void IS31FL3731_update_led_control_registers( uint8_t addr1, uint8_t addr2 )
 			IS31FL3731_write_register(addr2, i, g_led_control_registers[1][i] );
 		}
 	}
+	g_led_control_registers_update_required = false;
 }
 
@@ -44,7 +44,11 @@ void IS31FL3731_set_led_control_register( uint8_t index, bool red, bool green, b
 // (eg. from a timer interrupt).
 // Call this while idle (in between matrix scans).
 // If the buffer is dirty, it will update the driver with the buffer.
+// Only the 16 byte blocks of the buffer that changed are sent.
 void IS31FL3731_update_pwm_buffers( uint8_t addr1, uint8_t addr2 );
+// The same without waiting, starts sending the next changed block if the
+// I2C bus is free. Returns true once all the changes have been sent.
+bool IS31FL3731_flush_pwm_buffers( uint8_t addr1, uint8_t addr2 );
 void IS31FL3731_update_led_control_registers( uint8_t addr1, uint8_t addr2 );
 
 #define C1_1  0x24
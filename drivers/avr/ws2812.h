@@ -23,8 +23,10 @@
 #ifndef LIGHT_WS2812_H_
 #define LIGHT_WS2812_H_
 
+#if defined(__AVR__)
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#endif
 //#include "ws2812_config.h"
 //#include "i2cmaster.h"
 
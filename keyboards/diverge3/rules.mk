@@ -1,7 +1,9 @@
 SRC += ../lets_split/matrix.c \
-	   ../lets_split/serial.c \
 	   ../lets_split/split_util.c
 
+# Single wire link between the halves, see quantum/split_common
+SPLIT_TRANSPORT_ENABLE = yes
+
 # MCU name
 #MCU = at90usb1286
 MCU = atmega32u4
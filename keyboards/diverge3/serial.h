@@ -0,0 +1,2 @@
+// The halves talk like the Let's Split's, whose matrix.c is used
+#include "../lets_split/serial.h"
@@ -70,6 +70,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define SERIAL_LINK_BAUD 562500
 #define SERIAL_LINK_THREAD_PRIORITY (NORMALPRIO - 1)
+#define SERIAL_LINK_CRC32_SLICING_BY_4
 
 #define VISUALIZER_USER_DATA_SIZE 16
 
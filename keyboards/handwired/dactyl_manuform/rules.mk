@@ -1,9 +1,11 @@
 SRC += matrix.c \
 	   i2c.c \
 	   split_util.c \
-	   serial.c \
 	   ssd1306.c
 
+# Single wire link between the halves, see quantum/split_common
+SPLIT_TRANSPORT_ENABLE = yes
+
 # MCU name
 #MCU = at90usb1287
 MCU = atmega32u4
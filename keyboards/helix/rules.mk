@@ -1,7 +1,9 @@
 SRC += i2c.c \
-	   serial.c \
 	   ssd1306.c
 
+# Single wire link between the halves, see quantum/split_common
+SPLIT_TRANSPORT_ENABLE = yes
+
 # MCU name
 #MCU = at90usb1287
 MCU = atmega32u4
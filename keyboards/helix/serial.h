@@ -12,9 +12,11 @@
 #ifndef USE_SERIAL_PD2
 #define SERIAL_PIN_MASK _BV(PD0)
 #define SERIAL_PIN_INTERRUPT INT0_vect
+#define SERIAL_PIN_INT INT0
 #else
 #define SERIAL_PIN_MASK _BV(PD2)
 #define SERIAL_PIN_INTERRUPT INT2_vect
+#define SERIAL_PIN_INT INT2
 #endif
 
 #define SERIAL_SLAVE_BUFFER_LENGTH MATRIX_ROWS/2
@@ -33,9 +33,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifdef USE_I2C
 #  include "i2c.h"
+#  include "split_transport.h"
 #else // USE_SERIAL
 #  include "serial.h"
 #endif
+#ifdef SPLIT_EVENTS_ENABLE
+#  include "split_events.h"
+#endif
 
 #ifndef DEBOUNCING_DELAY
 #   define DEBOUNCING_DELAY 5
@@ -212,12 +216,22 @@ int i2c_transaction(void) {
     if (err) goto i2c_error;
 
     if (!err) {
-        int i;
-        for (i = 0; i < ROWS_PER_HAND-1; ++i) {
-            matrix[slaveOffset+i] = i2c_master_read(I2C_ACK);
+        // the rows are followed by their CRC, which also catches a read in
+        // the middle of the slave updating them
+        uint8_t rows[ROWS_PER_HAND];
+        uint8_t crc = SPLIT_CRC8_INIT;
+        for (int i = 0; i < ROWS_PER_HAND; ++i) {
+            rows[i] = i2c_master_read(I2C_ACK);
+            crc = split_crc8(crc, rows[i]);
         }
-        matrix[slaveOffset+i] = i2c_master_read(I2C_NACK);
+        crc = split_crc8(crc, i2c_master_read(I2C_NACK));
         i2c_master_stop();
+        if (crc) {
+            return 2;
+        }
+        for (int i = 0; i < ROWS_PER_HAND; ++i) {
+            matrix[slaveOffset+i] = rows[i];
+        }
     } else {
 i2c_error: // the cable is disconnceted, or something else went wrong
         i2c_reset_state();
@@ -230,15 +244,17 @@ i2c_error: // the cable is disconnceted, or something else went wrong
 #else // USE_SERIAL
 
 int serial_transaction(void) {
-    int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
-
     if (serial_update_buffers()) {
         return 1;
     }
 
+#ifndef SPLIT_EVENTS_ENABLE
+    // otherwise keyboard_task() gets the slave's events
+    int slaveOffset = (isLeftHand) ? (ROWS_PER_HAND) : 0;
     for (int i = 0; i < ROWS_PER_HAND; ++i) {
         matrix[slaveOffset+i] = serial_slave_buffer[i];
     }
+#endif
     return 0;
 }
 #endif
@@ -263,6 +279,9 @@ uint8_t matrix_scan(void)
             for (int i = 0; i < ROWS_PER_HAND; ++i) {
                 matrix[slaveOffset+i] = 0;
             }
+#ifdef SPLIT_EVENTS_ENABLE
+            split_events_disconnect();
+#endif
         }
     } else {
         // turn off the indicator led on no error
@@ -279,9 +298,14 @@ void matrix_slave_scan(void) {
     int offset = (isLeftHand) ? 0 : ROWS_PER_HAND;
 
 #ifdef USE_I2C
+    uint8_t crc = SPLIT_CRC8_INIT;
     for (int i = 0; i < ROWS_PER_HAND; ++i) {
         i2c_slave_buffer[i] = matrix[offset+i];
+        crc = split_crc8(crc, matrix[offset+i]);
     }
+    i2c_slave_buffer[ROWS_PER_HAND] = crc;
+#elif defined(SPLIT_EVENTS_ENABLE)
+    split_events_scan(matrix + offset, offset, ROWS_PER_HAND);
 #else // USE_SERIAL
     for (int i = 0; i < ROWS_PER_HAND; ++i) {
         serial_slave_buffer[i] = matrix[offset+i];
@@ -14,6 +14,8 @@
 
 #define SERIAL_SLAVE_BUFFER_LENGTH MATRIX_ROWS/2
 #define SERIAL_MASTER_BUFFER_LENGTH 1
+// The buffers hold whole rows
+#define SERIAL_BUFFER_TYPE matrix_row_t
 
 // Buffers for master - slave communication
 extern volatile matrix_row_t serial_slave_buffer[SERIAL_SLAVE_BUFFER_LENGTH];
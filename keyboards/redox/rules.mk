@@ -1,7 +1,9 @@
 SRC += matrix.c \
 	   i2c.c \
-	   split_util.c \
-	   serial.c
+	   split_util.c
+
+# Single wire link between the halves, see quantum/split_common
+SPLIT_TRANSPORT_ENABLE = yes
 
 # MCU name
 #MCU = at90usb1286
@@ -45,6 +45,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #  include "serial.h"
 #endif
 
+#ifndef USE_I2C
+void serial_slave_contacted(void) {
+    contacted_by_master = true;
+}
+#endif
+
 #ifndef DEBOUNCING_DELAY
 #   define DEBOUNCING_DELAY 5
 #endif
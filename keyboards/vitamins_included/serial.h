@@ -23,5 +23,7 @@ void serial_master_init(void);
 void serial_slave_init(void);
 int serial_update_buffers(void);
 bool serial_slave_data_corrupt(void);
+// Called on the slave when the master's buffer has been received
+void serial_slave_contacted(void);
 
 #endif
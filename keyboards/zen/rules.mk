@@ -1,6 +1,8 @@
 SRC += matrix.c \
-	   split_util.c \
-	   serial.c
+	   split_util.c
+
+# Single wire link between the halves, see quantum/split_common
+SPLIT_TRANSPORT_ENABLE = yes
 
 # MCU name
 #MCU = at90usb1287
@@ -0,0 +1,445 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include "synth.h"
+#include "musical_notes.h"
+#include "voices.h"
+#include "luts.h"
+#include "progmem.h"
+
+// Longest period, the one of SYNTH_MIN_FREQUENCY
+#define MAX_PERIOD ((uint16_t)(((float)F_CPU) / (SYNTH_MIN_FREQUENCY * SYNTH_PRESCALER)))
+
+// A glissando step is 2^(440 / f / 24), ( GLISSANDO_K * period ) >> 12 is
+// its exponent in Q16
+#define GLISSANDO_K ((uint32_t)(440.0 / 24 * (1UL << 28) * SYNTH_PRESCALER / F_CPU + 0.5))
+
+// ( VIBRATO_K * period ) >> 12 is 440 / f in Q12
+#define VIBRATO_K ((uint32_t)(440.0 * (1UL << 24) * SYNTH_PRESCALER / F_CPU + 0.5))
+
+int voices = 0;
+int voice_place = 0;
+
+float frequencies[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+int volumes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+
+// The timer periods of frequencies[]
+static uint16_t periods[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+// Where the glissandos of the two timers are, in Q8 as their steps can be
+// less than a timer count, 0 when there's no note
+static uint32_t period = 0;
+static uint32_t period_alt = 0;
+
+// How long the current note of the polyphony plays, in interrupts
+static uint32_t place = 0;
+static uint16_t place_end = 0;
+
+bool     playing_notes = false;
+bool     playing_note = false;
+float    note_frequency = 0;
+float    note_length = 0;
+uint8_t  note_tempo = TEMPO_DEFAULT;
+float    note_timbre = TIMBRE_DEFAULT;
+uint16_t note_position = 0;
+float (* notes_pointer)[][2];
+uint16_t notes_count;
+bool     notes_repeat;
+bool     note_resting = false;
+
+uint8_t current_note = 0;
+
+// The song note as a timer period. A note ends once its period has been
+// played for note_span timer counts, a rest after rest_end interrupts.
+static uint16_t note_period = 0;
+static uint32_t note_span = 0;
+static uint32_t note_elapsed = 0;
+static uint16_t rest_end = 0;
+
+// note_timbre in Q16, converted whenever it changes
+static float    timbre_last = -1;
+static uint16_t timbre_q16 = 0;
+
+#ifdef VIBRATO_ENABLE
+float vibrato_strength = .5;
+float vibrato_rate = 0.125;
+
+// Where the vibrato is in vibrato_period_lut, in Q12
+static uint32_t vibrato_counter = 0;
+// vibrato_rate in Q12 and vibrato_strength in Q8, converted whenever they change
+static float    vibrato_rate_last = -1;
+static uint16_t vibrato_rate_q12 = 0;
+#ifdef VIBRATO_STRENGTH_ENABLE
+static float    vibrato_strength_last = -1;
+static uint16_t vibrato_strength_q8 = 0;
+#endif
+#endif
+
+float polyphony_rate = 0;
+
+uint16_t envelope_index = 0;
+bool glissando = true;
+
+// 2^(x / 65536) - 1 when going up, 1 - 2^(-x / 65536) when going down, in
+// Q16. The first terms of the series of e^(x ln 2), within 1e-4 for the
+// exponents of the glissando steps.
+static uint32_t exp2_step(uint16_t x, bool up)
+{
+    uint32_t y = ((uint32_t)x * 45426) >> 16;
+    uint32_t y2 = (y * y) >> 17;
+    uint32_t y3 = (((y2 * y) >> 16) * 21845) >> 16;
+    uint32_t y4 = (y3 * y) >> 18;
+    return up ? y + y2 + y3 + y4 : y - y2 + y3 - y4;
+}
+
+// period * 2^(x / 65536), period in Q8
+static uint32_t period_up(uint32_t p, uint16_t x)
+{
+    uint32_t e = exp2_step(x, true);
+    return p + (((p >> 8) * e) >> 8) + (((p & 0xFF) * e) >> 16);
+}
+
+// period * 2^(-x / 65536), period in Q8
+static uint32_t period_down(uint32_t p, uint16_t x)
+{
+    uint32_t e = exp2_step(x, false);
+    return p - (((p >> 8) * e) >> 8) - (((p & 0xFF) * e) >> 16);
+}
+
+// period in Q8, four of its fraction bits are kept for the small periods
+static uint16_t glissando_exponent(uint32_t p)
+{
+    uint32_t x = ((p >> 4) * GLISSANDO_K + (1UL << 15)) >> 16;
+    return x > 0xFFFF ? 0xFFFF : x;
+}
+
+uint16_t synth_period(float freq)
+{
+    if (freq < 30.517578125) {
+        freq = SYNTH_MIN_FREQUENCY;
+    }
+    return (uint16_t)(((float)F_CPU) / (freq * SYNTH_PRESCALER));
+}
+
+// The frequency steps up or down by 2^(440 / f / 24) until it's within a step
+// of the target, in periods the steps are divisions or multiplications
+uint32_t synth_glissando(uint32_t p, uint16_t target)
+{
+    uint32_t target_q8 = (uint32_t)target << 8;
+    if (p == 0) {
+        return target_q8;
+    }
+    uint16_t x = glissando_exponent(target_q8);
+    if (p > target_q8 && p > period_up(target_q8, x)) {
+        return period_down(p, glissando_exponent(p));
+    } else if (p < target_q8 && p < period_down(target_q8, x)) {
+        return period_up(p, glissando_exponent(p));
+    }
+    return target_q8;
+}
+
+static uint16_t clamp_period(uint16_t p)
+{
+    return (p == 0 || p > MAX_PERIOD) ? MAX_PERIOD : p;
+}
+
+static uint16_t duty(uint16_t p)
+{
+    if (note_timbre != timbre_last) {
+        timbre_last = note_timbre;
+        timbre_q16 = timbre_last >= 1 ? 0xFFFF : timbre_last * 65536;
+    }
+    return ((uint32_t)p * timbre_q16) >> 16;
+}
+
+#ifdef VIBRATO_ENABLE
+
+static bool vibrato_active(void)
+{
+#ifdef VIBRATO_STRENGTH_ENABLE
+    if (vibrato_strength != vibrato_strength_last) {
+        vibrato_strength_last = vibrato_strength;
+        vibrato_strength_q8 = vibrato_strength_last <= 0 ? 0 : vibrato_strength_last >= 64 ? 64 * 256 : vibrato_strength_last * 256;
+    }
+    return vibrato_strength_q8 > 0;
+#else
+    return vibrato_strength > 0;
+#endif
+}
+
+static uint16_t vibrato(uint16_t p)
+{
+    if (vibrato_rate != vibrato_rate_last) {
+        vibrato_rate_last = vibrato_rate;
+        vibrato_rate_q12 = vibrato_rate_last >= 15 ? 0xFFFF : vibrato_rate_last * 4096;
+    }
+
+    uint16_t ratio = pgm_read_word(&vibrato_period_lut[vibrato_counter >> 12]);
+#ifdef VIBRATO_STRENGTH_ENABLE
+    // lut^strength, the lut stays within 1% of 1 so it's as good as
+    // 1 + strength * (lut - 1)
+    ratio = 32768 + (((int32_t)ratio - 32768) * vibrato_strength_q8) / 256;
+#endif
+    uint32_t vibrated = ((uint32_t)p * ratio + (1 << 14)) >> 15;
+
+    // the lut is gone through faster by the lower notes, by 1 + 440 / f
+    uint32_t f440 = ((uint32_t)p * VIBRATO_K) >> 12;
+    if (f440 > 0xFFFF) {
+        f440 = 0xFFFF;
+    }
+    vibrato_counter += vibrato_rate_q12 + (((uint32_t)vibrato_rate_q12 * f440 + (1 << 11)) >> 12);
+    while (vibrato_counter >= ((uint32_t)VIBRATO_LUT_LENGTH << 12)) {
+        vibrato_counter -= (uint32_t)VIBRATO_LUT_LENGTH << 12;
+    }
+    return vibrated > 0xFFFF ? 0xFFFF : vibrated;
+}
+
+#endif
+
+// The voices that change the frequency still need it as a float
+static uint16_t envelope(uint16_t p)
+{
+    if (envelope_index < 65535) {
+        envelope_index++;
+    }
+    if (voice_envelope_timbre()) {
+        return p;
+    }
+    float freq = voice_envelope(p ? ((float)F_CPU) / ((float)p * SYNTH_PRESCALER) : 0);
+    return freq > 0 ? synth_period(freq) : 0;
+}
+
+// Ticks each note of the polyphony gets, place has to go past it
+static uint16_t polyphony_length(uint8_t v)
+{
+    float length = frequencies[v] / polyphony_rate / SYNTH_PRESCALER;
+    return length >= 0xFFFF ? 0xFFFF : (uint16_t)length;
+}
+
+static void start_song_note(float length)
+{
+    note_length = length;
+    note_period = note_frequency > 0 ? synth_period(note_frequency) : 0;
+    note_span = (uint32_t)ceilf(length * 0xFFFF);
+    rest_end = (uint16_t)ceilf(length);
+    note_elapsed = 0;
+    note_position = 0;
+}
+
+void synth_play_note(float freq, int vol)
+{
+    playing_note = true;
+
+    envelope_index = 0;
+
+    if (freq > 0) {
+        frequencies[voices] = freq;
+        periods[voices] = synth_period(freq);
+        volumes[voices] = vol;
+        voices++;
+    }
+}
+
+bool synth_stop_note(float freq)
+{
+    for (int i = 7; i >= 0; i--) {
+        if (frequencies[i] == freq) {
+            frequencies[i] = 0;
+            periods[i] = 0;
+            volumes[i] = 0;
+            for (int j = i; (j < 7); j++) {
+                frequencies[j] = frequencies[j+1];
+                frequencies[j+1] = 0;
+                periods[j] = periods[j+1];
+                periods[j+1] = 0;
+                volumes[j] = volumes[j+1];
+                volumes[j+1] = 0;
+            }
+            break;
+        }
+    }
+    voices--;
+    if (voices < 0)
+        voices = 0;
+    if (voice_place >= voices) {
+        voice_place = 0;
+    }
+    if (voices == 0) {
+        period = 0;
+        period_alt = 0;
+        playing_note = false;
+        return true;
+    }
+    return false;
+}
+
+void synth_stop_all_notes(void)
+{
+    voices = 0;
+
+    playing_notes = false;
+    playing_note = false;
+    period = 0;
+    period_alt = 0;
+#ifdef VIBRATO_ENABLE
+    vibrato_counter = 0;
+#endif
+
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        frequencies[i] = 0;
+        periods[i] = 0;
+        volumes[i] = 0;
+    }
+}
+
+void synth_play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
+{
+    playing_notes = true;
+
+    notes_pointer = np;
+    notes_count = n_count;
+    notes_repeat = n_repeat;
+
+    place = 0;
+    current_note = 0;
+
+    note_frequency = (*notes_pointer)[current_note][0];
+    start_song_note(((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100));
+}
+
+synth_result_t synth_next_alt(synth_tone_t *tone)
+{
+    if (!playing_note || voices < 2) {
+        return SYNTH_KEEP;
+    }
+
+    uint16_t p = 0;
+    if (polyphony_rate == 0) {
+        if (glissando) {
+            period_alt = synth_glissando(period_alt, periods[voices - 2]);
+        } else {
+            period_alt = (uint32_t)periods[voices - 2] << 8;
+        }
+
+        p = period_alt >> 8;
+        #ifdef VIBRATO_ENABLE
+            if (vibrato_active()) {
+                p = vibrato(p);
+            }
+        #endif
+    }
+
+    p = clamp_period(envelope(p));
+    tone->period = p;
+    tone->duty = duty(p);
+    return SYNTH_TONE;
+}
+
+synth_result_t synth_next(synth_tone_t *tone)
+{
+    synth_result_t result = SYNTH_KEEP;
+    uint16_t p;
+
+    if (playing_note && voices > 0) {
+        if (polyphony_rate > 0) {
+            if (voices > 1) {
+                voice_place %= voices;
+                if (place == 0) {
+                    place_end = polyphony_length(voice_place);
+                }
+                if (place++ > place_end) {
+                    voice_place = (voice_place + 1) % voices;
+                    place = 0;
+                }
+            }
+            p = periods[voice_place];
+        } else {
+            if (glissando) {
+                period = synth_glissando(period, periods[voices - 1]);
+            } else {
+                period = (uint32_t)periods[voices - 1] << 8;
+            }
+            p = period >> 8;
+        }
+
+        #ifdef VIBRATO_ENABLE
+            if (vibrato_active()) {
+                p = vibrato(p);
+            }
+        #endif
+
+        p = clamp_period(envelope(p));
+        tone->period = p;
+        tone->duty = duty(p);
+        result = SYNTH_TONE;
+    }
+
+    if (playing_notes) {
+        p = 0;
+        if (note_period > 0) {
+            p = note_period;
+            #ifdef VIBRATO_ENABLE
+                if (vibrato_active()) {
+                    p = vibrato(p);
+                }
+            #endif
+            p = clamp_period(envelope(p));
+        }
+        tone->period = p;
+        tone->duty = p ? duty(p) : 0;
+        result = SYNTH_TONE;
+
+        // a note lasts note_length * 0xFFFF timer counts, whatever its period
+        note_position++;
+        bool end_of_note = false;
+        if (p > 0 && !note_resting) {
+            note_elapsed += p;
+            end_of_note = (note_elapsed + p >= note_span);
+        } else {
+            end_of_note = (note_position >= rest_end);
+        }
+
+        if (end_of_note) {
+            current_note++;
+            if (current_note >= notes_count) {
+                if (notes_repeat) {
+                    current_note = 0;
+                } else {
+                    playing_notes = false;
+                    return SYNTH_DONE;
+                }
+            }
+            if (!note_resting) {
+                note_resting = true;
+                current_note--;
+                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
+                    note_frequency = 0;
+                } else {
+                    note_frequency = (*notes_pointer)[current_note][0];
+                }
+                start_song_note(1);
+            } else {
+                note_resting = false;
+                envelope_index = 0;
+                note_frequency = (*notes_pointer)[current_note][0];
+                start_song_note(((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100));
+            }
+        }
+    }
+
+    return result;
+}
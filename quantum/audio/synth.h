@@ -0,0 +1,77 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SYNTH_H
+#define SYNTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The tone generator behind the AVR audio timers. The notes are turned into
+// timer periods when they start, the interrupts only do integer math on them.
+
+// The timers count at F_CPU / SYNTH_PRESCALER
+#define SYNTH_PRESCALER 8
+
+// Lowest frequency the 16 bit timers can play at 16 MHz, anything below is
+// played at it
+#define SYNTH_MIN_FREQUENCY 30.52f
+
+typedef struct {
+    uint16_t period;
+    uint16_t duty;
+} synth_tone_t;
+
+typedef enum {
+    // nothing to play, the timer keeps its tone
+    SYNTH_KEEP,
+    // the timer gets a new tone
+    SYNTH_TONE,
+    // the song is over, the timer can be stopped
+    SYNTH_DONE,
+} synth_result_t;
+
+extern int voices;
+extern bool playing_note;
+extern bool playing_notes;
+extern uint8_t note_tempo;
+extern float note_timbre;
+extern float polyphony_rate;
+#ifdef VIBRATO_ENABLE
+extern float vibrato_strength;
+extern float vibrato_rate;
+#endif
+
+// Timer period of a frequency, with the lower frequencies clamped
+uint16_t synth_period(float freq);
+
+// One step of the glissando from period to target, period is in 1/256 of a
+// timer count
+uint32_t synth_glissando(uint32_t period, uint16_t target);
+
+void synth_play_note(float freq, int vol);
+// Returns true once the last note is stopped
+bool synth_stop_note(float freq);
+void synth_stop_all_notes(void);
+void synth_play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat);
+
+// Called by the timer interrupts once per period of the tone they play.
+// synth_next() plays the notes, or the song, and synth_next_alt() the
+// second note when there's another timer for it.
+synth_result_t synth_next(synth_tone_t *tone);
+synth_result_t synth_next_alt(synth_tone_t *tone);
+
+#endif
@@ -13,11 +13,12 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
+#include <math.h>
 #include "voices.h"
-#include "audio.h"
+#include "musical_notes.h"
 #include "stdlib.h"
 
-// these are imported from audio.c
+// these are imported from audio.c, or synth.c on AVR
 extern uint16_t envelope_index;
 extern float note_timbre;
 extern float polyphony_rate;
@@ -37,6 +38,19 @@ void voice_deiterate() {
     voice = (voice - 1 + number_of_voices) % number_of_voices;
 }
 
+bool voice_envelope_timbre(void) {
+    switch (voice) {
+        case default_voice:
+            glissando = false;
+            note_timbre = TIMBRE_50;
+            polyphony_rate = 0;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
 float voice_envelope(float frequency) {
     // envelope_index ranges from 0 to 0xFFFF, which is preserved at 880.0 Hz
     __attribute__ ((unused))
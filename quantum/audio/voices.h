@@ -25,6 +25,9 @@
 #define VOICES_H
 
 float voice_envelope(float frequency);
+// The envelope of the voices that leave the frequency alone, without any
+// float math. Returns false for the others, they need voice_envelope().
+bool voice_envelope_timbre(void);
 
 typedef enum {
     default_voice,
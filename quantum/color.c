@@ -19,6 +19,24 @@
 #include "led_tables.h"
 #include "progmem.h"
 
+#ifdef COLOR_GAMMA_TABLE
+extern const uint8_t COLOR_GAMMA_TABLE[] PROGMEM;
+#	define color_gamma( x ) pgm_read_byte( &COLOR_GAMMA_TABLE[x] )
+#else
+#	define color_gamma( x ) ( x )
+#endif
+
+// ceil( i * 65536 / 60 ), ( d * HUE360_FRACTION[i] ) >> 16 is d * i / 60
+// rounded down for any d up to 255
+static const uint16_t HUE360_FRACTION[60] PROGMEM = {
+	    0,  1093,  2185,  3277,  4370,  5462,  6554,  7646,  8739,  9831,
+	10923, 12015, 13108, 14200, 15292, 16384, 17477, 18569, 19661, 20754,
+	21846, 22938, 24030, 25123, 26215, 27307, 28399, 29492, 30584, 31676,
+	32768, 33861, 34953, 36045, 37138, 38230, 39322, 40414, 41507, 42599,
+	43691, 44783, 45876, 46968, 48060, 49152, 50245, 51337, 52429, 53522,
+	54614, 55706, 56798, 57891, 58983, 60075, 61167, 62260, 63352, 64444,
+};
+
 RGB hsv_to_rgb( HSV hsv )
 {
 	RGB rgb;
@@ -37,7 +55,8 @@ RGB hsv_to_rgb( HSV hsv )
 	s = hsv.s;
 	v = hsv.v;
 
-	region = h / 43;
+	// h / 43, exact for any 8 bit hue
+	region = ( h * 191 ) >> 13;
 	remainder = (h - (region * 43)) * 6;
 
 	p = (v * (255 - s)) >> 8;
@@ -78,10 +97,92 @@ RGB hsv_to_rgb( HSV hsv )
 			break;
 	}
 
-	rgb.r = pgm_read_byte( &CIE1931_CURVE[rgb.r] );
-	rgb.g = pgm_read_byte( &CIE1931_CURVE[rgb.g] );
-	rgb.b = pgm_read_byte( &CIE1931_CURVE[rgb.b] );
+	rgb.r = color_gamma( rgb.r );
+	rgb.g = color_gamma( rgb.g );
+	rgb.b = color_gamma( rgb.b );
 
 	return rgb;
 }
 
+SV sv_prepare( uint8_t sat, uint8_t val )
+{
+	SV sv;
+	sv.val = val;
+	// achromatic color (gray), the hue doesn't matter
+	sv.base = sat ? ( ( 255 - sat ) * val ) >> 8 : val;
+	sv.range = val - sv.base;
+	return sv;
+}
+
+RGB hue360_to_rgb( SV sv, uint16_t hue )
+{
+	RGB rgb = { 0, 0, 0 };
+	uint8_t sector, color;
+
+	// past 359 is black, unless it's gray anyway
+	if ( hue >= 360 )
+	{
+		if ( sv.range )
+		{
+			return rgb;
+		}
+		hue = 0;
+	}
+
+	// hue / 60, without dividing
+	if ( hue < 180 )
+	{
+		sector = hue < 60 ? 0 : hue < 120 ? 1 : 2;
+	}
+	else
+	{
+		sector = hue < 240 ? 3 : hue < 300 ? 4 : 5;
+	}
+	color = ( (uint32_t)sv.range * pgm_read_word( &HUE360_FRACTION[hue - sector * 60] ) ) >> 16;
+
+	switch ( sector )
+	{
+		case 0:
+			rgb.r = sv.val;
+			rgb.g = sv.base + color;
+			rgb.b = sv.base;
+			break;
+		case 1:
+			rgb.r = sv.val - color;
+			rgb.g = sv.val;
+			rgb.b = sv.base;
+			break;
+		case 2:
+			rgb.r = sv.base;
+			rgb.g = sv.val;
+			rgb.b = sv.base + color;
+			break;
+		case 3:
+			rgb.r = sv.base;
+			rgb.g = sv.val - color;
+			rgb.b = sv.val;
+			break;
+		case 4:
+			rgb.r = sv.base + color;
+			rgb.g = sv.base;
+			rgb.b = sv.val;
+			break;
+		default:
+			rgb.r = sv.val;
+			rgb.g = sv.base;
+			rgb.b = sv.val - color;
+			break;
+	}
+
+	rgb.r = color_gamma( rgb.r );
+	rgb.g = color_gamma( rgb.g );
+	rgb.b = color_gamma( rgb.b );
+
+	return rgb;
+}
+
+RGB hsv360_to_rgb( uint16_t hue, uint8_t sat, uint8_t val )
+{
+	return hue360_to_rgb( sv_prepare( sat, val ), hue );
+}
+
@@ -50,6 +50,30 @@ typedef struct PACKED
 #pragma pack( pop )
 #endif
 
+// The gamma table applied to the converted colors, a 256 byte PROGMEM array.
+// CIE1931_CURVE by default, define COLOR_GAMMA_TABLE to use your own or
+// COLOR_NO_GAMMA to send the values as they are.
+#ifndef COLOR_NO_GAMMA
+#	ifndef COLOR_GAMMA_TABLE
+#		define COLOR_GAMMA_TABLE CIE1931_CURVE
+#	endif
+#endif
+
+// Hue 0-255, as used by the RGB matrix
 RGB hsv_to_rgb( HSV hsv );
 
+// The hue independent part of hue360_to_rgb(), to convert many LEDs of the
+// same saturation and value
+typedef struct
+{
+	uint8_t val;
+	uint8_t base;
+	uint8_t range;
+} SV;
+
+SV sv_prepare( uint8_t sat, uint8_t val );
+// Hue 0-359, as used by rgblight, anything above is black unless sat is 0
+RGB hue360_to_rgb( SV sv, uint16_t hue );
+RGB hsv360_to_rgb( uint16_t hue, uint8_t sat, uint8_t val );
+
 #endif // COLOR_H
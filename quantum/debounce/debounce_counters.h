@@ -0,0 +1,82 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Countdown timers shared by the per key algorithms, one per key, in ms.
+ * A counter of 0 means the key is idle. When DEBOUNCING_DELAY fits in 4 bits
+ * two counters are packed into each byte.
+ */
+
+#ifndef DEBOUNCE_COUNTERS_H
+#define DEBOUNCE_COUNTERS_H
+
+#include <stdint.h>
+#include "timer.h"
+
+#ifndef DEBOUNCING_DELAY
+#   define DEBOUNCING_DELAY 5
+#endif
+
+#if (DEBOUNCING_DELAY > 255)
+#   error "DEBOUNCING_DELAY can't be more than 255 ms with per key debouncing"
+#endif
+
+#define DEBOUNCE_KEYS (MATRIX_ROWS * MATRIX_COLS)
+
+#if (DEBOUNCING_DELAY < 16)
+static uint8_t debounce_counters[(DEBOUNCE_KEYS + 1) / 2];
+
+static inline uint8_t debounce_counter_get(uint16_t key)
+{
+    return (debounce_counters[key / 2] >> ((key & 1) * 4)) & 0x0F;
+}
+
+static inline void debounce_counter_set(uint16_t key, uint8_t value)
+{
+    const uint8_t shift = (key & 1) * 4;
+    debounce_counters[key / 2] = (debounce_counters[key / 2] & ~(0x0F << shift)) | (value << shift);
+}
+#else
+static uint8_t debounce_counters[DEBOUNCE_KEYS];
+
+static inline uint8_t debounce_counter_get(uint16_t key)
+{
+    return debounce_counters[key];
+}
+
+static inline void debounce_counter_set(uint16_t key, uint8_t value)
+{
+    debounce_counters[key] = value;
+}
+#endif
+
+static inline void debounce_counters_clear(void)
+{
+    for (uint16_t i = 0; i < sizeof(debounce_counters); i++) {
+        debounce_counters[i] = 0;
+    }
+}
+
+/* ms elapsed since the previous call, saturated to 255 */
+static inline uint8_t debounce_elapsed(void)
+{
+    static uint16_t last_time = 0;
+    const uint16_t now = timer_read();
+    const uint16_t elapsed = TIMER_DIFF_16(now, last_time);
+    last_time = now;
+    return elapsed > 255 ? 255 : elapsed;
+}
+
+#endif
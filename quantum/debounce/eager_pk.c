@@ -0,0 +1,97 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Eager, per key debouncing.
+ *
+ * A change is reported as soon as it is seen, then the key ignores any
+ * further change for DEBOUNCING_DELAY ms.
+ */
+
+#include "debounce.h"
+#include "debounce_counters.h"
+
+static bool counters_active = false;
+
+void debounce_init(uint8_t num_rows)
+{
+    debounce_counters_clear();
+    counters_active = false;
+}
+
+/* Counts down the lockout timers, returns true if any of them expired */
+static bool update_counters(uint8_t num_rows, uint8_t elapsed)
+{
+    bool expired = false;
+    counters_active = false;
+    for (uint16_t key = 0; key < num_rows * MATRIX_COLS; key++) {
+        uint8_t counter = debounce_counter_get(key);
+        if (!counter) {
+            continue;
+        }
+        if (counter <= elapsed) {
+            debounce_counter_set(key, 0);
+            expired = true;
+        } else {
+            debounce_counter_set(key, counter - elapsed);
+            counters_active = true;
+        }
+    }
+    return expired;
+}
+
+/* Commits the changes of the keys that aren't locked out, and locks them */
+static void transfer_matrix_values(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows)
+{
+    uint16_t key = 0;
+    for (uint8_t row = 0; row < num_rows; row++, key += MATRIX_COLS) {
+        const matrix_row_t delta = raw[row] ^ cooked[row];
+        if (!delta) {
+            continue;
+        }
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            const matrix_row_t mask = (matrix_row_t)1 << col;
+            if ((delta & mask) && !debounce_counter_get(key + col)) {
+                cooked[row] ^= mask;
+                debounce_counter_set(key + col, DEBOUNCING_DELAY);
+                counters_active = true;
+            }
+        }
+    }
+}
+
+void debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed)
+{
+#if (DEBOUNCING_DELAY > 0)
+    const uint8_t elapsed = debounce_elapsed();
+    bool expired = false;
+    if (counters_active && elapsed) {
+        expired = update_counters(num_rows, elapsed);
+    }
+    // a key may have changed state while it was locked out
+    if (changed || expired) {
+        transfer_matrix_values(raw, cooked, num_rows);
+    }
+#else
+    for (uint8_t i = 0; i < num_rows; i++) {
+        cooked[i] = raw[i];
+    }
+#endif
+}
+
+bool debounce_active(void)
+{
+    return counters_active;
+}
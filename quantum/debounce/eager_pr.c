@@ -0,0 +1,102 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Eager, per row debouncing.
+ *
+ * Same as eager_pk, but the whole row is locked out after a change, which
+ * only needs one counter per row.
+ */
+
+#include "debounce.h"
+#include "timer.h"
+
+#ifndef DEBOUNCING_DELAY
+#   define DEBOUNCING_DELAY 5
+#endif
+
+#if (DEBOUNCING_DELAY > 255)
+#   error "DEBOUNCING_DELAY can't be more than 255 ms with per row debouncing"
+#endif
+
+static uint8_t row_counters[MATRIX_ROWS];
+static bool counters_active = false;
+static uint16_t last_time;
+
+void debounce_init(uint8_t num_rows)
+{
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        row_counters[row] = 0;
+    }
+    counters_active = false;
+}
+
+/* Counts down the lockout timers, returns true if any of them expired */
+static bool update_counters(uint8_t num_rows, uint8_t elapsed)
+{
+    bool expired = false;
+    counters_active = false;
+    for (uint8_t row = 0; row < num_rows; row++) {
+        if (!row_counters[row]) {
+            continue;
+        }
+        if (row_counters[row] <= elapsed) {
+            row_counters[row] = 0;
+            expired = true;
+        } else {
+            row_counters[row] -= elapsed;
+            counters_active = true;
+        }
+    }
+    return expired;
+}
+
+/* Commits the rows that changed and aren't locked out, and locks them */
+static void transfer_matrix_values(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows)
+{
+    for (uint8_t row = 0; row < num_rows; row++) {
+        if (raw[row] != cooked[row] && !row_counters[row]) {
+            cooked[row] = raw[row];
+            row_counters[row] = DEBOUNCING_DELAY;
+            counters_active = true;
+        }
+    }
+}
+
+void debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed)
+{
+#if (DEBOUNCING_DELAY > 0)
+    const uint16_t now = timer_read();
+    const uint16_t elapsed = TIMER_DIFF_16(now, last_time);
+    last_time = now;
+    bool expired = false;
+    if (counters_active && elapsed) {
+        expired = update_counters(num_rows, elapsed > 255 ? 255 : elapsed);
+    }
+    // a row may have changed while it was locked out
+    if (changed || expired) {
+        transfer_matrix_values(raw, cooked, num_rows);
+    }
+#else
+    for (uint8_t i = 0; i < num_rows; i++) {
+        cooked[i] = raw[i];
+    }
+#endif
+}
+
+bool debounce_active(void)
+{
+    return counters_active;
+}
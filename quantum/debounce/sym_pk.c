@@ -0,0 +1,98 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Symmetric, per key, deferred debouncing.
+ *
+ * A key has to hold its new state for DEBOUNCING_DELAY ms before it is
+ * committed, bounces restart its own timer without delaying other keys.
+ */
+
+#include "debounce.h"
+#include "debounce_counters.h"
+
+static bool counters_active = false;
+
+void debounce_init(uint8_t num_rows)
+{
+    debounce_counters_clear();
+    counters_active = false;
+}
+
+/* Counts down the running timers, commits the keys whose timer expired */
+static void update_counters(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, uint8_t elapsed)
+{
+    counters_active = false;
+    uint16_t key = 0;
+    for (uint8_t row = 0; row < num_rows; row++) {
+        for (uint8_t col = 0; col < MATRIX_COLS; col++, key++) {
+            uint8_t counter = debounce_counter_get(key);
+            if (!counter) {
+                continue;
+            }
+            if (counter <= elapsed) {
+                const matrix_row_t mask = (matrix_row_t)1 << col;
+                cooked[row] = (cooked[row] & ~mask) | (raw[row] & mask);
+                debounce_counter_set(key, 0);
+            } else {
+                debounce_counter_set(key, counter - elapsed);
+                counters_active = true;
+            }
+        }
+    }
+}
+
+/* Starts the timer of keys that moved away from their debounced state and
+ * cancels it for the ones that bounced back
+ */
+static void start_counters(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows)
+{
+    uint16_t key = 0;
+    for (uint8_t row = 0; row < num_rows; row++, key += MATRIX_COLS) {
+        const matrix_row_t delta = raw[row] ^ cooked[row];
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            if (delta & ((matrix_row_t)1 << col)) {
+                if (!debounce_counter_get(key + col)) {
+                    debounce_counter_set(key + col, DEBOUNCING_DELAY);
+                }
+                counters_active = true;
+            } else {
+                debounce_counter_set(key + col, 0);
+            }
+        }
+    }
+}
+
+void debounce(matrix_row_t raw[], matrix_row_t cooked[], uint8_t num_rows, bool changed)
+{
+#if (DEBOUNCING_DELAY > 0)
+    const uint8_t elapsed = debounce_elapsed();
+    if (counters_active && elapsed) {
+        update_counters(raw, cooked, num_rows, elapsed);
+    }
+    if (changed) {
+        start_counters(raw, cooked, num_rows);
+    }
+#else
+    for (uint8_t i = 0; i < num_rows; i++) {
+        cooked[i] = raw[i];
+    }
+#endif
+}
+
+bool debounce_active(void)
+{
+    return counters_active;
+}
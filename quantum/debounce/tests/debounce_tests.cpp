@@ -0,0 +1,245 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <iostream>
+#include <vector>
+extern "C" {
+#include "debounce.h"
+#include "timer.h"
+void set_time(uint32_t t);
+void advance_time(uint32_t ms);
+}
+
+#if defined(DEBOUNCE_EAGER) && defined(DEBOUNCE_PER_KEY)
+static const char* algorithm = "eager_pk";
+#elif defined(DEBOUNCE_EAGER)
+static const char* algorithm = "eager_pr";
+#elif defined(DEBOUNCE_PER_KEY)
+static const char* algorithm = "sym_pk";
+#else
+static const char* algorithm = "sym_g";
+#endif
+
+struct Edge {
+    uint32_t time;
+    uint8_t row;
+    uint8_t col;
+    bool pressed;
+};
+
+struct Result {
+    unsigned events;
+    unsigned false_events;
+    unsigned missed_events;
+    unsigned max_latency;
+    double avg_latency;
+};
+
+class Debounce : public testing::Test {
+protected:
+    Debounce() {
+        set_time(1000);
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            m_raw[row] = 0;
+            m_cooked[row] = 0;
+        }
+        debounce_init(MATRIX_ROWS);
+        // settle the algorithm with a few idle scans
+        scan(20);
+    }
+
+    void scan(unsigned ms) {
+        for (unsigned i = 0; i < ms; i++) {
+            debounce(m_raw, m_cooked, MATRIX_ROWS, false);
+            advance_time(1);
+        }
+    }
+
+    // Feeds a recorded trace of raw switch edges, scanning once per ms, and
+    // compares the debounced edges against the ones the user meant to make.
+    // Edges of the `ignored` key aren't counted as false events.
+    Result run(const char* name, const std::vector<Edge>& trace,
+            const std::vector<Edge>& expected, uint32_t duration,
+            const Edge* ignored = nullptr) {
+        std::vector<Edge> cooked_edges;
+        const uint32_t start = timer_read32();
+        size_t next = 0;
+        for (uint32_t t = 0; t < duration; t++) {
+            matrix_row_t previous[MATRIX_ROWS];
+            bool changed = false;
+            for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+                previous[row] = m_cooked[row];
+            }
+            for (; next < trace.size() && trace[next].time == t; next++) {
+                const Edge& edge = trace[next];
+                matrix_row_t mask = (matrix_row_t)1 << edge.col;
+                matrix_row_t row = edge.pressed ? m_raw[edge.row] | mask : m_raw[edge.row] & ~mask;
+                changed |= row != m_raw[edge.row];
+                m_raw[edge.row] = row;
+            }
+            debounce(m_raw, m_cooked, MATRIX_ROWS, changed);
+            for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+                matrix_row_t delta = previous[row] ^ m_cooked[row];
+                for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                    if (delta & ((matrix_row_t)1 << col)) {
+                        cooked_edges.push_back({t, row, col, (bool)(m_cooked[row] & ((matrix_row_t)1 << col))});
+                    }
+                }
+            }
+            advance_time(1);
+        }
+        EXPECT_EQ(timer_read32() - start, duration);
+
+        Result result = {0, 0, 0, 0, 0.0};
+        unsigned total_latency = 0;
+        std::vector<bool> matched(cooked_edges.size(), false);
+        for (const Edge& want : expected) {
+            bool found = false;
+            for (size_t i = 0; i < cooked_edges.size(); i++) {
+                const Edge& got = cooked_edges[i];
+                if (!matched[i] && got.row == want.row && got.col == want.col &&
+                        got.pressed == want.pressed && got.time >= want.time) {
+                    matched[i] = true;
+                    found = true;
+                    unsigned latency = got.time - want.time;
+                    total_latency += latency;
+                    result.max_latency = std::max(result.max_latency, latency);
+                    result.events++;
+                    break;
+                }
+            }
+            if (!found) {
+                result.missed_events++;
+            }
+        }
+        for (size_t i = 0; i < cooked_edges.size(); i++) {
+            if (matched[i] || (ignored && cooked_edges[i].row == ignored->row &&
+                    cooked_edges[i].col == ignored->col)) {
+                continue;
+            }
+            result.false_events++;
+        }
+        if (result.events) {
+            result.avg_latency = (double)total_latency / result.events;
+        }
+        std::cout << "[ DEBOUNCE ] " << algorithm << " " << name
+            << ": added latency avg " << result.avg_latency << " ms, max " << result.max_latency
+            << " ms, false events " << result.false_events
+            << ", missed events " << result.missed_events << std::endl;
+        return result;
+    }
+
+    matrix_row_t m_raw[MATRIX_ROWS];
+    matrix_row_t m_cooked[MATRIX_ROWS];
+};
+
+TEST_F(Debounce, CleanTap) {
+    Result result = run("clean tap",
+        {{10, 0, 0, true}, {60, 0, 0, false}},
+        {{10, 0, 0, true}, {60, 0, 0, false}},
+        100);
+    EXPECT_EQ(result.events, 2);
+    EXPECT_EQ(result.false_events, 0);
+#ifdef DEBOUNCE_EAGER
+    EXPECT_EQ(result.max_latency, 0);
+#else
+    EXPECT_LE(result.max_latency, DEBOUNCING_DELAY + 1);
+#endif
+}
+
+TEST_F(Debounce, BouncyTap) {
+    // Recorded from a worn switch, the press bounces for 4 ms and the release for 3 ms
+    Result result = run("bouncy tap",
+        {
+            {10, 0, 0, true}, {11, 0, 0, false}, {12, 0, 0, true}, {13, 0, 0, false}, {14, 0, 0, true},
+            {80, 0, 0, false}, {81, 0, 0, true}, {83, 0, 0, false},
+        },
+        {{10, 0, 0, true}, {80, 0, 0, false}},
+        130);
+    EXPECT_EQ(result.events, 2);
+    EXPECT_EQ(result.false_events, 0);
+#ifdef DEBOUNCE_EAGER
+    EXPECT_EQ(result.max_latency, 0);
+#else
+    // the key only settles after the last bounce
+    EXPECT_LE(result.max_latency, 4 + DEBOUNCING_DELAY + 1);
+#endif
+}
+
+TEST_F(Debounce, FastRollOverOnTheSameRow) {
+    Result result = run("fast roll",
+        {
+            {10, 1, 0, true}, {25, 1, 1, true}, {35, 1, 0, false}, {45, 1, 2, true},
+            {50, 1, 1, false}, {70, 1, 2, false},
+        },
+        {
+            {10, 1, 0, true}, {25, 1, 1, true}, {35, 1, 0, false}, {45, 1, 2, true},
+            {50, 1, 1, false}, {70, 1, 2, false},
+        },
+        100);
+    EXPECT_EQ(result.events, 6);
+    EXPECT_EQ(result.false_events, 0);
+}
+
+TEST_F(Debounce, KeyPressedWhileAnotherKeyChatters) {
+    // Key 3,9 chatters every 2 ms for 60 ms
+    std::vector<Edge> trace;
+    for (uint32_t t = 0; t < 60; t += 2) {
+        trace.push_back({t, 3, 9, (t / 2) % 2 == 0});
+        if (t == 10) {
+            trace.push_back({t, 0, 0, true});
+        }
+        if (t == 40) {
+            trace.push_back({t, 0, 0, false});
+        }
+    }
+    trace.push_back({60, 3, 9, false});
+    const Edge chattering = {0, 3, 9, false};
+    Result result = run("press during chatter", trace,
+        {{10, 0, 0, true}, {40, 0, 0, false}},
+        120, &chattering);
+    EXPECT_EQ(result.false_events, 0);
+#if defined(DEBOUNCE_EAGER)
+    EXPECT_EQ(result.events, 2);
+    EXPECT_EQ(result.max_latency, 0);
+#elif defined(DEBOUNCE_PER_KEY)
+    EXPECT_EQ(result.events, 2);
+    EXPECT_LE(result.max_latency, DEBOUNCING_DELAY + 1);
+#else
+    // the global timer keeps being restarted by the other key, the whole
+    // tap is over before the matrix is committed and it never gets reported
+    EXPECT_EQ(result.missed_events, 2);
+#endif
+}
+
+TEST_F(Debounce, NoiseSpike) {
+    // A 1 ms glitch, not a real key press
+    Result result = run("noise spike",
+        {{30, 2, 4, true}, {31, 2, 4, false}},
+        {},
+        60);
+#ifdef DEBOUNCE_EAGER
+    // reported as a tap, the price of not waiting
+    EXPECT_EQ(result.false_events, 2);
+#else
+    EXPECT_EQ(result.false_events, 0);
+#endif
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        EXPECT_EQ(m_cooked[row], 0);
+    }
+    EXPECT_FALSE(debounce_active());
+}
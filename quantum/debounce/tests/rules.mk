@@ -0,0 +1,41 @@
+# Copyright 2018 QMK
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# The same simulation runs against every algorithm
+DEBOUNCE_COMMON_DEFS := -DMATRIX_ROWS=4 -DMATRIX_COLS=10 -DDEBOUNCING_DELAY=5
+
+DEBOUNCE_COMMON_SRC := \
+	$(QUANTUM_PATH)/debounce/tests/debounce_tests.cpp \
+	$(TMK_PATH)/common/test/timer.c
+
+debounce_sym_g_DEFS := $(DEBOUNCE_COMMON_DEFS)
+debounce_sym_g_SRC := \
+	$(DEBOUNCE_COMMON_SRC) \
+	$(QUANTUM_PATH)/debounce/sym_g.c
+
+debounce_sym_pk_DEFS := $(DEBOUNCE_COMMON_DEFS) -DDEBOUNCE_PER_KEY
+debounce_sym_pk_SRC := \
+	$(DEBOUNCE_COMMON_SRC) \
+	$(QUANTUM_PATH)/debounce/sym_pk.c
+
+debounce_eager_pk_DEFS := $(DEBOUNCE_COMMON_DEFS) -DDEBOUNCE_PER_KEY -DDEBOUNCE_EAGER
+debounce_eager_pk_SRC := \
+	$(DEBOUNCE_COMMON_SRC) \
+	$(QUANTUM_PATH)/debounce/eager_pk.c
+
+debounce_eager_pr_DEFS := $(DEBOUNCE_COMMON_DEFS) -DDEBOUNCE_EAGER
+debounce_eager_pr_SRC := \
+	$(DEBOUNCE_COMMON_SRC) \
+	$(QUANTUM_PATH)/debounce/eager_pr.c
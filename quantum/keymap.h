@@ -49,6 +49,13 @@ uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key);
 // translates function id to action
 uint16_t keymap_function_id_to_action( uint16_t function_id );
 
+// translates keycode to action, range by range
+action_t keycode_to_action_switch(uint16_t keycode);
+#ifdef KEYCODE_DECODE_TABLE
+// translates keycode to action, through a decoder table indexed by the keycode
+action_t keycode_to_action_table(uint16_t keycode);
+#endif
+
 extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
 extern const uint16_t fn_actions[];
 
@@ -46,6 +46,16 @@ action_t action_for_key(uint8_t layer, keypos_t key)
     // keycode remapping
     keycode = keycode_config(keycode);
 
+#ifdef KEYCODE_DECODE_TABLE
+    return keycode_to_action_table(keycode);
+#else
+    return keycode_to_action_switch(keycode);
+#endif
+}
+
+/* converts keycode to action, one range at a time */
+action_t keycode_to_action_switch(uint16_t keycode)
+{
     action_t action;
     uint8_t action_layer, when, mod;
 
@@ -164,6 +174,158 @@ action_t action_for_key(uint8_t layer, keypos_t key)
     return action;
 }
 
+#ifdef KEYCODE_DECODE_TABLE
+/* Decoders used by keycode_to_action_table(), one per kind of keycode */
+enum keycode_decoders {
+    KD_NO = 0,
+    KD_BASIC,
+    KD_KEY,
+    KD_TRANSPARENT,
+    KD_SYSTEM,
+    KD_CONSUMER,
+    KD_MOUSEKEY,
+    KD_FN,
+    KD_MODS,
+    KD_FUNCTION,
+    KD_MACRO,
+    KD_LAYER_TAP,
+    KD_TO,
+    KD_MOMENTARY,
+    KD_DEF_LAYER,
+    KD_TOGGLE_LAYER,
+    KD_ONE_SHOT_LAYER,
+    KD_ONE_SHOT_MOD,
+    KD_LAYER_TAP_TOGGLE,
+    KD_LAYER_MOD,
+    KD_MOD_TAP,
+    KD_SWAP_HANDS,
+    KD_QUANTUM,
+};
+
+/* Decoder for each high byte of a keycode */
+static const uint8_t PROGMEM keycode_page_decoders[256] = {
+    [QK_TMK >> 8]                                          = KD_BASIC,
+    [QK_MODS >> 8 ... QK_MODS_MAX >> 8]                    = KD_MODS,
+    [QK_FUNCTION >> 8 ... QK_FUNCTION_MAX >> 8]            = KD_FUNCTION,
+    [QK_MACRO >> 8 ... QK_MACRO_MAX >> 8]                  = KD_MACRO,
+    [QK_LAYER_TAP >> 8 ... QK_LAYER_TAP_MAX >> 8]          = KD_LAYER_TAP,
+    [QK_TO >> 8]                                           = KD_TO,
+    [QK_MOMENTARY >> 8]                                    = KD_MOMENTARY,
+    [QK_DEF_LAYER >> 8]                                    = KD_DEF_LAYER,
+    [QK_TOGGLE_LAYER >> 8]                                 = KD_TOGGLE_LAYER,
+    [QK_ONE_SHOT_LAYER >> 8]                               = KD_ONE_SHOT_LAYER,
+    [QK_ONE_SHOT_MOD >> 8]                                 = KD_ONE_SHOT_MOD,
+    [QK_LAYER_TAP_TOGGLE >> 8]                             = KD_LAYER_TAP_TOGGLE,
+    [QK_LAYER_MOD >> 8]                                    = KD_LAYER_MOD,
+#ifdef SWAP_HANDS_ENABLE
+    [QK_SWAP_HANDS >> 8]                                   = KD_SWAP_HANDS,
+#endif
+#ifdef BACKLIGHT_ENABLE
+    [BL_ON >> 8 ... BL_STEP >> 8]                          = KD_QUANTUM,
+#endif
+    [QK_MOD_TAP >> 8 ... QK_MOD_TAP_MAX >> 8]              = KD_MOD_TAP,
+};
+
+/* Decoder for each basic (QK_TMK) keycode */
+static const uint8_t PROGMEM keycode_basic_decoders[256] = {
+    [KC_TRNS]                                              = KD_TRANSPARENT,
+    [KC_A ... KC_EXSEL]                                    = KD_KEY,
+    [KC_SYSTEM_POWER ... KC_SYSTEM_WAKE]                   = KD_SYSTEM,
+    [KC_AUDIO_MUTE ... KC_MEDIA_REWIND]                    = KD_CONSUMER,
+    [KC_FN0 ... KC_FN31]                                   = KD_FN,
+    [KC_LCTRL ... KC_RGUI]                                 = KD_KEY,
+    [KC_MS_UP ... KC_MS_ACCEL2]                            = KD_MOUSEKEY,
+};
+
+/* converts keycode to action, through the decoder tables */
+action_t keycode_to_action_table(uint16_t keycode)
+{
+    action_t action;
+    uint8_t decoder = pgm_read_byte(&keycode_page_decoders[keycode >> 8]);
+    if (decoder == KD_BASIC) {
+        decoder = pgm_read_byte(&keycode_basic_decoders[keycode & 0xFF]);
+    }
+
+    switch (decoder) {
+        case KD_KEY:
+            action.code = ACTION_KEY(keycode);
+            break;
+        case KD_TRANSPARENT:
+            action.code = ACTION_TRANSPARENT;
+            break;
+        case KD_SYSTEM:
+            action.code = ACTION_USAGE_SYSTEM(KEYCODE2SYSTEM(keycode));
+            break;
+        case KD_CONSUMER:
+            action.code = ACTION_USAGE_CONSUMER(KEYCODE2CONSUMER(keycode));
+            break;
+        case KD_MOUSEKEY:
+            action.code = ACTION_MOUSEKEY(keycode);
+            break;
+        case KD_FN:
+            action.code = keymap_function_id_to_action(FN_INDEX(keycode));
+            break;
+        case KD_MODS:
+            action.code = ACTION_MODS_KEY(keycode >> 8, keycode & 0xFF);
+            break;
+        case KD_FUNCTION:
+            action.code = keymap_function_id_to_action( (int)keycode & 0xFFF );
+            break;
+        case KD_MACRO:
+            if (keycode & 0x800) // tap macros have upper bit set
+                action.code = ACTION_MACRO_TAP(keycode & 0xFF);
+            else
+                action.code = ACTION_MACRO(keycode & 0xFF);
+            break;
+        case KD_LAYER_TAP:
+            action.code = ACTION_LAYER_TAP_KEY((keycode >> 0x8) & 0xF, keycode & 0xFF);
+            break;
+        case KD_TO:
+            action.code = ACTION_LAYER_SET(keycode & 0xF, (keycode >> 0x4) & 0x3);
+            break;
+        case KD_MOMENTARY:
+            action.code = ACTION_LAYER_MOMENTARY(keycode & 0xFF);
+            break;
+        case KD_DEF_LAYER:
+            action.code = ACTION_DEFAULT_LAYER_SET(keycode & 0xFF);
+            break;
+        case KD_TOGGLE_LAYER:
+            action.code = ACTION_LAYER_TOGGLE(keycode & 0xFF);
+            break;
+        case KD_ONE_SHOT_LAYER:
+            action.code = ACTION_LAYER_ONESHOT(keycode & 0xFF);
+            break;
+        case KD_ONE_SHOT_MOD:
+            action.code = ACTION_MODS_ONESHOT(keycode & 0xFF);
+            break;
+        case KD_LAYER_TAP_TOGGLE:
+            action.code = ACTION_LAYER_TAP_TOGGLE(keycode & 0xFF);
+            break;
+        case KD_LAYER_MOD:
+            action.code = ACTION_LAYER_MODS((keycode >> 4) & 0xF, keycode & 0xF);
+            break;
+        case KD_MOD_TAP:
+            action.code = ACTION_MODS_TAP_KEY(mod_config((keycode >> 0x8) & 0x1F), keycode & 0xFF);
+            break;
+    #ifdef SWAP_HANDS_ENABLE
+        case KD_SWAP_HANDS:
+            action.code = ACTION(ACT_SWAP_HANDS, keycode & 0xff);
+            break;
+    #endif
+    #ifdef BACKLIGHT_ENABLE
+        case KD_QUANTUM:
+            // the only loose quantum keycodes with an action
+            action = keycode_to_action_switch(keycode);
+            break;
+    #endif
+        default:
+            action.code = ACTION_NO;
+            break;
+    }
+    return action;
+}
+#endif
+
 __attribute__ ((weak))
 const uint16_t PROGMEM fn_actions[] = {
 
@@ -25,18 +25,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "util.h"
 #include "matrix.h"
 #include "timer.h"
-
-
-/* Set 0 if debouncing isn't needed */
-
-#ifndef DEBOUNCING_DELAY
-#   define DEBOUNCING_DELAY 5
-#endif
-
-#if (DEBOUNCING_DELAY > 0)
-    static uint16_t debouncing_time;
-    static bool debouncing = false;
-#endif
+#include "debounce.h"
 
 #if (MATRIX_COLS <= 8)
 #    define print_matrix_header()  print("\nr/c 01234567\n")
@@ -59,16 +48,55 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
     extern const matrix_row_t matrix_mask[];
 #endif
 
+/* Time for a selected line to settle before its inputs are read, in us */
+#ifndef MATRIX_IO_DELAY
+#    define MATRIX_IO_DELAY 30
+#endif
+
 #if (DIODE_DIRECTION == ROW2COL) || (DIODE_DIRECTION == COL2ROW)
 static const uint8_t row_pins[MATRIX_ROWS] = MATRIX_ROW_PINS;
 static const uint8_t col_pins[MATRIX_COLS] = MATRIX_COL_PINS;
 #endif
 
 /* matrix state(1:on, 0:off) */
-static matrix_row_t matrix[MATRIX_ROWS];
+static matrix_row_t raw_matrix[MATRIX_ROWS]; //raw values
+static matrix_row_t matrix[MATRIX_ROWS]; //debounced values
+
+#ifdef MATRIX_IDLE_SCAN
+static bool raw_matrix_empty;
+#endif
 
-static matrix_row_t matrix_debouncing[MATRIX_ROWS];
+#ifdef DEBUG_MATRIX_SCAN_RATE
+static uint32_t matrix_timer;
+static uint32_t matrix_scan_count;
+#endif
+
+#if (DIODE_DIRECTION == COL2ROW)
+#    define MATRIX_INPUTS MATRIX_COLS
+#    define input_pins    col_pins
+#elif (DIODE_DIRECTION == ROW2COL)
+#    define MATRIX_INPUTS MATRIX_ROWS
+#    define input_pins    row_pins
+#endif
 
+#if (DIODE_DIRECTION == ROW2COL) || (DIODE_DIRECTION == COL2ROW)
+/* The input pins grouped by port, so that every port is read once per line
+ * instead of once per pin */
+static uint8_t input_port_count;
+static uint8_t input_port_addr[MATRIX_INPUTS];  // PINx
+static uint8_t input_port_mask[MATRIX_INPUTS];  // the input pins of the port
+static uint8_t input_port_index[MATRIX_INPUTS]; // port of each input pin
+
+#    define input_is_low(port_state, i) \
+        (!((port_state)[input_port_index[i]] & _BV(input_pins[i] & 0xF)))
+
+static void init_input_ports(void);
+static void read_input_ports(uint8_t port_state[]);
+static bool scan_lines(void);
+#    ifdef MATRIX_IDLE_SCAN
+static bool any_input_low(void);
+#    endif
+#endif
 
 #if (DIODE_DIRECTION == COL2ROW)
     static void init_cols(void);
@@ -76,12 +104,18 @@ static matrix_row_t matrix_debouncing[MATRIX_ROWS];
     static void unselect_rows(void);
     static void select_row(uint8_t row);
     static void unselect_row(uint8_t row);
+#    ifdef MATRIX_IDLE_SCAN
+    static void select_rows(void);
+#    endif
 #elif (DIODE_DIRECTION == ROW2COL)
     static void init_rows(void);
     static bool read_rows_on_col(matrix_row_t current_matrix[], uint8_t current_col);
     static void unselect_cols(void);
     static void unselect_col(uint8_t col);
     static void select_col(uint8_t col);
+#    ifdef MATRIX_IDLE_SCAN
+    static void select_cols(void);
+#    endif
 #endif
 
 __attribute__ ((weak))
@@ -162,63 +196,66 @@ void matrix_init(void) {
     unselect_cols();
     init_rows();
 #endif
+#if (DIODE_DIRECTION == ROW2COL) || (DIODE_DIRECTION == COL2ROW)
+    init_input_ports();
+#endif
 
     // initialize matrix state: all keys off
     for (uint8_t i=0; i < MATRIX_ROWS; i++) {
         matrix[i] = 0;
-        matrix_debouncing[i] = 0;
+        raw_matrix[i] = 0;
     }
+#ifdef MATRIX_IDLE_SCAN
+    raw_matrix_empty = true;
+#endif
+
+#ifdef DEBUG_MATRIX_SCAN_RATE
+    matrix_timer = timer_read32();
+    matrix_scan_count = 0;
+#endif
+
+    debounce_init(MATRIX_ROWS);
 
     matrix_init_quantum();
 }
 
 uint8_t matrix_scan(void)
 {
-
-#if (DIODE_DIRECTION == COL2ROW)
-
-    // Set row, read cols
-    for (uint8_t current_row = 0; current_row < MATRIX_ROWS; current_row++) {
-#       if (DEBOUNCING_DELAY > 0)
-            bool matrix_changed = read_cols_on_row(matrix_debouncing, current_row);
-
-            if (matrix_changed) {
-                debouncing = true;
-                debouncing_time = timer_read();
+    bool changed = false;
+
+#if defined(MATRIX_IDLE_SCAN) && ((DIODE_DIRECTION == COL2ROW) || (DIODE_DIRECTION == ROW2COL))
+    // While no key is down a single read with every line selected tells
+    // whether that is still the case, the full scan is only needed otherwise
+    if (!raw_matrix_empty || any_input_low()) {
+        changed = scan_lines();
+
+        raw_matrix_empty = true;
+        for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+            if (raw_matrix[i]) {
+                raw_matrix_empty = false;
+                break;
             }
-
-#       else
-            read_cols_on_row(matrix, current_row);
-#       endif
-
+        }
     }
+#elif (DIODE_DIRECTION == COL2ROW) || (DIODE_DIRECTION == ROW2COL)
+    changed = scan_lines();
+#endif
 
-#elif (DIODE_DIRECTION == ROW2COL)
+#ifdef DEBUG_MATRIX_SCAN_RATE
+    matrix_scan_count++;
 
-    // Set col, read rows
-    for (uint8_t current_col = 0; current_col < MATRIX_COLS; current_col++) {
-#       if (DEBOUNCING_DELAY > 0)
-            bool matrix_changed = read_rows_on_col(matrix_debouncing, current_col);
-            if (matrix_changed) {
-                debouncing = true;
-                debouncing_time = timer_read();
-            }
-#       else
-             read_rows_on_col(matrix, current_col);
-#       endif
+    uint32_t timer_now = timer_read32();
+    if (TIMER_DIFF_32(timer_now, matrix_timer)>1000) {
+        print("matrix scan frequency: ");
+        pdec(matrix_scan_count);
+        print("\n");
 
+        matrix_timer = timer_now;
+        matrix_scan_count = 0;
     }
-
 #endif
 
-#   if (DEBOUNCING_DELAY > 0)
-        if (debouncing && (timer_elapsed(debouncing_time) > DEBOUNCING_DELAY)) {
-            for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
-                matrix[i] = matrix_debouncing[i];
-            }
-            debouncing = false;
-        }
-#   endif
+    debounce(raw_matrix, matrix, MATRIX_ROWS, changed);
 
     matrix_scan_quantum();
     return 1;
@@ -226,9 +263,7 @@ uint8_t matrix_scan(void)
 
 bool matrix_is_modified(void)
 {
-#if (DEBOUNCING_DELAY > 0)
-    if (debouncing) return false;
-#endif
+    if (debounce_active()) return false;
     return true;
 }
 
@@ -271,6 +306,81 @@ uint8_t matrix_key_count(void)
 }
 
 
+#if (DIODE_DIRECTION == ROW2COL) || (DIODE_DIRECTION == COL2ROW)
+
+static void init_input_ports(void)
+{
+    input_port_count = 0;
+    for (uint8_t i = 0; i < MATRIX_INPUTS; i++) {
+        uint8_t addr = input_pins[i] >> 4;
+        uint8_t port = 0;
+        while (port < input_port_count && input_port_addr[port] != addr) {
+            port++;
+        }
+        if (port == input_port_count) {
+            input_port_addr[port] = addr;
+            input_port_mask[port] = 0;
+            input_port_count++;
+        }
+        input_port_mask[port] |= _BV(input_pins[i] & 0xF);
+        input_port_index[i] = port;
+    }
+}
+
+static void read_input_ports(uint8_t port_state[])
+{
+    for (uint8_t port = 0; port < input_port_count; port++) {
+        port_state[port] = _SFR_IO8(input_port_addr[port]);
+    }
+}
+
+static bool scan_lines(void)
+{
+    bool changed = false;
+
+#if (DIODE_DIRECTION == COL2ROW)
+    // Set row, read cols
+    for (uint8_t current_row = 0; current_row < MATRIX_ROWS; current_row++) {
+        changed |= read_cols_on_row(raw_matrix, current_row);
+    }
+#elif (DIODE_DIRECTION == ROW2COL)
+    // Set col, read rows
+    for (uint8_t current_col = 0; current_col < MATRIX_COLS; current_col++) {
+        changed |= read_rows_on_col(raw_matrix, current_col);
+    }
+#endif
+
+    return changed;
+}
+
+#ifdef MATRIX_IDLE_SCAN
+static bool any_input_low(void)
+{
+    uint8_t port_state[MATRIX_INPUTS];
+
+#if (DIODE_DIRECTION == COL2ROW)
+    select_rows();
+    wait_us(MATRIX_IO_DELAY);
+    read_input_ports(port_state);
+    unselect_rows();
+#elif (DIODE_DIRECTION == ROW2COL)
+    select_cols();
+    wait_us(MATRIX_IO_DELAY);
+    read_input_ports(port_state);
+    unselect_cols();
+#endif
+
+    for (uint8_t port = 0; port < input_port_count; port++) {
+        if ((port_state[port] & input_port_mask[port]) != input_port_mask[port]) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+#endif
+
 
 #if (DIODE_DIRECTION == COL2ROW)
 
@@ -293,22 +403,22 @@ static bool read_cols_on_row(matrix_row_t current_matrix[], uint8_t current_row)
 
     // Select row and wait for row selecton to stabilize
     select_row(current_row);
-    wait_us(30);
+    wait_us(MATRIX_IO_DELAY);
+
+    // Read the ports of all cols at once
+    uint8_t port_state[MATRIX_INPUTS];
+    read_input_ports(port_state);
+
+    // Unselect row
+    unselect_row(current_row);
 
     // For each col...
     for(uint8_t col_index = 0; col_index < MATRIX_COLS; col_index++) {
 
-        // Select the col pin to read (active low)
-        uint8_t pin = col_pins[col_index];
-        uint8_t pin_state = (_SFR_IO8(pin >> 4) & _BV(pin & 0xF));
-
-        // Populate the matrix row with the state of the col pin
-        current_matrix[current_row] |=  pin_state ? 0 : (ROW_SHIFTER << col_index);
+        // Populate the matrix row with the state of the col pin (active low)
+        current_matrix[current_row] |= input_is_low(port_state, col_index) ? (ROW_SHIFTER << col_index) : 0;
     }
 
-    // Unselect row
-    unselect_row(current_row);
-
     return (last_row_value != current_matrix[current_row]);
 }
 
@@ -335,6 +445,15 @@ static void unselect_rows(void)
     }
 }
 
+#ifdef MATRIX_IDLE_SCAN
+static void select_rows(void)
+{
+    for(uint8_t x = 0; x < MATRIX_ROWS; x++) {
+        select_row(x);
+    }
+}
+#endif
+
 #elif (DIODE_DIRECTION == ROW2COL)
 
 static void init_rows(void)
@@ -352,7 +471,14 @@ static bool read_rows_on_col(matrix_row_t current_matrix[], uint8_t current_col)
 
     // Select col and wait for col selecton to stabilize
     select_col(current_col);
-    wait_us(30);
+    wait_us(MATRIX_IO_DELAY);
+
+    // Read the ports of all rows at once
+    uint8_t port_state[MATRIX_INPUTS];
+    read_input_ports(port_state);
+
+    // Unselect col
+    unselect_col(current_col);
 
     // For each row...
     for(uint8_t row_index = 0; row_index < MATRIX_ROWS; row_index++)
@@ -362,7 +488,7 @@ static bool read_rows_on_col(matrix_row_t current_matrix[], uint8_t current_col)
         matrix_row_t last_row_value = current_matrix[row_index];
 
         // Check row pin state
-        if ((_SFR_IO8(row_pins[row_index] >> 4) & _BV(row_pins[row_index] & 0xF)) == 0)
+        if (input_is_low(port_state, row_index))
         {
             // Pin LO, set col bit
             current_matrix[row_index] |= (ROW_SHIFTER << current_col);
@@ -380,9 +506,6 @@ static bool read_rows_on_col(matrix_row_t current_matrix[], uint8_t current_col)
         }
     }
 
-    // Unselect col
-    unselect_col(current_col);
-
     return matrix_changed;
 }
 
@@ -409,4 +532,13 @@ static void unselect_cols(void)
     }
 }
 
+#ifdef MATRIX_IDLE_SCAN
+static void select_cols(void)
+{
+    for(uint8_t x = 0; x < MATRIX_COLS; x++) {
+        select_col(x);
+    }
+}
+#endif
+
 #endif
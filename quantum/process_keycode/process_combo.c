@@ -18,7 +18,7 @@
 #include "print.h"
 
 
-#define COMBO_TIMER_ELAPSED -1
+#define NO_COMBO 0xFF
 
 
 __attribute__ ((weak))
@@ -33,6 +33,219 @@ void process_combo_event(uint8_t combo_index, bool pressed) {
 
 static uint8_t current_combo_index = 0;
 
+#if COMBO_INDEX_SIZE > 0
+/* Every key of every combo, sorted by keycode (or COMBO_KEYPOS() of the
+ * position combos) then by combo, so that an event only touches the combos
+ * that contain its key. The keycodes stay in the combos. */
+typedef struct {
+    uint8_t combo_index;
+    uint8_t key;
+} combo_index_entry_t;
+
+static combo_index_entry_t combo_index[COMBO_INDEX_SIZE];
+
+static inline uint16_t combo_index_keycode(uint16_t entry)
+{
+    return pgm_read_word(&key_combos[combo_index[entry].combo_index].keys[combo_index[entry].key]);
+}
+static uint16_t combo_index_count = 0;
+static bool combo_index_usable = false;
+#endif
+static bool combo_index_built = false;
+
+/* The presses held back while they may still become a combo, in order */
+typedef struct {
+    keyrecord_t record;
+    uint16_t keycode;
+} combo_key_t;
+
+static combo_key_t key_buffer[COMBO_BUFFER_LENGTH];
+static uint8_t key_buffer_size = 0;
+
+/* The combos containing every buffered key, some of them may need more keys */
+static uint8_t candidates[COMBO_COUNT];
+static uint8_t candidate_count = 0;
+
+/* The combos that have been pressed, until all their keys are released */
+static uint8_t held_combos[COMBO_COUNT];
+static uint8_t held_combo_count = 0;
+
+static void build_combo_index(void)
+{
+    combo_index_built = true;
+#if COMBO_INDEX_SIZE > 0
+    combo_index_usable = false;
+    combo_index_count = 0;
+    for (uint8_t i = 0; i < COMBO_COUNT; i++) {
+        for (uint8_t k = 0; ; ++k) {
+            uint16_t keycode = pgm_read_word(&key_combos[i].keys[k]);
+            if (COMBO_END == keycode) break;
+            /* insertion sort, the combos are walked in order so equal
+             * keycodes keep their combo order */
+            uint16_t pos = combo_index_count;
+            while (pos > 0 && combo_index_keycode(pos - 1) > keycode) {
+                pos--;
+            }
+            if (pos > 0 && combo_index_keycode(pos - 1) == keycode &&
+                    combo_index[pos - 1].combo_index == i) {
+                continue; /* the same key twice in a combo */
+            }
+            if (combo_index_count == COMBO_INDEX_SIZE) {
+                dprint("combo: COMBO_INDEX_SIZE is too small, the index is disabled\n");
+                return;
+            }
+            for (uint16_t j = combo_index_count; j > pos; j--) {
+                combo_index[j] = combo_index[j - 1];
+            }
+            combo_index[pos].combo_index = i;
+            combo_index[pos].key = k;
+            combo_index_count++;
+        }
+    }
+    combo_index_usable = true;
+#endif
+}
+
+void combo_index_invalidate(void)
+{
+    combo_index_built = false;
+}
+
+static inline uint16_t combo_key(const combo_t *combo, uint16_t keycode, keypos_t key)
+{
+    return combo->by_position ? COMBO_KEYPOS(key.row, key.col) : keycode;
+}
+
+/* Returns the index of the key in the combo, or -1 */
+static int8_t combo_key_index(const combo_t *combo, uint16_t keycode, keypos_t key)
+{
+    uint16_t wanted = combo_key(combo, keycode, key);
+    for (int8_t i = 0; ; ++i) {
+        uint16_t k = pgm_read_word(&combo->keys[i]);
+        if (COMBO_END == k) return -1;
+        if (wanted == k) return i;
+    }
+}
+
+static uint8_t combo_length(const combo_t *combo)
+{
+    uint8_t count = 0;
+    while (COMBO_END != pgm_read_word(&combo->keys[count])) {
+        count++;
+    }
+    return count;
+}
+
+static inline bool combo_has_key(uint8_t index, const combo_key_t *key)
+{
+    return combo_key_index(&key_combos[index], key->keycode, key->record.event.key) >= 0;
+}
+
+/* A held combo can't be pressed again, nor a combo sharing a key that is
+ * still held down by one */
+static bool combo_is_available(uint8_t index)
+{
+    const combo_t *combo = &key_combos[index];
+    if (combo->state) return false;
+    for (uint8_t i = 0; i < held_combo_count; i++) {
+        const combo_t *held = &key_combos[held_combos[i]];
+        if (held->by_position != combo->by_position) continue;
+        for (uint8_t k = 0; ; k++) {
+            uint16_t key = pgm_read_word(&held->keys[k]);
+            if (COMBO_END == key) break;
+            if (!(held->state & ((uint32_t)1 << k))) continue;
+            for (const uint16_t *keys = combo->keys; ; ++keys) {
+                uint16_t other = pgm_read_word(keys);
+                if (COMBO_END == other) break;
+                if (key == other) return false;
+            }
+        }
+    }
+    return true;
+}
+
+#if COMBO_INDEX_SIZE > 0
+static void find_indexed_combos(uint16_t keycode, bool by_position)
+{
+    /* find the first entry of the keycode */
+    uint16_t lo = 0, hi = combo_index_count;
+    while (lo < hi) {
+        uint16_t mid = (lo + hi) / 2;
+        if (combo_index_keycode(mid) < keycode) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (; lo < combo_index_count && combo_index_keycode(lo) == keycode; ++lo) {
+        uint8_t index = combo_index[lo].combo_index;
+        if (key_combos[index].by_position == by_position && combo_is_available(index)) {
+            candidates[candidate_count++] = index;
+        }
+    }
+}
+#endif
+
+/* Finds the combos containing the first keys of the buffer, as many of them
+ * as possible, and returns how many keys they cover */
+static uint8_t find_candidates(void)
+{
+    candidate_count = 0;
+    if (!key_buffer_size) return 0;
+
+    /* the combos of the first key */
+    const combo_key_t *first = &key_buffer[0];
+#if COMBO_INDEX_SIZE > 0
+    if (combo_index_usable) {
+        find_indexed_combos(first->keycode, false);
+        find_indexed_combos(COMBO_KEYPOS(first->record.event.key.row, first->record.event.key.col), true);
+    } else
+#endif
+    {
+        for (uint8_t i = 0; i < COMBO_COUNT; i++) {
+            if (combo_has_key(i, first) && combo_is_available(i)) {
+                candidates[candidate_count++] = i;
+            }
+        }
+    }
+    if (!candidate_count) return 0;
+
+    /* narrowed down by the next keys, until one of them doesn't fit */
+    uint8_t covered = 1;
+    for (; covered < key_buffer_size; covered++) {
+        const combo_key_t *next = &key_buffer[covered];
+        uint8_t remaining = 0;
+        for (uint8_t i = 0; i < candidate_count; i++) {
+            remaining += combo_has_key(candidates[i], next);
+        }
+        if (!remaining) break;
+        remaining = 0;
+        for (uint8_t i = 0; i < candidate_count; i++) {
+            if (combo_has_key(candidates[i], next)) {
+                candidates[remaining++] = candidates[i];
+            }
+        }
+        candidate_count = remaining;
+    }
+    return covered;
+}
+
+/* Returns the candidate made of exactly `covered` keys, the first one if
+ * there are several, or NO_COMBO */
+static uint8_t complete_candidate(uint8_t covered, bool *more)
+{
+    uint8_t found = NO_COMBO;
+    *more = false;
+    for (uint8_t i = 0; i < candidate_count; i++) {
+        if (combo_length(&key_combos[candidates[i]]) != covered) {
+            *more = true;
+        } else if (candidates[i] < found) {
+            found = candidates[i];
+        }
+    }
+    return found;
+}
+
 static inline void send_combo(uint16_t action, bool pressed)
 {
     if (action) {
@@ -46,109 +259,150 @@ static inline void send_combo(uint16_t action, bool pressed)
     }
 }
 
-#define ALL_COMBO_KEYS_ARE_DOWN     (((1<<count)-1) == combo->state)
-#define NO_COMBO_KEYS_ARE_DOWN      (0 == combo->state)
-#define KEY_STATE_DOWN(key)         do{ combo->state |= (1<<key); } while(0)
-#define KEY_STATE_UP(key)           do{ combo->state &= ~(1<<key); } while(0)
-static bool process_single_combo(combo_t *combo, uint16_t keycode, keyrecord_t *record) 
+static void drop_keys(uint8_t count)
 {
-    uint8_t count = 0;
-    uint8_t index = -1;
-    /* Find index of keycode and number of combo keys */
-    for (const uint16_t *keys = combo->keys; ;++count) {
-        uint16_t key = pgm_read_word(&keys[count]);
-        if (keycode == key) index = count;
-        if (COMBO_END == key) break;
+    key_buffer_size -= count;
+    for (uint8_t i = 0; i < key_buffer_size; i++) {
+        key_buffer[i] = key_buffer[i + count];
     }
+}
 
-    /* Return if not a combo key */
-    if (-1 == (int8_t)index) return false;
-
-    /* The combos timer is used to signal whether the combo is active */
-    bool is_combo_active = COMBO_TIMER_ELAPSED == combo->timer ? false : true;
+static void fire_combo(uint8_t index, uint8_t covered)
+{
+    combo_t *combo = &key_combos[index];
+    combo->state = ((uint32_t)1 << covered) - 1;
+    held_combos[held_combo_count++] = index;
+    current_combo_index = index;
+    send_combo(combo->keycode, true);
+    drop_keys(covered);
+}
 
-    if (record->event.pressed) {
-        KEY_STATE_DOWN(index);
-
-        if (is_combo_active) {
-            if (ALL_COMBO_KEYS_ARE_DOWN) { /* Combo was pressed */
-                send_combo(combo->keycode, true);
-                combo->timer = COMBO_TIMER_ELAPSED;
-            } else { /* Combo key was pressed */
-                combo->timer = timer_read();
+/* The first key isn't part of a combo after all, it gets its normal action */
+static void replay_first_key(void)
+{
+    combo_key_t *first = &key_buffer[0];
 #ifdef COMBO_ALLOW_ACTION_KEYS
-                combo->prev_record = *record;
+    process_action(&first->record, store_or_get_action(true, first->record.event.key));
 #else
-                combo->prev_key = keycode;
+    register_code16(first->keycode);
 #endif
-            }
-        }
+    drop_keys(1);
+}
+
+/* Fires the combo of the first `covered` keys if there is one, or replays
+ * the first key */
+static void resolve_first_keys(uint8_t covered)
+{
+    bool more;
+    uint8_t index = complete_candidate(covered, &more);
+    if (index != NO_COMBO) {
+        fire_combo(index, covered);
     } else {
-        if (ALL_COMBO_KEYS_ARE_DOWN) { /* Combo was released */
-            send_combo(combo->keycode, false);
-        }
+        replay_first_key();
+    }
+}
 
-        if (is_combo_active) { /* Combo key was tapped */
-#ifdef COMBO_ALLOW_ACTION_KEYS
-            record->event.pressed = true;
-            process_action(record, store_or_get_action(record->event.pressed, record->event.key));
-            record->event.pressed = false;
-            process_action(record, store_or_get_action(record->event.pressed, record->event.key));
-#else
-            register_code16(keycode);
-            send_keyboard_report();
-            unregister_code16(keycode);
-#endif
-            combo->timer = 0;            
+/* Resolves what can't wait any more: keys that no combo contains together
+ * with the first ones, and combos that no longer combo can extend. After
+ * it the candidates are the ones of the whole buffer. */
+static void settle_buffer(void)
+{
+    while (key_buffer_size) {
+        uint8_t covered = find_candidates();
+        if (covered == key_buffer_size) {
+            bool more;
+            uint8_t index = complete_candidate(covered, &more);
+            if (more && key_buffer_size < COMBO_BUFFER_LENGTH) {
+                return; /* a longer combo is still possible */
+            }
+            if (index != NO_COMBO) {
+                fire_combo(index, covered);
+                continue;
+            }
         }
+        resolve_first_keys(covered);
+    }
+    candidate_count = 0;
+}
 
-        KEY_STATE_UP(index);        
+/* Resolves every buffered key, nothing else is going to come */
+static void flush_buffer(void)
+{
+    while (key_buffer_size) {
+        resolve_first_keys(find_candidates());
     }
+    candidate_count = 0;
+}
+
+static bool press_combo_key(uint16_t keycode, keyrecord_t *record)
+{
+    combo_key_t key = { .record = *record, .keycode = keycode };
 
-    if (NO_COMBO_KEYS_ARE_DOWN) {
-        combo->timer = 0;
+    /* resolve the buffered keys until the new one can join them */
+    while (key_buffer_size) {
+        bool joins = false;
+        for (uint8_t i = 0; i < candidate_count && !joins; i++) {
+            joins = combo_has_key(candidates[i], &key);
+        }
+        if (joins) break;
+        resolve_first_keys(key_buffer_size);
+        settle_buffer();
     }
 
-    return is_combo_active;
+    key_buffer[key_buffer_size++] = key;
+    if (key_buffer_size == 1 && !find_candidates()) {
+        /* not a combo key, handled as usual */
+        key_buffer_size = 0;
+        return true;
+    }
+    settle_buffer();
+    return false;
 }
 
-bool process_combo(uint16_t keycode, keyrecord_t *record)
+static bool release_combo_key(uint16_t keycode, keyrecord_t *record)
 {
-    bool is_combo_key = false;
+    for (uint8_t i = 0; i < key_buffer_size; i++) {
+        if (KEYEQ(key_buffer[i].record.event.key, record->event.key)) {
+            flush_buffer();
+            break;
+        }
+    }
 
-    for (current_combo_index = 0; current_combo_index < COMBO_COUNT; ++current_combo_index) {
+    for (uint8_t i = 0; i < held_combo_count; i++) {
+        current_combo_index = held_combos[i];
         combo_t *combo = &key_combos[current_combo_index];
-        is_combo_key |= process_single_combo(combo, keycode, record);
-    }    
+        int8_t index = combo_key_index(combo, keycode, record->event.key);
+        if (index < 0 || !(combo->state & ((uint32_t)1 << index))) continue;
+
+        /* the combo is released with its first key, the others are ignored */
+        if (combo->state == ((uint32_t)1 << combo_length(combo)) - 1) {
+            send_combo(combo->keycode, false);
+        }
+        combo->state &= ~((uint32_t)1 << index);
+        if (!combo->state) {
+            held_combos[i] = held_combos[--held_combo_count];
+        }
+        return false;
+    }
+    return true;
+}
+
+bool process_combo(uint16_t keycode, keyrecord_t *record)
+{
+    if (!combo_index_built) {
+        build_combo_index();
+    }
 
-    return !is_combo_key;
+    if (record->event.pressed) {
+        return press_combo_key(keycode, record);
+    } else {
+        return release_combo_key(keycode, record);
+    }
 }
 
 void matrix_scan_combo(void)
 {
-    for (int i = 0; i < COMBO_COUNT; ++i) {
-        // Do not treat the (weak) key_combos too strict.
-        #pragma GCC diagnostic push
-        #pragma GCC diagnostic ignored "-Warray-bounds"
-        combo_t *combo = &key_combos[i];
-        #pragma GCC diagnostic pop
-        if (combo->timer &&
-            combo->timer != COMBO_TIMER_ELAPSED && 
-            timer_elapsed(combo->timer) > COMBO_TERM) {
-            
-            /* This disables the combo, meaning key events for this
-             * combo will be handled by the next processors in the chain 
-             */
-            combo->timer = COMBO_TIMER_ELAPSED;
-
-#ifdef COMBO_ALLOW_ACTION_KEYS
-            process_action(&combo->prev_record, 
-                store_or_get_action(combo->prev_record.event.pressed, 
-                                    combo->prev_record.event.key));
-#else
-            unregister_code16(combo->prev_key);
-            register_code16(combo->prev_key);
-#endif
-        }
+    if (key_buffer_size && timer_elapsed(key_buffer[0].record.event.time) > COMBO_TERM) {
+        flush_buffer();
     }
 }
@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include "progmem.h"
 #include "quantum.h"
+#include "action_tapping.h"
 
 typedef struct
 {
@@ -32,17 +33,18 @@ typedef struct
 #else
     uint8_t state;
 #endif
-    uint16_t timer;
-#ifdef COMBO_ALLOW_ACTION_KEYS
-    keyrecord_t prev_record;
-#else
-    uint16_t prev_key;
-#endif
+    /* the keys are COMBO_KEYPOS() matrix positions instead of keycodes */
+    bool by_position;
 } combo_t;
 
 
 #define COMBO(ck, ca)       {.keys = &(ck)[0], .keycode = (ca)}
 #define COMBO_ACTION(ck)    {.keys = &(ck)[0]}
+#define COMBO_POS(ck, ca)   {.keys = &(ck)[0], .keycode = (ca), .by_position = true}
+#define COMBO_POS_ACTION(ck) {.keys = &(ck)[0], .by_position = true}
+
+/* A key of a COMBO_POS() combo, the same on every layer */
+#define COMBO_KEYPOS(row, col) (0x8000 | ((row) << 8) | (col))
 
 #define COMBO_END 0
 #ifndef COMBO_COUNT
@@ -51,9 +53,26 @@ typedef struct
 #ifndef COMBO_TERM
 #define COMBO_TERM TAPPING_TERM
 #endif
+/* Number of keys in all the combos together, for the keycode index. Events
+ * fall back to checking every combo if it's too small, 0 disables it. It
+ * takes 2 bytes of RAM per key, the AVRs only get it when it's set. */
+#ifndef COMBO_INDEX_SIZE
+#   ifdef __AVR__
+#       define COMBO_INDEX_SIZE 0
+#   else
+#       define COMBO_INDEX_SIZE (COMBO_COUNT * 3)
+#   endif
+#endif
+/* Number of combo key presses held back while a combo is possible, at least
+ * the number of keys of the longest combo */
+#ifndef COMBO_BUFFER_LENGTH
+#define COMBO_BUFFER_LENGTH 4
+#endif
 
 bool process_combo(uint16_t keycode, keyrecord_t *record);
 void matrix_scan_combo(void);
 void process_combo_event(uint8_t combo_index, bool pressed);
+/* To be called after changing the keys of key_combos at runtime */
+void combo_index_invalidate(void);
 
 #endif
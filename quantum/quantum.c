@@ -541,6 +541,7 @@ bool process_record_quantum(keyrecord_t *record) {
             break;
         }
         eeconfig_update_keymap(keymap_config.raw);
+        layer_cache_invalidate(); // keycodes may have been remapped
         clear_keyboard(); // clear to prevent stuck keys
 
         return false;
@@ -879,10 +880,12 @@ void matrix_scan_quantum() {
 
   #ifdef RGB_MATRIX_ENABLE
     rgb_matrix_task();
-    if (rgb_matrix_task_counter == 0) {
-      rgb_matrix_update_pwm_buffers();
-    }
-    rgb_matrix_task_counter = ((rgb_matrix_task_counter + 1) % (RGB_MATRIX_SKIP_FRAMES + 1));
+    #ifndef RGB_MATRIX_LED_PROCESS_LIMIT
+      if (rgb_matrix_task_counter == 0) {
+        rgb_matrix_update_pwm_buffers();
+      }
+      rgb_matrix_task_counter = ((rgb_matrix_task_counter + 1) % (RGB_MATRIX_SKIP_FRAMES + 1));
+    #endif
   #endif
 
   matrix_scan_kb();
@@ -17,15 +17,18 @@
 
 
 #include "rgb_matrix.h"
-#include <avr/io.h>
 #include "TWIlib.h"
-#include <util/delay.h>
-#include <avr/interrupt.h>
 #include "progmem.h"
-#include "config.h"
 #include "eeprom.h"
-#include "lufa.h"
-#include <math.h>
+#include "timer.h"
+#include "rgb_matrix_math.h"
+
+#ifndef MIN
+    #define MIN(a,b) (((a)<(b))?(a):(b))
+#endif
+#ifndef MAX
+    #define MAX(a,b) (((a)>(b))?(a):(b))
+#endif
 
 rgb_config_t rgb_matrix_config;
 
@@ -41,6 +44,13 @@ rgb_config_t rgb_matrix_config;
     #define EECONFIG_RGB_MATRIX EECONFIG_RGBLIGHT
 #endif
 
+#ifdef RGB_MATRIX_LED_PROCESS_LIMIT
+    // ms between the start of two frames, 20 Hz
+    #ifndef RGB_MATRIX_FRAME_INTERVAL
+        #define RGB_MATRIX_FRAME_INTERVAL 50
+    #endif
+#endif
+
 bool g_suspend_state = false;
 
 // Global tick at 20 Hz
@@ -52,9 +62,19 @@ uint8_t g_key_hit[DRIVER_LED_TOTAL];
 // Ticks since any key was last hit.
 uint32_t g_any_key_hit = 0;
 
-#ifndef PI
-#define PI 3.14159265
-#endif
+// The LEDs the effects render in this call of rgb_matrix_task(),
+// all of them unless the frame is rendered a few LEDs at a time.
+static uint8_t g_led_min = 0;
+static uint8_t g_led_max = DRIVER_LED_TOTAL;
+
+// The frame being rendered
+static uint8_t g_frame_effect;
+static bool g_frame_initialize;
+static bool g_frame_indicators;
+
+// Frame effects that aren't modes
+#define RGB_MATRIX_FRAME_ALL_OFF 254
+#define RGB_MATRIX_FRAME_TEST 255
 
 uint32_t eeconfig_read_rgb_matrix(void) {
   return eeprom_read_dword(EECONFIG_RGB_MATRIX);
@@ -115,6 +135,13 @@ void rgb_matrix_set_color_all( uint8_t red, uint8_t green, uint8_t blue ) {
     IS31FL3731_set_color_all( red, green, blue );
 }
 
+// Sets all the LEDs rendered in this call
+static void rgb_matrix_fill( uint8_t red, uint8_t green, uint8_t blue ) {
+    for ( int i = g_led_min; i < g_led_max; i++ ) {
+        IS31FL3731_set_color( i, red, green, blue );
+    }
+}
+
 
 bool process_rgb_matrix(uint16_t keycode, keyrecord_t *record) {
     if ( record->event.pressed ) {
@@ -154,22 +181,22 @@ void rgb_matrix_test(void) {
     {
         case 0:
         {
-            rgb_matrix_set_color_all( 20, 0, 0 );
+            rgb_matrix_fill( 20, 0, 0 );
             break;
         }
         case 1:
         {
-            rgb_matrix_set_color_all( 0, 20, 0 );
+            rgb_matrix_fill( 0, 20, 0 );
             break;
         }
         case 2:
         {
-            rgb_matrix_set_color_all( 0, 0, 20 );
+            rgb_matrix_fill( 0, 0, 20 );
             break;
         }
         case 3:
         {
-            rgb_matrix_set_color_all( 20, 20, 20 );
+            rgb_matrix_fill( 20, 20, 20 );
             break;
         }
     }
@@ -218,19 +245,19 @@ void rgb_matrix_single_LED_test(void) {
 
 // All LEDs off
 void rgb_matrix_all_off(void) { 
-    rgb_matrix_set_color_all( 0, 0, 0 );
+    rgb_matrix_fill( 0, 0, 0 );
 }
 
 // Solid color
 void rgb_matrix_solid_color(void) {
     HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
     RGB rgb = hsv_to_rgb( hsv );
-    rgb_matrix_set_color_all( rgb.r, rgb.g, rgb.b );
+    rgb_matrix_fill( rgb.r, rgb.g, rgb.b );
 }
 
 void rgb_matrix_solid_reactive(void) {
 	// Relies on hue being 8-bit and wrapping
-	for ( int i=0; i<DRIVER_LED_TOTAL; i++ )
+	for ( int i=g_led_min; i<g_led_max; i++ )
 	{
 		uint16_t offset2 = g_key_hit[i]<<2;
 		offset2 = (offset2<=130) ? (130-offset2) : 0;
@@ -248,7 +275,7 @@ void rgb_matrix_alphas_mods(void) {
     RGB rgb2 = hsv_to_rgb( (HSV){ .h = (rgb_matrix_config.hue + 180) % 360, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val } );
 
     rgb_led led;
-    for (int i = 0; i < DRIVER_LED_TOTAL; i++) {
+    for (int i = g_led_min; i < g_led_max; i++) {
         led = g_rgb_leds[i];
         if ( led.matrix_co.raw < 0xFF ) {
             if ( led.modifier )
@@ -287,7 +314,7 @@ void rgb_matrix_gradient_up_down(void) {
     HSV hsv = { .h = 0, .s = 255, .v = rgb_matrix_config.val };
     RGB rgb;
     Point point;
-    for ( int i=0; i<DRIVER_LED_TOTAL; i++ )
+    for ( int i=g_led_min; i<g_led_max; i++ )
     {
         // map_led_to_point( i, &point );
         point = g_rgb_leds[i].point;
@@ -325,9 +352,12 @@ void rgb_matrix_raindrops(bool initialize) {
     RGB rgb;
 
     // Change one LED every tick, make sure speed is not 0
-    uint8_t led_to_change = ( g_tick & ( 0x0A / (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed) ) ) == 0 ? rand() % (DRIVER_LED_TOTAL) : 255;
+    static uint8_t led_to_change;
+    if ( g_led_min == 0 ) {
+        led_to_change = ( g_tick & ( 0x0A / (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed) ) ) == 0 ? rand() % (DRIVER_LED_TOTAL) : 255;
+    }
 
-    for ( int i=0; i<DRIVER_LED_TOTAL; i++ )
+    for ( int i=g_led_min; i<g_led_max; i++ )
     {
         // If initialize, all get set to random colors
         // If not, all but one will stay the same as before.
@@ -350,7 +380,7 @@ void rgb_matrix_cycle_all(void) {
     rgb_led led;
 
     // Relies on hue being 8-bit and wrapping
-    for ( int i=0; i<DRIVER_LED_TOTAL; i++ )
+    for ( int i=g_led_min; i<g_led_max; i++ )
     {
         // map_index_to_led(i, &led);
         led = g_rgb_leds[i];
@@ -371,7 +401,7 @@ void rgb_matrix_cycle_left_right(void) {
     RGB rgb;
     Point point;
     rgb_led led;
-    for ( int i=0; i<DRIVER_LED_TOTAL; i++ )
+    for ( int i=g_led_min; i<g_led_max; i++ )
     {
         // map_index_to_led(i, &led);
         led = g_rgb_leds[i];
@@ -395,7 +425,7 @@ void rgb_matrix_cycle_up_down(void) {
     RGB rgb;
     Point point;
     rgb_led led;
-    for ( int i=0; i<DRIVER_LED_TOTAL; i++ )
+    for ( int i=g_led_min; i<g_led_max; i++ )
     {
         // map_index_to_led(i, &led);
         led = g_rgb_leds[i];
@@ -414,54 +444,35 @@ void rgb_matrix_cycle_up_down(void) {
 }
 
 
-void rgb_matrix_dual_beacon(void) {
+static void rgb_matrix_wave_effect(uint8_t effect) {
     HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
     RGB rgb;
     rgb_led led;
-    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
+    rgb_matrix_wave_t wave;
+    rgb_matrix_wave_effect_init( &wave, effect, g_tick, rgb_matrix_config.speed );
+    for (uint8_t i = g_led_min; i < g_led_max; i++) {
         led = g_rgb_leds[i];
-        hsv.h = ((led.point.y - 32.0)* cos(g_tick * PI / 128) / 32 + (led.point.x - 112.0) * sin(g_tick * PI / 128) / (112)) * (180) + rgb_matrix_config.hue;
+        uint16_t h = rgb_matrix_wave_effect_hue( &wave, effect, led.point.x, led.point.y );
+        hsv.h = rgb_matrix_config.hue + ( h >> 8 );
         rgb = hsv_to_rgb( hsv );
         rgb_matrix_set_color( i, rgb.r, rgb.g, rgb.b );
     }
 }
 
+void rgb_matrix_dual_beacon(void) {
+    rgb_matrix_wave_effect( RGB_MATRIX_WAVE_DUAL_BEACON );
+}
+
 void rgb_matrix_rainbow_beacon(void) {
-    HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
-    RGB rgb;
-    rgb_led led;
-    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
-        led = g_rgb_leds[i];
-        hsv.h = (1.5 * (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed)) * (led.point.y - 32.0)* cos(g_tick * PI / 128) + (1.5 * (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed)) * (led.point.x - 112.0) * sin(g_tick * PI / 128) + rgb_matrix_config.hue;
-        rgb = hsv_to_rgb( hsv );
-        rgb_matrix_set_color( i, rgb.r, rgb.g, rgb.b );
-    }
+    rgb_matrix_wave_effect( RGB_MATRIX_WAVE_RAINBOW_BEACON );
 }
 
 void rgb_matrix_rainbow_pinwheels(void) {
-    HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
-    RGB rgb;
-    rgb_led led;
-    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
-        led = g_rgb_leds[i];
-        hsv.h = (2 * (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed)) * (led.point.y - 32.0)* cos(g_tick * PI / 128) + (2 * (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed)) * (66 - abs(led.point.x - 112.0)) * sin(g_tick * PI / 128) + rgb_matrix_config.hue;
-        rgb = hsv_to_rgb( hsv );
-        rgb_matrix_set_color( i, rgb.r, rgb.g, rgb.b );
-    }
+    rgb_matrix_wave_effect( RGB_MATRIX_WAVE_RAINBOW_PINWHEELS );
 }
 
 void rgb_matrix_rainbow_moving_chevron(void) {
-    HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
-    RGB rgb;
-    rgb_led led;
-    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
-        led = g_rgb_leds[i];
-        // uint8_t r = g_tick;
-        uint8_t r = 32;
-        hsv.h = (1.5 * (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed)) * abs(led.point.y - 32.0)* sin(r * PI / 128) + (1.5 * (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed)) * (led.point.x - (g_tick / 256.0 * 224)) * cos(r * PI / 128) + rgb_matrix_config.hue;
-        rgb = hsv_to_rgb( hsv );
-        rgb_matrix_set_color( i, rgb.r, rgb.g, rgb.b );
-    }
+    rgb_matrix_wave_effect( RGB_MATRIX_WAVE_RAINBOW_MOVING_CHEVRON );
 }
 
 
@@ -470,9 +481,12 @@ void rgb_matrix_jellybean_raindrops( bool initialize ) {
     RGB rgb;
 
     // Change one LED every tick, make sure speed is not 0
-    uint8_t led_to_change = ( g_tick & ( 0x0A / (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed) ) ) == 0 ? rand() % (DRIVER_LED_TOTAL) : 255;
+    static uint8_t led_to_change;
+    if ( g_led_min == 0 ) {
+        led_to_change = ( g_tick & ( 0x0A / (rgb_matrix_config.speed == 0 ? 1 : rgb_matrix_config.speed) ) ) == 0 ? rand() % (DRIVER_LED_TOTAL) : 255;
+    }
 
-    for ( int i=0; i<DRIVER_LED_TOTAL; i++ )
+    for ( int i=g_led_min; i<g_led_max; i++ )
     {
         // If initialize, all get set to random colors
         // If not, all but one will stay the same as before.
@@ -494,14 +508,14 @@ void rgb_matrix_multisplash(void) {
         HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
         RGB rgb;
         rgb_led led;
-        for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
+        for (uint8_t i = g_led_min; i < g_led_max; i++) {
             led = g_rgb_leds[i];
             uint16_t c = 0, d = 0;
             rgb_led last_led;
             // if (g_last_led_count) {
                 for (uint8_t last_i = 0; last_i < g_last_led_count; last_i++) {
                     last_led = g_rgb_leds[g_last_led_hit[last_i]];
-                    uint16_t dist = (uint16_t)sqrt(pow(led.point.x - last_led.point.x, 2) + pow(led.point.y - last_led.point.y, 2));
+                    uint16_t dist = rgb_matrix_distance(led.point.x - last_led.point.x, led.point.y - last_led.point.y);
                     uint16_t effect = (g_key_hit[g_last_led_hit[last_i]] << 2) - dist;
                     c += MIN(MAX(effect, 0), 255);
                     d += 255 - MIN(MAX(effect, 0), 255);
@@ -531,14 +545,14 @@ void rgb_matrix_solid_multisplash(void) {
         HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
         RGB rgb;
         rgb_led led;
-        for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
+        for (uint8_t i = g_led_min; i < g_led_max; i++) {
             led = g_rgb_leds[i];
             uint16_t d = 0;
             rgb_led last_led;
             // if (g_last_led_count) {
                 for (uint8_t last_i = 0; last_i < g_last_led_count; last_i++) {
                     last_led = g_rgb_leds[g_last_led_hit[last_i]];
-                    uint16_t dist = (uint16_t)sqrt(pow(led.point.x - last_led.point.x, 2) + pow(led.point.y - last_led.point.y, 2));
+                    uint16_t dist = rgb_matrix_distance(led.point.x - last_led.point.x, led.point.y - last_led.point.y);
                     uint16_t effect = (g_key_hit[g_last_led_hit[last_i]] << 2) - dist;
                     d += 255 - MIN(MAX(effect, 0), 255);
                 }
@@ -576,18 +590,20 @@ void rgb_matrix_custom(void) {
 //     }
 }
 
-void rgb_matrix_task(void) {
+// Starts a new frame, returns false if there is nothing to render yet
+static bool rgb_matrix_frame_begin(void) {
     static uint8_t toggle_enable_last = 255;
 	if (!rgb_matrix_config.enable) {
-    	rgb_matrix_all_off();
+        g_frame_effect = RGB_MATRIX_FRAME_ALL_OFF;
+        g_frame_indicators = false;
         toggle_enable_last = rgb_matrix_config.enable;
-    	return;
+    	return true;
     }
     // delay 1 second before driving LEDs or doing anything else
     static uint8_t startup_tick = 0;
     if ( startup_tick < 20 ) {
         startup_tick++;
-        return;
+        return false;
     }
 
     g_tick++;
@@ -606,8 +622,9 @@ void rgb_matrix_task(void) {
 
     // Factory default magic value
     if ( rgb_matrix_config.mode == 255 ) {
-        rgb_matrix_test();
-        return;
+        g_frame_effect = RGB_MATRIX_FRAME_TEST;
+        g_frame_indicators = false;
+        return true;
     }
 
     // Ideally we would also stop sending zeros to the LED driver PWM buffers
@@ -620,14 +637,26 @@ void rgb_matrix_task(void) {
     // detect change in effect, so each effect can
     // have an optional initialization.
     static uint8_t effect_last = 255;
-    bool initialize = (effect != effect_last) || (rgb_matrix_config.enable != toggle_enable_last);
+    g_frame_initialize = (effect != effect_last) || (rgb_matrix_config.enable != toggle_enable_last);
     effect_last = effect;
     toggle_enable_last = rgb_matrix_config.enable;
 
-    // this gets ticked at 20 Hz.
+    g_frame_effect = effect;
+    g_frame_indicators = !suspend_backlight;
+    return true;
+}
+
+// Renders the LEDs from g_led_min to g_led_max of the frame
+static void rgb_matrix_frame_render(void) {
     // each effect can opt to do calculations
     // and/or request PWM buffer updates.
-    switch ( effect ) {
+    switch ( g_frame_effect ) {
+        case RGB_MATRIX_FRAME_ALL_OFF:
+            rgb_matrix_all_off();
+            break;
+        case RGB_MATRIX_FRAME_TEST:
+            rgb_matrix_test();
+            break;
         case RGB_MATRIX_SOLID_COLOR:
             rgb_matrix_solid_color();
             break;
@@ -641,7 +670,7 @@ void rgb_matrix_task(void) {
             rgb_matrix_gradient_up_down();
             break;
         case RGB_MATRIX_RAINDROPS:
-            rgb_matrix_raindrops( initialize );
+            rgb_matrix_raindrops( g_frame_initialize );
             break;
         case RGB_MATRIX_CYCLE_ALL:
             rgb_matrix_cycle_all();
@@ -662,7 +691,7 @@ void rgb_matrix_task(void) {
             rgb_matrix_rainbow_moving_chevron();
             break;
         case RGB_MATRIX_JELLYBEAN_RAINDROPS:
-            rgb_matrix_jellybean_raindrops( initialize );
+            rgb_matrix_jellybean_raindrops( g_frame_initialize );
             break;
         #ifdef RGB_MATRIX_KEYPRESSES
             case RGB_MATRIX_SOLID_REACTIVE:
@@ -686,10 +715,40 @@ void rgb_matrix_task(void) {
             break;
     }
 
-    if ( ! suspend_backlight ) {
+    if ( g_frame_indicators && g_led_max == DRIVER_LED_TOTAL ) {
         rgb_matrix_indicators();
     }
+}
 
+void rgb_matrix_task(void) {
+#ifdef RGB_MATRIX_LED_PROCESS_LIMIT
+    // The effects render the next frame into the PWM buffers of the driver a
+    // few LEDs per call. Once it is complete, the blocks that changed are sent
+    // to the LED drivers one per call, and the next frame only starts after
+    // that, so the LEDs never show a half rendered frame.
+    static uint16_t frame_timer = 0;
+    if ( g_led_max == DRIVER_LED_TOTAL ) {
+        if ( !IS31FL3731_flush_pwm_buffers( DRIVER_ADDR_1, DRIVER_ADDR_2 ) ) {
+            return;
+        }
+        IS31FL3731_update_led_control_registers( DRIVER_ADDR_1, DRIVER_ADDR_2 );
+        if ( timer_elapsed( frame_timer ) < RGB_MATRIX_FRAME_INTERVAL ) {
+            return;
+        }
+        frame_timer = timer_read();
+        if ( !rgb_matrix_frame_begin() ) {
+            return;
+        }
+        g_led_max = 0;
+    }
+    g_led_min = g_led_max;
+    g_led_max = MIN( g_led_min + RGB_MATRIX_LED_PROCESS_LIMIT, DRIVER_LED_TOTAL );
+    rgb_matrix_frame_render();
+#else
+    if ( rgb_matrix_frame_begin() ) {
+        rgb_matrix_frame_render();
+    }
+#endif
 }
 
 void rgb_matrix_indicators(void) {
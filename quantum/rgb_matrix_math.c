@@ -0,0 +1,98 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rgb_matrix_math.h"
+#include "progmem.h"
+
+/* A quarter of a sine wave, round(32767 * sin(i * PI / 128)) */
+static const uint16_t SIN_TABLE[65] PROGMEM = {
+    0, 804, 1608, 2410, 3212, 4011, 4808, 5602,
+    6393, 7179, 7962, 8739, 9512, 10278, 11039, 11793,
+    12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+    18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+    23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+    27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+    30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+    32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+    32767,
+};
+
+int16_t rgb_matrix_sin(uint8_t angle)
+{
+    uint8_t i = angle & 0x3F;
+    if (angle & 0x40) {
+        i = 64 - i;
+    }
+    int16_t value = pgm_read_word(&SIN_TABLE[i]);
+    return (angle & 0x80) ? -value : value;
+}
+
+void rgb_matrix_wave_init(rgb_matrix_wave_t *wave, uint8_t angle, uint16_t scale_y, uint16_t scale_x)
+{
+    // 8.8 scale times a 1.15 sine, leaves 16 fraction bits
+    wave->y = ((int32_t)scale_y * rgb_matrix_cos(angle)) >> 7;
+    wave->x = ((int32_t)scale_x * rgb_matrix_sin(angle)) >> 7;
+}
+
+void rgb_matrix_wave_effect_init(rgb_matrix_wave_t *wave, uint8_t effect, uint32_t tick, uint8_t speed)
+{
+    uint32_t s = speed == 0 ? 1 : speed;
+    wave->scroll = 0;
+    switch (effect) {
+        case RGB_MATRIX_WAVE_DUAL_BEACON:
+            // both halves of the board span 180 degrees of hue
+            rgb_matrix_wave_init(wave, tick, 180 * 256 / 32, 180 * 256 / 112);
+            return;
+        case RGB_MATRIX_WAVE_RAINBOW_BEACON:
+            // 1.5 hue steps per unit of distance and of speed
+            rgb_matrix_wave_init(wave, tick, 384, 384);
+            break;
+        case RGB_MATRIX_WAVE_RAINBOW_PINWHEELS:
+            // 2 hue steps per unit of distance and of speed
+            rgb_matrix_wave_init(wave, tick, 512, 512);
+            break;
+        case RGB_MATRIX_WAVE_RAINBOW_MOVING_CHEVRON:
+            // at 45 degrees sin and cos are the same, the chevron is symmetric
+            rgb_matrix_wave_init(wave, 32, 384, 384);
+            break;
+    }
+    // 384 and 512 are multiples of 128, the products keep every bit, and
+    // scaling them by the speed only wraps around like the hues do
+    wave->y = (int32_t)((uint32_t)wave->y * s);
+    wave->x = (int32_t)((uint32_t)wave->x * s);
+    if (effect == RGB_MATRIX_WAVE_RAINBOW_MOVING_CHEVRON) {
+        // the chevron moves 224/256 of a unit per tick
+        wave->scroll = (tick * 224 * (uint32_t)wave->x) >> 16;
+    }
+}
+
+uint16_t rgb_matrix_distance(int16_t dx, int16_t dy)
+{
+    if (dx < 0) dx = -dx;
+    if (dy < 0) dy = -dy;
+    // the LED coordinates are 8 bit, the squares fit in 17 bits
+    uint32_t square = (uint32_t)dx * dx + (uint32_t)dy * dy;
+    uint32_t root = 0;
+    for (uint32_t bit = 1UL << 16; bit; bit >>= 2) {
+        if (square >= root + bit) {
+            square -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+    }
+    return root;
+}
@@ -0,0 +1,87 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RGB_MATRIX_MATH_H
+#define RGB_MATRIX_MATH_H
+
+#include <stdint.h>
+
+/* Integer math for the RGB matrix effects, none of the MCUs driving one has
+ * an FPU.
+ *
+ * Angles are 8 bit, a full turn is 256. Hues are 8.8 fixed point and wrap
+ * like the 8 bit hue of HSV.
+ */
+
+/* The center of the LED coordinates, x is 0..224 and y is 0..64 */
+#define RGB_MATRIX_CENTER_X 112
+#define RGB_MATRIX_CENTER_Y 32
+
+/* sin and cos scaled to +-32767 */
+int16_t rgb_matrix_sin(uint8_t angle);
+#define rgb_matrix_cos(angle) rgb_matrix_sin((uint8_t)((angle) + 64))
+
+/* A plane wave, the hue of a LED at (dx, dy) is
+ *   (dy * scale_y * cos(angle) + dx * scale_x * sin(angle)) / 256
+ * Everything that doesn't depend on the LED is computed once per frame.
+ */
+typedef struct {
+    int32_t y;
+    int32_t x;
+    /* Subtracted from the hues of a wave effect */
+    uint16_t scroll;
+} rgb_matrix_wave_t;
+
+/* The scales are 8.8 fixed point */
+void rgb_matrix_wave_init(rgb_matrix_wave_t *wave, uint8_t angle, uint16_t scale_y, uint16_t scale_x);
+
+/* The 8.8 hue of a LED, the products wrap around but the hue bits stay exact */
+static inline uint16_t rgb_matrix_wave(const rgb_matrix_wave_t *wave, int16_t dy, int16_t dx)
+{
+    return ((uint32_t)(int32_t)dy * (uint32_t)wave->y + (uint32_t)(int32_t)dx * (uint32_t)wave->x) >> 8;
+}
+
+/* The effects of rgb_matrix.c that are plane waves */
+enum rgb_matrix_wave_effects {
+    RGB_MATRIX_WAVE_DUAL_BEACON,
+    RGB_MATRIX_WAVE_RAINBOW_BEACON,
+    RGB_MATRIX_WAVE_RAINBOW_PINWHEELS,
+    RGB_MATRIX_WAVE_RAINBOW_MOVING_CHEVRON,
+};
+
+/* The wave of an effect for the frame at a tick, at any speed */
+void rgb_matrix_wave_effect_init(rgb_matrix_wave_t *wave, uint8_t effect, uint32_t tick, uint8_t speed);
+
+/* The 8.8 hue offset of the LED at a point in an effect */
+static inline uint16_t rgb_matrix_wave_effect_hue(const rgb_matrix_wave_t *wave, uint8_t effect, uint8_t x, uint8_t y)
+{
+    int16_t dx = x - RGB_MATRIX_CENTER_X;
+    int16_t dy = y - RGB_MATRIX_CENTER_Y;
+    switch (effect) {
+        case RGB_MATRIX_WAVE_RAINBOW_PINWHEELS:
+            // mirrored around the center, one pinwheel per half
+            return rgb_matrix_wave(wave, dy, 66 - (dx < 0 ? -dx : dx));
+        case RGB_MATRIX_WAVE_RAINBOW_MOVING_CHEVRON:
+            return rgb_matrix_wave(wave, dy < 0 ? -dy : dy, x) - wave->scroll;
+        default:
+            return rgb_matrix_wave(wave, dy, dx);
+    }
+}
+
+/* The distance between two points, rounded down like (uint16_t)sqrt() */
+uint16_t rgb_matrix_distance(int16_t dx, int16_t dy);
+
+#endif
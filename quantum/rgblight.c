@@ -14,14 +14,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <math.h>
-#include <avr/eeprom.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
+#include <string.h>
+#include "eeprom.h"
+#include "wait.h"
 #include "progmem.h"
 #include "timer.h"
 #include "rgblight.h"
 #include "debug.h"
-#include "led_tables.h"
+#include "color.h"
 
 #ifndef RGBLIGHT_LIMIT_VAL
 #define RGBLIGHT_LIMIT_VAL 255
@@ -51,58 +51,32 @@ uint8_t rgblight_inited = 0;
 bool rgblight_timer_enabled = false;
 
 void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1) {
-  uint8_t r = 0, g = 0, b = 0, base, color;
-
   if (val > RGBLIGHT_LIMIT_VAL) {
       val=RGBLIGHT_LIMIT_VAL; // limit the val
   }
+  RGB rgb = hsv360_to_rgb(hue, sat, val);
+  setrgb(rgb.r, rgb.g, rgb.b, led1);
+}
 
-  if (sat == 0) { // Acromatic color (gray). Hue doesn't mind.
-    r = val;
-    g = val;
-    b = val;
-  } else {
-    base = ((255 - sat) * val) >> 8;
-    color = (val - base) * (hue % 60) / 60;
-
-    switch (hue / 60) {
-      case 0:
-        r = val;
-        g = base + color;
-        b = base;
-        break;
-      case 1:
-        r = val - color;
-        g = val;
-        b = base;
-        break;
-      case 2:
-        r = base;
-        g = val;
-        b = base + color;
-        break;
-      case 3:
-        r = base;
-        g = val - color;
-        b = val;
-        break;
-      case 4:
-        r = base + color;
-        g = base;
-        b = val;
-        break;
-      case 5:
-        r = val;
-        g = base;
-        b = val - color;
-        break;
+// Sets count LEDs, the hue moving by step for each one, wrapping around at 360
+void sethsv_range(uint16_t hue, int16_t step, uint8_t sat, uint8_t val, LED_TYPE *led1, uint8_t count) {
+  if (val > RGBLIGHT_LIMIT_VAL) {
+      val=RGBLIGHT_LIMIT_VAL; // limit the val
+  }
+  SV sv = sv_prepare(sat, val);
+  hue %= 360;
+  step %= 360;
+  if (step < 0) {
+    step += 360;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    RGB rgb = hue360_to_rgb(sv, hue);
+    setrgb(rgb.r, rgb.g, rgb.b, &led1[i]);
+    hue += step;
+    if (hue >= 360) {
+      hue -= 360;
     }
   }
-  r = pgm_read_byte(&CIE1931_CURVE[r]);
-  g = pgm_read_byte(&CIE1931_CURVE[g]);
-  b = pgm_read_byte(&CIE1931_CURVE[b]);
-
-  setrgb(r, g, b, led1);
 }
 
 void setrgb(uint8_t r, uint8_t g, uint8_t b, LED_TYPE *led1) {
@@ -281,7 +255,7 @@ void rgblight_disable(void) {
   #ifdef RGBLIGHT_ANIMATIONS
     rgblight_timer_disable();
   #endif
-  _delay_ms(50);
+  wait_ms(50);
   rgblight_set();
 }
 
@@ -385,14 +359,10 @@ void rgblight_sethsv(uint16_t hue, uint8_t sat, uint8_t val) {
         hue = rgblight_config.hue;
       } else if (rgblight_config.mode >= 25 && rgblight_config.mode <= 34) {
         // static gradient
-        uint16_t _hue;
         int8_t direction = ((rgblight_config.mode - 25) % 2) ? -1 : 1;
         uint16_t range = pgm_read_word(&RGBLED_GRADIENT_RANGES[(rgblight_config.mode - 25) / 2]);
-        for (uint8_t i = 0; i < RGBLED_NUM; i++) {
-          _hue = (range / RGBLED_NUM * i * direction + hue + 360) % 360;
-          dprintf("rgblight rainbow set hsv: %u,%u,%d,%u\n", i, _hue, direction, range);
-          sethsv(_hue, sat, val, (LED_TYPE *)&led[i]);
-        }
+        dprintf("rgblight rainbow set hsv: %u,%d,%u\n", hue, direction, range);
+        sethsv_range(hue, range / RGBLED_NUM * direction, sat, val, led, RGBLED_NUM);
         rgblight_set();
       }
     }
@@ -445,25 +415,56 @@ void rgblight_sethsv_at(uint16_t hue, uint8_t sat, uint8_t val, uint8_t index) {
 }
 
 #ifndef RGBLIGHT_CUSTOM_DRIVER
-void rgblight_set(void) {
-  if (rgblight_config.enable) {
+// The last frame sent to the strip. The LEDs keep their color until they get
+// new data, and the data goes through the strip from the first LED, so only
+// the LEDs up to the last one that changed need to be sent.
+static LED_TYPE led_sent[RGBLED_NUM];
+static bool led_sent_valid = false;
+#if defined(RGBLIGHT_MAX_FPS) && defined(RGBLIGHT_ANIMATIONS)
+static uint16_t led_sent_timer;
+static bool led_pending = false;
+#endif
+
+static void rgblight_send(void) {
+  uint8_t count = RGBLED_NUM;
+  if (led_sent_valid) {
+    while (count && memcmp(&led[count - 1], &led_sent[count - 1], sizeof(LED_TYPE)) == 0) {
+      count--;
+    }
+  }
+  if (count) {
     #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
+      ws2812_setleds_rgbw(led, count);
     #else
-      ws2812_setleds(led, RGBLED_NUM);
+      ws2812_setleds(led, count);
     #endif
-  } else {
+    memcpy(led_sent, led, count * sizeof(LED_TYPE));
+#if defined(RGBLIGHT_MAX_FPS) && defined(RGBLIGHT_ANIMATIONS)
+    led_sent_timer = timer_read();
+#endif
+  }
+  led_sent_valid = true;
+#if defined(RGBLIGHT_MAX_FPS) && defined(RGBLIGHT_ANIMATIONS)
+  led_pending = false;
+#endif
+}
+
+void rgblight_set(void) {
+  if (!rgblight_config.enable) {
     for (uint8_t i = 0; i < RGBLED_NUM; i++) {
       led[i].r = 0;
       led[i].g = 0;
       led[i].b = 0;
     }
-    #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
-    #else
-      ws2812_setleds(led, RGBLED_NUM);
-    #endif
   }
+#if defined(RGBLIGHT_MAX_FPS) && defined(RGBLIGHT_ANIMATIONS)
+  // too early, rgblight_task() sends it when the time comes
+  if (led_sent_valid && timer_elapsed(led_sent_timer) < 1000 / RGBLIGHT_MAX_FPS) {
+    led_pending = true;
+    return;
+  }
+#endif
+  rgblight_send();
 }
 #endif
 
@@ -530,6 +531,11 @@ void rgblight_task(void) {
       rgblight_effect_christmas();
     }
   }
+#if defined(RGBLIGHT_MAX_FPS) && !defined(RGBLIGHT_CUSTOM_DRIVER)
+  if (led_pending && timer_elapsed(led_sent_timer) >= 1000 / RGBLIGHT_MAX_FPS) {
+    rgblight_send();
+  }
+#endif
 }
 
 // Effects
@@ -563,16 +569,11 @@ void rgblight_effect_rainbow_mood(uint8_t interval) {
 void rgblight_effect_rainbow_swirl(uint8_t interval) {
   static uint16_t current_hue = 0;
   static uint16_t last_timer = 0;
-  uint16_t hue;
-  uint8_t i;
   if (timer_elapsed(last_timer) < pgm_read_byte(&RGBLED_RAINBOW_SWIRL_INTERVALS[interval / 2])) {
     return;
   }
   last_timer = timer_read();
-  for (i = 0; i < RGBLED_NUM; i++) {
-    hue = (360 / RGBLED_NUM * i + current_hue) % 360;
-    sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
-  }
+  sethsv_range(current_hue, 360 / RGBLED_NUM, rgblight_config.sat, rgblight_config.val, led, RGBLED_NUM);
   rgblight_set();
 
   if (interval % 2) {
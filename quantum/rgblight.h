@@ -133,6 +133,7 @@ void rgb_matrix_increase(void);
 void rgb_matrix_decrease(void);
 
 void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1);
+void sethsv_range(uint16_t hue, int16_t step, uint8_t sat, uint8_t val, LED_TYPE *led1, uint8_t count);
 void setrgb(uint8_t r, uint8_t g, uint8_t b, LED_TYPE *led1);
 void rgblight_sethsv_noeeprom(uint16_t hue, uint8_t sat, uint8_t val);
 
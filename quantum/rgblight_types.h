@@ -23,7 +23,11 @@
 #ifndef RGBLIGHT_TYPES
 #define RGBLIGHT_TYPES
 
+#if defined(__AVR__)
 #include <avr/io.h>
+#else
+#include <stdint.h>
+#endif
 
 #ifdef RGBW
   #define LED_TYPE struct cRGBW
@@ -25,83 +25,199 @@ SOFTWARE.
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/frame_validator.h"
 #include "serial_link/protocol/physical.h"
+#include "serial_link/protocol/crc32.h"
 #include <stdbool.h>
+#include <string.h>
 
 // This implements the "Consistent overhead byte stuffing protocol"
 // https://en.wikipedia.org/wiki/Consistent_Overhead_Byte_Stuffing
 // http://www.stuartcheshire.org/papers/COBSforToN.pdf
 
+// The bytes of a frame are received in place, into the buffer of its link,
+// and decoded there: the zero that a block code stands for takes the place
+// of the code. So the payload starts at data[1], and is only moved after the
+// block codes that stand for no zero, which are 254 bytes apart.
+#define RECV_BUFFER_SIZE (MAX_FRAME_SIZE + MAX_FRAME_SIZE / 254 + 3)
+
 typedef struct byte_stuffer_state {
     uint16_t next_zero;
-    uint16_t data_pos;
+    // The decoded payload is data[1..data_end), the bytes received are
+    // data[0..recv_end), the ones before recv_pos are decoded
+    uint16_t data_end;
+    uint16_t recv_pos;
+    uint16_t recv_end;
     bool long_frame;
-    uint8_t data[MAX_FRAME_SIZE];
+    // The CRC of the payload before crc_pos
+    uint16_t crc_pos;
+    uint32_t crc;
+    uint8_t data[RECV_BUFFER_SIZE];
 }byte_stuffer_state_t;
 
 static byte_stuffer_state_t states[NUM_LINKS];
 
 void init_byte_stuffer_state(byte_stuffer_state_t* state) {
     state->next_zero = 0;
-    state->data_pos = 0;
+    state->data_end = 1;
     state->long_frame = false;
+    state->crc_pos = 0;
+    state->crc = CRC32_INIT;
 }
 
 void init_byte_stuffer(void) {
     int i;
     for (i=0;i<NUM_LINKS;i++) {
         init_byte_stuffer_state(&states[i]);
+        states[i].recv_pos = 0;
+        states[i].recv_end = 0;
     }
 }
 
-void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
-    byte_stuffer_state_t* state = &states[link];
-    // Start of a new frame
-    if (state->next_zero == 0) {
-        state->next_zero = data;
-        state->long_frame = data == 0xFF;
-        state->data_pos = 0;
-        return;
+static uint16_t payload_size(byte_stuffer_state_t* state) {
+    return state->data_end - 1;
+}
+
+// The CRC is computed while the frame is decoded, leaving out the last four
+// bytes which can be the CRC of the frame
+static void update_crc(byte_stuffer_state_t* state) {
+    uint16_t size = payload_size(state);
+    if (size > state->crc_pos + 4) {
+        state->crc = crc32_update(state->crc, state->data + 1 + state->crc_pos, size - 4 - state->crc_pos);
+        state->crc_pos = size - 4;
+    }
+}
+
+// The first byte of a frame, moved to the start of the buffer
+static void start_frame(byte_stuffer_state_t* state) {
+    uint8_t* code = state->data + state->recv_pos;
+    uint16_t left = state->recv_end - state->recv_pos;
+    if (code != state->data) {
+        memmove(state->data, code, left);
+    }
+    init_byte_stuffer_state(state);
+    state->next_zero = state->data[0];
+    state->long_frame = state->data[0] == 0xFF;
+    state->recv_pos = 1;
+    state->recv_end = left;
+}
+
+// The non-zero bytes of a block up to the next code, or the end of what was
+// received
+static void decode_block(byte_stuffer_state_t* state) {
+    uint16_t size = state->next_zero - 1;
+    uint16_t received = state->recv_end - state->recv_pos;
+    uint16_t space = MAX_FRAME_SIZE - payload_size(state);
+    if (size > received) {
+        size = received;
     }
+    if (size > space) {
+        size = space;
+    }
+    uint8_t* block = state->data + state->recv_pos;
+    uint8_t* zero = memchr(block, 0, size);
+    if (zero) {
+        size = zero - block;
+    }
+    if (state->data_end != state->recv_pos) {
+        memmove(state->data + state->data_end, block, size);
+    }
+    state->data_end += size;
+    state->recv_pos += size;
+    state->next_zero -= size;
+}
 
-    state->next_zero--;
-    if (data == 0) {
+static void decode(uint8_t link, byte_stuffer_state_t* state) {
+    while (state->recv_pos < state->recv_end) {
+        // Start of a new frame
         if (state->next_zero == 0) {
-            // The frame is completed
-            if (state->data_pos > 0) {
-                validator_recv_frame(link, state->data, state->data_pos);
+            start_frame(state);
+            continue;
+        }
+
+        if (state->next_zero > 1) {
+            decode_block(state);
+            update_crc(state);
+            if (state->recv_pos == state->recv_end) {
+                break;
             }
         }
-        else {
-            // The frame is invalid, so reset
-            init_byte_stuffer_state(state);
+
+        uint8_t data = state->data[state->recv_pos];
+        if (data == 0) {
+            state->recv_pos++;
+            if (state->next_zero == 1) {
+                // The frame is completed
+                state->next_zero = 0;
+                if (payload_size(state) > 0) {
+                    validator_recv_frame_with_crc(link, state->data + 1, payload_size(state),
+                        crc32_final(state->crc));
+                }
+            }
+            else {
+                // The frame is invalid, so reset
+                init_byte_stuffer_state(state);
+            }
         }
-    }
-    else {
-        if (state->data_pos == MAX_FRAME_SIZE) {
+        else if (payload_size(state) == MAX_FRAME_SIZE) {
             // We exceeded our maximum frame size
-            // therefore there's nothing else to do than reset to a new frame
-            state->next_zero = data;
-            state->long_frame = data == 0xFF;
-            state->data_pos = 0;
+            // therefore there's nothing else to do than start a new frame
+            // with this byte
+            state->next_zero = 0;
         }
-        else if (state->next_zero == 0) {
-            if (state->long_frame) {
-                // This is part of a long frame, so continue
-                state->next_zero = data;
-                state->long_frame = data == 0xFF;
-            }
-            else {
+        else {
+            state->recv_pos++;
+            if (!state->long_frame) {
                 // Special case for zeroes
-                state->next_zero = data;
-                state->data[state->data_pos++] = 0;
+                state->data[state->data_end++] = 0;
+                update_crc(state);
             }
+            // Otherwise this is part of a long frame, so continue
+            state->next_zero = data;
+            state->long_frame = data == 0xFF;
         }
-        else {
-            state->data[state->data_pos++] = data;
+    }
+}
+
+uint8_t* byte_stuffer_recv_buffer(uint8_t link, uint16_t* size) {
+    byte_stuffer_state_t* state = &states[link];
+    // Between frames, everything received is decoded
+    if (state->next_zero == 0) {
+        state->recv_pos = 0;
+        state->recv_end = 0;
+    }
+    if (state->recv_end == RECV_BUFFER_SIZE) {
+        // Can't happen, the frame is aborted before it gets that long
+        init_byte_stuffer_state(state);
+        state->recv_pos = 0;
+        state->recv_end = 0;
+    }
+    *size = RECV_BUFFER_SIZE - state->recv_end;
+    return state->data + state->recv_end;
+}
+
+void byte_stuffer_recv_in_place(uint8_t link, uint16_t size) {
+    byte_stuffer_state_t* state = &states[link];
+    state->recv_end += size;
+    decode(link, state);
+}
+
+void byte_stuffer_recv(uint8_t link, const uint8_t* data, uint16_t size) {
+    while (size > 0) {
+        uint16_t space;
+        uint8_t* buffer = byte_stuffer_recv_buffer(link, &space);
+        if (space > size) {
+            space = size;
         }
+        memcpy(buffer, data, space);
+        byte_stuffer_recv_in_place(link, space);
+        data += space;
+        size -= space;
     }
 }
 
+void byte_stuffer_recv_byte(uint8_t link, uint8_t data) {
+    byte_stuffer_recv(link, &data, 1);
+}
+
 static void send_block(uint8_t link, uint8_t* start, uint8_t* end, uint8_t num_non_zero) {
     send_data(link, &num_non_zero, 1);
     if (end > start) {
@@ -32,6 +32,11 @@ SOFTWARE.
 
 void init_byte_stuffer(void);
 void byte_stuffer_recv_byte(uint8_t link, uint8_t data);
+void byte_stuffer_recv(uint8_t link, const uint8_t* data, uint16_t size);
+// Where the next bytes of the link can be received, without a copy, and how
+// many fit, then byte_stuffer_recv_in_place() decodes the ones received
+uint8_t* byte_stuffer_recv_buffer(uint8_t link, uint16_t* size);
+void byte_stuffer_recv_in_place(uint8_t link, uint16_t size);
 void byte_stuffer_send_frame(uint8_t link, uint8_t* data, uint16_t size);
 
 #endif
@@ -0,0 +1,47 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#ifndef SERIAL_LINK_CRC32_H
+#define SERIAL_LINK_CRC32_H
+
+#include <stdint.h>
+
+/* The CRC32 of the frames, which can be fed a few bytes at a time as they
+ * arrive:
+ *   uint32_t crc = CRC32_INIT;
+ *   crc = crc32_update(crc, data, size);
+ *   ...
+ *   crc = crc32_final(crc);
+ *
+ * It goes a byte at a time through a 1 KB table, or with
+ * SERIAL_LINK_CRC32_SLICING_BY_4 defined four bytes at a time through 4 KB
+ * of tables, which is faster on the 32 bit MCUs.
+ */
+
+#define CRC32_INIT 0xFFFFFFFF
+#define crc32_final(crc) ((crc) ^ 0xFFFFFFFF)
+
+uint32_t crc32_update(uint32_t crc, const uint8_t* data, uint16_t size);
+
+#endif
@@ -28,6 +28,8 @@ SOFTWARE.
 #include <stdint.h>
 
 void validator_recv_frame(uint8_t link, uint8_t* data, uint16_t size);
+// The same, with the CRC32 of all but the last 4 bytes already computed
+void validator_recv_frame_with_crc(uint8_t link, uint8_t* data, uint16_t size, uint32_t crc);
 // The buffer pointed to by the data needs 4 additional bytes
 void validator_send_frame(uint8_t link, uint8_t* data, uint16_t size);
 
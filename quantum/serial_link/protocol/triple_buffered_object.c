@@ -27,52 +27,109 @@ SOFTWARE.
 #include <stdbool.h>
 #include <stddef.h>
 
-#define GET_READ_INDEX() object->state & 3
-#define GET_WRITE_INDEX() (object->state >> 2) & 3
-#define GET_SHARED_INDEX() (object->state >> 4) & 3
-#define GET_DATA_AVAILABLE() (object->state >> 6) & 1
+// The whole state is a single byte, so both sides swap their buffer with the
+// shared one by replacing it at once. Where the CPU has exclusive loads and
+// stores (LDREXB/STREXB on Cortex-M3 and up) that's a compare and swap loop,
+// otherwise the interrupts are masked around it.
+#if defined(__AVR__)
+#   include <util/atomic.h>
+#elif !defined(PROTOCOL_CHIBIOS) || defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#   define TRIPLE_BUFFER_ATOMIC
+#endif
 
-#define SET_READ_INDEX(i) object->state = ((object->state & ~3) | i)
-#define SET_WRITE_INDEX(i) object->state = ((object->state & ~(3 << 2)) | (i << 2))
-#define SET_SHARED_INDEX(i) object->state = ((object->state & ~(3 << 4)) | (i << 4))
-#define SET_DATA_AVAILABLE(i) object->state = ((object->state & ~(1 << 6)) | (i << 6))
+#define GET_READ_INDEX(state) ((state) & 3)
+#define GET_WRITE_INDEX(state) (((state) >> 2) & 3)
+#define GET_SHARED_INDEX(state) (((state) >> 4) & 3)
+#define GET_DATA_AVAILABLE(state) (((state) >> 6) & 1)
 
-void triple_buffer_init(triple_buffer_object_t* object) {
-    object->state = 0;
-    SET_WRITE_INDEX(0);
-    SET_READ_INDEX(1);
-    SET_SHARED_INDEX(2);
-    SET_DATA_AVAILABLE(0);
+#define MAKE_STATE(read, write, shared, available) \
+    ((read) | ((write) << 2) | ((shared) << 4) | ((available) << 6))
+
+// The reader takes the shared buffer if there's new data in it
+static uint8_t read_state(uint8_t state) {
+    return MAKE_STATE(GET_SHARED_INDEX(state), GET_WRITE_INDEX(state), GET_READ_INDEX(state), false);
 }
 
-void* triple_buffer_read_internal(uint16_t object_size, triple_buffer_object_t* object) {
+// The writer publishes its buffer and takes the shared one
+static uint8_t write_state(uint8_t state) {
+    return MAKE_STATE(GET_READ_INDEX(state), GET_SHARED_INDEX(state), GET_WRITE_INDEX(state), true);
+}
+
+#if defined(TRIPLE_BUFFER_ATOMIC)
+
+static uint8_t load_state(triple_buffer_object_t* object) {
+    return __atomic_load_n(&object->state, __ATOMIC_ACQUIRE);
+}
+
+// Returns false if the other side changed the state in the meantime
+static bool swap_state(triple_buffer_object_t* object, uint8_t* state, uint8_t new_state) {
+    return __atomic_compare_exchange_n(&object->state, state, new_state, true,
+        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+#elif defined(__AVR__)
+
+static uint8_t load_state(triple_buffer_object_t* object) {
+    return *(volatile uint8_t*)&object->state;
+}
+
+static bool swap_state(triple_buffer_object_t* object, uint8_t* state, uint8_t new_state) {
+    bool swapped = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (object->state == *state) {
+            object->state = new_state;
+            swapped = true;
+        }
+        else {
+            *state = object->state;
+        }
+    }
+    return swapped;
+}
+
+#else
+
+static uint8_t load_state(triple_buffer_object_t* object) {
+    return *(volatile uint8_t*)&object->state;
+}
+
+static bool swap_state(triple_buffer_object_t* object, uint8_t* state, uint8_t new_state) {
+    bool swapped = false;
     serial_link_lock();
-    if (GET_DATA_AVAILABLE()) {
-        uint8_t shared_index = GET_SHARED_INDEX();
-        uint8_t read_index = GET_READ_INDEX();
-        SET_READ_INDEX(shared_index);
-        SET_SHARED_INDEX(read_index);
-        SET_DATA_AVAILABLE(false);
-        serial_link_unlock();
-        return object->buffer + object_size * shared_index;
+    if (object->state == *state) {
+        object->state = new_state;
+        swapped = true;
     }
     else {
-        serial_link_unlock();
-        return NULL;
+        *state = object->state;
     }
+    serial_link_unlock();
+    return swapped;
+}
+
+#endif
+
+void triple_buffer_init(triple_buffer_object_t* object) {
+    object->state = MAKE_STATE(1, 0, 2, false);
+}
+
+void* triple_buffer_read_internal(uint16_t object_size, triple_buffer_object_t* object) {
+    uint8_t state = load_state(object);
+    do {
+        if (!GET_DATA_AVAILABLE(state)) {
+            return NULL;
+        }
+    } while (!swap_state(object, &state, read_state(state)));
+    return object->buffer + object_size * GET_SHARED_INDEX(state);
 }
 
 void* triple_buffer_begin_write_internal(uint16_t object_size, triple_buffer_object_t* object) {
-    uint8_t write_index = GET_WRITE_INDEX();
+    // Only the writer changes the write index
+    uint8_t write_index = GET_WRITE_INDEX(load_state(object));
     return object->buffer + object_size * write_index;
 }
 
 void triple_buffer_end_write_internal(triple_buffer_object_t* object) {
-    serial_link_lock();
-    uint8_t shared_index = GET_SHARED_INDEX();
-    uint8_t write_index = GET_WRITE_INDEX();
-    SET_SHARED_INDEX(write_index);
-    SET_WRITE_INDEX(shared_index);
-    SET_DATA_AVAILABLE(true);
-    serial_link_unlock();
+    uint8_t state = load_state(object);
+    while (!swap_state(object, &state, write_state(state)));
 }
@@ -27,6 +27,8 @@ SOFTWARE.
 
 #include <stdint.h>
 
+// One writer and one reader, which can run in different threads or interrupts
+// without any other locking. The reader gets the latest complete object.
 typedef struct {
     uint8_t state;
     uint8_t buffer[] __attribute__((aligned(4)));
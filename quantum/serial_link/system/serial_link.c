@@ -67,15 +67,11 @@ static SerialConfig config = {
 //#define DEBUG_LINK_ERRORS
 
 static uint32_t read_from_serial(SerialDriver* driver, uint8_t link) {
-    const uint32_t buffer_size = 16;
-    uint8_t buffer[buffer_size];
+    // everything that is in the input queue, straight into the frame buffer
+    uint16_t buffer_size;
+    uint8_t* buffer = byte_stuffer_recv_buffer(link, &buffer_size);
     uint32_t bytes_read = sdAsynchronousRead(driver, buffer, buffer_size);
-    uint8_t* current = buffer;
-    uint8_t* end = current + bytes_read;
-    while(current < end) {
-        byte_stuffer_recv_byte(link, *current);
-        current++;
-    }
+    byte_stuffer_recv_in_place(link, bytes_read);
     return bytes_read;
 }
 
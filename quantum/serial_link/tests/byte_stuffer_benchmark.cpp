@@ -0,0 +1,212 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+extern "C" {
+#include "serial_link/protocol/byte_stuffer.h"
+#include "serial_link/protocol/crc32.h"
+}
+
+// Received frames are compared against the ones sent through the CRC the
+// byte stuffer computed for them
+static unsigned frames_received;
+static unsigned crc_errors;
+
+extern "C" {
+    void validator_recv_frame_with_crc(uint8_t link, uint8_t* data, uint16_t size, uint32_t crc) {
+        uint32_t frame_crc;
+        memcpy(&frame_crc, data + size - 4, 4);
+        crc_errors += frame_crc != crc;
+        frames_received++;
+    }
+
+    void send_data(uint8_t link, const uint8_t* data, uint16_t size);
+}
+
+static std::vector<uint8_t> wire;
+
+void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
+    wire.insert(wire.end(), data, data + size);
+}
+
+// The decoder before the frames were decoded in place, a byte at a time into
+// its own buffer, with the CRC computed in a second pass
+namespace before {
+    struct {
+        uint16_t next_zero;
+        uint16_t data_pos;
+        bool long_frame;
+        uint8_t data[MAX_FRAME_SIZE];
+    } state;
+
+    void recv_frame(uint8_t* data, uint16_t size) {
+        if (size > 4) {
+            uint32_t crc = crc32_final(crc32_update(CRC32_INIT, data, size - 4));
+            validator_recv_frame_with_crc(0, data, size, crc);
+        }
+    }
+
+    void recv_byte(uint8_t data) {
+        if (state.next_zero == 0) {
+            state.next_zero = data;
+            state.long_frame = data == 0xFF;
+            state.data_pos = 0;
+            return;
+        }
+        state.next_zero--;
+        if (data == 0) {
+            if (state.next_zero == 0) {
+                if (state.data_pos > 0) {
+                    recv_frame(state.data, state.data_pos);
+                }
+            }
+            else {
+                state.next_zero = 0;
+                state.data_pos = 0;
+                state.long_frame = false;
+            }
+        }
+        else if (state.data_pos == MAX_FRAME_SIZE) {
+            state.next_zero = data;
+            state.long_frame = data == 0xFF;
+            state.data_pos = 0;
+        }
+        else if (state.next_zero == 0) {
+            if (!state.long_frame) {
+                state.data[state.data_pos++] = 0;
+            }
+            state.next_zero = data;
+            state.long_frame = data == 0xFF;
+        }
+        else {
+            state.data[state.data_pos++] = data;
+        }
+    }
+}
+
+// The serial driver's input queue hands over this much at a time
+static const size_t QUEUE_SIZE = 16;
+
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+class ByteStufferBenchmark : public testing::TestWithParam<uint16_t> {
+public:
+    ByteStufferBenchmark() : random(42) {
+        init_byte_stuffer();
+        memset(&before::state, 0, sizeof(before::state));
+        wire.clear();
+        frames_received = 0;
+        crc_errors = 0;
+        // random frames with a few zeroes, with their CRC
+        uint16_t size = GetParam();
+        for (unsigned i = 0; i < FRAMES; i++) {
+            std::vector<uint8_t> frame(size + 4);
+            for (uint16_t j = 0; j < size; j++) {
+                frame[j] = random() % 32 ? random() : 0;
+            }
+            uint32_t crc = crc32_final(crc32_update(CRC32_INIT, frame.data(), size));
+            memcpy(frame.data() + size, &crc, 4);
+            byte_stuffer_send_frame(0, frame.data(), frame.size());
+        }
+    }
+
+    static const unsigned FRAMES = 2000;
+    std::mt19937 random;
+};
+
+TEST_P(ByteStufferBenchmark, decodes_the_frames) {
+    uint16_t size = GetParam();
+    const unsigned rounds = 20;
+
+    // the driver copies into a buffer on the stack, then a byte at a time
+    uint64_t start = cycles();
+    size_t before_copied = 0;
+    for (unsigned round = 0; round < rounds; round++) {
+        for (size_t pos = 0; pos < wire.size(); pos += QUEUE_SIZE) {
+            uint8_t buffer[QUEUE_SIZE];
+            size_t read = std::min(QUEUE_SIZE, wire.size() - pos);
+            memcpy(buffer, wire.data() + pos, read);
+            before_copied += read;
+            for (size_t i = 0; i < read; i++) {
+                before::recv_byte(buffer[i]);
+            }
+        }
+    }
+    uint64_t before_cycles = cycles() - start;
+    EXPECT_EQ(frames_received, FRAMES * rounds);
+    // and each byte of the payload once more into the frame
+    before_copied += (size_t)frames_received * (size + 4);
+    unsigned before_frames = frames_received;
+
+    // the driver copies straight into the frame, which is decoded there
+    frames_received = 0;
+    start = cycles();
+    for (unsigned round = 0; round < rounds; round++) {
+        size_t pos = 0;
+        while (pos < wire.size()) {
+            uint16_t space;
+            uint8_t* buffer = byte_stuffer_recv_buffer(1, &space);
+            size_t read = std::min({QUEUE_SIZE, wire.size() - pos, (size_t)space});
+            memcpy(buffer, wire.data() + pos, read);
+            byte_stuffer_recv_in_place(1, read);
+            pos += read;
+        }
+    }
+    uint64_t after_cycles = cycles() - start;
+    EXPECT_EQ(frames_received, FRAMES * rounds);
+    EXPECT_EQ(crc_errors, 0);
+    // the frames are short of the 254 non-zero bytes after which a part of
+    // them is moved
+    size_t after_copied = wire.size() * rounds;
+
+    double bytes = (double)wire.size() * rounds;
+#if defined(__x86_64__) || defined(__i386__)
+    const char* unit = "bytes/cycle";
+#else
+    const char* unit = "bytes/ns";
+#endif
+    std::cout << "[ COBS     ] " << size << " byte frames: before " << bytes / before_cycles << " " << unit
+        << ", " << (double)before_copied / before_frames / (size + 4) << " copies per frame; after "
+        << bytes / after_cycles << " " << unit << ", "
+        << (double)after_copied / frames_received / (size + 4) << " copies per frame" << std::endl;
+}
+
+// A few keys, a report, and a long frame
+INSTANTIATE_TEST_CASE_P(FrameSizes, ByteStufferBenchmark, testing::Values(8, 64, 250, 1000));
@@ -30,11 +30,13 @@ extern "C" {
 #include "serial_link/protocol/byte_stuffer.h"
 #include "serial_link/protocol/frame_validator.h"
 #include "serial_link/protocol/physical.h"
+#include "serial_link/protocol/crc32.h"
 }
 
 using testing::_;
 using testing::ElementsAreArray;
 using testing::Args;
+using testing::Invoke;
 
 class ByteStuffer : public ::testing::Test{
 public:
@@ -53,6 +55,7 @@ public:
         std::copy(data, data + size, std::back_inserter(sent_data));
     }
     std::vector<uint8_t> sent_data;
+    uint32_t received_crc;
 
     static ByteStuffer* Instance;
 };
@@ -64,6 +67,11 @@ extern "C" {
         ByteStuffer::Instance->validator_recv_frame(link, data, size);
     }
 
+    void validator_recv_frame_with_crc(uint8_t link, uint8_t* data, uint16_t size, uint32_t crc) {
+        ByteStuffer::Instance->received_crc = crc;
+        ByteStuffer::Instance->validator_recv_frame(link, data, size);
+    }
+
     void send_data(uint8_t link, const uint8_t* data, uint16_t size) {
         ByteStuffer::Instance->send_data(link, data, size);
     }
@@ -481,3 +489,66 @@ TEST_F(ByteStuffer, sends_and_receives_full_roundtrip_254_bytes_and_then_zero) {
        byte_stuffer_recv_byte(1, d);
     }
 }
+
+TEST_F(ByteStuffer, computes_the_crc_of_frames_of_any_length_while_receiving) {
+    uint8_t original_data[300];
+    int i;
+    for(i=0;i<300;i++) {
+        original_data[i] = i * 7;
+    }
+    EXPECT_CALL(*this, validator_recv_frame(_, _, _))
+        .Times(300 - 4);
+    uint16_t size;
+    for(size=5;size<=300;size++) {
+        sent_data.clear();
+        byte_stuffer_send_frame(0, original_data, size);
+        for(auto& d : sent_data) {
+           byte_stuffer_recv_byte(1, d);
+        }
+        // everything but the last four bytes, which are the frame's CRC
+        uint32_t expected = crc32_final(crc32_update(CRC32_INIT, original_data, size - 4));
+        EXPECT_EQ(received_crc, expected) << size << " bytes";
+    }
+}
+
+TEST_F(ByteStuffer, receives_the_same_frames_from_buffers_of_any_size) {
+    std::vector<std::vector<uint8_t>> frames;
+    frames.push_back({1, 2, 3});
+    frames.push_back({0, 0, 7, 0});
+    frames.push_back(std::vector<uint8_t>(300, 9));
+    frames.push_back(std::vector<uint8_t>(600));
+    for (size_t i = 0; i < frames[3].size(); i++) {
+        frames[3][i] = i % 255;
+    }
+    for (auto& frame : frames) {
+        byte_stuffer_send_frame(0, frame.data(), frame.size());
+    }
+    std::vector<uint8_t> stream = sent_data;
+    std::vector<std::vector<uint8_t>> received;
+    EXPECT_CALL(*this, validator_recv_frame(_, _, _))
+        .WillRepeatedly(Invoke([&received](uint8_t link, uint8_t* data, uint16_t size) {
+            received.emplace_back(data, data + size);
+        }));
+    size_t buffer_size;
+    for (buffer_size = 1; buffer_size <= stream.size(); buffer_size += buffer_size < 40 ? 1 : 97) {
+        received.clear();
+        size_t pos;
+        for (pos = 0; pos < stream.size(); pos += buffer_size) {
+            byte_stuffer_recv(1, stream.data() + pos, std::min(buffer_size, stream.size() - pos));
+        }
+        EXPECT_EQ(received, frames) << buffer_size << " byte buffers";
+    }
+}
+
+TEST_F(ByteStuffer, decodes_the_frame_where_it_was_received) {
+    uint8_t original_data[] = {1, 0, 3, 0, 0, 9};
+    byte_stuffer_send_frame(0, original_data, sizeof(original_data));
+    uint16_t size;
+    uint8_t* buffer = byte_stuffer_recv_buffer(1, &size);
+    ASSERT_GE(size, sent_data.size());
+    std::copy(sent_data.begin(), sent_data.end(), buffer);
+    // the payload starts after the first code
+    EXPECT_CALL(*this, validator_recv_frame(1, buffer + 1, sizeof(original_data)))
+        .With(Args<1, 2>(ElementsAreArray(original_data)));
+    byte_stuffer_recv_in_place(1, sent_data.size());
+}
@@ -0,0 +1,115 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2016 Fred Sundvik
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+extern "C" {
+#include "serial_link/protocol/crc32.h"
+}
+
+// A bit at a time, straight from the polynomial
+static uint32_t reference_crc32(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size) {
+    return crc32_final(crc32_update(CRC32_INIT, data, size));
+}
+
+class Crc32 : public testing::Test {
+public:
+    Crc32() : random(42), data(1024 + 4) {
+        for (auto& byte : data) {
+            byte = random();
+        }
+    }
+
+    std::mt19937 random;
+    std::vector<uint8_t> data;
+};
+
+TEST_F(Crc32, computes_the_check_value) {
+    const char* check = "123456789";
+    EXPECT_EQ(crc32(reinterpret_cast<const uint8_t*>(check), 9), 0xCBF43926);
+}
+
+TEST_F(Crc32, matches_the_reference_at_any_length_and_alignment) {
+    for (size_t offset = 0; offset < 4; offset++) {
+        for (size_t size = 0; size <= 64; size++) {
+            EXPECT_EQ(crc32(data.data() + offset, size), reference_crc32(data.data() + offset, size))
+                << size << " bytes at offset " << offset;
+        }
+    }
+    EXPECT_EQ(crc32(data.data(), 1024), reference_crc32(data.data(), 1024));
+}
+
+TEST_F(Crc32, gives_the_same_crc_when_fed_in_pieces) {
+    const size_t size = 100;
+    uint32_t expected = reference_crc32(data.data(), size);
+    for (size_t split = 0; split <= size; split++) {
+        uint32_t crc = CRC32_INIT;
+        crc = crc32_update(crc, data.data(), split);
+        crc = crc32_update(crc, data.data() + split, size - split);
+        EXPECT_EQ(crc32_final(crc), expected) << "split at " << split;
+    }
+    for (int i = 0; i < 100; i++) {
+        uint32_t crc = CRC32_INIT;
+        size_t pos = 0;
+        while (pos < size) {
+            size_t piece = std::min<size_t>(random() % 9, size - pos);
+            crc = crc32_update(crc, data.data() + pos, piece);
+            pos += piece;
+        }
+        EXPECT_EQ(crc32_final(crc), expected);
+    }
+}
+
+TEST_F(Crc32, benchmark) {
+    const int frames = 20000;
+    const size_t size = 1024;
+    volatile uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < frames; i++) {
+        sink = sink + crc32(data.data() + (i & 3), size);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+#ifdef SERIAL_LINK_CRC32_SLICING_BY_4
+    const char* name = "slicing by 4";
+#else
+    const char* name = "byte at a time";
+#endif
+    std::cout << "[ CRC32    ] " << name << ": "
+        << frames * size / elapsed.count() / 1e6 << " MB/s, "
+        << elapsed.count() * 1e9 / (frames * size) << " ns per byte" << std::endl;
+}
@@ -98,6 +98,20 @@ TEST_F(FrameValidator, validates_five_byte_frame_with_correct_crc) {
     validator_recv_frame(0, data, 9);
 }
 
+TEST_F(FrameValidator, validates_frame_with_the_crc_it_is_given) {
+    uint8_t data[] = {1, 2, 3, 4, 5, 0xF4, 0x99, 0x0B, 0x47};
+    EXPECT_CALL(*this, route_incoming_frame(_, _, _))
+        .With(Args<1, 2>(ElementsAreArray(data, 5)));
+    validator_recv_frame_with_crc(0, data, 9, 0x470B99F4);
+}
+
+TEST_F(FrameValidator, does_not_validate_frame_with_a_different_crc) {
+    uint8_t data[] = {1, 2, 3, 4, 5, 0xF4, 0x99, 0x0B, 0x47};
+    EXPECT_CALL(*this, route_incoming_frame(_, _, _))
+        .Times(0);
+    validator_recv_frame_with_crc(0, data, 9, 0x470B99F5);
+}
+
 TEST_F(FrameValidator, sends_one_byte_with_correct_crc) {
     uint8_t original[] = {0x44, 0, 0, 0, 0};
     uint8_t expected[] = {0x44, 0x04, 0x6A, 0xB3, 0xA3};
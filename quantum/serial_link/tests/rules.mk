@@ -1,17 +1,32 @@
 serial_link_byte_stuffer_SRC :=\
 	$(SERIAL_PATH)/tests/byte_stuffer_tests.cpp \
-	$(SERIAL_PATH)/protocol/byte_stuffer.c
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/crc32.c
+
+serial_link_byte_stuffer_benchmark_SRC :=\
+	$(SERIAL_PATH)/tests/byte_stuffer_benchmark.cpp \
+	$(SERIAL_PATH)/protocol/byte_stuffer.c \
+	$(SERIAL_PATH)/protocol/crc32.c
 
 serial_link_frame_validator_SRC := \
 	$(SERIAL_PATH)/tests/frame_validator_tests.cpp \
-	$(SERIAL_PATH)/protocol/frame_validator.c 
+	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/crc32.c
 
 serial_link_frame_router_SRC := \
 	$(SERIAL_PATH)/tests/frame_router_tests.cpp \
 	$(SERIAL_PATH)/protocol/byte_stuffer.c \
 	$(SERIAL_PATH)/protocol/frame_validator.c \
+	$(SERIAL_PATH)/protocol/crc32.c \
 	$(SERIAL_PATH)/protocol/frame_router.c
 
+serial_link_crc32_SRC := \
+	$(SERIAL_PATH)/tests/crc32_tests.cpp \
+	$(SERIAL_PATH)/protocol/crc32.c
+
+serial_link_crc32_slicing_DEFS := -DSERIAL_LINK_CRC32_SLICING_BY_4
+serial_link_crc32_slicing_SRC := $(serial_link_crc32_SRC)
+
 serial_link_triple_buffered_object_SRC := \
 	$(SERIAL_PATH)/tests/triple_buffered_object_tests.cpp \
 	$(SERIAL_PATH)/protocol/triple_buffered_object.c 
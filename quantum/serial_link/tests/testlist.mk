@@ -1,6 +1,9 @@
 TEST_LIST +=\
 	serial_link_byte_stuffer\
+	serial_link_byte_stuffer_benchmark\
 	serial_link_frame_validator\
+	serial_link_crc32\
+	serial_link_crc32_slicing\
 	serial_link_frame_router\
 	serial_link_triple_buffered_object\
 	serial_link_transport
\ No newline at end of file
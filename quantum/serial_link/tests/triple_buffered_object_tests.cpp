@@ -23,6 +23,10 @@ SOFTWARE.
 */
 
 #include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
 extern "C" {
 #include "serial_link/protocol/triple_buffered_object.h"
 }
@@ -82,3 +86,107 @@ TEST_F(TripleBufferedObject, performs_two_writes_in_the_middle_of_read) {
     EXPECT_EQ(*triple_buffer_read(&test_object), 3);
     EXPECT_EQ(triple_buffer_read(&test_object), nullptr);
 }
+
+struct stress_frame {
+    uint32_t sequence;
+    uint32_t words[15];
+};
+
+struct stress_object {
+    uint8_t state;
+    stress_frame buffer[3] __attribute__((aligned(4)));
+};
+
+stress_object stress_object;
+
+static void write_stress_frame(uint32_t sequence) {
+    stress_frame* frame = triple_buffer_begin_write(&stress_object);
+    frame->sequence = sequence;
+    for (uint32_t i = 0; i < 15; i++) {
+        frame->words[i] = sequence * (i + 1);
+    }
+    triple_buffer_end_write(&stress_object);
+}
+
+static bool is_whole_frame(const stress_frame* frame) {
+    for (uint32_t i = 0; i < 15; i++) {
+        if (frame->words[i] != frame->sequence * (i + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The writer and the reader run in their own threads, like the serial link
+// thread and the keyboard task, every frame read has to be one written as a
+// whole and newer than the previous one
+TEST_F(TripleBufferedObject, reads_whole_frames_while_writing_from_another_thread) {
+    const uint32_t num_writes = 1000000;
+    triple_buffer_init((triple_buffer_object_t*)&stress_object);
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        for (uint32_t sequence = 1; sequence <= num_writes; sequence++) {
+            write_stress_frame(sequence);
+            // give the reader a chance on a single core too
+            if ((sequence & 63) == 0) {
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+    });
+
+    uint32_t num_reads = 0;
+    uint32_t torn_reads = 0;
+    uint32_t out_of_order_reads = 0;
+    uint32_t last_sequence = 0;
+    while (last_sequence != num_writes) {
+        bool writer_done = done;
+        stress_frame* frame = triple_buffer_read(&stress_object);
+        if (!frame) {
+            // the last frame is still there once the writer is done
+            EXPECT_FALSE(writer_done);
+            if (writer_done) {
+                break;
+            }
+            std::this_thread::yield();
+            continue;
+        }
+        num_reads++;
+        uint32_t sequence = frame->sequence;
+        if (!is_whole_frame(frame)) {
+            torn_reads++;
+        }
+        if (sequence <= last_sequence) {
+            out_of_order_reads++;
+        }
+        last_sequence = sequence;
+    }
+    writer.join();
+
+    std::cout << "[ BUFFER   ] " << num_writes << " writes, " << num_reads
+        << " reads from another thread" << std::endl;
+    EXPECT_EQ(torn_reads, 0);
+    EXPECT_EQ(out_of_order_reads, 0);
+    EXPECT_EQ(last_sequence, num_writes);
+    EXPECT_GT(num_reads, 1);
+}
+
+TEST_F(TripleBufferedObject, benchmark) {
+    const uint32_t num_writes = 1000000;
+    triple_buffer_init((triple_buffer_object_t*)&stress_object);
+    uint32_t num_reads = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint32_t sequence = 1; sequence <= num_writes; sequence++) {
+        write_stress_frame(sequence);
+        // the keyboard task reads less often than the link writes
+        if ((sequence & 3) == 0) {
+            stress_frame* frame = triple_buffer_read(&stress_object);
+            num_reads += frame && frame->sequence == sequence;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "[ BUFFER   ] " << sizeof(stress_frame) << " byte frames: "
+        << seconds * 1e9 / (num_writes + num_reads) << " ns per write or read, "
+        << num_writes * sizeof(stress_frame) / seconds / 1e6 << " MB/s written" << std::endl;
+    EXPECT_EQ(num_reads, num_writes / 4);
+}
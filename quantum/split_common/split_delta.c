@@ -0,0 +1,186 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "split_delta.h"
+
+#define MASK_LENGTH(length) (((length) + 7) / 8)
+
+void split_delta_master_init(split_delta_master_t *master, uint8_t length)
+{
+    master->length = length;
+    for (uint8_t i = 0; i < SPLIT_DELTA_MAX_LENGTH; i++) {
+        master->rows[i] = 0;
+    }
+    master->seq = 0;
+    master->synced = false;
+}
+
+void split_delta_slave_init(split_delta_slave_t *slave, uint8_t length)
+{
+    slave->length = length;
+    for (uint8_t i = 0; i < SPLIT_DELTA_MAX_LENGTH; i++) {
+        slave->sent[i] = 0;
+        slave->acked[i] = 0;
+    }
+    slave->sent_seq = 0;
+    slave->acked_seq = 0;
+    slave->unacked = 0;
+    slave->synced = false;
+}
+
+uint8_t split_delta_request(split_delta_master_t *master, const uint8_t *data, uint8_t length, uint8_t *frame)
+{
+    frame[0] = master->synced ? master->seq : SPLIT_DELTA_RESYNC;
+    for (uint8_t i = 0; i < length; i++) {
+        frame[i + 1] = data[i];
+    }
+    return length + 1;
+}
+
+static bool apply_changes(split_delta_master_t *master, const uint8_t *frame, uint8_t length)
+{
+    const uint8_t *mask = frame + 1;
+    const uint8_t *data = mask + MASK_LENGTH(master->length);
+    const uint8_t *end = frame + length;
+    if (data > end) {
+        return false;
+    }
+    // check the length before touching the rows
+    uint8_t changed = 0;
+    for (uint8_t i = 0; i < master->length; i++) {
+        changed += (mask[i / 8] >> (i % 8)) & 1;
+    }
+    if (data + changed != end) {
+        return false;
+    }
+    for (uint8_t i = 0; i < master->length; i++) {
+        if ((mask[i / 8] >> (i % 8)) & 1) {
+            master->rows[i] = *data++;
+        }
+    }
+    return true;
+}
+
+bool split_delta_apply(split_delta_master_t *master, const uint8_t *frame, uint8_t length)
+{
+    if (length == 0) {
+        master->synced = false;
+        return false;
+    }
+    uint8_t header = frame[0];
+    uint8_t seq = SPLIT_DELTA_SEQ(header);
+    bool applied = false;
+    switch (header & SPLIT_DELTA_TYPE) {
+    case SPLIT_DELTA_SAME:
+        applied = master->synced && seq == master->seq && length == 1;
+        break;
+    case SPLIT_DELTA_CHANGES:
+        // the changes from rows the master doesn't have are lost
+        applied = master->synced && SPLIT_DELTA_BASE(header) == master->seq &&
+            apply_changes(master, frame, length);
+        break;
+    case SPLIT_DELTA_FULL:
+        if (length == master->length + 1) {
+            for (uint8_t i = 0; i < master->length; i++) {
+                master->rows[i] = frame[i + 1];
+            }
+            applied = true;
+        }
+        break;
+    }
+    master->synced = applied;
+    if (applied) {
+        master->seq = seq;
+    }
+    return applied;
+}
+
+static void acknowledge(split_delta_slave_t *slave, const uint8_t *request, uint8_t request_length)
+{
+    bool wrapped = slave->unacked >= 7;
+    slave->unacked = 0;
+    if (request_length == 0 || (request[0] & SPLIT_DELTA_RESYNC) || wrapped) {
+        slave->synced = false;
+        return;
+    }
+    uint8_t seq = request[0] & 7;
+    if (slave->synced && seq == slave->acked_seq) {
+        return;
+    }
+    if (seq == slave->sent_seq) {
+        for (uint8_t i = 0; i < slave->length; i++) {
+            slave->acked[i] = slave->sent[i];
+        }
+        slave->acked_seq = seq;
+        slave->synced = true;
+    } else {
+        slave->synced = false;
+    }
+}
+
+uint8_t split_delta_answer(split_delta_slave_t *slave, const uint8_t *request, uint8_t request_length,
+                           bool valid, const uint8_t *rows, uint8_t *frame)
+{
+    // a corrupted request says nothing of the rows the master has
+    if (valid) {
+        acknowledge(slave, request, request_length);
+    }
+
+    // the changes, as long as they are shorter than all the rows
+    bool full = !slave->synced;
+    uint8_t mask_length = MASK_LENGTH(slave->length);
+    uint8_t length = 1 + mask_length;
+    for (uint8_t i = 0; i < mask_length; i++) {
+        frame[1 + i] = 0;
+    }
+    for (uint8_t i = 0; i < slave->length && !full; i++) {
+        if (rows[i] != slave->acked[i]) {
+            if (length >= slave->length) {
+                full = true;
+            } else {
+                frame[1 + i / 8] |= 1 << (i % 8);
+                frame[length++] = rows[i];
+            }
+        }
+    }
+
+    if (!full && length == 1 + mask_length) {
+        frame[0] = SPLIT_DELTA_SAME | slave->acked_seq << 3;
+        return 1;
+    }
+
+    // a new number for new rows, never the acknowledged one
+    slave->sent_seq = (slave->sent_seq + 1) & 7;
+    if (slave->sent_seq == slave->acked_seq) {
+        slave->sent_seq = (slave->sent_seq + 1) & 7;
+    }
+    if (slave->unacked < 0xFF) {
+        slave->unacked++;
+    }
+    for (uint8_t i = 0; i < slave->length; i++) {
+        slave->sent[i] = rows[i];
+    }
+
+    if (!full) {
+        frame[0] = SPLIT_DELTA_CHANGES | slave->sent_seq << 3 | slave->acked_seq;
+        return length;
+    }
+    frame[0] = SPLIT_DELTA_FULL | slave->sent_seq << 3;
+    for (uint8_t i = 0; i < slave->length; i++) {
+        frame[1 + i] = rows[i];
+    }
+    return 1 + slave->length;
+}
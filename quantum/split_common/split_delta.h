@@ -0,0 +1,86 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPLIT_DELTA_H
+#define SPLIT_DELTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "split_transport.h"
+
+/* The slave's rows are only sent when they change, as the bytes that differ
+ * from the last rows the master acknowledged.
+ *
+ * The slave's frames start with a header: the type in the two top bits, the
+ * sequence number of the rows in the next three and, for the changes, the
+ * sequence number of the rows they apply to in the three bottom ones.
+ *   SAME     the rows the master acknowledged haven't changed
+ *   CHANGES  a mask with a bit per byte of the rows, then the bytes set in it
+ *   FULL     all the rows
+ *
+ * The master's frames start with the sequence number of the rows it has,
+ * with SPLIT_DELTA_RESYNC set when it hasn't got any it can apply changes
+ * to, followed by its own buffer as it is. An update lost on the way is sent
+ * again in the next changes, which still apply to the rows the master has. */
+
+#define SPLIT_DELTA_SAME    0x00
+#define SPLIT_DELTA_CHANGES 0x40
+#define SPLIT_DELTA_FULL    0x80
+#define SPLIT_DELTA_TYPE    0xC0
+#define SPLIT_DELTA_SEQ(header)  (((header) >> 3) & 7)
+#define SPLIT_DELTA_BASE(header) ((header) & 7)
+
+#define SPLIT_DELTA_RESYNC  0x08
+
+/* Largest rows, so that a full frame fits in the transport */
+#define SPLIT_DELTA_MAX_LENGTH (SPLIT_TRANSPORT_BUFFER_SIZE - 1)
+
+typedef struct {
+    uint8_t length;
+    uint8_t rows[SPLIT_DELTA_MAX_LENGTH];
+    uint8_t seq;
+    /* rows and seq are the slave's */
+    bool synced;
+} split_delta_master_t;
+
+typedef struct {
+    uint8_t length;
+    /* The rows of the last frame, and the last ones the master acknowledged */
+    uint8_t sent[SPLIT_DELTA_MAX_LENGTH];
+    uint8_t acked[SPLIT_DELTA_MAX_LENGTH];
+    uint8_t sent_seq;
+    uint8_t acked_seq;
+    /* Frames numbered since the last request, once the numbers wrap an
+     * acknowledgement could mean any of them */
+    uint8_t unacked;
+    bool synced;
+} split_delta_slave_t;
+
+void split_delta_master_init(split_delta_master_t *master, uint8_t length);
+void split_delta_slave_init(split_delta_slave_t *slave, uint8_t length);
+
+/* Writes the master's frame to frame, returns its length */
+uint8_t split_delta_request(split_delta_master_t *master, const uint8_t *data, uint8_t length, uint8_t *frame);
+/* Applies the slave's frame to the master's rows, returns false if it
+ * couldn't, the next request asks for all the rows */
+bool split_delta_apply(split_delta_master_t *master, const uint8_t *frame, uint8_t length);
+
+/* Writes the slave's answer to request, which is only looked at if valid,
+ * returns its length */
+uint8_t split_delta_answer(split_delta_slave_t *slave, const uint8_t *request, uint8_t request_length,
+                           bool valid, const uint8_t *rows, uint8_t *frame);
+
+#endif
@@ -0,0 +1,250 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stddef.h>
+#include "split_events.h"
+#include "split_transport.h"
+#include "event_queue.h"
+#include "timer.h"
+
+#define EVENT_BYTES 3
+#define MAX_EVENTS ((SPLIT_TRANSPORT_BUFFER_SIZE - 1) / EVENT_BYTES)
+
+/* The slave's events until the master has them, slave_index is the number
+ * of the oldest one */
+static keyrecord_t slave_records[SPLIT_EVENTS_QUEUE_SIZE];
+static event_queue_t slave_queue = EVENT_QUEUE_INIT(slave_records);
+static uint8_t slave_index;
+static matrix_row_t slave_rows[MATRIX_ROWS];
+
+/* The master's own events and the slave's, until they run */
+static keyrecord_t local_records[SPLIT_EVENTS_QUEUE_SIZE];
+static event_queue_t local_queue = EVENT_QUEUE_INIT(local_records);
+static keyrecord_t remote_records[SPLIT_EVENTS_QUEUE_SIZE];
+static event_queue_t remote_queue = EVENT_QUEUE_INIT(remote_records);
+/* The number of the slave's next event */
+static uint8_t expected;
+/* The master has all the slave's events up to then */
+static uint16_t watermark;
+static uint16_t last_answer;
+static bool linked;
+static matrix_row_t remote_down[MATRIX_ROWS];
+
+void split_events_init(void)
+{
+    event_queue_clear(&slave_queue);
+    event_queue_clear(&local_queue);
+    event_queue_clear(&remote_queue);
+    slave_index = 0;
+    expected = 0;
+    linked = false;
+    for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+        slave_rows[r] = 0;
+        remote_down[r] = 0;
+    }
+}
+
+// Whether a happened before b, both in the last 65 s
+static bool before(uint16_t a, uint16_t b, uint16_t now)
+{
+    return (uint16_t)(now - a) > (uint16_t)(now - b);
+}
+
+/* The time of an event now, which is odd as 0 is no event: the times of the
+ * events of this ms can be one ahead of timer_read() */
+static uint16_t event_time(void)
+{
+    return timer_read() | 1;
+}
+
+static keyrecord_t key_record(uint8_t row, uint8_t col, bool pressed, uint16_t time)
+{
+    keyrecord_t record = {
+        .event = {
+            .key = (keypos_t){ .row = row, .col = col },
+            .pressed = pressed,
+            .time = time | 1
+        }
+    };
+    return record;
+}
+
+void split_events_scan(const matrix_row_t *rows, uint8_t first_row, uint8_t count)
+{
+    uint16_t now = event_time();
+    for (uint8_t r = 0; r < count; r++) {
+        matrix_row_t *previous = &slave_rows[first_row + r];
+        matrix_row_t change = rows[r] ^ *previous;
+        for (uint8_t c = 0; change && c < MATRIX_COLS; c++) {
+            matrix_row_t bit = (matrix_row_t)1 << c;
+            if (change & bit) {
+                // when full, a later scan picks the change up
+                if (!event_queue_push(&slave_queue, key_record(first_row + r, c, rows[r] & bit, now))) {
+                    return;
+                }
+                *previous ^= bit;
+                change ^= bit;
+            }
+        }
+    }
+}
+
+uint8_t split_events_answer(const uint8_t *request, uint8_t request_length, bool valid, uint8_t *frame)
+{
+    uint8_t length = event_queue_length(&slave_queue);
+    if (valid && request_length >= 1) {
+        uint8_t acked = (request[0] - slave_index) & SPLIT_EVENTS_INDEX;
+        if (acked <= length) {
+            for (uint8_t i = 0; i < acked; i++) {
+                event_queue_pop(&slave_queue);
+            }
+            length -= acked;
+        }
+        // otherwise one of the halves restarted, the events are numbered
+        // from the one the master expects
+        slave_index = request[0] & SPLIT_EVENTS_INDEX;
+    }
+
+    uint8_t count = length < MAX_EVENTS ? length : MAX_EVENTS;
+    frame[0] = slave_index | (length > count ? SPLIT_EVENTS_MORE : 0);
+    uint16_t now = event_time();
+    for (uint8_t i = 0; i < count; i++) {
+        keyevent_t *event = &event_queue_at(&slave_queue, i)->event;
+        uint16_t age = now - event->time;
+        uint8_t *bytes = frame + 1 + i * EVENT_BYTES;
+        bytes[0] = event->key.row | (event->pressed ? SPLIT_EVENTS_PRESSED : 0);
+        bytes[1] = event->key.col;
+        bytes[2] = age < 0xFF ? age : 0xFF;
+    }
+    return 1 + count * EVENT_BYTES;
+}
+
+uint8_t split_events_request(const uint8_t *data, uint8_t length, uint8_t *frame)
+{
+    frame[0] = expected;
+    for (uint8_t i = 0; i < length; i++) {
+        frame[i + 1] = data[i];
+    }
+    return length + 1;
+}
+
+void split_events_receive(const uint8_t *frame, uint8_t length)
+{
+    if (length == 0 || (length - 1) % EVENT_BYTES) {
+        return;
+    }
+    uint16_t now = event_time();
+    if (!linked) {
+        watermark = now;
+    }
+    linked = true;
+    last_answer = now;
+
+    uint8_t count = (length - 1) / EVENT_BYTES;
+    uint8_t first = frame[0] & SPLIT_EVENTS_INDEX;
+    // the ones the master already has, unless the slave numbered its events
+    // again and some are lost
+    uint8_t skip = (expected - first) & SPLIT_EVENTS_INDEX;
+    if (skip > SPLIT_EVENTS_INDEX / 2) {
+        skip = 0;
+        expected = first;
+    }
+    bool complete = !(frame[0] & SPLIT_EVENTS_MORE);
+    for (uint8_t i = skip; i < count; i++) {
+        const uint8_t *bytes = frame + 1 + i * EVENT_BYTES;
+        uint8_t row = bytes[0] & ~SPLIT_EVENTS_PRESSED;
+        uint8_t col = bytes[1];
+        bool pressed = bytes[0] & SPLIT_EVENTS_PRESSED;
+        if (row >= MATRIX_ROWS || col >= MATRIX_COLS) {
+            return;
+        }
+        // after the events that may already have run
+        uint16_t time = now - bytes[2];
+        if (before(time, watermark, now)) {
+            time = watermark;
+        }
+        if (!event_queue_push(&remote_queue, key_record(row, col, pressed, time))) {
+            complete = false;
+            break;
+        }
+        if (pressed) {
+            remote_down[row] |= (matrix_row_t)1 << col;
+        } else {
+            remote_down[row] &= ~((matrix_row_t)1 << col);
+        }
+        expected = (expected + 1) & SPLIT_EVENTS_INDEX;
+        watermark = time;
+    }
+    if (complete) {
+        watermark = now;
+    }
+}
+
+void split_events_disconnect(void)
+{
+    uint16_t now = event_time();
+    for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+        for (uint8_t c = 0; remote_down[r] && c < MATRIX_COLS; c++) {
+            matrix_row_t bit = (matrix_row_t)1 << c;
+            if ((remote_down[r] & bit) && event_queue_push(&remote_queue, key_record(r, c, false, now))) {
+                remote_down[r] &= ~bit;
+            }
+        }
+    }
+    linked = false;
+}
+
+bool split_events_local(keyevent_t event)
+{
+    keyrecord_t record = { .event = event };
+    return event_queue_push(&local_queue, record);
+}
+
+bool split_events_next(keyevent_t *event)
+{
+    uint16_t now = event_time();
+    if (linked && TIMER_DIFF_16(now, last_answer) > SPLIT_EVENTS_TIMEOUT) {
+        linked = false;
+    }
+    keyrecord_t *local = event_queue_peek(&local_queue);
+    keyrecord_t *remote = event_queue_peek(&remote_queue);
+    // the slave's events up to the local one may not be in yet
+    if (local && linked && before(watermark, local->event.time, now)) {
+        local = NULL;
+    }
+    if (remote && (!local || !before(local->event.time, remote->event.time, now))) {
+        *event = remote->event;
+        event_queue_pop(&remote_queue);
+        return true;
+    }
+    if (local) {
+        *event = local->event;
+        event_queue_pop(&local_queue);
+        return true;
+    }
+    return false;
+}
+
+keyevent_t split_events_tick(void)
+{
+    keyevent_t tick = TICK;
+    // a tick past the watermark could time out a key the slave released
+    // before then
+    if (linked) {
+        tick.time = watermark | 1;
+    }
+    return tick;
+}
@@ -0,0 +1,77 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPLIT_EVENTS_H
+#define SPLIT_EVENTS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "keyboard.h"
+#include "matrix.h"
+
+/* The slave half sends its key events with their age instead of its rows,
+ * so the master sees every change at the time it happened. keyboard_task()
+ * runs the master's own events and the slave's in time order, holding its
+ * own back until it has the slave's up to then.
+ *
+ * The slave's frames start with the number of their first event, with
+ * SPLIT_EVENTS_MORE set when it has more than fit, followed by 3 bytes per
+ * event: the row with SPLIT_EVENTS_PRESSED, the column, and how many ms ago
+ * it happened. The master's frames start with the number of the next event
+ * it expects, which tells the slave which ones it can drop, followed by its
+ * own buffer. */
+
+#define SPLIT_EVENTS_MORE    0x80
+#define SPLIT_EVENTS_PRESSED 0x80
+#define SPLIT_EVENTS_INDEX   0x7F
+
+/* Events waiting on either side, a power of two */
+#ifndef SPLIT_EVENTS_QUEUE_SIZE
+#   define SPLIT_EVENTS_QUEUE_SIZE 16
+#endif
+
+/* Without an answer from the slave for that long, in ms, the master stops
+ * waiting for its events */
+#ifndef SPLIT_EVENTS_TIMEOUT
+#   define SPLIT_EVENTS_TIMEOUT 20
+#endif
+
+void split_events_init(void);
+
+/* Slave: records the changes of its rows, from the first one on */
+void split_events_scan(const matrix_row_t *rows, uint8_t first_row, uint8_t count);
+/* Slave: writes the answer to the master's request, which is only looked at
+ * if valid, returns its length */
+uint8_t split_events_answer(const uint8_t *request, uint8_t request_length, bool valid, uint8_t *frame);
+
+/* Master: writes its frame, followed by data, returns its length */
+uint8_t split_events_request(const uint8_t *data, uint8_t length, uint8_t *frame);
+/* Master: queues the slave's events of a valid frame */
+void split_events_receive(const uint8_t *frame, uint8_t length);
+/* Master: releases the keys of the slave that are down, once it's gone */
+void split_events_disconnect(void);
+
+/* Master, from keyboard_task(): queues one of its own events, returns false
+ * when the queue is full */
+bool split_events_local(keyevent_t event);
+/* Master, from keyboard_task(): the next event of either half, in time
+ * order, that doesn't have to wait for the slave */
+bool split_events_next(keyevent_t *event);
+/* Master, from keyboard_task(): a tick event, no later than the events that
+ * are still waiting */
+keyevent_t split_events_tick(void);
+
+#endif
@@ -0,0 +1,236 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The serial.h interface of the split keyboards on top of split_transport,
+ * on the single wire between the halves. Timer 4 of the ATmega32U4 ticks
+ * once per bit and the INTx interrupt of the pin catches the start bits.
+ * The slave's buffer is sent with split_delta, only when it changes, or
+ * with SPLIT_EVENTS_ENABLE its key events are sent with split_events instead.
+ *
+ * The keyboard's serial.h sets the pin, its interrupt and the buffers:
+ *   SERIAL_PIN_DDR, SERIAL_PIN_PORT, SERIAL_PIN_INPUT, SERIAL_PIN_MASK
+ *   SERIAL_PIN_INTERRUPT       INT0_vect
+ *   SERIAL_PIN_INT             INT0, the bit of the interrupt in EIMSK
+ *   SERIAL_SLAVE_BUFFER_LENGTH, SERIAL_MASTER_BUFFER_LENGTH
+ *   SERIAL_BUFFER_TYPE         uint8_t, type of the buffer elements
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <string.h>
+#include "serial.h"
+#include "split_transport.h"
+#include "split_delta.h"
+#ifdef SPLIT_EVENTS_ENABLE
+#   include "split_events.h"
+#endif
+
+#ifndef USE_I2C
+
+#ifndef SERIAL_PIN_INT
+#   define SERIAL_PIN_INT INT0
+#endif
+
+#ifndef SERIAL_BUFFER_TYPE
+#   define SERIAL_BUFFER_TYPE uint8_t
+#endif
+
+/* Length of a bit on the wire, the interrupts of the USB and the other
+ * timers can delay the sampling by up to half of it */
+#ifndef SPLIT_SERIAL_BIT_US
+#   define SPLIT_SERIAL_BIT_US 32
+#endif
+
+/* Timer 4 counts at F_CPU / 8 */
+#define BIT_TICKS ((uint16_t)(F_CPU / 8 / 1000000 * SPLIT_SERIAL_BIT_US))
+
+SERIAL_BUFFER_TYPE volatile serial_slave_buffer[SERIAL_SLAVE_BUFFER_LENGTH] = {0};
+SERIAL_BUFFER_TYPE volatile serial_master_buffer[SERIAL_MASTER_BUFFER_LENGTH] = {0};
+
+typedef char serial_buffers_fit[
+    sizeof(serial_slave_buffer) <= SPLIT_DELTA_MAX_LENGTH &&
+    sizeof(serial_master_buffer) <= SPLIT_DELTA_MAX_LENGTH ? 1 : -1];
+
+static split_transport_t transport;
+static split_delta_master_t delta_master;
+static split_delta_slave_t delta_slave;
+
+/* Called by the slave when the master's buffer has been received */
+__attribute__((weak))
+void serial_slave_contacted(void) {
+}
+
+static void timer_start(uint16_t first_tick) {
+    TCCR4B = 0;
+    TC4H = 0;
+    TCNT4 = BIT_TICKS - first_tick;
+    TIFR4 = _BV(TOV4);
+    TCCR4B = _BV(CS42); // F_CPU / 8
+}
+
+static void timer_stop(void) {
+    TCCR4B = 0;
+}
+
+static void apply(void) {
+    if (transport.line) {
+        // released, with the pull-up
+        SERIAL_PIN_DDR &= ~SERIAL_PIN_MASK;
+        SERIAL_PIN_PORT |= SERIAL_PIN_MASK;
+    } else {
+        SERIAL_PIN_PORT &= ~SERIAL_PIN_MASK;
+        SERIAL_PIN_DDR |= SERIAL_PIN_MASK;
+    }
+
+    if (transport.listening) {
+        EIFR = _BV(SERIAL_PIN_INT);
+        EIMSK |= _BV(SERIAL_PIN_INT);
+    } else {
+        EIMSK &= ~_BV(SERIAL_PIN_INT);
+    }
+
+    switch (transport.timer) {
+    case SPLIT_TIMER_STOP:
+        timer_stop();
+        break;
+    case SPLIT_TIMER_RUN:
+        if (!TCCR4B) {
+            timer_start(BIT_TICKS);
+        }
+        break;
+    case SPLIT_TIMER_HALF_BIT:
+        timer_start(BIT_TICKS / 2);
+        transport.timer = SPLIT_TIMER_RUN;
+        break;
+    }
+}
+
+// From the timer interrupt, right after the master's frame
+static void slave_answer(split_transport_t *t) {
+#ifdef SPLIT_EVENTS_ENABLE
+    t->tx_length = split_events_answer(t->rx, t->rx_length, t->result == SPLIT_RESULT_OK, t->tx);
+#else
+    t->tx_length = split_delta_answer(&delta_slave, t->rx, t->rx_length,
+        t->result == SPLIT_RESULT_OK, (const uint8_t *)serial_slave_buffer, t->tx);
+#endif
+}
+
+static void serial_init(bool master) {
+    split_transport_init(&transport, master, master ? NULL : slave_answer);
+    split_delta_master_init(&delta_master, sizeof(serial_slave_buffer));
+    split_delta_slave_init(&delta_slave, sizeof(serial_slave_buffer));
+
+    // normal mode, counting up to OCR4C
+    TCCR4A = 0;
+    TCCR4B = 0;
+    TCCR4C = 0;
+    TCCR4D = 0;
+    TCCR4E = 0;
+    TC4H = 0;
+    OCR4C = BIT_TICKS - 1;
+    TIMSK4 = _BV(TOIE4);
+
+    // falling edge
+    EICRA = (EICRA & ~(3 << (2 * SERIAL_PIN_INT))) | (2 << (2 * SERIAL_PIN_INT));
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        apply();
+    }
+}
+
+void serial_master_init(void) {
+    serial_init(true);
+}
+
+void serial_slave_init(void) {
+    serial_init(false);
+}
+
+ISR(TIMER4_OVF_vect) {
+    split_transport_tick(&transport, SERIAL_PIN_INPUT & SERIAL_PIN_MASK);
+    if (!transport.master && transport.received) {
+        transport.received = false;
+        // the master's buffer follows the header
+        if (transport.rx_length == sizeof(serial_master_buffer) + 1) {
+            memcpy((void *)serial_master_buffer, transport.rx + 1, sizeof(serial_master_buffer));
+        }
+        serial_slave_contacted();
+    }
+    apply();
+}
+
+ISR(SERIAL_PIN_INTERRUPT) {
+    split_transport_edge(&transport);
+    apply();
+}
+
+bool serial_slave_data_corrupt(void) {
+    return transport.result == SPLIT_RESULT_CORRUPT;
+}
+
+bool serial_slave_DATA_CORRUPT(void) {
+    return serial_slave_data_corrupt();
+}
+
+// Doesn't wait for the slave: returns the result of the last exchange, with
+// serial_slave_buffer updated if it succeeded, and starts the next one. An
+// update the master couldn't apply leaves the buffer as it was, the slave
+// sends it again.
+//
+// Returns:
+// 0 => no error, or the exchange is still running
+// 1 => slave did not respond
+// 2 => the slave's answer was corrupted
+int serial_update_buffers(void) {
+    if (split_transport_busy(&transport)) {
+        return 0;
+    }
+
+    split_result_t result = transport.result;
+    if (transport.received) {
+        transport.received = false;
+#ifdef SPLIT_EVENTS_ENABLE
+        split_events_receive(transport.rx, transport.rx_length);
+#else
+        if (split_delta_apply(&delta_master, transport.rx, transport.rx_length)) {
+            memcpy((void *)serial_slave_buffer, delta_master.rows, sizeof(serial_slave_buffer));
+        }
+#endif
+    }
+#ifdef SPLIT_EVENTS_ENABLE
+    transport.tx_length = split_events_request(
+        (const uint8_t *)serial_master_buffer, sizeof(serial_master_buffer), transport.tx);
+#else
+    transport.tx_length = split_delta_request(&delta_master,
+        (const uint8_t *)serial_master_buffer, sizeof(serial_master_buffer), transport.tx);
+#endif
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        split_transport_start(&transport);
+        apply();
+    }
+
+    switch (result) {
+    case SPLIT_RESULT_NO_RESPONSE:
+        return 1;
+    case SPLIT_RESULT_CORRUPT:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+#endif
@@ -0,0 +1,227 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "split_transport.h"
+
+enum {
+    IDLE,
+    SEND,
+    /* between the bytes of a frame, or waiting for the answer */
+    RECEIVE_WAIT,
+    RECEIVE,
+};
+
+/* Bits of a byte, with the start and stop bits */
+#define STOP_BIT 9
+#define BYTE_BITS 10
+
+uint8_t split_crc8(uint8_t crc, uint8_t data)
+{
+    crc ^= data;
+    for (uint8_t i = 0; i < 8; i++) {
+        crc = crc & 1 ? (crc >> 1) ^ 0xE0 : crc >> 1;
+    }
+    return crc;
+}
+
+static void idle(split_transport_t *transport)
+{
+    transport->state = IDLE;
+    transport->line = true;
+    // the slave waits for the master
+    transport->listening = !transport->master;
+    transport->timer = SPLIT_TIMER_STOP;
+}
+
+// The bytes go out of tx as they are, the CRC is computed along
+static void send(split_transport_t *transport)
+{
+    transport->crc = SPLIT_CRC8_INIT;
+    transport->index = 0;
+    transport->bit = 0;
+    transport->state = SEND;
+    transport->listening = false;
+    transport->timer = SPLIT_TIMER_RUN;
+}
+
+static void receive_wait(split_transport_t *transport)
+{
+    transport->state = RECEIVE_WAIT;
+    transport->wait = 0;
+    transport->line = true;
+    transport->listening = true;
+    transport->timer = SPLIT_TIMER_RUN;
+}
+
+static void receive_start(split_transport_t *transport)
+{
+    transport->index = 0;
+    transport->crc = SPLIT_CRC8_INIT;
+}
+
+static void fail(split_transport_t *transport, split_result_t result)
+{
+    transport->result = result;
+    idle(transport);
+}
+
+static void frame_received(split_transport_t *transport)
+{
+    // at least the CRC, and the CRC of the whole frame is 0
+    bool valid = transport->index >= 1 && transport->crc == 0;
+    if (valid) {
+        uint8_t length = transport->index - 1;
+        for (uint8_t i = 0; i < length; i++) {
+            transport->rx[i] = transport->frame[i];
+        }
+        transport->rx_length = length;
+        transport->received = true;
+    }
+    transport->result = valid ? SPLIT_RESULT_OK : SPLIT_RESULT_CORRUPT;
+    if (transport->master) {
+        idle(transport);
+    } else {
+        // the master waits for the answer even if its frame was corrupted
+        if (transport->answer) {
+            transport->answer(transport);
+        }
+        send(transport);
+    }
+}
+
+void split_transport_init(split_transport_t *transport, bool master, split_transport_answer_t answer)
+{
+    transport->master = master;
+    transport->answer = answer;
+    transport->tx_length = 0;
+    transport->rx_length = 0;
+    for (uint8_t i = 0; i < SPLIT_TRANSPORT_BUFFER_SIZE; i++) {
+        transport->tx[i] = 0;
+        transport->rx[i] = 0;
+    }
+    transport->received = false;
+    transport->result = SPLIT_RESULT_NONE;
+    idle(transport);
+}
+
+void split_transport_start(split_transport_t *transport)
+{
+    transport->result = SPLIT_RESULT_NONE;
+    send(transport);
+}
+
+bool split_transport_busy(split_transport_t *transport)
+{
+    return transport->state != IDLE;
+}
+
+void split_transport_tick(split_transport_t *transport, bool line)
+{
+    switch (transport->state) {
+    case SEND:
+        if (transport->bit == BYTE_BITS) {
+            transport->bit = 0;
+            // the CRC is the last byte
+            if (++transport->index > transport->tx_length) {
+                if (transport->master) {
+                    receive_start(transport);
+                    receive_wait(transport);
+                } else {
+                    idle(transport);
+                }
+                return;
+            }
+        }
+        if (transport->bit == 0) {
+            if (transport->index < transport->tx_length) {
+                transport->byte = transport->tx[transport->index];
+                transport->crc = split_crc8(transport->crc, transport->byte);
+            } else {
+                transport->byte = transport->crc;
+            }
+            transport->line = false;
+        } else if (transport->bit == STOP_BIT) {
+            transport->line = true;
+        } else {
+            transport->line = (transport->byte >> (transport->bit - 1)) & 1;
+        }
+        transport->bit++;
+        break;
+
+    case RECEIVE_WAIT:
+        ++transport->wait;
+        if (transport->index == 0) {
+            if (transport->wait > SPLIT_TRANSPORT_TIMEOUT) {
+                fail(transport, SPLIT_RESULT_NO_RESPONSE);
+            }
+        } else if (transport->wait > SPLIT_TRANSPORT_FRAME_GAP) {
+            frame_received(transport);
+        }
+        break;
+
+    case RECEIVE:
+        // sampled in the middle of the bits
+        transport->timer = SPLIT_TIMER_RUN;
+        if (transport->bit == 0) {
+            if (line) {
+                // a glitch, not a start bit
+                if (transport->index == 0 && !transport->master) {
+                    idle(transport);
+                } else {
+                    transport->state = RECEIVE_WAIT;
+                    transport->listening = true;
+                }
+                return;
+            }
+            if (transport->index > SPLIT_TRANSPORT_BUFFER_SIZE) {
+                fail(transport, SPLIT_RESULT_CORRUPT);
+                return;
+            }
+            transport->frame[transport->index] = 0;
+        } else if (transport->bit == STOP_BIT) {
+            if (!line) {
+                fail(transport, SPLIT_RESULT_CORRUPT);
+                return;
+            }
+            transport->crc = split_crc8(transport->crc, transport->frame[transport->index]);
+            transport->index++;
+            receive_wait(transport);
+            return;
+        } else if (line) {
+            transport->frame[transport->index] |= 1 << (transport->bit - 1);
+        }
+        transport->bit++;
+        break;
+
+    default:
+        transport->timer = SPLIT_TIMER_STOP;
+        break;
+    }
+}
+
+void split_transport_edge(split_transport_t *transport)
+{
+    if (transport->state == IDLE && !transport->master) {
+        receive_start(transport);
+    } else if (transport->state != RECEIVE_WAIT) {
+        return;
+    }
+    transport->state = RECEIVE;
+    transport->bit = 0;
+    transport->wait = 0;
+    transport->listening = false;
+    transport->timer = SPLIT_TIMER_HALF_BIT;
+}
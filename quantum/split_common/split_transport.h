@@ -0,0 +1,124 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPLIT_TRANSPORT_H
+#define SPLIT_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The exchange between the two halves of a split keyboard over a single
+ * wire, driven by a timer interrupt once per bit and by the interrupt of the
+ * falling edge of the start bits. Nothing waits, the master starts an
+ * exchange and reads its result once it's done.
+ *
+ * The master sends its frame, the slave answers with its own right after.
+ * Each byte is a start bit, 8 data bits LSB first and a stop bit, a frame is
+ * its bytes followed by their CRC-8 and ends when the line stays idle for
+ * SPLIT_TRANSPORT_FRAME_GAP bits. */
+
+/* Largest buffer sent by either half, in bytes */
+#ifndef SPLIT_TRANSPORT_BUFFER_SIZE
+#   define SPLIT_TRANSPORT_BUFFER_SIZE 16
+#endif
+
+/* Bits the master waits for the answer */
+#ifndef SPLIT_TRANSPORT_TIMEOUT
+#   define SPLIT_TRANSPORT_TIMEOUT 20
+#endif
+
+/* Idle bits after a stop bit that end a frame */
+#ifndef SPLIT_TRANSPORT_FRAME_GAP
+#   define SPLIT_TRANSPORT_FRAME_GAP 2
+#endif
+
+/* What the bit timer should do after each call */
+typedef enum {
+    SPLIT_TIMER_STOP,
+    /* keep ticking once per bit, starting one bit from now if stopped */
+    SPLIT_TIMER_RUN,
+    /* restart with the next tick half a bit from now, in the middle of the
+     * start bit */
+    SPLIT_TIMER_HALF_BIT,
+} split_timer_t;
+
+typedef enum {
+    SPLIT_RESULT_NONE,
+    SPLIT_RESULT_OK,
+    SPLIT_RESULT_NO_RESPONSE,
+    SPLIT_RESULT_CORRUPT,
+} split_result_t;
+
+typedef struct split_transport split_transport_t;
+
+/* Called by the slave once the master's frame has ended, with result telling
+ * whether rx holds it, to fill tx and tx_length with the answer */
+typedef void (*split_transport_answer_t)(split_transport_t *transport);
+
+struct split_transport {
+    /* Set after every call, for the hardware: the level to drive (true
+     * releases the line), whether the falling edge interrupt is enabled and
+     * what the bit timer does */
+    bool line;
+    bool listening;
+    split_timer_t timer;
+
+    bool master;
+    uint8_t state;
+    uint8_t bit;
+    uint8_t index;
+    uint8_t wait;
+    uint8_t crc;
+    /* the byte being sent */
+    uint8_t byte;
+    /* the frame being received, with its CRC */
+    uint8_t frame[SPLIT_TRANSPORT_BUFFER_SIZE + 1];
+
+    split_transport_answer_t answer;
+
+    /* Sent as they are, the master's are written before starting an exchange
+     * and the slave's by answer(). rx_length is the length of the last frame
+     * received. */
+    uint8_t tx_length;
+    uint8_t rx_length;
+    uint8_t tx[SPLIT_TRANSPORT_BUFFER_SIZE];
+    uint8_t rx[SPLIT_TRANSPORT_BUFFER_SIZE];
+    /* rx has been written since it was last cleared */
+    volatile bool received;
+    /* Outcome of the last exchange, SPLIT_RESULT_NONE while the master runs
+     * one */
+    volatile split_result_t result;
+};
+
+void split_transport_init(split_transport_t *transport, bool master, split_transport_answer_t answer);
+
+/* Master only, sends tx and receives rx */
+void split_transport_start(split_transport_t *transport);
+/* In the middle of an exchange */
+bool split_transport_busy(split_transport_t *transport);
+
+/* From the interrupts, line is the level of the wire */
+void split_transport_tick(split_transport_t *transport, bool line);
+void split_transport_edge(split_transport_t *transport);
+
+/* CRC-8 with the polynomial 0x07, reflected since the bytes go out LSB
+ * first, from SPLIT_CRC8_INIT. It catches any burst of up to 8 bits on the
+ * wire, and any 3 flipped bits in frames of up to 14 bytes. Running it over a
+ * frame followed by its CRC gives 0. */
+#define SPLIT_CRC8_INIT 0xFF
+uint8_t split_crc8(uint8_t crc, uint8_t data);
+
+#endif
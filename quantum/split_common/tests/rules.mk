@@ -0,0 +1,26 @@
+# Copyright 2018 QMK
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Both halves run in the same binary, on a simulated wire
+split_transport_INC := $(QUANTUM_PATH)/split_common
+split_transport_SRC := \
+	$(QUANTUM_PATH)/split_common/tests/split_transport_tests.cpp \
+	$(QUANTUM_PATH)/split_common/split_transport.c
+
+split_delta_INC := $(QUANTUM_PATH)/split_common
+split_delta_SRC := \
+	$(QUANTUM_PATH)/split_common/tests/split_delta_tests.cpp \
+	$(QUANTUM_PATH)/split_common/split_delta.c \
+	$(QUANTUM_PATH)/split_common/split_transport.c
@@ -0,0 +1,281 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+extern "C" {
+#include "split_delta.h"
+}
+
+// The rows of a lets_split half and the master's byte
+static const uint8_t ROWS = 4;
+static const uint8_t MASTER_LENGTH = 1;
+
+typedef std::vector<uint8_t> frame_t;
+
+static uint8_t crc8(const frame_t& frame) {
+    uint8_t crc = SPLIT_CRC8_INIT;
+    for (uint8_t byte : frame) {
+        crc = split_crc8(crc, byte);
+    }
+    return crc;
+}
+
+// The checksum of the old serial.c
+static uint8_t sum(const frame_t& frame, size_t length) {
+    uint8_t sum = 0;
+    for (size_t i = 0; i < length; i++) {
+        sum += frame[i];
+    }
+    return sum;
+}
+
+class SplitDelta : public testing::Test {
+protected:
+    SplitDelta() : m_random(42) {
+        split_delta_master_init(&m_master, ROWS);
+        split_delta_slave_init(&m_slave, ROWS);
+        memset(m_rows, 0, sizeof(m_rows));
+        m_bytes = 0;
+    }
+
+    // One exchange on a link that loses or corrupts the frames the hooks
+    // say, with the CRC of the transport. Returns whether the master applied
+    // the slave's frame.
+    template<typename Link>
+    bool exchange(Link& link) {
+        uint8_t buffer[SPLIT_TRANSPORT_BUFFER_SIZE];
+        uint8_t master_data[MASTER_LENGTH] = {0};
+        uint8_t length = split_delta_request(&m_master, master_data, MASTER_LENGTH, buffer);
+        frame_t request(buffer, buffer + length);
+        request.push_back(crc8(request));
+        m_bytes += request.size();
+        if (!link(request)) {
+            return false;
+        }
+        bool valid = crc8(request) == 0;
+
+        length = split_delta_answer(&m_slave, request.data(), request.size() - 1, valid, m_rows, buffer);
+        frame_t answer(buffer, buffer + length);
+        answer.push_back(crc8(answer));
+        m_bytes += answer.size();
+        if (!link(answer) || crc8(answer) != 0) {
+            return false;
+        }
+        bool applied = split_delta_apply(&m_master, answer.data(), answer.size() - 1);
+        if (applied) {
+            m_sent.assign(m_slave.sent, m_slave.sent + ROWS);
+        }
+        return applied;
+    }
+
+    bool master_has(const uint8_t* rows) {
+        return memcmp(m_master.rows, rows, ROWS) == 0;
+    }
+
+    // A key changes in a few of the scans
+    void type() {
+        if (std::uniform_int_distribution<>(0, 9)(m_random) == 0) {
+            uint8_t key = std::uniform_int_distribution<>(0, ROWS * 8 - 1)(m_random);
+            m_rows[key / 8] ^= 1 << (key % 8);
+        }
+    }
+
+    split_delta_master_t m_master;
+    split_delta_slave_t m_slave;
+    uint8_t m_rows[ROWS];
+    frame_t m_sent;
+    size_t m_bytes;
+    std::mt19937 m_random;
+};
+
+static bool perfect(frame_t&) {
+    return true;
+}
+
+TEST_F(SplitDelta, FirstExchangeSendsAllTheRows) {
+    uint8_t rows[ROWS] = {1, 2, 3, 4};
+    memcpy(m_rows, rows, ROWS);
+    EXPECT_TRUE(exchange(perfect));
+    EXPECT_TRUE(master_has(rows));
+}
+
+TEST_F(SplitDelta, SendsOnlyTheChanges) {
+    m_rows[0] = 1;
+    exchange(perfect);
+    exchange(perfect);
+    size_t before = m_bytes;
+    // the master's header and byte, the slave's header, each with a CRC
+    exchange(perfect);
+    EXPECT_EQ(m_bytes - before, (1 + MASTER_LENGTH + 1) + (1 + 1));
+
+    m_rows[2] = 0x10;
+    before = m_bytes;
+    EXPECT_TRUE(exchange(perfect));
+    EXPECT_TRUE(master_has(m_rows));
+    // and a mask and the changed row
+    EXPECT_EQ(m_bytes - before, (1 + MASTER_LENGTH + 1) + (1 + 1 + 1 + 1));
+}
+
+TEST_F(SplitDelta, LostUpdateIsSentAgain) {
+    exchange(perfect);
+    exchange(perfect);
+    m_rows[1] = 0x20;
+    unsigned frames = 0;
+    auto lose_answer = [&frames](frame_t&) {
+        return frames++ != 1;
+    };
+    EXPECT_FALSE(exchange(lose_answer));
+    m_rows[3] = 0x40;
+    EXPECT_TRUE(exchange(perfect));
+    EXPECT_TRUE(master_has(m_rows));
+}
+
+TEST_F(SplitDelta, LostAcknowledgementResyncs) {
+    exchange(perfect);
+    exchange(perfect);
+    m_rows[1] = 0x20;
+    EXPECT_TRUE(exchange(perfect));
+    // the master has the rows, the slave doesn't know
+    bool first = true;
+    auto corrupt_request = [&first](frame_t& frame) {
+        if (first) {
+            frame[0] ^= 1;
+            first = false;
+        }
+        return true;
+    };
+    m_rows[1] = 0;
+    EXPECT_FALSE(exchange(corrupt_request)) << "changes from rows the master doesn't have";
+    EXPECT_TRUE(exchange(perfect));
+    EXPECT_TRUE(master_has(m_rows));
+}
+
+// Random frames of a split half with a few flipped bits
+TEST_F(SplitDelta, DetectsFlippedBits) {
+    const unsigned frames = 20000;
+    std::cout << "[ DELTA    ] bits  missed by the CRC-8  missed by the sum" << std::endl;
+    for (unsigned flips = 1; flips <= 6; flips++) {
+        unsigned crc_missed = 0;
+        unsigned sum_missed = 0;
+        for (unsigned i = 0; i < frames; i++) {
+            frame_t frame(1 + ROWS);
+            for (uint8_t& byte : frame) {
+                byte = m_random();
+            }
+            frame_t with_crc = frame;
+            with_crc.push_back(crc8(frame));
+            frame_t with_sum = frame;
+            with_sum.push_back(sum(frame, frame.size()));
+
+            // distinct bits
+            std::vector<unsigned> bits(with_crc.size() * 8);
+            for (unsigned b = 0; b < bits.size(); b++) {
+                bits[b] = b;
+            }
+            std::shuffle(bits.begin(), bits.end(), m_random);
+            for (unsigned f = 0; f < flips; f++) {
+                with_crc[bits[f] / 8] ^= 1 << (bits[f] % 8);
+                with_sum[bits[f] / 8] ^= 1 << (bits[f] % 8);
+            }
+            crc_missed += crc8(with_crc) == 0;
+            sum_missed += with_sum.back() == sum(with_sum, frame.size());
+        }
+        std::cout << "[ DELTA    ] " << flips << "     "
+            << 100.0 * crc_missed / frames << "%                "
+            << 100.0 * sum_missed / frames << "%" << std::endl;
+        if (flips <= 3) {
+            EXPECT_EQ(crc_missed, 0) << flips << " bits";
+        }
+    }
+}
+
+// Typing on a link that drops frames and flips bursts of bits in others, as
+// a glitch on the wire would: the master only ever has rows the slave sent,
+// and catches up once the link is clean.
+TEST_F(SplitDelta, Fuzz) {
+    const unsigned scans = 100000;
+    unsigned lost = 0;
+    unsigned corrupted = 0;
+    unsigned undetected = 0;
+    unsigned sum_undetected = 0;
+    auto link = [&](frame_t& frame) {
+        unsigned fate = std::uniform_int_distribution<>(0, 99)(m_random);
+        if (fate < 2) {
+            lost++;
+            return false;
+        }
+        if (fate < 7) {
+            // up to a byte long, starting and ending with a flipped bit
+            unsigned bits = frame.size() * 8;
+            unsigned length = std::uniform_int_distribution<>(1, 8)(m_random);
+            unsigned start = std::uniform_int_distribution<>(0, bits - length)(m_random);
+            frame_t error(frame.size());
+            for (unsigned b = start; b < start + length; b++) {
+                if (b == start || b == start + length - 1 || (m_random() & 1)) {
+                    error[b / 8] ^= 1 << (b % 8);
+                }
+            }
+            // the same error on the frame with a sum instead
+            frame_t with_sum(frame.begin(), frame.end() - 1);
+            with_sum.push_back(sum(with_sum, with_sum.size()));
+            for (size_t i = 0; i < frame.size(); i++) {
+                frame[i] ^= error[i];
+                with_sum[i] ^= error[i];
+            }
+            corrupted++;
+            undetected += crc8(frame) == 0;
+            sum_undetected += with_sum.back() == sum(with_sum, with_sum.size() - 1);
+        }
+        return true;
+    };
+
+    unsigned stale = 0;
+    for (unsigned scan = 0; scan < scans; scan++) {
+        type();
+        if (exchange(link)) {
+            // what the slave had when it sent that frame
+            EXPECT_TRUE(master_has(m_sent.data())) << "scan " << scan;
+        }
+        stale += !master_has(m_rows);
+    }
+    size_t fuzz_bytes = m_bytes;
+
+    exchange(perfect);
+    EXPECT_TRUE(master_has(m_rows));
+    m_bytes = 0;
+    for (unsigned scan = 0; scan < scans; scan++) {
+        type();
+        exchange(perfect);
+        EXPECT_TRUE(master_has(m_rows));
+    }
+
+    size_t fixed_bytes = (MASTER_LENGTH + 1) + (ROWS + 1);
+    std::cout << "[ DELTA    ] " << corrupted << " corrupted frames, "
+        << 100.0 * (corrupted - undetected) / corrupted << "% detected by the CRC-8, "
+        << 100.0 * (corrupted - sum_undetected) / corrupted << "% by the sum" << std::endl;
+    std::cout << "[ DELTA    ] " << lost << " frames lost, the master was behind the slave in "
+        << stale << " of " << scans << " scans" << std::endl;
+    std::cout << "[ DELTA    ] " << (double)fuzz_bytes / scans << " bytes per scan on the fuzzed link, "
+        << (double)m_bytes / scans << " on a clean one, " << fixed_bytes
+        << " for all the rows with a sum" << std::endl;
+    EXPECT_EQ(undetected, 0);
+    EXPECT_LT((double)m_bytes / scans, fixed_bytes);
+}
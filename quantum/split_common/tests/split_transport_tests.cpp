@@ -0,0 +1,297 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+extern "C" {
+#include "split_transport.h"
+}
+
+// The slave sends the rows of its half, the master a byte of state
+static const uint8_t SLAVE_LENGTH = 4;
+static const uint8_t MASTER_LENGTH = 1;
+static const double BIT_US = 32;
+
+// One half: its transport and the timer and edge interrupts driving it
+struct Half {
+    split_transport_t transport;
+    double bit_us;
+    bool running;
+    double next_tick;
+    bool connected;
+    unsigned interrupts;
+
+    void init(bool master, double skew, split_transport_answer_t answer = nullptr) {
+        split_transport_init(&transport, master, answer);
+        transport.tx_length = master ? MASTER_LENGTH : SLAVE_LENGTH;
+        bit_us = BIT_US * (1 + skew);
+        running = false;
+        connected = true;
+        interrupts = 0;
+    }
+
+    // What the AVR apply() does to the timer, latency is how late the
+    // interrupt restarting it ran
+    void apply_timer(double now, double latency) {
+        switch (transport.timer) {
+        case SPLIT_TIMER_STOP:
+            running = false;
+            break;
+        case SPLIT_TIMER_RUN:
+            if (!running) {
+                running = true;
+                next_tick = now + bit_us;
+            }
+            break;
+        case SPLIT_TIMER_HALF_BIT:
+            running = true;
+            next_tick = now + latency + bit_us / 2;
+            transport.timer = SPLIT_TIMER_RUN;
+            break;
+        }
+    }
+
+    bool line() {
+        return !connected || transport.line;
+    }
+};
+
+class SplitTransport : public testing::Test {
+protected:
+    SplitTransport() : m_random(42) {
+        m_master.init(true, 0);
+        m_slave.init(false, 0);
+        m_now = 0;
+        m_max_latency = 0;
+        m_noise_start = m_noise_end = -1;
+    }
+
+    bool wire() {
+        bool noise = m_now >= m_noise_start && m_now < m_noise_end;
+        return m_master.line() && m_slave.line() && !noise;
+    }
+
+    void edge(Half& half) {
+        if (half.connected && half.transport.listening) {
+            std::uniform_real_distribution<double> latency(0, m_max_latency);
+            split_transport_edge(&half.transport);
+            half.interrupts++;
+            half.apply_timer(m_now, latency(m_random));
+        }
+    }
+
+    // Runs the interrupts of both halves until the given time
+    void run_until(double end) {
+        while (true) {
+            Half* next = nullptr;
+            for (Half* half : {&m_master, &m_slave}) {
+                if (half->running && half->connected && (!next || half->next_tick < next->next_tick)) {
+                    next = half;
+                }
+            }
+            double next_time = next ? next->next_tick : end;
+            // the noise edges count too
+            for (double t : {m_noise_start, m_noise_end}) {
+                if (t > m_now && t < next_time && t <= end) {
+                    bool before = wire();
+                    m_now = t;
+                    if (before && !wire()) {
+                        edge(m_master);
+                        edge(m_slave);
+                    }
+                }
+            }
+            if (!next || next->next_tick > end) {
+                break;
+            }
+            m_now = next->next_tick;
+            next->next_tick += next->bit_us;
+            bool before = wire();
+            split_transport_tick(&next->transport, before);
+            next->interrupts++;
+            next->apply_timer(m_now, 0);
+            if (before && !wire()) {
+                edge(next == &m_master ? m_slave : m_master);
+            }
+        }
+        m_now = end;
+    }
+
+    // The master's side of serial_update_buffers(), returns the result of
+    // the exchange it picked up, or SPLIT_RESULT_NONE if it's still running
+    split_result_t master_update(uint8_t* slave_rows, uint8_t master_state) {
+        if (split_transport_busy(&m_master.transport)) {
+            return SPLIT_RESULT_NONE;
+        }
+        split_result_t result = m_master.transport.result;
+        if (m_master.transport.received) {
+            m_master.transport.received = false;
+            memcpy(slave_rows, m_master.transport.rx, SLAVE_LENGTH);
+        }
+        m_master.transport.tx[0] = master_state;
+        split_transport_start(&m_master.transport);
+        m_master.apply_timer(m_now, 0);
+        return result;
+    }
+
+    void slave_write(const uint8_t* rows) {
+        memcpy(m_slave.transport.tx, rows, SLAVE_LENGTH);
+    }
+
+    Half m_master;
+    Half m_slave;
+    double m_now;
+    double m_max_latency;
+    double m_noise_start;
+    double m_noise_end;
+    std::mt19937 m_random;
+};
+
+TEST_F(SplitTransport, ExchangesTheBuffersBothWays) {
+    uint8_t rows[SLAVE_LENGTH] = {0x01, 0x80, 0xFF, 0x00};
+    uint8_t got[SLAVE_LENGTH] = {};
+    slave_write(rows);
+    EXPECT_EQ(master_update(got, 0xA5), SPLIT_RESULT_NONE);
+    EXPECT_TRUE(split_transport_busy(&m_master.transport));
+    run_until(5000);
+    EXPECT_FALSE(split_transport_busy(&m_master.transport));
+    EXPECT_EQ(master_update(got, 0xA5), SPLIT_RESULT_OK);
+    EXPECT_EQ(0, memcmp(got, rows, SLAVE_LENGTH));
+    EXPECT_TRUE(m_slave.transport.received);
+    EXPECT_EQ(m_slave.transport.rx[0], 0xA5);
+}
+
+// The slave answers with as many bytes as the master asks for
+static void answer_length(split_transport_t *transport) {
+    transport->tx_length = 0;
+    if (transport->result == SPLIT_RESULT_OK) {
+        transport->tx_length = transport->rx[0];
+        for (uint8_t i = 0; i < transport->tx_length; i++) {
+            transport->tx[i] = i;
+        }
+    }
+}
+
+TEST_F(SplitTransport, FramesOfAnyLength) {
+    m_slave.init(false, 0, answer_length);
+    uint8_t got[SLAVE_LENGTH] = {};
+    for (uint8_t length = 0; length <= SPLIT_TRANSPORT_BUFFER_SIZE; length++) {
+        master_update(got, length);
+        run_until(m_now + 10000);
+        EXPECT_EQ(master_update(got, 0), SPLIT_RESULT_OK);
+        EXPECT_EQ(m_master.transport.rx_length, length);
+        for (uint8_t i = 0; i < length; i++) {
+            EXPECT_EQ(m_master.transport.rx[i], i);
+        }
+        // the exchange that started
+        run_until(m_now + 10000);
+    }
+}
+
+TEST_F(SplitTransport, MissingSlaveDoesNotAnswer) {
+    uint8_t got[SLAVE_LENGTH] = {};
+    m_slave.connected = false;
+    master_update(got, 0);
+    run_until(5000);
+    EXPECT_FALSE(split_transport_busy(&m_master.transport));
+    EXPECT_EQ(master_update(got, 0), SPLIT_RESULT_NO_RESPONSE);
+    // and recovers once it's back
+    m_slave.connected = true;
+    run_until(10000);
+    EXPECT_EQ(master_update(got, 0), SPLIT_RESULT_OK);
+}
+
+TEST_F(SplitTransport, CorruptedAnswerIsDetected) {
+    uint8_t rows[SLAVE_LENGTH] = {0xFF, 0xFF, 0xFF, 0xFF};
+    uint8_t got[SLAVE_LENGTH] = {};
+    slave_write(rows);
+    master_update(got, 0);
+    // the third data bit of the slave's second byte, the master frame is 2
+    // bytes and the slave starts after the gap that ends it
+    double slave_start = 2 * 10 * BIT_US + (SPLIT_TRANSPORT_FRAME_GAP + 2.5) * BIT_US;
+    m_noise_start = slave_start + (10 + 3) * BIT_US + 4;
+    m_noise_end = m_noise_start + BIT_US / 2;
+    run_until(5000);
+    EXPECT_EQ(master_update(got, 0), SPLIT_RESULT_CORRUPT);
+    for (uint8_t i = 0; i < SLAVE_LENGTH; i++) {
+        EXPECT_EQ(got[i], 0) << "the corrupted rows are dropped";
+    }
+}
+
+// The halves' clocks are within a percent of each other, the edge interrupt
+// can be delayed by the others
+TEST_F(SplitTransport, ToleratesClockSkewAndInterruptLatency) {
+    for (double skew : {-0.01, 0.01}) {
+        m_master.init(true, skew);
+        m_slave.init(false, -skew);
+        m_max_latency = 0.25 * BIT_US;
+        unsigned errors = 0;
+        unsigned exchanges = 0;
+        uint8_t got[SLAVE_LENGTH] = {};
+        uint8_t rows[SLAVE_LENGTH] = {};
+        for (unsigned scan = 0; scan < 2000; scan++) {
+            split_result_t result = master_update(got, scan);
+            if (result == SPLIT_RESULT_OK) {
+                exchanges++;
+                // the rows of a single scan of the slave
+                EXPECT_EQ(got[3], (uint8_t)~got[0]);
+            } else if (result != SPLIT_RESULT_NONE) {
+                errors++;
+            }
+            if (scan % 3 == 0) {
+                rows[0]++;
+                rows[3] = ~rows[0];
+                slave_write(rows);
+            }
+            run_until(m_now + 1000);
+        }
+        EXPECT_EQ(errors, 0) << "skew " << skew;
+        // an exchange takes a bit more than two scans
+        EXPECT_GT(exchanges, 600);
+    }
+}
+
+// The old serial.c bit banged the same exchange from the scan loop, with the
+// interrupts disabled. Here the scan loop only picks up the result.
+TEST_F(SplitTransport, ScanLoopTime) {
+    const unsigned scans = 20000;
+    const double scan_us = 1000;
+    uint8_t got[SLAVE_LENGTH] = {};
+    uint8_t rows[SLAVE_LENGTH] = {};
+    unsigned exchanges = 0;
+    std::chrono::steady_clock::duration in_transport(0);
+    for (unsigned scan = 0; scan < scans; scan++) {
+        rows[scan % SLAVE_LENGTH] = scan;
+        slave_write(rows);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        exchanges += master_update(got, scan) == SPLIT_RESULT_OK;
+        in_transport += std::chrono::steady_clock::now() - start;
+        run_until(m_now + scan_us);
+    }
+    double wire_us = ((MASTER_LENGTH + 1) + (SLAVE_LENGTH + 1)) * 10 * BIT_US +
+        (2 * (SPLIT_TRANSPORT_FRAME_GAP + 1) + 1.5) * BIT_US;
+    double interrupts = (double)(m_master.interrupts + m_slave.interrupts) / exchanges / 2;
+    std::cout << "[ SPLIT    ] " << exchanges << " exchanges in " << scans << " scans, "
+        << wire_us << " us on the wire each, that a blocking transport spends in the scan loop" << std::endl;
+    std::cout << "[ SPLIT    ] scan loop in the transport: "
+        << std::chrono::duration<double, std::nano>(in_transport).count() / scans
+        << " ns per scan (host), " << interrupts << " interrupts per exchange on each half" << std::endl;
+    EXPECT_GT(exchanges, scans / 4);
+}
@@ -0,0 +1,3 @@
+TEST_LIST +=\
+	split_transport\
+	split_delta
@@ -0,0 +1,567 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+extern "C" {
+#include "synth.h"
+#include "voices.h"
+#include "luts.h"
+#include "musical_notes.h"
+#include "song_list.h"
+
+extern uint16_t envelope_index;
+extern bool glissando;
+extern bool note_resting;
+}
+
+#define CPU_PRESCALER 8
+
+// The timer interrupt before it stopped using floats, the same state it had
+// in audio.c. The voices keep their state in synth.c.
+namespace reference {
+
+int voices = 0;
+int voice_place = 0;
+float frequency = 0;
+float frequency_alt = 0;
+float frequencies[8];
+float place = 0;
+
+bool playing_notes = false;
+bool playing_note = false;
+float note_frequency = 0;
+float note_length = 0;
+uint16_t note_position = 0;
+float (*notes_pointer)[][2];
+uint16_t notes_count;
+bool notes_repeat;
+bool note_resting = false;
+uint8_t current_note = 0;
+
+float vibrato_counter = 0;
+
+float mod(float a, int b)
+{
+    float r = fmod(a, b);
+    return r < 0 ? r + b : r;
+}
+
+float vibrato(float average_freq) {
+    float vibrated_freq = average_freq * pow(vibrato_lut[(int)vibrato_counter], vibrato_strength);
+    vibrato_counter = mod((vibrato_counter + vibrato_rate * (1.0 + 440.0/average_freq)), VIBRATO_LUT_LENGTH);
+    return vibrated_freq;
+}
+
+void play_note(float freq) {
+    playing_note = true;
+    envelope_index = 0;
+    if (freq > 0) {
+        frequencies[voices] = freq;
+        voices++;
+    }
+}
+
+void play_notes(float (*np)[][2], uint16_t n_count, bool n_repeat)
+{
+    playing_notes = true;
+    notes_pointer = np;
+    notes_count = n_count;
+    notes_repeat = n_repeat;
+    place = 0;
+    current_note = 0;
+    note_frequency = (*notes_pointer)[current_note][0];
+    note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
+    note_position = 0;
+}
+
+// The timer 1 and 3 registers
+uint16_t TIMER_1_PERIOD, TIMER_1_DUTY_CYCLE, TIMER_3_PERIOD, TIMER_3_DUTY_CYCLE;
+
+// ISR(TIMER3_AUDIO_vect) with both timers, returns false when it disables itself
+bool isr(void)
+{
+    float freq;
+
+    if (playing_note) {
+        if (voices > 0) {
+
+            float freq_alt = 0;
+                if (voices > 1) {
+                    if (polyphony_rate == 0) {
+                        if (glissando) {
+                            if (frequency_alt != 0 && frequency_alt < frequencies[voices - 2] && frequency_alt < frequencies[voices - 2] * pow(2, -440/frequencies[voices - 2]/12/2)) {
+                                frequency_alt = frequency_alt * pow(2, 440/frequency_alt/12/2);
+                            } else if (frequency_alt != 0 && frequency_alt > frequencies[voices - 2] && frequency_alt > frequencies[voices - 2] * pow(2, 440/frequencies[voices - 2]/12/2)) {
+                                frequency_alt = frequency_alt * pow(2, -440/frequency_alt/12/2);
+                            } else {
+                                frequency_alt = frequencies[voices - 2];
+                            }
+                        } else {
+                            frequency_alt = frequencies[voices - 2];
+                        }
+
+                        if (vibrato_strength > 0) {
+                            freq_alt = vibrato(frequency_alt);
+                        } else {
+                            freq_alt = frequency_alt;
+                        }
+                    }
+
+                    if (envelope_index < 65535) {
+                        envelope_index++;
+                    }
+
+                    freq_alt = voice_envelope(freq_alt);
+
+                    if (freq_alt < 30.517578125) {
+                        freq_alt = 30.52;
+                    }
+
+                    TIMER_1_PERIOD = (uint16_t)(((float)F_CPU) / (freq_alt * CPU_PRESCALER));
+                    TIMER_1_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq_alt * CPU_PRESCALER)) * note_timbre);
+                }
+
+            if (polyphony_rate > 0) {
+                if (voices > 1) {
+                    voice_place %= voices;
+                    if (place++ > (frequencies[voice_place] / polyphony_rate / CPU_PRESCALER)) {
+                        voice_place = (voice_place + 1) % voices;
+                        place = 0.0;
+                    }
+                }
+
+                if (vibrato_strength > 0) {
+                    freq = vibrato(frequencies[voice_place]);
+                } else {
+                    freq = frequencies[voice_place];
+                }
+            } else {
+                if (glissando) {
+                    if (frequency != 0 && frequency < frequencies[voices - 1] && frequency < frequencies[voices - 1] * pow(2, -440/frequencies[voices - 1]/12/2)) {
+                        frequency = frequency * pow(2, 440/frequency/12/2);
+                    } else if (frequency != 0 && frequency > frequencies[voices - 1] && frequency > frequencies[voices - 1] * pow(2, 440/frequencies[voices - 1]/12/2)) {
+                        frequency = frequency * pow(2, -440/frequency/12/2);
+                    } else {
+                        frequency = frequencies[voices - 1];
+                    }
+                } else {
+                    frequency = frequencies[voices - 1];
+                }
+
+                if (vibrato_strength > 0) {
+                    freq = vibrato(frequency);
+                } else {
+                    freq = frequency;
+                }
+            }
+
+            if (envelope_index < 65535) {
+                envelope_index++;
+            }
+
+            freq = voice_envelope(freq);
+
+            if (freq < 30.517578125) {
+                freq = 30.52;
+            }
+
+            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
+            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+        }
+    }
+
+    if (playing_notes) {
+        if (note_frequency > 0) {
+            if (vibrato_strength > 0) {
+                freq = vibrato(note_frequency);
+            } else {
+                freq = note_frequency;
+            }
+
+            if (envelope_index < 65535) {
+                envelope_index++;
+            }
+            freq = voice_envelope(freq);
+
+            TIMER_3_PERIOD = (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER));
+            TIMER_3_DUTY_CYCLE = (uint16_t)((((float)F_CPU) / (freq * CPU_PRESCALER)) * note_timbre);
+        } else {
+            TIMER_3_PERIOD = 0;
+            TIMER_3_DUTY_CYCLE = 0;
+        }
+
+        note_position++;
+        bool end_of_note = false;
+        if (TIMER_3_PERIOD > 0) {
+            if (!note_resting)
+                end_of_note = (note_position >= (note_length / TIMER_3_PERIOD * 0xFFFF - 1));
+            else
+                end_of_note = (note_position >= (note_length));
+        } else {
+            end_of_note = (note_position >= (note_length));
+        }
+
+        if (end_of_note) {
+            current_note++;
+            if (current_note >= notes_count) {
+                if (notes_repeat) {
+                    current_note = 0;
+                } else {
+                    playing_notes = false;
+                    return false;
+                }
+            }
+            if (!note_resting) {
+                note_resting = true;
+                current_note--;
+                if ((*notes_pointer)[current_note][0] == (*notes_pointer)[current_note + 1][0]) {
+                    note_frequency = 0;
+                    note_length = 1;
+                } else {
+                    note_frequency = (*notes_pointer)[current_note][0];
+                    note_length = 1;
+                }
+            } else {
+                note_resting = false;
+                envelope_index = 0;
+                note_frequency = (*notes_pointer)[current_note][0];
+                note_length = ((*notes_pointer)[current_note][1] / 4) * (((float)note_tempo) / 100);
+            }
+
+            note_position = 0;
+        }
+    }
+    return true;
+}
+
+}
+
+struct Tick {
+    uint16_t period;
+    uint16_t duty;
+    uint16_t period_alt;
+};
+
+static float test_song[][2] = SONG(
+    Q__NOTE(_A4), Q__NOTE(_A4), E__NOTE(_C5), E__NOTE(_E5), H__NOTE(_REST),
+    S__NOTE(_C2), S__NOTE(_C8), W__NOTE(_GS3)
+);
+static float startup_song[][2] = SONG(STARTUP_SOUND);
+
+#define SONG_POINTER(song) reinterpret_cast<float (*)[][2]>(&song)
+#define SONG_LENGTH(song) (sizeof(song) / sizeof(song[0]))
+
+class AudioSynth : public testing::Test {
+protected:
+    AudioSynth() {
+        set_voice(default_voice);
+        set_strength(0);
+        vibrato_rate = 0.125;
+        polyphony_rate = 0;
+        note_tempo = TEMPO_DEFAULT;
+        note_timbre = TIMBRE_DEFAULT;
+        reset();
+    }
+
+    void set_strength(float strength) {
+        vibrato_strength = strength;
+    }
+
+    // Both sides start from the same voice state
+    void reset() {
+        glissando = true;
+        envelope_index = 0;
+        synth_stop_all_notes();
+        note_resting = false;
+        reference::voices = 0;
+        reference::voice_place = 0;
+        reference::frequency = 0;
+        reference::frequency_alt = 0;
+        reference::place = 0;
+        reference::playing_note = false;
+        reference::playing_notes = false;
+        reference::note_resting = false;
+        reference::vibrato_counter = 0;
+        for (int i = 0; i < 8; i++) {
+            reference::frequencies[i] = 0;
+        }
+    }
+
+    // The reference for the first `switch_at` interrupts, then the notes
+    // in `more` are added
+    std::vector<Tick> run_reference(const std::vector<float>& notes, unsigned ticks,
+            const std::vector<float>& more = {}, unsigned switch_at = 0) {
+        std::vector<Tick> out;
+        reset();
+        for (float note : notes) {
+            reference::play_note(note);
+        }
+        for (unsigned i = 0; i < ticks; i++) {
+            if (i == switch_at) {
+                for (float note : more) {
+                    reference::play_note(note);
+                }
+            }
+            reference::TIMER_1_PERIOD = 0;
+            reference::isr();
+            out.push_back({reference::TIMER_3_PERIOD, reference::TIMER_3_DUTY_CYCLE, reference::TIMER_1_PERIOD});
+        }
+        return out;
+    }
+
+    std::vector<Tick> run_synth(const std::vector<float>& notes, unsigned ticks,
+            const std::vector<float>& more = {}, unsigned switch_at = 0) {
+        std::vector<Tick> out;
+        reset();
+        for (float note : notes) {
+            synth_play_note(note, 0xF);
+        }
+        for (unsigned i = 0; i < ticks; i++) {
+            if (i == switch_at) {
+                for (float note : more) {
+                    synth_play_note(note, 0xF);
+                }
+            }
+            synth_tone_t tone = {0, 0};
+            synth_tone_t alt = {0, 0};
+            synth_next_alt(&alt);
+            synth_next(&tone);
+            out.push_back({tone.period, tone.duty, alt.period});
+        }
+        return out;
+    }
+
+    std::vector<Tick> run_reference_song(float (*song)[][2], uint16_t length) {
+        std::vector<Tick> out;
+        reset();
+        reference::play_notes(song, length, false);
+        while (reference::isr()) {
+            out.push_back({reference::TIMER_3_PERIOD, reference::TIMER_3_DUTY_CYCLE, 0});
+        }
+        return out;
+    }
+
+    std::vector<Tick> run_synth_song(float (*song)[][2], uint16_t length) {
+        std::vector<Tick> out;
+        reset();
+        synth_play_notes(song, length, false);
+        synth_tone_t tone = {0, 0};
+        while (synth_next(&tone) != SYNTH_DONE) {
+            out.push_back({tone.period, tone.duty, 0});
+        }
+        return out;
+    }
+
+    // Largest difference between the periods, relative to the reference
+    static double compare(const char* name, const std::vector<Tick>& reference,
+            const std::vector<Tick>& synth, bool alt = false) {
+        EXPECT_EQ(synth.size(), reference.size()) << name;
+        double worst = 0;
+        for (size_t i = 0; i < std::min(synth.size(), reference.size()); i++) {
+            uint16_t want = alt ? reference[i].period_alt : reference[i].period;
+            uint16_t got = alt ? synth[i].period_alt : synth[i].period;
+            if (!alt && want && got) {
+                EXPECT_NEAR((double)synth[i].duty / got, (double)reference[i].duty / want, 0.002)
+                    << name << " interrupt " << i;
+            }
+            if (want == got) {
+                continue;
+            }
+            double error = want ? std::fabs((double)got - want) / want : 1;
+            worst = std::max(worst, error);
+        }
+        std::cout << "[ AUDIO    ] " << name << ": " << synth.size()
+            << " interrupts, worst period error " << worst * 100 << " %" << std::endl;
+        return worst;
+    }
+};
+
+TEST_F(AudioSynth, PeriodsMatchTheNotes) {
+    for (float note : {NOTE_C2, NOTE_A4, NOTE_CS6, NOTE_B8, 20.0f}) {
+        float freq = note < 30.517578125 ? 30.52f : note;
+        EXPECT_EQ(synth_period(note), (uint16_t)(((float)F_CPU) / (freq * CPU_PRESCALER))) << note;
+    }
+}
+
+TEST_F(AudioSynth, GlissandoMatchesFloats) {
+    const float notes[] = {NOTE_C2, NOTE_A3, NOTE_A4, NOTE_E5, NOTE_C7, NOTE_B8};
+    double worst = 0;
+    int worst_steps = 0;
+    for (float from : notes) {
+        for (float to : notes) {
+            // the float glissando, between the frequencies of the timer
+            // periods
+            uint16_t target = synth_period(to);
+            uint16_t start = synth_period(from);
+            float to_f = ((float)F_CPU) / (target * CPU_PRESCALER);
+            size_t want = 0;
+            float f = ((float)F_CPU) / (start * CPU_PRESCALER);
+            do {
+                if (f < to_f && f < to_f * pow(2, -440/to_f/12/2)) {
+                    f = f * pow(2, 440/f/12/2);
+                } else if (f > to_f && f > to_f * pow(2, 440/to_f/12/2)) {
+                    f = f * pow(2, -440/f/12/2);
+                } else {
+                    f = to_f;
+                }
+                want++;
+            } while (f != to_f);
+
+            // each step of the integer glissando against the float step from
+            // the same period, the steps grow with the period so comparing
+            // the whole runs would amplify any difference at the start
+            uint32_t period = (uint32_t)start << 8;
+            size_t got = 0;
+            do {
+                double p = period / 256.0;
+                double step = pow(2, 440 * p * CPU_PRESCALER / F_CPU / 12 / 2);
+                period = synth_glissando(period, target);
+                got++;
+                if (period != (uint32_t)target << 8) {
+                    double next = target > p ? p * step : p / step;
+                    worst = std::max(worst, std::fabs(period / 256.0 - next) / next);
+                }
+            } while (period != (uint32_t)target << 8 && got < 1000);
+
+            EXPECT_EQ(period, (uint32_t)target << 8) << from << " to " << to;
+            worst_steps = std::max(worst_steps, std::abs((int)got - (int)want));
+        }
+    }
+    std::cout << "[ AUDIO    ] glissando: worst step error " << worst * 100
+        << " %, worst length difference " << worst_steps << " steps" << std::endl;
+    // close to B8 the steps are under a timer count, the runs end a few
+    // steps apart
+    EXPECT_LE(worst_steps, 4);
+    EXPECT_LT(worst, 0.0001);
+}
+
+TEST_F(AudioSynth, NoteMatchesFloats) {
+    std::vector<Tick> want = run_reference({NOTE_A4}, 2000);
+    std::vector<Tick> got = run_synth({NOTE_A4}, 2000);
+    EXPECT_EQ(compare("A4", want, got), 0);
+}
+
+TEST_F(AudioSynth, VibratoMatchesFloats) {
+    for (float strength : {0.5f, 1.0f, 2.0f}) {
+        set_strength(strength);
+        for (float note : {NOTE_C3, NOTE_A4, NOTE_C7}) {
+            std::vector<Tick> want = run_reference({note}, 5000);
+            std::vector<Tick> got = run_synth({note}, 5000);
+            char name[64];
+            snprintf(name, sizeof(name), "vibrato %.1f at %.0f Hz", strength, note);
+            // a vibrato step is about 0.2%, the integer one is at worst a step off
+            EXPECT_LT(compare(name, want, got), 0.005);
+        }
+    }
+}
+
+TEST_F(AudioSynth, SecondNoteMatchesFloats) {
+    set_strength(1);
+    std::vector<Tick> want = run_reference({NOTE_C4, NOTE_G4}, 3000);
+    std::vector<Tick> got = run_synth({NOTE_C4, NOTE_G4}, 3000);
+    EXPECT_LT(compare("C4+G4", want, got), 0.005);
+    EXPECT_LT(compare("C4+G4 second timer", want, got, true), 0.005);
+}
+
+TEST_F(AudioSynth, SlowPolyphonySwitchesNotes) {
+    // the voices other than octave_crunch turn the polyphony off, and the
+    // time a note gets is capped at 0xFFFF interrupts
+    set_voice(octave_crunch);
+    polyphony_rate = 0.0001;
+    synth_play_note(NOTE_C4, 0xF);
+    synth_play_note(NOTE_G4, 0xF);
+    uint16_t middle = (synth_period(NOTE_C4) + synth_period(NOTE_G4)) / 2;
+    synth_tone_t tone = {0, 0};
+    unsigned ticks = 0;
+    do {
+        synth_next(&tone);
+        ticks++;
+    } while (ticks < 0x20000 && tone.period > middle);
+    // C4 plays for 0x10000 interrupts, G4 from the next one
+    EXPECT_EQ(ticks, 0x10001u);
+}
+
+TEST_F(AudioSynth, VoicesMatchFloats) {
+    // duty_octave_down keeps the glissando and changes the timbre on every
+    // interrupt, delayed_vibrato also changes the frequency. The frequency
+    // they get is the one of the timer period, the voices that switch at a
+    // given point of the envelope may switch an interrupt apart.
+    for (voice_type v : {duty_octave_down, delayed_vibrato}) {
+        set_voice(v);
+        std::vector<Tick> want = run_reference({NOTE_A3}, 3000, {NOTE_A5}, 1000);
+        std::vector<Tick> got = run_synth({NOTE_A3}, 3000, {NOTE_A5}, 1000);
+        char name[64];
+        snprintf(name, sizeof(name), "voice %d, A3 then A5", (int)v);
+        EXPECT_LT(compare(name, want, got), 0.01);
+    }
+}
+
+TEST_F(AudioSynth, SongsMatchFloats) {
+    std::vector<Tick> want = run_reference_song(SONG_POINTER(test_song), SONG_LENGTH(test_song));
+    std::vector<Tick> got = run_synth_song(SONG_POINTER(test_song), SONG_LENGTH(test_song));
+    EXPECT_EQ(compare("song", want, got), 0);
+
+    want = run_reference_song(SONG_POINTER(startup_song), SONG_LENGTH(startup_song));
+    got = run_synth_song(SONG_POINTER(startup_song), SONG_LENGTH(startup_song));
+    EXPECT_EQ(compare("startup song", want, got), 0);
+
+    set_strength(1);
+    want = run_reference_song(SONG_POINTER(test_song), SONG_LENGTH(test_song));
+    got = run_synth_song(SONG_POINTER(test_song), SONG_LENGTH(test_song));
+    // the notes last as long, in timer counts, whatever the vibrato does
+    EXPECT_NEAR(got.size(), want.size(), want.size() / 100);
+}
+
+TEST_F(AudioSynth, Benchmark) {
+    typedef std::chrono::steady_clock clock;
+    const unsigned ticks = 200000;
+    volatile uint16_t sink = 0;
+    set_strength(1);
+
+    reset();
+    reference::play_note(NOTE_C4);
+    reference::play_note(NOTE_G4);
+    clock::time_point start = clock::now();
+    for (unsigned i = 0; i < ticks; i++) {
+        reference::isr();
+        sink += reference::TIMER_3_PERIOD + reference::TIMER_1_PERIOD;
+    }
+    clock::time_point floats = clock::now();
+
+    reset();
+    synth_play_note(NOTE_C4, 0xF);
+    synth_play_note(NOTE_G4, 0xF);
+    clock::time_point integers_start = clock::now();
+    for (unsigned i = 0; i < ticks; i++) {
+        synth_tone_t tone, alt;
+        synth_next_alt(&alt);
+        synth_next(&tone);
+        sink += tone.period + alt.period;
+    }
+    clock::time_point integers = clock::now();
+
+    auto ns = [&](clock::time_point from, clock::time_point to) {
+        return std::chrono::duration<double, std::nano>(to - from).count() / ticks;
+    };
+    std::cout << "[ AUDIO    ] two notes with vibrato: floats " << ns(start, floats)
+        << " ns/interrupt, integers " << ns(integers_start, integers) << " ns/interrupt" << std::endl;
+    (void)sink;
+}
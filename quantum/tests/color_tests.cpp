@@ -0,0 +1,183 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <iostream>
+#include <vector>
+extern "C" {
+#include "color.h"
+#include "led_tables.h"
+}
+
+// hsv_to_rgb() before it stopped dividing
+static RGB reference_hsv_to_rgb(HSV hsv) {
+    RGB rgb;
+    uint8_t region, p, q, t;
+    uint16_t h, s, v, remainder;
+
+    if (hsv.s == 0) {
+        rgb.r = hsv.v;
+        rgb.g = hsv.v;
+        rgb.b = hsv.v;
+        return rgb;
+    }
+
+    h = hsv.h;
+    s = hsv.s;
+    v = hsv.v;
+
+    region = h / 43;
+    remainder = (h - (region * 43)) * 6;
+
+    p = (v * (255 - s)) >> 8;
+    q = (v * (255 - ((s * remainder) >> 8))) >> 8;
+    t = (v * (255 - ((s * (255 - remainder)) >> 8))) >> 8;
+
+    switch (region) {
+        case 0: rgb.r = v; rgb.g = t; rgb.b = p; break;
+        case 1: rgb.r = q; rgb.g = v; rgb.b = p; break;
+        case 2: rgb.r = p; rgb.g = v; rgb.b = t; break;
+        case 3: rgb.r = p; rgb.g = q; rgb.b = v; break;
+        case 4: rgb.r = t; rgb.g = p; rgb.b = v; break;
+        default: rgb.r = v; rgb.g = p; rgb.b = q; break;
+    }
+
+    rgb.r = CIE1931_CURVE[rgb.r];
+    rgb.g = CIE1931_CURVE[rgb.g];
+    rgb.b = CIE1931_CURVE[rgb.b];
+    return rgb;
+}
+
+// sethsv() of rgblight.c, before it moved to color.c
+static RGB reference_hsv360_to_rgb(uint16_t hue, uint8_t sat, uint8_t val) {
+    uint8_t r = 0, g = 0, b = 0, base, color;
+
+    if (sat == 0) {
+        r = val;
+        g = val;
+        b = val;
+    } else {
+        base = ((255 - sat) * val) >> 8;
+        color = (val - base) * (hue % 60) / 60;
+
+        switch (hue / 60) {
+            case 0: r = val; g = base + color; b = base; break;
+            case 1: r = val - color; g = val; b = base; break;
+            case 2: r = base; g = val; b = base + color; break;
+            case 3: r = base; g = val - color; b = val; break;
+            case 4: r = base + color; g = base; b = val; break;
+            case 5: r = val; g = base; b = val - color; break;
+        }
+    }
+    return (RGB){CIE1931_CURVE[r], CIE1931_CURVE[g], CIE1931_CURVE[b]};
+}
+
+static bool operator==(const RGB& a, const RGB& b) {
+    return a.r == b.r && a.g == b.g && a.b == b.b;
+}
+
+static std::ostream& operator<<(std::ostream& os, const RGB& rgb) {
+    return os << "(" << (int)rgb.r << ", " << (int)rgb.g << ", " << (int)rgb.b << ")";
+}
+
+TEST(Color, HsvToRgbMatchesDivisions) {
+    for (unsigned h = 0; h < 256; h++) {
+        for (unsigned s = 0; s < 256; s++) {
+            for (unsigned v = 0; v < 256; v++) {
+                HSV hsv = {(uint8_t)h, (uint8_t)s, (uint8_t)v};
+                RGB expected = reference_hsv_to_rgb(hsv);
+                RGB rgb = hsv_to_rgb(hsv);
+                if (!(rgb == expected)) {
+                    FAIL() << "h " << h << " s " << s << " v " << v << ": " << rgb << " instead of " << expected;
+                }
+            }
+        }
+    }
+}
+
+TEST(Color, Hsv360ToRgbMatchesDivisions) {
+    // and a few hues past 359
+    for (unsigned hue = 0; hue < 400; hue++) {
+        for (unsigned sat = 0; sat < 256; sat++) {
+            for (unsigned val = 0; val < 256; val++) {
+                RGB expected = reference_hsv360_to_rgb(hue, sat, val);
+                RGB rgb = hsv360_to_rgb(hue, sat, val);
+                if (!(rgb == expected)) {
+                    FAIL() << "hue " << hue << " sat " << sat << " val " << val << ": " << rgb << " instead of " << expected;
+                }
+            }
+        }
+    }
+}
+
+TEST(Color, Benchmark) {
+    typedef std::chrono::steady_clock clock;
+    // a rainbow swirl over 16 LEDs, for every hue
+    const unsigned leds = 16;
+    const unsigned frames = 360 * 200;
+    volatile uint8_t sink = 0;
+
+    clock::time_point start = clock::now();
+    for (unsigned frame = 0; frame < frames; frame++) {
+        for (unsigned i = 0; i < leds; i++) {
+            sink += reference_hsv360_to_rgb((360 / leds * i + frame) % 360, 255, 255).g;
+        }
+    }
+    clock::time_point divisions = clock::now();
+    for (unsigned frame = 0; frame < frames; frame++) {
+        for (unsigned i = 0; i < leds; i++) {
+            sink += hsv360_to_rgb((360 / leds * i + frame) % 360, 255, 255).g;
+        }
+    }
+    clock::time_point single = clock::now();
+    for (unsigned frame = 0; frame < frames; frame++) {
+        SV sv = sv_prepare(255, 255);
+        uint16_t hue = frame % 360;
+        for (unsigned i = 0; i < leds; i++) {
+            sink += hue360_to_rgb(sv, hue).g;
+            hue += 360 / leds;
+            if (hue >= 360) {
+                hue -= 360;
+            }
+        }
+    }
+    clock::time_point batched = clock::now();
+    for (unsigned frame = 0; frame < frames; frame++) {
+        for (unsigned i = 0; i < leds; i++) {
+            sink += reference_hsv_to_rgb((HSV){(uint8_t)(frame + i * 16), 255, 255}).g;
+        }
+    }
+    clock::time_point matrix_divisions = clock::now();
+    for (unsigned frame = 0; frame < frames; frame++) {
+        for (unsigned i = 0; i < leds; i++) {
+            sink += hsv_to_rgb((HSV){(uint8_t)(frame + i * 16), 255, 255}).g;
+        }
+    }
+    clock::time_point matrix = clock::now();
+
+    double conversions = (double)frames * leds;
+    auto ns = [&](clock::time_point from, clock::time_point to) {
+        return std::chrono::duration<double, std::nano>(to - from).count() / conversions;
+    };
+    std::cout << "[ COLOR    ] rgblight: divisions " << ns(start, divisions)
+        << " ns/LED, hsv360_to_rgb " << ns(divisions, single)
+        << " ns/LED, hue360_to_rgb " << ns(single, batched) << " ns/LED" << std::endl;
+    std::cout << "[ COLOR    ] rgb matrix: divisions " << ns(batched, matrix_divisions)
+        << " ns/LED, hsv_to_rgb " << ns(matrix_divisions, matrix) << " ns/LED" << std::endl;
+    (void)sink;
+}
@@ -0,0 +1,188 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+extern "C" {
+#include "rgb_matrix_math.h"
+}
+
+#define PI 3.14159265
+
+struct Point {
+    uint8_t x;
+    uint8_t y;
+};
+
+enum Effect {
+    DUAL_BEACON = RGB_MATRIX_WAVE_DUAL_BEACON,
+    RAINBOW_BEACON = RGB_MATRIX_WAVE_RAINBOW_BEACON,
+    RAINBOW_PINWHEELS = RGB_MATRIX_WAVE_RAINBOW_PINWHEELS,
+    RAINBOW_MOVING_CHEVRON = RGB_MATRIX_WAVE_RAINBOW_MOVING_CHEVRON,
+};
+
+static const char* effect_names[] = {
+    "dual beacon", "rainbow beacon", "rainbow pinwheels", "rainbow moving chevron",
+};
+
+// The hue offsets computed by the effects of rgb_matrix.c, before they moved
+// to fixed point, as 8.8 hues. The effects truncated them toward zero, the
+// fixed point ones round down, the hues only differ by one step on the
+// negative side.
+static void render_float(Effect effect, uint32_t tick, uint8_t speed,
+        const std::vector<Point>& leds, uint16_t* hues) {
+    double s = speed == 0 ? 1 : speed;
+    for (size_t i = 0; i < leds.size(); i++) {
+        const Point& led = leds[i];
+        double h = 0;
+        switch (effect) {
+            case DUAL_BEACON:
+                h = ((led.y - 32.0)* cos(tick * PI / 128) / 32 + (led.x - 112.0) * sin(tick * PI / 128) / (112)) * (180);
+                break;
+            case RAINBOW_BEACON:
+                h = (1.5 * s) * (led.y - 32.0)* cos(tick * PI / 128) + (1.5 * s) * (led.x - 112.0) * sin(tick * PI / 128);
+                break;
+            case RAINBOW_PINWHEELS:
+                h = (2 * s) * (led.y - 32.0)* cos(tick * PI / 128) + (2 * s) * (66 - abs(led.x - 112.0)) * sin(tick * PI / 128);
+                break;
+            case RAINBOW_MOVING_CHEVRON:
+                h = (1.5 * s) * abs(led.y - 32.0)* sin(32 * PI / 128) + (1.5 * s) * (led.x - (tick / 256.0 * 224)) * cos(32 * PI / 128);
+                break;
+        }
+        hues[i] = (uint16_t)(int64_t)floor(h * 256);
+    }
+}
+
+// The hues rgb_matrix.c gives the LEDs
+static void render_fixed(Effect effect, uint32_t tick, uint8_t speed,
+        const std::vector<Point>& leds, uint16_t* hues) {
+    rgb_matrix_wave_t wave;
+    rgb_matrix_wave_effect_init(&wave, effect, tick, speed);
+    for (size_t i = 0; i < leds.size(); i++) {
+        hues[i] = rgb_matrix_wave_effect_hue(&wave, effect, leds[i].x, leds[i].y);
+    }
+}
+
+class RgbMatrixMath : public testing::Test {
+protected:
+    // A 60% board, 14 or 15 keys a row on a 16 unit grid
+    RgbMatrixMath() {
+        for (uint8_t row = 0; row < 5; row++) {
+            for (uint8_t col = 0; col < (row == 4 ? 14 : 15); col++) {
+                m_leds.push_back({(uint8_t)(col * 16), (uint8_t)(row * 16)});
+            }
+        }
+    }
+
+    std::vector<Point> m_leds;
+};
+
+TEST_F(RgbMatrixMath, SineMatchesLibm) {
+    for (unsigned angle = 0; angle < 256; angle++) {
+        EXPECT_EQ(rgb_matrix_sin(angle), (int16_t)lround(32767 * sin(angle * PI / 128))) << angle;
+        EXPECT_EQ(rgb_matrix_cos(angle), (int16_t)lround(32767 * cos(angle * PI / 128))) << angle;
+    }
+}
+
+TEST_F(RgbMatrixMath, DistanceMatchesSqrt) {
+    for (int16_t dx = -255; dx <= 255; dx++) {
+        for (int16_t dy = -255; dy <= 255; dy++) {
+            ASSERT_EQ(rgb_matrix_distance(dx, dy), (uint16_t)sqrt(pow(dx, 2) + pow(dy, 2)))
+                << dx << ", " << dy;
+        }
+    }
+}
+
+// Renders every effect for a while at every speed, the fixed point hues are
+// within a fraction of a step of the floating point ones
+TEST_F(RgbMatrixMath, EffectsMatchFloatingPoint) {
+    const uint32_t ticks = 2048;
+    std::vector<uint16_t> expected(m_leds.size());
+    std::vector<uint16_t> actual(m_leds.size());
+    for (int effect = DUAL_BEACON; effect <= RAINBOW_MOVING_CHEVRON; effect++) {
+        int max_error = 0;
+        unsigned errors = 0;
+        for (uint8_t speed = 0; speed <= 3; speed++) {
+            for (uint32_t tick = 0; tick < ticks; tick++) {
+                render_float((Effect)effect, tick, speed, m_leds, expected.data());
+                render_fixed((Effect)effect, tick, speed, m_leds, actual.data());
+                for (size_t i = 0; i < m_leds.size(); i++) {
+                    int error = abs((int16_t)(actual[i] - expected[i]));
+                    max_error = std::max(max_error, error);
+                    errors += (actual[i] >> 8) != (expected[i] >> 8);
+                }
+            }
+        }
+        std::cout << "[ RGB MATH ] " << effect_names[effect] << ": "
+            << errors << " of " << 4 * ticks * m_leds.size() << " hues rounded the other way, error at most "
+            << max_error << "/256" << std::endl;
+        EXPECT_LE(max_error, 64) << effect_names[effect];
+    }
+}
+
+// The speed only goes up to 3, at any speed the waves of the rainbows have
+// the scale they're documented with, modulo the 32 bits of their products
+TEST_F(RgbMatrixMath, AnySpeedKeepsTheScale) {
+    const struct {
+        Effect effect;
+        int64_t scale;
+    } rainbows[] = {{RAINBOW_BEACON, 384}, {RAINBOW_PINWHEELS, 512}};
+    for (auto rainbow : rainbows) {
+        for (unsigned speed : {1, 3, 127, 128, 170, 171, 255}) {
+            for (uint32_t tick = 0; tick < 256; tick++) {
+                rgb_matrix_wave_t wave;
+                rgb_matrix_wave_effect_init(&wave, rainbow.effect, tick, speed);
+                int64_t scale = rainbow.scale * speed;
+                EXPECT_EQ((uint32_t)wave.y, (uint32_t)((scale * rgb_matrix_cos(tick)) >> 7))
+                    << effect_names[rainbow.effect] << " at speed " << speed << ", tick " << tick;
+                EXPECT_EQ((uint32_t)wave.x, (uint32_t)((scale * rgb_matrix_sin(tick)) >> 7))
+                    << effect_names[rainbow.effect] << " at speed " << speed << ", tick " << tick;
+            }
+        }
+    }
+}
+
+TEST_F(RgbMatrixMath, Benchmark) {
+    typedef std::chrono::steady_clock clock;
+    const uint32_t ticks = 20000;
+    std::vector<uint16_t> hues(m_leds.size());
+    volatile uint16_t sink = 0;
+    for (int effect = DUAL_BEACON; effect <= RAINBOW_MOVING_CHEVRON; effect++) {
+        clock::time_point start = clock::now();
+        for (uint32_t tick = 0; tick < ticks; tick++) {
+            render_float((Effect)effect, tick, 1, m_leds, hues.data());
+            sink += hues[tick % hues.size()];
+        }
+        clock::time_point middle = clock::now();
+        for (uint32_t tick = 0; tick < ticks; tick++) {
+            render_fixed((Effect)effect, tick, 1, m_leds, hues.data());
+            sink += hues[tick % hues.size()];
+        }
+        clock::time_point end = clock::now();
+        double leds = (double)ticks * m_leds.size();
+        std::cout << "[ RGB MATH ] " << effect_names[effect] << ": float "
+            << std::chrono::duration<double, std::nano>(middle - start).count() / leds
+            << " ns/LED, fixed "
+            << std::chrono::duration<double, std::nano>(end - middle).count() / leds
+            << " ns/LED" << std::endl;
+    }
+    (void)sink;
+}
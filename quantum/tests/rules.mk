@@ -0,0 +1,37 @@
+# Copyright 2018 QMK
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# The RGB matrix effects, against the floating point versions they replace
+rgb_matrix_math_INC := $(QUANTUM_PATH) $(TMK_PATH)/common
+rgb_matrix_math_SRC := \
+	$(QUANTUM_PATH)/tests/rgb_matrix_math_tests.cpp \
+	$(QUANTUM_PATH)/rgb_matrix_math.c
+
+# The HSV conversions, against the ones using divisions they replace
+color_DEFS := -DUSE_CIE1931_CURVE
+color_INC := $(QUANTUM_PATH) $(TMK_PATH)/common
+color_SRC := \
+	$(QUANTUM_PATH)/tests/color_tests.cpp \
+	$(QUANTUM_PATH)/color.c \
+	$(QUANTUM_PATH)/led_tables.c
+
+# The audio timer interrupts, against the floating point ones they replace
+audio_synth_DEFS := -DF_CPU=16000000 -DVIBRATO_ENABLE -DVIBRATO_STRENGTH_ENABLE -DAUDIO_VOICES
+audio_synth_INC := $(QUANTUM_PATH)/audio $(TMK_PATH)/common
+audio_synth_SRC := \
+	$(QUANTUM_PATH)/tests/audio_synth_tests.cpp \
+	$(QUANTUM_PATH)/audio/synth.c \
+	$(QUANTUM_PATH)/audio/voices.c \
+	$(QUANTUM_PATH)/audio/luts.c
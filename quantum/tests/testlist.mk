@@ -0,0 +1,4 @@
+TEST_LIST +=\
+	rgb_matrix_math\
+	color\
+	audio_synth
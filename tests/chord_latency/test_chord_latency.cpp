@@ -0,0 +1,143 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <iostream>
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
+
+extern "C" {
+    uint32_t timer_read32(void);
+    void advance_time(uint32_t ms);
+}
+
+// This file is built twice, by tests/chord_latency with the default one key
+// per scan, and by tests/chord_latency_batched with QMK_KEYS_PER_SCAN.
+class ChordLatency : public TestFixture {
+protected:
+    struct Result {
+        unsigned latency;
+        unsigned scans;
+        unsigned reports;
+    };
+
+    // Presses the first `keys` keys of row 0 at once and runs scan loops
+    // until the host has received the final state of the chord
+    Result press_chord(uint8_t keys) {
+        TestDriver driver;
+        Result result = {0, 0, 0};
+        uint8_t keys_in_report = 0;
+        EXPECT_CALL(driver, send_keyboard_mock(_))
+            .Times(AnyNumber())
+            .WillRepeatedly(Invoke([&](report_keyboard_t& report) {
+                result.reports++;
+                keys_in_report = has_anykey(&report);
+            }));
+        for (uint8_t col = 0; col < keys; col++) {
+            press_key(col, 0);
+        }
+        uint32_t start = timer_read32();
+        uint32_t last_report = start;
+        for (unsigned scan = 0; scan < 100; scan++) {
+            unsigned reports = result.reports;
+            keyboard_task();
+            if (result.reports == reports) {
+                break;
+            }
+            last_report = timer_read32();
+            result.scans++;
+            advance_time(1);
+        }
+        result.latency = last_report - start;
+        // keys beyond the 6KRO limit are dropped from the report
+        EXPECT_EQ(keys_in_report, keys < KEYBOARD_REPORT_KEYS ? keys : KEYBOARD_REPORT_KEYS);
+        testing::Mock::VerifyAndClearExpectations(&driver);
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+        clear_all_keys();
+        idle_for(keys + 1);
+        return result;
+    }
+};
+
+TEST_F(ChordLatency, ChordsFromTwoToTenKeys) {
+    for (uint8_t keys = 2; keys <= 10; keys++) {
+        Result result = press_chord(keys);
+        std::cout << "[ CHORD    ] " << (int)keys << " keys: "
+            << result.latency << " ms press-to-report, "
+            << result.scans << " scans, "
+            << result.reports << " reports" << std::endl;
+#ifdef QMK_KEYS_PER_SCAN
+        // the whole chord is delivered in the first scan, as a single report
+        EXPECT_EQ(result.latency, 0);
+        EXPECT_EQ(result.scans, 1);
+        EXPECT_EQ(result.reports, 1);
+#else
+        // one key per scan, every key gets its own report
+        EXPECT_EQ(result.latency, keys - 1);
+        EXPECT_EQ(result.scans, keys);
+        EXPECT_EQ(result.reports, keys);
+#endif
+    }
+}
+
+TEST_F(ChordLatency, ReleasedChordIsReported) {
+    TestDriver driver;
+    press_key(0, 0);
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    idle_for(2);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(0, 0);
+    release_key(1, 0);
+#ifdef QMK_KEYS_PER_SCAN
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+#else
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    run_one_scan_loop();
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+#endif
+}
+
+// A key released and pressed again within a scan reaches the host twice
+TEST_F(ChordLatency, DoublePressWithinAScanIsReportedTwice) {
+    TestDriver driver;
+    testing::InSequence s;
+    press_key(0, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_B)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    release_key(0, 1);
+    run_one_scan_loop();
+}
+
+TEST_F(ChordLatency, SendStringOfARepeatedLetter) {
+    TestDriver driver;
+    testing::InSequence s;
+    press_key(1, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    release_key(1, 1);
+    run_one_scan_loop();
+}
@@ -0,0 +1,54 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+enum custom_keycodes {
+    // taps B twice
+    DOUBLE_B = SAFE_RANGE,
+    // sends "aa"
+    STRING_AA,
+};
+
+// The chord tests press the keys of row 0 from left to right, the keys of
+// row 1 send several reports from a single press
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0       1          2      3      4      5      6      7      8      9
+        {KC_A,     KC_B,      KC_C,  KC_D,  KC_E,  KC_F,  KC_G,  KC_H,  KC_I,  KC_J},
+        {DOUBLE_B, STRING_AA, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,    KC_NO,     KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,    KC_NO,     KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+    },
+};
+
+bool process_record_user(uint16_t keycode, keyrecord_t *record) {
+    if (!record->event.pressed) {
+        return true;
+    }
+    switch (keycode) {
+    case DOUBLE_B:
+        register_code(KC_B);
+        unregister_code(KC_B);
+        register_code(KC_B);
+        unregister_code(KC_B);
+        return false;
+    case STRING_AA:
+        SEND_STRING("aa");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,222 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+extern "C" {
+#include "process_combo.h"
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
+
+// This file is built twice, by tests/combo with the keycode index and by
+// tests/combo_linear without it.
+
+// Combos 0-199 are pairs and 200-249 triples, of distinct keycodes
+static const unsigned pair_combos = 200;
+static const unsigned triple_combos = COMBO_COUNT - pair_combos;
+static const unsigned combo_key_count = pair_combos * 2 + triple_combos * 3;
+
+// The n-th combo keycode, plain and modified basic keycodes
+static uint16_t combo_keycode(unsigned n) {
+    static const uint16_t mods[] = {0, QK_LCTL, QK_LSFT, QK_LALT};
+    const unsigned basic = KC_EXSEL - KC_A + 1;
+    return mods[n / basic] | (KC_A + n % basic);
+}
+
+static uint16_t combo_keys[combo_key_count + COMBO_COUNT];
+
+extern "C" {
+combo_t key_combos[COMBO_COUNT];
+}
+
+static struct ComboSetup {
+    ComboSetup() {
+        unsigned n = 0;
+        uint16_t* keys = combo_keys;
+        for (unsigned i = 0; i < COMBO_COUNT; i++) {
+            key_combos[i].keys = keys;
+            key_combos[i].keycode = KC_F13 + i % 12;
+            for (unsigned k = 0; k < (i < pair_combos ? 2 : 3); k++) {
+                *keys++ = combo_keycode(n++);
+            }
+            *keys++ = COMBO_END;
+        }
+    }
+} combo_setup;
+
+class Combo : public TestFixture {
+protected:
+    static keyrecord_t record(bool pressed) {
+        keyrecord_t record = {};
+        record.event.key = (keypos_t){ .col = 9, .row = 3 };
+        record.event.pressed = pressed;
+        record.event.time = timer_read() | 1;
+        return record;
+    }
+
+    static bool combo_event(uint16_t keycode, bool pressed) {
+        keyrecord_t r = record(pressed);
+        return process_combo(keycode, &r);
+    }
+
+    static bool report_is(const report_keyboard_t& report, uint8_t keycode) {
+        return report.mods == 0 && has_anykey((report_keyboard_t*)&report) == 1 &&
+            std::find(std::begin(report.keys), std::end(report.keys), keycode) != std::end(report.keys);
+    }
+
+    static bool report_is_empty(const report_keyboard_t& report) {
+        return report.mods == 0 && has_anykey((report_keyboard_t*)&report) == 0;
+    }
+
+    static std::vector<uint16_t> keys_of(unsigned combo) {
+        std::vector<uint16_t> keys;
+        for (const uint16_t* key = key_combos[combo].keys; *key != COMBO_END; key++) {
+            keys.push_back(*key);
+        }
+        return keys;
+    }
+};
+
+TEST_F(Combo, EveryComboFires) {
+    TestDriver driver;
+    report_keyboard_t last_report = {};
+    EXPECT_CALL(driver, send_keyboard_mock(_))
+        .Times(AnyNumber())
+        .WillRepeatedly(Invoke([&](report_keyboard_t& report) { last_report = report; }));
+    for (unsigned i = 0; i < COMBO_COUNT; i++) {
+        std::vector<uint16_t> keys = keys_of(i);
+        for (uint16_t key : keys) {
+            // swallowed while the combo is pending
+            EXPECT_FALSE(combo_event(key, true)) << "combo " << i;
+        }
+        EXPECT_TRUE(report_is(last_report, KC_F13 + i % 12)) << "combo " << i;
+        for (uint16_t key : keys) {
+            combo_event(key, false);
+        }
+        EXPECT_TRUE(report_is_empty(last_report)) << "combo " << i;
+        run_one_scan_loop();
+    }
+}
+
+TEST_F(Combo, OtherKeycodesPassThrough) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    EXPECT_TRUE(combo_event(KC_RALT, true));
+    EXPECT_TRUE(combo_event(KC_RALT, false));
+    EXPECT_TRUE(combo_event(LGUI(KC_A), true));
+    EXPECT_TRUE(combo_event(LGUI(KC_A), false));
+}
+
+TEST_F(Combo, ComboPressedFromTheMatrix) {
+    TestDriver driver;
+    press_key(0, 0);
+    press_key(1, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_F13)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(0, 0);
+    release_key(1, 0);
+    // the combo is released with its first key, not re-sent as taps
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    idle_for(2);
+}
+
+TEST_F(Combo, ComboKeyTappedAlone) {
+    TestDriver driver;
+    press_key(2, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(10);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(2, 0);
+    // the held back press is replayed before the release
+    testing::InSequence s;
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_C)));
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(Combo, ComboKeyHeldAlone) {
+    TestDriver driver;
+    press_key(2, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(COMBO_TERM);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_C)));
+    run_one_scan_loop();
+    // and only once
+    idle_for(10);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(2, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(Combo, Benchmark) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    const unsigned passes = 200;
+
+    // Non combo keycodes, the common case while typing
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned pass = 0; pass < passes; pass++) {
+        for (uint16_t keycode = KC_A; keycode <= KC_EXSEL; keycode++) {
+            combo_event(LGUI(keycode), true);
+            combo_event(LGUI(keycode), false);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double other_ns = std::chrono::duration<double, std::nano>(end - start).count() /
+        (passes * 2 * (KC_EXSEL - KC_A + 1));
+
+    // Every combo pressed and released
+    start = std::chrono::steady_clock::now();
+    for (unsigned pass = 0; pass < passes / 10; pass++) {
+        for (unsigned i = 0; i < COMBO_COUNT; i++) {
+            for (const uint16_t* key = key_combos[i].keys; *key != COMBO_END; key++) {
+                combo_event(*key, true);
+            }
+            for (const uint16_t* key = key_combos[i].keys; *key != COMBO_END; key++) {
+                combo_event(*key, false);
+            }
+        }
+    }
+    end = std::chrono::steady_clock::now();
+    double combo_ns = std::chrono::duration<double, std::nano>(end - start).count() /
+        (passes / 10 * 2 * combo_key_count);
+
+    // Idle scans
+    const unsigned scans = 100000;
+    start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < scans; i++) {
+        matrix_scan_combo();
+    }
+    end = std::chrono::steady_clock::now();
+    double scan_ns = std::chrono::duration<double, std::nano>(end - start).count() / scans;
+
+    std::cout << "[ COMBO    ] " << COMBO_COUNT << " combos, index size " << COMBO_INDEX_SIZE
+        << ": " << other_ns << " ns/other key event, "
+        << combo_ns << " ns/combo key event, "
+        << scan_ns << " ns/idle scan" << std::endl;
+}
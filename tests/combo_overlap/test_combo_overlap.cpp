@@ -0,0 +1,226 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+
+// The combos are in keymap.c: J+K is ESC, J+K+L is TAB, Q+W is ENT and the
+// first two keys of row 1 are BSPC on every layer. The matrix delivers one
+// key per scan.
+class ComboOverlap : public TestFixture {
+protected:
+    void verify() {
+        testing::Mock::VerifyAndClearExpectations(&m_driver);
+    }
+
+    void release_all() {
+        EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(AnyNumber());
+        clear_all_keys();
+        idle_for(10);
+        verify();
+    }
+
+    TestDriver m_driver;
+};
+
+TEST_F(ComboOverlap, SubsetComboFiresWhenReleased) {
+    press_key(0, 0);
+    press_key(1, 0);
+    // J+K+L is still possible
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    run_one_scan_loop();
+    verify();
+    release_key(0, 0);
+    {
+        InSequence s;
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport()));
+    }
+    run_one_scan_loop();
+    verify();
+    release_key(1, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    verify();
+}
+
+TEST_F(ComboOverlap, SupersetComboFiresOnItsLastKey) {
+    press_key(0, 0);
+    press_key(1, 0);
+    press_key(2, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    run_one_scan_loop();
+    verify();
+    // nothing longer is possible, no need to wait
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_TAB)));
+    run_one_scan_loop();
+    verify();
+    release_key(1, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    verify();
+    release_all();
+}
+
+TEST_F(ComboOverlap, SubsetComboFiresAfterComboTerm) {
+    press_key(0, 0);
+    press_key(1, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    idle_for(COMBO_TERM - 10);
+    verify();
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+    idle_for(20);
+    verify();
+    // the combo is held, L is a key of its own now
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_ESC, KC_L)));
+    press_key(2, 0);
+    run_one_scan_loop();
+    verify();
+    release_all();
+}
+
+TEST_F(ComboOverlap, SubsetComboFiresWhenAnotherKeyIsPressed) {
+    press_key(0, 0);
+    press_key(1, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    run_one_scan_loop();
+    verify();
+    press_key(3, 0);
+    {
+        InSequence s;
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_ESC)));
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_ESC, KC_X)));
+    }
+    run_one_scan_loop();
+    verify();
+    release_all();
+}
+
+TEST_F(ComboOverlap, BufferedKeyIsReleasedByAKeyOfNoCombo) {
+    press_key(0, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    verify();
+    // no waiting for COMBO_TERM, J goes out in the same scan as X
+    press_key(3, 0);
+    {
+        InSequence s;
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_J)));
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_J, KC_X)));
+    }
+    run_one_scan_loop();
+    verify();
+    release_all();
+}
+
+TEST_F(ComboOverlap, BufferedKeyIsReleasedByAKeyOfAnotherCombo) {
+    press_key(0, 0);
+    run_one_scan_loop();
+    press_key(4, 0);
+    // Q starts Q+W
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_J)));
+    run_one_scan_loop();
+    verify();
+    press_key(5, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_J, KC_ENT)));
+    run_one_scan_loop();
+    verify();
+    release_all();
+}
+
+TEST_F(ComboOverlap, LoneKeyTap) {
+    press_key(1, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    verify();
+    release_key(1, 0);
+    {
+        InSequence s;
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_K)));
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport()));
+    }
+    run_one_scan_loop();
+    verify();
+}
+
+TEST_F(ComboOverlap, ComboFiresOnItsLastKey) {
+    press_key(4, 0);
+    press_key(5, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    verify();
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_ENT)));
+    run_one_scan_loop();
+    verify();
+    // released with the first key
+    release_key(5, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    verify();
+    release_key(4, 0);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    verify();
+}
+
+TEST_F(ComboOverlap, PositionComboOnEveryLayer) {
+    press_key(0, 1);
+    press_key(1, 1);
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_BSPC)));
+    run_one_scan_loop();
+    run_one_scan_loop();
+    verify();
+    release_all();
+
+    press_key(2, 1);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(AnyNumber());
+    run_one_scan_loop();
+    verify();
+    press_key(0, 1);
+    press_key(1, 1);
+    EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_BSPC)));
+    run_one_scan_loop();
+    run_one_scan_loop();
+    verify();
+    release_all();
+}
+
+TEST_F(ComboOverlap, PositionComboKeyAloneKeepsItsLayer) {
+    press_key(2, 1);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(AnyNumber());
+    run_one_scan_loop();
+    verify();
+    press_key(0, 1);
+    EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    verify();
+    release_key(0, 1);
+    {
+        InSequence s;
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport(KC_3)));
+        EXPECT_CALL(m_driver, send_keyboard_mock(KeyboardReport()));
+    }
+    run_one_scan_loop();
+    verify();
+    release_all();
+}
@@ -0,0 +1,201 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <random>
+
+extern "C" {
+#include "event_queue.h"
+#include "action_tapping.h"
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
+
+static keyrecord_t record(uint8_t col, bool pressed, uint16_t time = 1) {
+    keyrecord_t record = {};
+    record.event.key = (keypos_t){ .col = col, .row = 0 };
+    record.event.pressed = pressed;
+    record.event.time = time;
+    return record;
+}
+
+class EventQueue : public testing::Test {
+protected:
+    EventQueue() : m_queue(EVENT_QUEUE_INIT(m_records)) {}
+
+    keyrecord_t m_records[8];
+    event_queue_t m_queue;
+};
+
+TEST_F(EventQueue, StartsEmpty) {
+    EXPECT_EQ(event_queue_length(&m_queue), 0);
+    EXPECT_EQ(event_queue_peek(&m_queue), nullptr);
+    EXPECT_FALSE(event_queue_has_pressed(&m_queue));
+    EXPECT_EQ(event_queue_overflows(&m_queue), 0);
+    // popping an empty queue does nothing
+    event_queue_pop(&m_queue);
+    EXPECT_EQ(event_queue_length(&m_queue), 0);
+}
+
+TEST_F(EventQueue, PopsInPushOrder) {
+    for (uint8_t col = 0; col < 5; col++) {
+        EXPECT_TRUE(event_queue_push(&m_queue, record(col, true)));
+    }
+    EXPECT_EQ(event_queue_length(&m_queue), 5);
+    for (uint8_t col = 0; col < 5; col++) {
+        keyrecord_t* oldest = event_queue_peek(&m_queue);
+        ASSERT_NE(oldest, nullptr);
+        EXPECT_EQ(oldest->event.key.col, col);
+        event_queue_pop(&m_queue);
+    }
+    EXPECT_EQ(event_queue_peek(&m_queue), nullptr);
+}
+
+TEST_F(EventQueue, EveryRecordIsUsedAndOverflowsAreCounted) {
+    for (uint8_t col = 0; col < 8; col++) {
+        EXPECT_TRUE(event_queue_push(&m_queue, record(col, false)));
+    }
+    EXPECT_FALSE(event_queue_push(&m_queue, record(8, false)));
+    EXPECT_FALSE(event_queue_push(&m_queue, record(9, false)));
+    EXPECT_EQ(event_queue_overflows(&m_queue), 2);
+    EXPECT_EQ(event_queue_length(&m_queue), 8);
+    // the queued events are untouched
+    for (uint8_t i = 0; i < 8; i++) {
+        EXPECT_EQ(event_queue_at(&m_queue, i)->event.key.col, i);
+    }
+    event_queue_pop(&m_queue);
+    EXPECT_TRUE(event_queue_push(&m_queue, record(8, false)));
+    EXPECT_EQ(event_queue_at(&m_queue, 7)->event.key.col, 8);
+}
+
+TEST_F(EventQueue, CountsThePressedEvents) {
+    event_queue_push(&m_queue, record(0, false));
+    EXPECT_FALSE(event_queue_has_pressed(&m_queue));
+    event_queue_push(&m_queue, record(1, true));
+    event_queue_push(&m_queue, record(2, true));
+    EXPECT_TRUE(event_queue_has_pressed(&m_queue));
+    event_queue_pop(&m_queue);
+    event_queue_pop(&m_queue);
+    EXPECT_TRUE(event_queue_has_pressed(&m_queue));
+    event_queue_pop(&m_queue);
+    EXPECT_FALSE(event_queue_has_pressed(&m_queue));
+    event_queue_push(&m_queue, record(3, true));
+    event_queue_clear(&m_queue);
+    EXPECT_FALSE(event_queue_has_pressed(&m_queue));
+    EXPECT_EQ(event_queue_length(&m_queue), 0);
+}
+
+TEST_F(EventQueue, WrapsAround) {
+    for (unsigned round = 0; round < 300; round++) {
+        EXPECT_TRUE(event_queue_push(&m_queue, record(round % 10, true, round)));
+        EXPECT_TRUE(event_queue_push(&m_queue, record(round % 10, false, round)));
+        EXPECT_EQ(event_queue_at(&m_queue, 1)->event.time, round);
+        event_queue_pop(&m_queue);
+        event_queue_pop(&m_queue);
+    }
+    EXPECT_EQ(event_queue_length(&m_queue), 0);
+}
+
+TEST_F(EventQueue, RandomEventsMatchAReferenceQueue) {
+    std::mt19937 rng(42);
+    std::deque<keyrecord_t> reference;
+    unsigned overflows = 0;
+    for (unsigned i = 0; i < 10000; i++) {
+        if (rng() % 2) {
+            keyrecord_t r = record(rng() % 10, rng() % 2, i);
+            bool pushed = event_queue_push(&m_queue, r);
+            EXPECT_EQ(pushed, reference.size() < 8);
+            if (pushed) {
+                reference.push_back(r);
+            } else {
+                overflows++;
+            }
+        } else {
+            keyrecord_t* oldest = event_queue_peek(&m_queue);
+            EXPECT_EQ(oldest == nullptr, reference.empty());
+            if (oldest) {
+                EXPECT_EQ(oldest->event.time, reference.front().event.time);
+                reference.pop_front();
+            }
+            event_queue_pop(&m_queue);
+        }
+        ASSERT_EQ(event_queue_length(&m_queue), reference.size());
+        EXPECT_EQ(event_queue_has_pressed(&m_queue),
+            std::any_of(reference.begin(), reference.end(), [](const keyrecord_t& r) { return r.event.pressed; }));
+        for (uint8_t n = 0; n < reference.size(); n++) {
+            EXPECT_EQ(event_queue_at(&m_queue, n)->event.time, reference[n].event.time);
+        }
+    }
+    EXPECT_EQ(event_queue_overflows(&m_queue), overflows);
+}
+
+class WaitingBuffer : public TestFixture {};
+
+TEST_F(WaitingBuffer, OverflowIsCounted) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    uint16_t overflows = action_tapping_overflows();
+    press_key(0, 0);
+    run_one_scan_loop();
+    // every event waits for the tap key to be decided
+    for (unsigned i = 0; i < WAITING_BUFFER_SIZE / 2; i++) {
+        press_key(2, 0);
+        run_one_scan_loop();
+        release_key(2, 0);
+        run_one_scan_loop();
+    }
+    EXPECT_EQ(action_tapping_overflows(), overflows);
+    press_key(3, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(action_tapping_overflows(), overflows + 1);
+    clear_all_keys();
+    idle_for(TAPPING_TERM + 10);
+}
+
+TEST_F(WaitingBuffer, RandomTypingLeavesNoKeyStuck) {
+    TestDriver driver;
+    report_keyboard_t last_report = {};
+    EXPECT_CALL(driver, send_keyboard_mock(_))
+        .Times(AnyNumber())
+        .WillRepeatedly(Invoke([&](report_keyboard_t& report) { last_report = report; }));
+    std::mt19937 rng(1234);
+    bool pressed[7] = {};
+    uint16_t overflows = action_tapping_overflows();
+    for (unsigned i = 0; i < 10000; i++) {
+        uint8_t col = rng() % 7;
+        pressed[col] = !pressed[col];
+        if (pressed[col]) {
+            press_key(col, 0);
+        } else {
+            release_key(col, 0);
+        }
+        run_one_scan_loop();
+        idle_for(rng() % 40);
+    }
+    clear_all_keys();
+    idle_for(TAPPING_TERM * 2);
+    std::cout << "[ QUEUE    ] 10000 random events, " << action_tapping_overflows() - overflows
+        << " waiting buffer overflows" << std::endl;
+    EXPECT_EQ(last_report.mods, 0);
+    EXPECT_EQ(has_anykey(&last_report), 0);
+    EXPECT_EQ(layer_state, 0);
+}
@@ -0,0 +1,155 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include "action_tapping.h"
+
+extern "C" {
+#include "instrument.h"
+}
+
+using testing::_;
+using testing::AnyNumber;
+
+class Instrument : public TestFixture {
+protected:
+    Instrument() {
+        instrument_reset();
+    }
+
+    static uint32_t get_u32(const uint8_t* data) {
+        return data[0] | (data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+};
+
+TEST_F(Instrument, EveryStageOfTheTaskIsTimed) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(10);
+    EXPECT_EQ(instrument_get_stage(INSTRUMENT_MATRIX_SCAN)->count, 10);
+    EXPECT_EQ(instrument_get_stage(INSTRUMENT_ACTION_EXEC)->count, 10);
+    EXPECT_EQ(instrument_get_stage(INSTRUMENT_LED)->count, 10);
+    EXPECT_EQ(instrument_get_stage(INSTRUMENT_KEYBOARD_TASK)->count, 10);
+    // not enabled in this build
+    EXPECT_EQ(instrument_get_stage(INSTRUMENT_VISUALIZER)->count, 0);
+    EXPECT_EQ(instrument_get_stage(INSTRUMENT_MIDI)->count, 0);
+    // the fake timer doesn't move during a task
+    EXPECT_EQ(instrument_get_stage(INSTRUMENT_KEYBOARD_TASK)->max, 0);
+}
+
+TEST_F(Instrument, ScansPerSecond) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    EXPECT_EQ(instrument_get_scan_rate(), 0);
+    // one scan per ms
+    idle_for(2500);
+    EXPECT_EQ(instrument_get_scan_rate(), 1000);
+}
+
+TEST_F(Instrument, KeyIsReportedInTheScanThatFindsIt) {
+    TestDriver driver;
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_A)));
+    run_one_scan_loop();
+    release_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    const instrument_stat_t* latency = instrument_get_latency();
+    EXPECT_EQ(latency->count, 2);
+    EXPECT_EQ(latency->max, 0);
+    EXPECT_EQ(instrument_get_latency_bucket(0), 2);
+}
+
+TEST_F(Instrument, HoldOfModTapIsReportedAfterTheTappingTerm) {
+    TestDriver driver;
+    press_key(0, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(TAPPING_TERM);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_EQ(instrument_get_latency()->count, 0);
+
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    const instrument_stat_t* latency = instrument_get_latency();
+    EXPECT_EQ(latency->count, 1);
+    // the budget of a hold is the tapping term and a scan
+    EXPECT_GE(latency->max, TAPPING_TERM * 1000);
+    EXPECT_LE(latency->max, (TAPPING_TERM + 1) * 1000);
+    // 128 ms and more
+    EXPECT_EQ(instrument_get_latency_bucket(INSTRUMENT_LATENCY_BUCKETS - 1), 1);
+
+    release_key(0, 1);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(Instrument, LatencyIsMeasuredFromTheLastKeyEvent) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    // the layer key doesn't send anything itself
+    press_key(2, 0);
+    idle_for(50);
+    instrument_reset();
+    press_key(0, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_1)));
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+
+    EXPECT_EQ(instrument_get_latency()->count, 1);
+    EXPECT_EQ(instrument_get_latency()->max, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+}
+
+TEST_F(Instrument, RawHidQuery) {
+    TestDriver driver;
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    press_key(0, 0);
+    run_one_scan_loop();
+    release_key(0, 0);
+    run_one_scan_loop();
+
+    uint8_t data[32] = {0};
+    EXPECT_FALSE(instrument_raw_hid_query(data, sizeof(data)));
+
+    data[0] = INSTRUMENT_RAW_HID_ID;
+    data[1] = INSTRUMENT_MATRIX_SCAN;
+    EXPECT_TRUE(instrument_raw_hid_query(data, sizeof(data)));
+    EXPECT_EQ(data[1], INSTRUMENT_MATRIX_SCAN);
+    EXPECT_EQ(get_u32(&data[2]), 2);
+
+    data[1] = INSTRUMENT_QUERY_LATENCY;
+    EXPECT_TRUE(instrument_raw_hid_query(data, sizeof(data)));
+    EXPECT_EQ(get_u32(&data[2]), 2);
+    EXPECT_EQ(get_u32(&data[14]), 0);
+
+    data[1] = INSTRUMENT_QUERY_HISTOGRAM;
+    EXPECT_TRUE(instrument_raw_hid_query(data, sizeof(data)));
+    EXPECT_EQ(data[2], 2);
+    EXPECT_EQ(data[3], 0);
+    EXPECT_EQ(data[4], 0);
+
+    data[1] = 0x7F;
+    EXPECT_TRUE(instrument_raw_hid_query(data, sizeof(data)));
+    EXPECT_EQ(data[1], INSTRUMENT_QUERY_INVALID);
+
+    data[1] = INSTRUMENT_QUERY_RESET;
+    EXPECT_TRUE(instrument_raw_hid_query(data, sizeof(data)));
+    EXPECT_EQ(instrument_get_latency()->count, 0);
+}
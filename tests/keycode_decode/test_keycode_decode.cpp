@@ -0,0 +1,65 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <chrono>
+#include <iostream>
+
+class KeycodeDecode : public TestFixture {
+protected:
+    // Decodes the whole keycode space `passes` times, returns ns per keycode
+    template<typename Decoder>
+    static double time_decoder(Decoder decoder, unsigned passes) {
+        volatile uint16_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned pass = 0; pass < passes; pass++) {
+            for (uint32_t keycode = 0; keycode <= 0xFFFF; keycode++) {
+                sink = sink + decoder(keycode).code;
+            }
+        }
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / (passes * 0x10000);
+    }
+};
+
+TEST_F(KeycodeDecode, TableMatchesSwitchForAllKeycodes) {
+    for (uint32_t keycode = 0; keycode <= 0xFFFF; keycode++) {
+        EXPECT_EQ(keycode_to_action_table(keycode).code, keycode_to_action_switch(keycode).code)
+            << "keycode 0x" << std::hex << keycode;
+    }
+}
+
+TEST_F(KeycodeDecode, TableMatchesSwitchWithSwappedMods) {
+    // Mod tap decoding depends on the keymap config
+    keymap_config.swap_lalt_lgui = true;
+    keymap_config.swap_ralt_rgui = true;
+    keymap_config.no_gui = true;
+    for (uint32_t keycode = QK_MOD_TAP; keycode <= QK_MOD_TAP_MAX; keycode++) {
+        EXPECT_EQ(keycode_to_action_table(keycode).code, keycode_to_action_switch(keycode).code)
+            << "keycode 0x" << std::hex << keycode;
+    }
+    keymap_config.swap_lalt_lgui = false;
+    keymap_config.swap_ralt_rgui = false;
+    keymap_config.no_gui = false;
+}
+
+TEST_F(KeycodeDecode, Benchmark) {
+    const unsigned passes = 50;
+    double switch_ns = time_decoder(keycode_to_action_switch, passes);
+    double table_ns = time_decoder(keycode_to_action_table, passes);
+    std::cout << "[ DECODE   ] switch: " << switch_ns << " ns/keycode, "
+        << "table: " << table_ns << " ns/keycode" << std::endl;
+}
@@ -0,0 +1,70 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+// Layers mix transparent keys with every kind of action, the layer cache
+// tests compare the cached lookups against walking these layers by hand
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        {KC_E, OSM(MOD_LSFT), KC_C, KC_ENT, KC_D, LT(4, KC_F), TG(2), LT(4, KC_F), KC_VOLU, MO(1)},
+        {KC_2, KC_D, LT(4, KC_F), KC_A, MO(1), MO(3), KC_MS_U, KC_A, TG(2), KC_ENT},
+        {KC_SPC, OSM(MOD_LSFT), KC_D, KC_LCTL, KC_A, KC_A, KC_A, KC_VOLU, LCTL(KC_H), KC_A},
+        {MO(1), KC_2, MO(3), KC_A, SFT_T(KC_G), KC_SPC, TG(2), LT(4, KC_F), LCTL(KC_H), KC_SPC},
+    },
+    [1] = {
+        {KC_TRNS, TG(2), KC_A, KC_TRNS, KC_VOLU, KC_TRNS, KC_LSFT, KC_TRNS, KC_TRNS, SFT_T(KC_G)},
+        {MO(3), KC_TRNS, KC_2, KC_TRNS, KC_TRNS, SFT_T(KC_G), KC_TRNS, LT(4, KC_F), KC_TRNS, MO(3)},
+        {KC_NO, KC_TRNS, KC_NO, KC_TRNS, KC_D, SFT_T(KC_G), KC_NO, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_MS_U, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_2, KC_TRNS, KC_SPC, KC_TRNS, KC_TRNS},
+    },
+    [2] = {
+        {KC_NO, KC_TRNS, KC_TRNS, KC_TRNS, KC_A, KC_TRNS, SFT_T(KC_G), SFT_T(KC_G), KC_2, KC_TRNS},
+        {KC_TRNS, OSM(MOD_LSFT), KC_TRNS, MO(3), KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_MS_U, KC_TRNS},
+        {KC_TRNS, KC_VOLU, KC_TRNS, KC_TRNS, LCTL(KC_H), KC_ENT, KC_TRNS, KC_C, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_SPC, KC_TRNS, KC_1, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+    },
+    [3] = {
+        {TG(2), LT(4, KC_F), KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, SFT_T(KC_G), KC_MS_U},
+        {KC_TRNS, KC_SPC, KC_TRNS, KC_TRNS, KC_1, KC_TRNS, KC_TRNS, KC_TRNS, KC_VOLU, SFT_T(KC_G)},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_LCTL, MO(3), KC_TRNS, KC_TRNS, KC_B, KC_TRNS, KC_LSFT},
+        {KC_LSFT, MO(3), KC_TRNS, KC_TRNS, KC_TRNS, OSM(MOD_LSFT), OSM(MOD_LSFT), KC_TRNS, KC_MS_U, KC_TRNS},
+    },
+    [4] = {
+        {KC_TRNS, KC_TRNS, KC_TRNS, MO(3), KC_TRNS, KC_TRNS, MO(1), KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_LSFT, KC_TRNS, KC_TRNS, KC_TRNS, KC_E, KC_TRNS, KC_TRNS, MO(1), KC_NO, LCTL(KC_H)},
+        {KC_TRNS, KC_SPC, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, LT(4, KC_F), KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+    },
+    [5] = {
+        {KC_E, KC_LCTL, KC_TRNS, KC_TRNS, KC_C, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, OSM(MOD_LSFT)},
+        {KC_TRNS, KC_TRNS, KC_D, KC_LSFT, KC_TRNS, KC_C, KC_TRNS, KC_B, KC_TRNS, OSM(MOD_LSFT)},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_D, KC_TRNS, LCTL(KC_H), KC_LSFT, KC_TRNS, KC_LCTL},
+        {KC_TRNS, KC_B, KC_TRNS, KC_LSFT, KC_LCTL, KC_TRNS, KC_TRNS, KC_TRNS, KC_MS_U, KC_D},
+    },
+    [6] = {
+        {KC_TRNS, LCTL(KC_H), LT(4, KC_F), KC_ENT, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_C, TG(2)},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_B, KC_TRNS, KC_TRNS, KC_LSFT, KC_TRNS, KC_TRNS},
+        {KC_MS_U, KC_TRNS, KC_TRNS, MO(1), KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_LSFT, KC_NO},
+        {KC_TRNS, KC_E, KC_TRNS, KC_LCTL, KC_TRNS, KC_1, KC_TRNS, KC_TRNS, KC_TRNS, KC_LSFT},
+    },
+    [7] = {
+        {KC_TRNS, KC_TRNS, KC_LSFT, KC_TRNS, KC_TRNS, KC_TRNS, KC_LCTL, KC_MS_U, LCTL(KC_H), KC_2},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_SPC, KC_TRNS, KC_TRNS, MO(3), KC_TRNS, KC_TRNS, TG(2)},
+        {KC_TRNS, KC_1, KC_TRNS, KC_TRNS, MO(3), KC_A, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, MO(1), KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS, TG(2), KC_VOLU},
+    },
+};
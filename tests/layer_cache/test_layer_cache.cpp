@@ -0,0 +1,104 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <random>
+
+using testing::_;
+using testing::AnyNumber;
+
+// The number of layers in keymap.c
+static const uint8_t num_layers = 8;
+
+class LayerCache : public TestFixture {
+protected:
+    LayerCache() : m_default_layer_state(default_layer_state) {
+        EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(AnyNumber());
+    }
+
+    ~LayerCache() {
+        default_layer_set(m_default_layer_state);
+    }
+
+    // The uncached lookup, walking the layers from the top
+    static int8_t reference_layer(keypos_t key) {
+        uint32_t layers = layer_state | default_layer_state;
+        for (int8_t i = 31; i >= 0; i--) {
+            if ((layers & (1UL << i)) && action_for_key(i, key).code != ACTION_TRANSPARENT) {
+                return i;
+            }
+        }
+        return 0;
+    }
+
+    static void expect_matches_reference(keypos_t key) {
+        int8_t layer = reference_layer(key);
+        EXPECT_EQ(layer_switch_get_layer(key), layer)
+            << "row " << (int)key.row << " col " << (int)key.col
+            << " layer_state " << layer_state << " default_layer_state " << default_layer_state;
+        EXPECT_EQ(layer_switch_get_action(key).code, action_for_key(layer, key).code)
+            << "row " << (int)key.row << " col " << (int)key.col
+            << " layer_state " << layer_state << " default_layer_state " << default_layer_state;
+    }
+
+    TestDriver m_driver;
+    uint32_t m_default_layer_state;
+};
+
+TEST_F(LayerCache, MatchesUncachedLookupForAllKeys) {
+    for (uint32_t state = 0; state < (1UL << num_layers); state++) {
+        layer_state_set(state);
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                expect_matches_reference((keypos_t){ .col = col, .row = row });
+            }
+        }
+    }
+}
+
+TEST_F(LayerCache, MatchesUncachedLookupForRandomLayerStates) {
+    std::mt19937 rng(1234);
+    for (unsigned i = 0; i < 20000; i++) {
+        switch (rng() % 6) {
+            case 0:
+                layer_state_set(rng() & ((1UL << num_layers) - 1));
+                break;
+            case 1:
+                layer_on(rng() % num_layers);
+                break;
+            case 2:
+                layer_off(rng() % num_layers);
+                break;
+            case 3:
+                layer_invert(rng() % num_layers);
+                break;
+            case 4:
+                default_layer_set(1UL << (rng() % num_layers));
+                break;
+            default:
+                // no state change, the cached rows have to stay valid
+                break;
+        }
+        // Only look at a few keys, so that some rows are still stale when
+        // the state changes again
+        for (unsigned lookups = rng() % 4; lookups > 0; lookups--) {
+            expect_matches_reference((keypos_t){
+                .col = (uint8_t)(rng() % MATRIX_COLS),
+                .row = (uint8_t)(rng() % MATRIX_ROWS)
+            });
+        }
+    }
+}
@@ -0,0 +1,256 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+extern "C" {
+    uint32_t timer_read32(void);
+    void advance_time(uint32_t ms);
+}
+
+// The LUFA endpoint API used by deferred_report.h, for a single bank
+// endpoint that the host empties when it polls
+enum {
+    DEVICE_STATE_Configured = 4
+};
+static uint8_t USB_DeviceState = DEVICE_STATE_Configured;
+
+struct Bank {
+    bool full;
+    report_keyboard_t report;
+};
+static Bank bank;
+
+static void Endpoint_SelectEndpoint(uint8_t) {}
+
+static bool Endpoint_IsReadWriteAllowed(void) {
+    return !bank.full;
+}
+
+static uint8_t Endpoint_Write_Stream_LE(const void *buffer, uint16_t length, uint16_t *) {
+    EXPECT_FALSE(bank.full);
+    memset(&bank.report, 0, sizeof(bank.report));
+    memcpy(&bank.report, buffer, length);
+    return 0;
+}
+
+static void Endpoint_ClearIN(void) {
+    bank.full = true;
+}
+
+#include "protocol/lufa/deferred_report.h"
+
+class LufaDeferredSend : public TestFixture {
+protected:
+    struct Edge {
+        uint32_t time;
+        uint8_t col;
+        bool pressed;
+    };
+
+    struct Result {
+        uint32_t stall;
+        unsigned dropped;
+        unsigned missed;
+        bool final_state;
+    };
+
+    // Fast rolls on row 0: a press every 4 to 15 ms, held for 20 to 100 ms,
+    // at most 4 keys held
+    static std::vector<Edge> burst(unsigned seed, unsigned presses) {
+        std::mt19937 rng(seed);
+        std::vector<Edge> edges;
+        std::map<uint8_t, uint32_t> released;
+        uint32_t time = 10;
+        while (presses) {
+            time += 4 + rng() % 12;
+            std::vector<uint8_t> free;
+            unsigned held = 0;
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                if (released[col] + 5 <= time) {
+                    free.push_back(col);
+                } else if (released[col] > time) {
+                    held++;
+                }
+            }
+            if (held >= 4 || free.empty()) {
+                continue;
+            }
+            uint8_t col = free[rng() % free.size()];
+            uint32_t release = time + 20 + rng() % 81;
+            edges.push_back({time, col, true});
+            edges.push_back({release, col, false});
+            released[col] = release;
+            presses--;
+        }
+        std::stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+            return a.time < b.time;
+        });
+        return edges;
+    }
+
+    // The host polls every 10 ms, but skips one now and then when the bus is busy
+    void poll() {
+        while (TIMER_DIFF_32(timer_read32(), m_next_poll) < 0x80000000UL) {
+            if (bank.full && m_rng() % 8) {
+                m_received.push_back(bank.report);
+                bank.full = false;
+            }
+            m_next_poll += 10;
+        }
+    }
+
+    // The previous send_keyboard(): wait for the bank for up to 10 ms,
+    // the report is dropped if it's still busy
+    static void send_blocking(report_keyboard_t *report) {
+        for (uint8_t timeout = 10; bank.full && timeout; timeout--) {
+            advance_time(1);
+            m_this->m_stall++;
+            m_this->poll();
+        }
+        if (bank.full) {
+            m_this->m_dropped++;
+            return;
+        }
+        Endpoint_Write_Stream_LE(report, KEYBOARD_REPORT_SIZE, NULL);
+        Endpoint_ClearIN();
+    }
+
+    static void send_deferred(report_keyboard_t *report) {
+        deferred_report_send(&m_this->m_queue, 1, report, KEYBOARD_REPORT_SIZE);
+    }
+
+    static bool superseded(const void *previous, const void *pending, const void *report) {
+        return is_report_superseded((const report_keyboard_t *)pending,
+            (const report_keyboard_t *)previous, (const report_keyboard_t *)report);
+    }
+
+    static uint8_t keyboard_leds(void) { return 0; }
+    static void send_mouse(report_mouse_t *) {}
+    static void send_system(uint16_t) {}
+    static void send_consumer(uint16_t) {}
+
+    Result type(const char *name, bool blocking, uint8_t queue_size, const std::vector<Edge> &typed, unsigned seed) {
+        host_driver_t driver = {keyboard_leds, blocking ? send_blocking : send_deferred,
+            send_mouse, send_system, send_consumer};
+        host_set_driver(&driver);
+        m_this = this;
+        m_queue = REPORT_QUEUE_INIT(m_reports, superseded);
+        m_queue.mask = queue_size - 1;
+        m_rng.seed(seed);
+        m_received.clear();
+        m_stall = 0;
+        m_dropped = 0;
+        bank.full = false;
+        const uint32_t start = timer_read32();
+        m_next_poll = start + 10;
+
+        size_t next = 0;
+        while (next < typed.size() || bank.full || report_queue_busy(&m_queue)) {
+            uint32_t now = timer_read32() - start;
+            for (; next < typed.size() && typed[next].time <= now; next++) {
+                if (typed[next].pressed) {
+                    press_key(typed[next].col, 0);
+                } else {
+                    release_key(typed[next].col, 0);
+                }
+            }
+            poll();
+            keyboard_task();
+            deferred_report_flush(&m_queue, 1, KEYBOARD_REPORT_SIZE);
+            advance_time(1);
+        }
+        idle_for(20);
+        poll();
+
+        // count the presses and releases the host saw against the typed ones
+        std::map<uint8_t, unsigned> typed_edges, seen_edges;
+        for (const Edge &edge : typed) {
+            typed_edges[edge.col]++;
+        }
+        report_keyboard_t previous = {};
+        for (const report_keyboard_t &report : m_received) {
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                bool before = false, now = false;
+                for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+                    before |= previous.keys[i] == KC_A + col;
+                    now |= report.keys[i] == KC_A + col;
+                }
+                seen_edges[col] += before != now;
+            }
+            previous = report;
+        }
+        Result result = {m_stall, m_dropped, 0, !m_received.empty() && !has_anykey(&previous)};
+        for (auto &key : typed_edges) {
+            result.missed += key.second - std::min(key.second, seen_edges[key.first]);
+        }
+        std::cout << "[ LUFA     ] " << name << ": scan loop stalled " << result.stall << " ms, "
+            << result.dropped << " reports dropped, missed edges " << result.missed
+            << ", keys released at the end " << (result.final_state ? "yes" : "no") << std::endl;
+        m_this = nullptr;
+        return result;
+    }
+
+    report_keyboard_t m_reports[4];
+    report_queue_t m_queue;
+    std::mt19937 m_rng;
+    std::vector<report_keyboard_t> m_received;
+    uint32_t m_next_poll;
+    uint32_t m_stall;
+    unsigned m_dropped;
+    static LufaDeferredSend *m_this;
+};
+
+LufaDeferredSend *LufaDeferredSend::m_this = nullptr;
+
+TEST_F(LufaDeferredSend, DeferredSendNeverBlocksAndDeliversTheFinalState) {
+    for (unsigned seed = 1; seed <= 5; seed++) {
+        std::vector<Edge> typed = burst(seed, 40);
+        Result blocking = type("blocking", true, 2, typed, seed);
+        Result latest = type("deferred, 1 pending", false, 2, typed, seed);
+        Result queued = type("deferred, 3 pending", false, 4, typed, seed);
+        EXPECT_GT(blocking.stall, 0);
+        EXPECT_EQ(latest.stall, 0);
+        EXPECT_EQ(queued.stall, 0);
+        EXPECT_EQ(latest.dropped, 0);
+        EXPECT_TRUE(latest.final_state);
+        EXPECT_TRUE(queued.final_state);
+        EXPECT_LE(queued.missed, latest.missed);
+    }
+}
+
+TEST_F(LufaDeferredSend, ReleaseIsntLostWhenTheBankIsBusy) {
+    // the press is still in the bank when the key is released
+    Result result = type("quick tap", false, 2, {{10, 0, true}, {12, 0, false}}, 1);
+    EXPECT_EQ(result.missed, 0);
+    EXPECT_TRUE(result.final_state);
+}
+
+TEST_F(LufaDeferredSend, LongerQueueKeepsTapsWithinAPoll) {
+    // a whole roll between two polls, only the last state fits in one slot
+    std::vector<Edge> typed = {{10, 0, true}, {12, 1, true}, {13, 0, false}, {14, 1, false}};
+    Result latest = type("roll, 1 pending", false, 2, typed, 1);
+    EXPECT_EQ(latest.missed, 2);
+    EXPECT_TRUE(latest.final_state);
+    Result queued = type("roll, 3 pending", false, 4, typed, 1);
+    EXPECT_EQ(queued.missed, 0);
+    EXPECT_TRUE(queued.final_state);
+}
@@ -0,0 +1,38 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "quantum.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0    1      2      3      4      5      6      7      8      9
+        {KC_A,  KC_B,  KC_C,  KC_D,  KC_E,  KC_F,  KC_G,  KC_H,  KC_I,  KC_J},
+        {KC_K,  KC_L,  KC_M,  KC_N,  KC_O,  KC_P,  KC_Q,  KC_R,  KC_S,  KC_T},
+        {KC_U,  KC_V,  KC_W,  KC_X,  KC_Y,  KC_Z,  KC_1,  KC_2,  KC_3,  KC_4},
+        {KC_5,  KC_6,  KC_7,  KC_8,  KC_9,  KC_0,  KC_NO, KC_NO, KC_NO, KC_NO},
+    },
+};
+
+// One LED per key, spread over the whole 224x64 area
+#define LED(row, col) {{(row) | ((col) << 4)}, {(col) * 224 / 9, (row) * 64 / 3}, 0}
+
+const rgb_led g_rgb_leds[DRIVER_LED_TOTAL] = {
+    LED(0, 0), LED(0, 1), LED(0, 2), LED(0, 3), LED(0, 4), LED(0, 5), LED(0, 6), LED(0, 7), LED(0, 8), LED(0, 9),
+    LED(1, 0), LED(1, 1), LED(1, 2), LED(1, 3), LED(1, 4), LED(1, 5), LED(1, 6), LED(1, 7), LED(1, 8), LED(1, 9),
+    LED(2, 0), LED(2, 1), LED(2, 2), LED(2, 3), LED(2, 4), LED(2, 5), LED(2, 6), LED(2, 7), LED(2, 8), LED(2, 9),
+    LED(3, 0), LED(3, 1), LED(3, 2), LED(3, 3), LED(3, 4), LED(3, 5), LED(3, 6), LED(3, 7), LED(3, 8), LED(3, 9),
+};
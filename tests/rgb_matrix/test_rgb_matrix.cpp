@@ -0,0 +1,195 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include <iostream>
+#include <vector>
+
+using testing::_;
+using testing::AnyNumber;
+
+extern "C" {
+    extern rgb_config_t rgb_matrix_config;
+    void advance_time(uint32_t ms);
+}
+
+// This file is built twice, by tests/rgb_matrix rendering whole frames, and
+// by tests/rgb_matrix_sliced with RGB_MATRIX_LED_PROCESS_LIMIT.
+
+// An I2C transfer to the IS31FL3731 is the address, the register and 16 bytes
+// of PWM values, each byte takes 9 clocks at 400 kHz
+static const unsigned transfer_bytes = 18;
+static const double byte_us = 9 / 0.4;
+
+// The IS31FL3731 driver, the LEDs only see the frames once they are sent.
+// tests/rgb_matrix_i2c runs the real driver.
+static RGB pwm_buffer[DRIVER_LED_TOTAL];
+static RGB leds[DRIVER_LED_TOTAL];
+static bool pwm_buffer_dirty;
+static uint8_t flush_transfer;
+static unsigned scan_leds;
+static unsigned scan_bytes;
+static std::vector<std::vector<RGB>> frames;
+
+static void frame_sent() {
+    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
+        leds[i] = pwm_buffer[i];
+    }
+    frames.push_back(std::vector<RGB>(leds, leds + DRIVER_LED_TOTAL));
+    pwm_buffer_dirty = false;
+}
+
+extern "C" {
+void TWIInit(void) {}
+
+void IS31FL3731_init(uint8_t addr) {}
+
+void IS31FL3731_set_color(int index, uint8_t red, uint8_t green, uint8_t blue) {
+    EXPECT_EQ(flush_transfer, 0) << "LED " << index << " changed while its frame is sent";
+    pwm_buffer[index] = (RGB){red, green, blue};
+    pwm_buffer_dirty = true;
+    scan_leds++;
+}
+
+void IS31FL3731_set_color_all(uint8_t red, uint8_t green, uint8_t blue) {
+    for (int i = 0; i < DRIVER_LED_TOTAL; i++) {
+        IS31FL3731_set_color(i, red, green, blue);
+    }
+}
+
+void IS31FL3731_set_led_control_register(uint8_t index, bool red, bool green, bool blue) {}
+
+void IS31FL3731_update_led_control_registers(uint8_t addr1, uint8_t addr2) {}
+
+void IS31FL3731_update_pwm_buffers(uint8_t addr1, uint8_t addr2) {
+    if (pwm_buffer_dirty) {
+        scan_bytes += 2 * 9 * transfer_bytes;
+        frame_sent();
+    }
+}
+
+// Sends every block of a changed frame, one per call
+bool IS31FL3731_flush_pwm_buffers(uint8_t addr1, uint8_t addr2) {
+    if (pwm_buffer_dirty) {
+        scan_bytes += transfer_bytes;
+        if (++flush_transfer == 2 * 9) {
+            flush_transfer = 0;
+            frame_sent();
+        }
+    }
+    return !pwm_buffer_dirty;
+}
+}
+
+class RgbMatrix : public TestFixture {
+protected:
+    struct Result {
+        unsigned max_leds;
+        unsigned max_bytes;
+        unsigned frames;
+    };
+
+    RgbMatrix() {
+        EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(AnyNumber());
+        rgb_matrix_config.enable = 1;
+        rgb_matrix_config.hue = 0;
+        rgb_matrix_config.sat = 255;
+        rgb_matrix_config.val = 255;
+        rgb_matrix_config.speed = 0;
+        // past the startup delay, and the end of the last frame
+        set_mode(RGB_MATRIX_SOLID_COLOR);
+        run(1500, 1);
+    }
+
+    void set_mode(uint8_t mode) {
+        rgb_matrix_config.mode = mode;
+    }
+
+    // Scans every scan_interval ms for a while
+    Result run(unsigned ms, unsigned scan_interval) {
+        Result result = {0, 0, 0};
+        size_t frames_before = frames.size();
+        for (unsigned t = 0; t < ms; t += scan_interval) {
+            scan_leds = 0;
+            scan_bytes = 0;
+            keyboard_task();
+            advance_time(scan_interval);
+            result.max_leds = std::max(result.max_leds, scan_leds);
+            result.max_bytes = std::max(result.max_bytes, scan_bytes);
+        }
+        result.frames = frames.size() - frames_before;
+        return result;
+    }
+
+    TestDriver m_driver;
+};
+
+TEST_F(RgbMatrix, ScanLoad) {
+    static const struct {
+        uint8_t mode;
+        const char* name;
+    } modes[] = {
+        {RGB_MATRIX_SOLID_COLOR, "solid color"},
+        {RGB_MATRIX_CYCLE_LEFT_RIGHT, "cycle left right"},
+        {RGB_MATRIX_RAINBOW_BEACON, "rainbow beacon"},
+        {RGB_MATRIX_JELLYBEAN_RAINDROPS, "jellybean raindrops"},
+    };
+    for (auto& mode : modes) {
+        set_mode(mode.mode);
+        Result result = run(1000, 1);
+        std::cout << "[ RGB      ] " << mode.name << ": " << result.frames << " frames sent/s, worst scan renders "
+            << result.max_leds << " LEDs and sends " << result.max_bytes << " bytes ("
+            << result.max_bytes * byte_us << " us at 400 kHz)" << std::endl;
+#ifdef RGB_MATRIX_LED_PROCESS_LIMIT
+        EXPECT_LE(result.max_leds, RGB_MATRIX_LED_PROCESS_LIMIT);
+        EXPECT_LE(result.max_bytes, transfer_bytes);
+#else
+        EXPECT_EQ(result.max_leds, DRIVER_LED_TOTAL);
+        EXPECT_EQ(result.max_bytes, 2 * 9 * transfer_bytes);
+#endif
+    }
+}
+
+TEST_F(RgbMatrix, OnlyCompleteFramesAreSent) {
+    // All the LEDs have the same color, which changes every frame
+    set_mode(RGB_MATRIX_CYCLE_ALL);
+    run(100, 1);
+    frames.clear();
+    run(1000, 1);
+    ASSERT_GT(frames.size(), 2);
+    for (size_t frame = 0; frame < frames.size(); frame++) {
+        for (uint8_t i = 1; i < DRIVER_LED_TOTAL; i++) {
+            EXPECT_EQ(frames[frame][i].r, frames[frame][0].r) << "frame " << frame << " LED " << (int)i;
+            EXPECT_EQ(frames[frame][i].g, frames[frame][0].g) << "frame " << frame << " LED " << (int)i;
+            EXPECT_EQ(frames[frame][i].b, frames[frame][0].b) << "frame " << frame << " LED " << (int)i;
+        }
+    }
+}
+
+#ifdef RGB_MATRIX_LED_PROCESS_LIMIT
+TEST_F(RgbMatrix, FrameRateDoesNotDependOnScanRate) {
+    set_mode(RGB_MATRIX_CYCLE_ALL);
+    run(100, 1);
+    // 20 frames per second by default
+    uint32_t tick = rgb_matrix_get_tick();
+    run(2000, 1);
+    EXPECT_NEAR(rgb_matrix_get_tick() - tick, 2000 / 50, 1);
+    tick = rgb_matrix_get_tick();
+    run(2000, 2);
+    EXPECT_NEAR(rgb_matrix_get_tick() - tick, 2000 / 50, 1);
+}
+#endif
@@ -0,0 +1,192 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include <iostream>
+
+using testing::_;
+using testing::AnyNumber;
+
+extern "C" {
+#include "TWIlib.h"
+    extern rgb_config_t rgb_matrix_config;
+    extern uint8_t g_pwm_buffer[DRIVER_COUNT][144];
+    extern uint16_t g_pwm_buffer_dirty[DRIVER_COUNT];
+    extern uint8_t g_pwm_buffer_transfer;
+    void advance_time(uint32_t ms);
+}
+
+// The I2C bus and the two IS31FL3731, a transfer is on the bus until the
+// next time the driver polls it
+static uint8_t chip_bank[DRIVER_COUNT];
+static uint8_t chip_registers[DRIVER_COUNT][256];
+static uint8_t transfer[TXMAXBUFLEN];
+static uint8_t transfer_length;
+static unsigned bus_bytes;
+static unsigned nacks;
+
+static void complete_transfer() {
+    if (transfer_length == 0) {
+        return;
+    }
+    bus_bytes += transfer_length;
+    if (nacks) {
+        nacks--;
+        TWIInfo.errorCode = TWI_MT_DATA_NACK;
+    } else {
+        uint8_t chip = (transfer[0] >> 1) == DRIVER_ADDR_1 ? 0 : 1;
+        uint8_t reg = transfer[1];
+        if (reg == 0xFD) {
+            chip_bank[chip] = transfer[2];
+        } else if (chip_bank[chip] == 0) {
+            for (uint8_t i = 2; i < transfer_length; i++) {
+                chip_registers[chip][reg++] = transfer[i];
+            }
+        }
+        TWIInfo.errorCode = TWI_SUCCESS;
+    }
+    transfer_length = 0;
+    TWIInfo.mode = Ready;
+}
+
+extern "C" {
+TWIInfoStruct TWIInfo;
+
+void TWIInit(void) {
+    TWIInfo.mode = Ready;
+    TWIInfo.errorCode = TWI_SUCCESS;
+}
+
+// TWIlib waits for the previous transfer before starting the next one
+uint8_t TWITransmitData(void *const data, uint8_t length, uint8_t repStart) {
+    complete_transfer();
+    memcpy(transfer, data, length);
+    transfer_length = length;
+    TWIInfo.mode = MasterTransmitter;
+    return 0;
+}
+
+uint8_t isTWIReady(void) {
+    if (transfer_length) {
+        complete_transfer();
+        return 0;
+    }
+    return 1;
+}
+}
+
+class RgbMatrixI2c : public TestFixture {
+protected:
+    RgbMatrixI2c() {
+        EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(AnyNumber());
+        rgb_matrix_config.enable = 1;
+        rgb_matrix_config.hue = 0;
+        rgb_matrix_config.sat = 255;
+        rgb_matrix_config.val = 255;
+        rgb_matrix_config.speed = 0;
+        nacks = 0;
+        // past the startup delay
+        rgb_matrix_config.mode = RGB_MATRIX_SOLID_COLOR;
+        run(1500);
+    }
+
+    // Scans once per ms, returns the number of scans that sent a frame
+    unsigned run(unsigned ms) {
+        unsigned frames = 0;
+        for (unsigned t = 0; t < ms; t++) {
+            unsigned bytes = bus_bytes;
+            keyboard_task();
+            advance_time(1);
+            frames += bus_bytes != bytes;
+            if (!g_pwm_buffer_dirty[0] && !g_pwm_buffer_dirty[1] && g_pwm_buffer_transfer == 0xFF) {
+                expect_chips_match_buffers();
+            }
+        }
+        return frames;
+    }
+
+    static void expect_chips_match_buffers() {
+        for (uint8_t chip = 0; chip < DRIVER_COUNT; chip++) {
+            for (uint8_t i = 0; i < 144; i++) {
+                ASSERT_EQ(chip_registers[chip][0x24 + i], g_pwm_buffer[chip][i])
+                    << "chip " << (int)chip << " register " << (int)(0x24 + i);
+            }
+        }
+    }
+
+    TestDriver m_driver;
+};
+
+TEST_F(RgbMatrixI2c, OnlyChangedBlocksAreSent) {
+    // What IS31FL3731_update_pwm_buffers() used to send for every changed frame
+    bus_bytes = 0;
+    IS31FL3731_write_pwm_buffer(DRIVER_ADDR_1, g_pwm_buffer[0]);
+    IS31FL3731_write_pwm_buffer(DRIVER_ADDR_2, g_pwm_buffer[1]);
+    isTWIReady();
+    const unsigned full_frame_bytes = bus_bytes;
+    EXPECT_EQ(full_frame_bytes, 2 * 9 * 18);
+
+    static const struct {
+        uint8_t mode;
+        const char* name;
+    } modes[] = {
+        {RGB_MATRIX_SOLID_COLOR, "solid color"},
+        {RGB_MATRIX_ALPHAS_MODS, "alphas mods"},
+        {RGB_MATRIX_DUAL_BEACON, "dual beacon"},
+        {RGB_MATRIX_GRADIENT_UP_DOWN, "gradient up down"},
+        {RGB_MATRIX_RAINDROPS, "raindrops"},
+        {RGB_MATRIX_CYCLE_ALL, "cycle all"},
+        {RGB_MATRIX_CYCLE_LEFT_RIGHT, "cycle left right"},
+        {RGB_MATRIX_CYCLE_UP_DOWN, "cycle up down"},
+        {RGB_MATRIX_RAINBOW_BEACON, "rainbow beacon"},
+        {RGB_MATRIX_RAINBOW_PINWHEELS, "rainbow pinwheels"},
+        {RGB_MATRIX_RAINBOW_MOVING_CHEVRON, "rainbow moving chevron"},
+        {RGB_MATRIX_JELLYBEAN_RAINDROPS, "jellybean raindrops"},
+    };
+    for (auto& mode : modes) {
+        rgb_matrix_config.mode = mode.mode;
+        run(100);
+        bus_bytes = 0;
+        unsigned frames = run(1000);
+        std::cout << "[ RGB I2C  ] " << mode.name << ": " << frames << " frames/s, "
+            << bus_bytes << " bytes/s, " << frames * full_frame_bytes
+            << " when sending the whole buffers" << std::endl;
+        EXPECT_LE(bus_bytes, frames * full_frame_bytes);
+    }
+}
+
+TEST_F(RgbMatrixI2c, UnchangedFramesAreNotSent) {
+    rgb_matrix_config.mode = RGB_MATRIX_SOLID_COLOR;
+    run(100);
+    bus_bytes = 0;
+    run(1000);
+    EXPECT_EQ(bus_bytes, 0);
+}
+
+TEST_F(RgbMatrixI2c, FailedTransfersAreSentAgain) {
+    rgb_matrix_config.mode = RGB_MATRIX_SOLID_COLOR;
+    rgb_matrix_config.hue = 85;
+    nacks = 5;
+    run(100);
+    EXPECT_EQ(nacks, 0);
+    EXPECT_EQ(g_pwm_buffer_dirty[0], 0);
+    EXPECT_EQ(g_pwm_buffer_dirty[1], 0);
+    expect_chips_match_buffers();
+    // and the LEDs are green
+    EXPECT_NE(chip_registers[0][0x24 + 48], 0);
+    EXPECT_EQ(chip_registers[0][0x24], 0);
+}
@@ -0,0 +1,29 @@
+# Copyright 2018 QMK
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+CUSTOM_MATRIX=yes
+
+# Same scenarios as tests/rgb_matrix, rendering a few LEDs per scan
+SRC += tests/rgb_matrix/test_rgb_matrix.cpp
+
+# The effects run on the host, the test stands in for the IS31FL3731 driver
+OPT_DEFS += -DRGB_MATRIX_ENABLE
+SRC += \
+	$(QUANTUM_DIR)/color.c \
+	$(QUANTUM_DIR)/rgb_matrix.c \
+	$(QUANTUM_DIR)/rgb_matrix_math.c
+CIE1931_CURVE = yes
+VPATH += $(DRIVER_PATH)/avr
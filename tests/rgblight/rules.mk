@@ -0,0 +1,25 @@
+# Copyright 2018 QMK
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+CUSTOM_MATRIX=yes
+
+# The animations run on the host, the test stands in for the WS2812 driver
+OPT_DEFS += -DRGBLIGHT_ENABLE
+SRC += \
+	$(QUANTUM_DIR)/color.c \
+	$(QUANTUM_DIR)/rgblight.c
+CIE1931_CURVE = yes
+VPATH += $(DRIVER_PATH)/avr
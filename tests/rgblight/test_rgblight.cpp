@@ -0,0 +1,163 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include <iostream>
+
+using testing::_;
+using testing::AnyNumber;
+
+extern "C" {
+    void advance_time(uint32_t ms);
+}
+
+// ws2812_sendarray_mask() keeps the interrupts disabled while it sends 24
+// bits at 800 kHz per LED
+static const unsigned led_us = 30;
+
+// The strip, the LEDs that don't get new data keep their color
+static LED_TYPE strip[RGBLED_NUM];
+static unsigned scan_us;
+static unsigned sends;
+static unsigned sent_leds;
+
+extern "C" {
+void ws2812_setleds(LED_TYPE *ledarray, uint16_t number_of_leds) {
+    ASSERT_LE(number_of_leds, RGBLED_NUM);
+    for (uint16_t i = 0; i < number_of_leds; i++) {
+        strip[i] = ledarray[i];
+    }
+    scan_us += number_of_leds * led_us;
+    sends++;
+    sent_leds += number_of_leds;
+    // what's left of the strip already shows the rest of the frame
+    for (uint8_t i = 0; i < RGBLED_NUM; i++) {
+        EXPECT_EQ(strip[i].r, led[i].r) << "LED " << (int)i;
+        EXPECT_EQ(strip[i].g, led[i].g) << "LED " << (int)i;
+        EXPECT_EQ(strip[i].b, led[i].b) << "LED " << (int)i;
+    }
+}
+}
+
+class Rgblight : public TestFixture {
+protected:
+    struct Result {
+        unsigned sends;
+        unsigned leds;
+        unsigned max_us;
+        unsigned total_us;
+    };
+
+    Rgblight() {
+        EXPECT_CALL(m_driver, send_keyboard_mock(_)).Times(AnyNumber());
+        rgblight_enable();
+        rgblight_sethsv(0, 255, 255);
+    }
+
+    // Scans once per ms
+    Result run(unsigned ms) {
+        Result result = {0, 0, 0, 0};
+        sends = 0;
+        sent_leds = 0;
+        for (unsigned t = 0; t < ms; t++) {
+            scan_us = 0;
+            keyboard_task();
+            rgblight_task();
+            advance_time(1);
+            result.max_us = std::max(result.max_us, scan_us);
+            result.total_us += scan_us;
+        }
+        result.sends = sends;
+        result.leds = sent_leds;
+        return result;
+    }
+
+    TestDriver m_driver;
+};
+
+TEST_F(Rgblight, ScanLoad) {
+    static const struct {
+        uint8_t mode;
+        const char* name;
+    } modes[] = {
+        {1, "static"},
+        {5, "breathing"},
+        {8, "rainbow mood"},
+        {14, "rainbow swirl"},
+        {20, "snake"},
+        {23, "knight"},
+        {24, "christmas"},
+        {25, "static gradient"},
+    };
+    for (auto& mode : modes) {
+        rgblight_mode(mode.mode);
+        run(100);
+        Result result = run(1000);
+        std::cout << "[ RGBLIGHT ] " << mode.name << ": " << result.sends << " frames sent/s, "
+            << (result.sends ? result.leds / result.sends : 0) << " of " << RGBLED_NUM
+            << " LEDs per frame, interrupts disabled " << result.total_us << " us/s, at most "
+            << result.max_us << " us per scan (" << RGBLED_NUM * led_us << " for the whole strip)" << std::endl;
+        EXPECT_LE(result.max_us, RGBLED_NUM * led_us);
+        EXPECT_LE(result.sends, RGBLIGHT_MAX_FPS + 1);
+    }
+}
+
+TEST_F(Rgblight, UnchangedFramesAreNotSent) {
+    rgblight_mode(1);
+    run(100);
+    Result result = run(1000);
+    EXPECT_EQ(result.sends, 0);
+    // green, the whole strip changes
+    sends = 0;
+    sent_leds = 0;
+    rgblight_sethsv(120, 255, 255);
+    EXPECT_EQ(sends, 1);
+    EXPECT_EQ(sent_leds, RGBLED_NUM);
+    EXPECT_EQ(strip[RGBLED_NUM - 1].r, 0);
+    EXPECT_GT(strip[RGBLED_NUM - 1].g, 0);
+}
+
+TEST_F(Rgblight, FrameRateIsLimited) {
+    // a new frame every 20 ms
+    rgblight_mode(14);
+    run(100);
+    Result result = run(1000);
+    EXPECT_GE(result.sends, RGBLIGHT_MAX_FPS - 2);
+    EXPECT_LE(result.sends, RGBLIGHT_MAX_FPS + 1);
+}
+
+TEST_F(Rgblight, UnchangedFramesDontDelayTheNextOne) {
+    rgblight_mode(1);
+    run(100);
+    sends = 0;
+    rgblight_set();
+    EXPECT_EQ(sends, 0);
+    rgblight_sethsv(120, 255, 255);
+    EXPECT_EQ(sends, 1);
+}
+
+TEST_F(Rgblight, DisablingTurnsTheStripOff) {
+    rgblight_mode(1);
+    run(100);
+    rgblight_disable();
+    run(100);
+    for (uint8_t i = 0; i < RGBLED_NUM; i++) {
+        EXPECT_EQ(strip[i].r, 0);
+        EXPECT_EQ(strip[i].g, 0);
+        EXPECT_EQ(strip[i].b, 0);
+    }
+}
@@ -0,0 +1,199 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include "action_tapping.h"
+#include <string>
+#include <vector>
+extern "C" {
+#include "split_events.h"
+#include "split_transport.h"
+#include "timer.h"
+}
+
+using testing::_;
+using testing::Invoke;
+
+// The slave's half starts at row 2
+static const uint8_t SLAVE_ROW = 2;
+
+class SplitEvents : public TestFixture {
+protected:
+    SplitEvents() {
+        split_events_init();
+        memset(m_slave_rows, 0, sizeof(m_slave_rows));
+        m_period = 10;
+        m_connected = true;
+        m_lose_answers = false;
+    }
+
+    // Records the reports as the keys in them, "S" first for shift
+    void record(TestDriver& driver) {
+        EXPECT_CALL(driver, send_keyboard_mock(_)).WillRepeatedly(Invoke([this](report_keyboard_t& report) {
+            std::string keys = report.mods & MOD_BIT(KC_LSFT) ? "S" : "";
+            for (size_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+                if (report.keys[i] >= KC_A && report.keys[i] <= KC_Z) {
+                    keys += 'A' + report.keys[i] - KC_A;
+                }
+            }
+            m_reports.push_back(keys);
+        }));
+    }
+
+    // One ms of both halves: the slave scans, they talk every m_period ms,
+    // then the master scans
+    void step() {
+        split_events_scan(m_slave_rows, SLAVE_ROW, 2);
+        if (m_connected && timer_read() % m_period == 0) {
+            uint8_t request[SPLIT_TRANSPORT_BUFFER_SIZE];
+            uint8_t answer[SPLIT_TRANSPORT_BUFFER_SIZE];
+            uint8_t data = 0;
+            uint8_t length = split_events_request(&data, 1, request);
+            length = split_events_answer(request, length, true, answer);
+            if (!m_lose_answers) {
+                split_events_receive(answer, length);
+            }
+        }
+        run_one_scan_loop();
+    }
+
+    void run(unsigned ms) {
+        for (unsigned i = 0; i < ms; i++) {
+            step();
+        }
+    }
+
+    // Until the next ms is the first one after an exchange
+    void align() {
+        while (timer_read() % m_period != 1) {
+            step();
+        }
+    }
+
+    void press_slave(uint8_t col) {
+        m_slave_rows[0] |= 1 << col;
+    }
+
+    void release_slave(uint8_t col) {
+        m_slave_rows[0] &= ~(1 << col);
+    }
+
+    matrix_row_t m_slave_rows[2];
+    unsigned m_period;
+    bool m_connected;
+    bool m_lose_answers;
+    std::vector<std::string> m_reports;
+};
+
+typedef std::vector<std::string> reports_t;
+
+TEST_F(SplitEvents, SlaveTapJustWithinTheTappingTerm) {
+    TestDriver driver;
+    record(driver);
+    press_slave(0);
+    run(TAPPING_TERM - 5);
+    release_slave(0);
+    // the master only hears of the release after the tapping term, when the
+    // rows would have made it a hold
+    run(TAPPING_TERM);
+    EXPECT_EQ(m_reports, reports_t({"Q", ""}));
+}
+
+TEST_F(SplitEvents, HalvesRunInTheOrderOfTheirEvents) {
+    TestDriver driver;
+    record(driver);
+    m_period = 20;
+    align();
+    press_slave(0);
+    run(100);
+    press_key(1, 0);
+    run(50);
+    // the master hears of it 9 ms later, after its own release of A
+    release_slave(0);
+    run(5);
+    release_key(1, 0);
+    run(50);
+    // a tap of each, Q released first; with permissive hold, A released
+    // first would have been Shift+A
+    EXPECT_EQ(m_reports, reports_t({"Q", "QA", "A", ""}));
+}
+
+TEST_F(SplitEvents, ChangesWithinAnExchangeAreKept) {
+    TestDriver driver;
+    record(driver);
+    align();
+    press_slave(1);
+    run(3);
+    release_slave(1);
+    run(20);
+    EXPECT_EQ(m_reports, reports_t({"B", ""}));
+}
+
+TEST_F(SplitEvents, DoubleTapWithinAnExchangeIsKept) {
+    TestDriver driver;
+    record(driver);
+    align();
+    press_slave(1);
+    run(2);
+    release_slave(1);
+    run(2);
+    press_slave(1);
+    run(2);
+    release_slave(1);
+    // all four events arrive in the same exchange
+    run(20);
+    EXPECT_EQ(m_reports, reports_t({"B", "", "B", ""}));
+}
+
+TEST_F(SplitEvents, LostAnswersAreSentAgain) {
+    TestDriver driver;
+    record(driver);
+    m_lose_answers = true;
+    press_slave(1);
+    run(15);
+    release_slave(1);
+    run(15);
+    EXPECT_EQ(m_reports, reports_t());
+    m_lose_answers = false;
+    run(SPLIT_EVENTS_TIMEOUT);
+    EXPECT_EQ(m_reports, reports_t({"B", ""}));
+}
+
+TEST_F(SplitEvents, MasterDoesNotWaitForAMissingSlave) {
+    TestDriver driver;
+    record(driver);
+    run(20);
+    m_connected = false;
+    press_key(1, 0);
+    run(SPLIT_EVENTS_TIMEOUT + 2);
+    EXPECT_EQ(m_reports, reports_t({"A"}));
+    release_key(1, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(m_reports, reports_t({"A", ""}));
+}
+
+TEST_F(SplitEvents, DisconnectReleasesTheSlaveKeys) {
+    TestDriver driver;
+    record(driver);
+    press_slave(1);
+    run(20);
+    EXPECT_EQ(m_reports, reports_t({"B"}));
+    m_connected = false;
+    split_events_disconnect();
+    run_one_scan_loop();
+    EXPECT_EQ(m_reports, reports_t({"B", ""}));
+    release_slave(1);
+}
@@ -0,0 +1,47 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "quantum.h"
+#include "action_tapping.h"
+
+// The tap keys of row 0 only differ by their tapping mode or term
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        // 0           1            2            3            4            5      6      7      8      9
+        {SFT_T(KC_P), SFT_T(KC_Q), SFT_T(KC_R), SFT_T(KC_S), SFT_T(KC_T), KC_A,  KC_B,  KC_NO, KC_NO, KC_NO},
+        {KC_NO,       KC_NO,       KC_NO,       KC_NO,       KC_NO,       KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,       KC_NO,       KC_NO,       KC_NO,       KC_NO,       KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+        {KC_NO,       KC_NO,       KC_NO,       KC_NO,       KC_NO,       KC_NO, KC_NO, KC_NO, KC_NO, KC_NO},
+    },
+};
+
+uint8_t get_tapping_mode(keyrecord_t *record) {
+    switch (record->event.key.col) {
+        case 1:
+            return TAPPING_HOLD_ON_OTHER_KEY_PRESS;
+        case 2:
+            return TAPPING_PERMISSIVE_HOLD;
+        case 3:
+            return TAPPING_RETRO_TAP;
+        default:
+            return TAPPING_DEFAULT_MODE;
+    }
+}
+
+uint16_t get_tapping_term(keyrecord_t *record) {
+    return record->event.key.col == 4 ? TAPPING_TERM / 2 : TAPPING_TERM;
+}
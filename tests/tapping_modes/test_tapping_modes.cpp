@@ -0,0 +1,191 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include "action_tapping.h"
+#include <algorithm>
+#include <iostream>
+
+using testing::_;
+using testing::AnyNumber;
+using testing::InSequence;
+using testing::Invoke;
+
+extern "C" {
+    uint32_t timer_read32(void);
+}
+
+// Every tap key of row 0 is SFT_T() of a letter, with the tapping mode or
+// term given by get_tapping_mode() and get_tapping_term() in keymap.c
+static const uint8_t default_key = 0;
+static const uint8_t hold_on_other_key_press_key = 1;
+static const uint8_t permissive_hold_key = 2;
+static const uint8_t retro_tap_key = 3;
+static const uint8_t short_term_key = 4;
+static const uint8_t a_key = 5;
+
+class TappingModes : public TestFixture {
+protected:
+    // Holds the tap key down past its tapping term and types A 10 ms after
+    // it for 20 ms. Returns how long A waited for its first report, the
+    // worst case of a key typed during TAPPING_TERM.
+    unsigned added_latency(uint8_t col) {
+        TestDriver driver;
+        bool reported = false;
+        uint32_t reported_at = 0;
+        EXPECT_CALL(driver, send_keyboard_mock(_))
+            .Times(AnyNumber())
+            .WillRepeatedly(Invoke([&](report_keyboard_t& report) {
+                if (!reported && std::find(std::begin(report.keys), std::end(report.keys), KC_A) != std::end(report.keys)) {
+                    reported = true;
+                    reported_at = timer_read32();
+                }
+            }));
+        press_key(col, 0);
+        run_one_scan_loop();
+        idle_for(9);
+        press_key(a_key, 0);
+        uint32_t pressed_at = timer_read32();
+        run_one_scan_loop();
+        idle_for(19);
+        release_key(a_key, 0);
+        idle_for(TAPPING_TERM + 20);
+        release_key(col, 0);
+        idle_for(TAPPING_TERM + 20);
+        EXPECT_TRUE(reported);
+        return reported_at - pressed_at;
+    }
+};
+
+TEST_F(TappingModes, AddedLatencyOfAKeyTypedDuringTappingTerm) {
+    static const struct {
+        uint8_t col;
+        const char* name;
+        unsigned latency;
+    } modes[] = {
+        {default_key, "default", TAPPING_TERM - 10},
+        {hold_on_other_key_press_key, "hold on other key press", 0},
+        {permissive_hold_key, "permissive hold", 20},
+        {retro_tap_key, "retro tap", TAPPING_TERM - 10},
+        {short_term_key, "half tapping term", TAPPING_TERM / 2 - 10},
+    };
+    for (const auto& mode : modes) {
+        unsigned latency = added_latency(mode.col);
+        std::cout << "[ TAPPING  ] " << mode.name << ": " << latency << " ms added latency" << std::endl;
+        EXPECT_EQ(latency, mode.latency) << mode.name;
+    }
+}
+
+TEST_F(TappingModes, HoldOnOtherKeyPressIsAHoldAtOnce) {
+    TestDriver driver;
+    press_key(hold_on_other_key_press_key, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    press_key(a_key, 0);
+    {
+        InSequence s;
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_A)));
+    }
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    clear_all_keys();
+    idle_for(10);
+}
+
+TEST_F(TappingModes, HoldOnOtherKeyPressStillTaps) {
+    TestDriver driver;
+    press_key(hold_on_other_key_press_key, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(hold_on_other_key_press_key, 0);
+    {
+        InSequence s;
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_Q)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    }
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(TAPPING_TERM + 1);
+}
+
+TEST_F(TappingModes, PermissiveHoldWaitsForTheOtherKeyRelease) {
+    TestDriver driver;
+    press_key(permissive_hold_key, 0);
+    run_one_scan_loop();
+    press_key(a_key, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(10);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(a_key, 0);
+    {
+        InSequence s;
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT, KC_A)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    }
+    run_one_scan_loop();
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+    clear_all_keys();
+    idle_for(10);
+}
+
+TEST_F(TappingModes, RetroTapAfterTappingTerm) {
+    TestDriver driver;
+    press_key(retro_tap_key, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    idle_for(TAPPING_TERM + 10);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(retro_tap_key, 0);
+    {
+        InSequence s;
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_S)));
+        EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    }
+    run_one_scan_loop();
+}
+
+TEST_F(TappingModes, NoRetroTapForTheOtherKeys) {
+    TestDriver driver;
+    press_key(default_key, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    idle_for(TAPPING_TERM + 10);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(default_key, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
+
+TEST_F(TappingModes, PerKeyTappingTerm) {
+    TestDriver driver;
+    press_key(short_term_key, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(_)).Times(0);
+    idle_for(TAPPING_TERM / 2 - 1);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(KC_LSFT)));
+    idle_for(2);
+    testing::Mock::VerifyAndClearExpectations(&driver);
+    release_key(short_term_key, 0);
+    EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+    run_one_scan_loop();
+}
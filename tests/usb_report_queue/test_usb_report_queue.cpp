@@ -0,0 +1,304 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "test_common.hpp"
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+extern "C" {
+#include "report_queue.h"
+    uint32_t timer_read32(void);
+    void advance_time(uint32_t ms);
+}
+
+// The keyboard IN endpoint of the ChibiOS driver, polled by the host every
+// `interval` ms. The blocking one is the previous send_keyboard(), which
+// waited for the report in flight to be polled before starting the next.
+class MockEndpoint {
+public:
+    MockEndpoint(bool blocking, uint32_t interval)
+        : m_driver{&MockEndpoint::keyboard_leds, &MockEndpoint::send_keyboard,
+            &MockEndpoint::send_mouse, &MockEndpoint::send_system, &MockEndpoint::send_consumer},
+          m_queue(REPORT_QUEUE_INIT(m_reports, superseded)),
+          m_blocking(blocking), m_interval(interval),
+          m_next_poll(timer_read32() + interval), m_in_flight(nullptr),
+          stall(0), max_stall(0) {
+        host_set_driver(&m_driver);
+        m_this = this;
+    }
+
+    ~MockEndpoint() {
+        m_this = nullptr;
+    }
+
+    // Runs the host polls that are due
+    void poll() {
+        while (TIMER_DIFF_32(timer_read32(), m_next_poll) < 0x80000000UL) {
+            if (m_in_flight) {
+                received.push_back({m_next_poll, *m_in_flight});
+                m_in_flight = m_blocking ? nullptr : (const report_keyboard_t *)report_queue_sent(&m_queue);
+            }
+            m_next_poll += m_interval;
+        }
+    }
+
+    bool idle() const {
+        return !m_in_flight;
+    }
+
+    struct Received {
+        uint32_t time;
+        report_keyboard_t report;
+    };
+    std::vector<Received> received;
+    uint32_t stall;
+    uint32_t max_stall;
+
+private:
+    static bool superseded(const void *previous, const void *pending, const void *report) {
+        return is_report_superseded((const report_keyboard_t *)pending,
+            (const report_keyboard_t *)previous, (const report_keyboard_t *)report);
+    }
+
+    static uint8_t keyboard_leds(void) { return 0; }
+    static void send_mouse(report_mouse_t *) {}
+    static void send_system(uint16_t) {}
+    static void send_consumer(uint16_t) {}
+
+    static void send_keyboard(report_keyboard_t *report) {
+        MockEndpoint *self = m_this;
+        if (!self->m_blocking) {
+            const void *next = report_queue_push(&self->m_queue, report);
+            if (next) {
+                self->m_in_flight = (const report_keyboard_t *)next;
+            }
+            return;
+        }
+        if (self->m_in_flight) {
+            // suspended until the host polls
+            uint32_t wait = self->m_next_poll - timer_read32();
+            advance_time(wait);
+            self->stall += wait;
+            self->max_stall = std::max(self->max_stall, wait);
+            self->poll();
+        }
+        self->m_sent = *report;
+        self->m_in_flight = &self->m_sent;
+    }
+
+    host_driver_t m_driver;
+    report_keyboard_t m_reports[4];
+    report_queue_t m_queue;
+    report_keyboard_t m_sent;
+    bool m_blocking;
+    uint32_t m_interval;
+    uint32_t m_next_poll;
+    const report_keyboard_t *m_in_flight;
+    static MockEndpoint *m_this;
+};
+
+MockEndpoint *MockEndpoint::m_this = nullptr;
+
+class UsbReportQueue : public TestFixture {
+protected:
+    struct Edge {
+        uint32_t time;
+        uint8_t col;
+        bool pressed;
+    };
+
+    struct Result {
+        unsigned reports;
+        uint32_t stall;
+        uint32_t max_stall;
+        unsigned missed;
+        double avg_latency;
+        uint32_t max_latency;
+    };
+
+    // Fast rolls on row 0: a press every 4 to 15 ms, held for 20 to 100 ms
+    static std::vector<Edge> burst(unsigned seed, unsigned presses) {
+        std::mt19937 rng(seed);
+        std::vector<Edge> edges;
+        std::map<uint8_t, uint32_t> released;
+        uint32_t time = 10;
+        for (unsigned i = 0; i < presses; i++) {
+            time += 4 + rng() % 12;
+            // at most 4 keys held, well within the 6KRO report
+            std::vector<uint8_t> free;
+            unsigned held = 0;
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                if (released[col] + 5 <= time) {
+                    free.push_back(col);
+                } else if (released[col] > time) {
+                    held++;
+                }
+            }
+            if (held >= 4 || free.empty()) {
+                i--;
+                continue;
+            }
+            uint8_t col = free[rng() % free.size()];
+            uint32_t release = time + 20 + rng() % 81;
+            edges.push_back({time, col, true});
+            edges.push_back({release, col, false});
+            released[col] = release;
+        }
+        std::stable_sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) {
+            return a.time < b.time;
+        });
+        return edges;
+    }
+
+    static uint8_t keycode(uint8_t col) {
+        return KC_A + col;
+    }
+
+    static std::vector<Edge> host_edges(const std::vector<MockEndpoint::Received> &received) {
+        std::vector<Edge> edges;
+        report_keyboard_t previous = {};
+        for (const auto &r : received) {
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                bool before = false, now = false;
+                for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+                    before |= previous.keys[i] == keycode(col);
+                    now |= r.report.keys[i] == keycode(col);
+                }
+                if (before != now) {
+                    edges.push_back({r.time, col, now});
+                }
+            }
+            previous = r.report;
+        }
+        return edges;
+    }
+
+    Result type(const char *name, bool blocking, const std::vector<Edge> &typed) {
+        MockEndpoint endpoint(blocking, 10);
+        const uint32_t start = timer_read32();
+        size_t next = 0;
+        while (next < typed.size() || !endpoint.idle()) {
+            uint32_t now = timer_read32() - start;
+            // the edges that happened while the scan loop was stalled show up together
+            for (; next < typed.size() && typed[next].time <= now; next++) {
+                if (typed[next].pressed) {
+                    press_key(typed[next].col, 0);
+                } else {
+                    release_key(typed[next].col, 0);
+                }
+            }
+            endpoint.poll();
+            keyboard_task();
+            advance_time(1);
+        }
+
+        // match every typed edge with the next one of the same key the host saw
+        Result result = {(unsigned)endpoint.received.size(), endpoint.stall, endpoint.max_stall, 0, 0.0, 0};
+        std::vector<Edge> seen = host_edges(endpoint.received);
+        std::map<uint8_t, size_t> matched;
+        uint64_t total = 0;
+        for (const Edge &want : typed) {
+            size_t i = matched[want.col];
+            for (; i < seen.size(); i++) {
+                if (seen[i].col == want.col && seen[i].pressed == want.pressed && seen[i].time - start >= want.time) {
+                    break;
+                }
+            }
+            if (i == seen.size()) {
+                result.missed++;
+                continue;
+            }
+            uint32_t latency = seen[i].time - start - want.time;
+            total += latency;
+            result.max_latency = std::max(result.max_latency, latency);
+            matched[want.col] = i + 1;
+        }
+        if (typed.size() > result.missed) {
+            result.avg_latency = (double)total / (typed.size() - result.missed);
+        }
+        std::cout << "[ USB      ] " << name << ": " << result.reports << " reports, scan loop stalled "
+            << result.stall << " ms (max " << result.max_stall << " ms), missed edges "
+            << result.missed << ", key to host avg "
+            << result.avg_latency << " ms, max " << result.max_latency << " ms" << std::endl;
+        return result;
+    }
+};
+
+TEST_F(UsbReportQueue, BurstTypingDoesntStallTheScanLoop) {
+    for (unsigned seed = 1; seed <= 3; seed++) {
+        std::vector<Edge> typed = burst(seed, 40);
+        Result blocking = type("blocking", true, typed);
+        Result queued = type("queued", false, typed);
+        // every report waited for the host, the keys got processed late
+        // and the quick ones could be gone by the time they were scanned
+        EXPECT_GT(blocking.stall, 0);
+        EXPECT_EQ(queued.stall, 0);
+        EXPECT_EQ(queued.missed, 0);
+        EXPECT_LE(queued.missed, blocking.missed);
+        // a report waits for at most the one in flight and its own poll
+        EXPECT_LE(queued.max_latency, 2 * 10 + 1);
+        EXPECT_LE(queued.max_latency, blocking.max_latency);
+    }
+}
+
+TEST_F(UsbReportQueue, TapIsntMergedAway) {
+    report_keyboard_t reports[4];
+    report_queue_t queue = REPORT_QUEUE_INIT(reports, nullptr);
+    queue.merge = [](const void *previous, const void *pending, const void *report) {
+        return is_report_superseded((const report_keyboard_t *)pending,
+            (const report_keyboard_t *)previous, (const report_keyboard_t *)report);
+    };
+    report_keyboard_t empty = {}, a = {}, ab = {};
+    a.keys[0] = KC_A;
+    ab.keys[0] = KC_A;
+    ab.keys[1] = KC_B;
+
+    EXPECT_EQ(report_queue_push(&queue, &empty), &reports[0]);
+    EXPECT_EQ(report_queue_push(&queue, &a), nullptr);
+    // A released again before the press got out
+    EXPECT_EQ(report_queue_push(&queue, &empty), nullptr);
+    EXPECT_EQ(report_queue_length(&queue), 3);
+    EXPECT_EQ(queue.merged, 0);
+
+    // A pressed again, then B while that's still queued: A+B replaces A
+    EXPECT_EQ(report_queue_push(&queue, &a), nullptr);
+    EXPECT_EQ(report_queue_push(&queue, &ab), nullptr);
+    EXPECT_EQ(report_queue_length(&queue), 4);
+    EXPECT_EQ(queue.merged, 1);
+
+    EXPECT_EQ(report_queue_sent(&queue), &reports[1]);
+    EXPECT_EQ(report_queue_sent(&queue), &reports[2]);
+    EXPECT_EQ(report_queue_sent(&queue), &reports[3]);
+    EXPECT_EQ(memcmp(&reports[3], &ab, sizeof(ab)), 0);
+    EXPECT_EQ(report_queue_sent(&queue), nullptr);
+    EXPECT_FALSE(report_queue_busy(&queue));
+}
+
+TEST_F(UsbReportQueue, FullQueueKeepsTheNewestReport) {
+    uint8_t reports[4][1];
+    report_queue_t queue = REPORT_QUEUE_INIT(reports, nullptr);
+    for (uint8_t i = 0; i < 6; i++) {
+        report_queue_push(&queue, &i);
+    }
+    EXPECT_EQ(queue.overflows, 2);
+    EXPECT_EQ(*(const uint8_t *)report_queue_sent(&queue), 1);
+    EXPECT_EQ(*(const uint8_t *)report_queue_sent(&queue), 2);
+    EXPECT_EQ(*(const uint8_t *)report_queue_sent(&queue), 5);
+    EXPECT_EQ(report_queue_sent(&queue), nullptr);
+}
@@ -11,6 +11,7 @@ TMK_COMMON_SRC +=	$(COMMON_DIR)/host.c \
 	$(COMMON_DIR)/keyboard.c \
 	$(COMMON_DIR)/action.c \
 	$(COMMON_DIR)/action_tapping.c \
+	$(COMMON_DIR)/event_queue.c \
 	$(COMMON_DIR)/action_macro.c \
 	$(COMMON_DIR)/action_layer.c \
 	$(COMMON_DIR)/action_util.c \
@@ -19,6 +20,7 @@ TMK_COMMON_SRC +=	$(COMMON_DIR)/host.c \
 	$(COMMON_DIR)/util.c \
 	$(COMMON_DIR)/eeconfig.c \
 	$(COMMON_DIR)/report.c \
+	$(COMMON_DIR)/report_queue.c \
 	$(PLATFORM_COMMON_DIR)/suspend.c \
 	$(PLATFORM_COMMON_DIR)/timer.c \
 	$(PLATFORM_COMMON_DIR)/bootloader.c \
@@ -30,6 +32,9 @@ endif
 ifeq ($(PLATFORM),CHIBIOS)
 	TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/printf.c
 	TMK_COMMON_SRC += $(PLATFORM_COMMON_DIR)/eeprom.c
+  ifeq ($(strip $(MCU_SERIES)), KL2x)
+    TMK_COMMON_SRC += $(COMMON_DIR)/eeprom_log.c
+  endif
   ifeq ($(strip $(AUTO_SHIFT_ENABLE)), yes)
     TMK_COMMON_SRC += $(CHIBIOS)/os/various/syscalls.c
   endif
@@ -71,6 +76,11 @@ else
     TMK_COMMON_DEFS += -DNO_DEBUG
 endif
 
+ifeq ($(strip $(INSTRUMENT_ENABLE)), yes)
+    TMK_COMMON_SRC += $(COMMON_DIR)/instrument.c
+    TMK_COMMON_DEFS += -DINSTRUMENT_ENABLE
+endif
+
 ifeq ($(strip $(COMMAND_ENABLE)), yes)
     TMK_COMMON_SRC += $(COMMON_DIR)/command.c
     TMK_COMMON_DEFS += -DCOMMAND_ENABLE
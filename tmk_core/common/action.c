@@ -36,7 +36,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 int tp_buttons;
 
-#ifdef RETRO_TAPPING
+#if defined(RETRO_TAPPING) || defined(TAPPING_MODE_PER_KEY)
 int retro_tapping_counter = 0;
 #endif
 
@@ -53,7 +53,7 @@ void action_exec(keyevent_t event)
     if (!IS_NOEVENT(event)) {
         dprint("\n---- action_exec: start -----\n");
         dprint("EVENT: "); debug_event(event); dprintln();
-#ifdef RETRO_TAPPING
+#if defined(RETRO_TAPPING) || defined(TAPPING_MODE_PER_KEY)
         retro_tapping_counter++;
 #endif
     }
@@ -652,7 +652,7 @@ void process_action(keyrecord_t *record, action_t action)
 #endif
 
 #ifndef NO_ACTION_TAPPING
-  #ifdef RETRO_TAPPING
+  #if defined(RETRO_TAPPING) || defined(TAPPING_MODE_PER_KEY)
   if (!is_tap_key(record->event.key)) {
     retro_tapping_counter = 0;
   } else {
@@ -666,7 +666,11 @@ void process_action(keyrecord_t *record, action_t action)
       if (tap_count > 0) {
         retro_tapping_counter = 0;
       } else {
+  #ifdef TAPPING_MODE_PER_KEY
+        if (retro_tapping_counter == 2 && (get_tapping_mode(record) & TAPPING_RETRO_TAP)) {
+  #else
         if (retro_tapping_counter == 2) {
+  #endif
           register_code(action.layer_tap.code);
           unregister_code(action.layer_tap.code);
         }
@@ -34,6 +34,7 @@ static void default_layer_state_set(uint32_t state)
     debug("default_layer_state: ");
     default_layer_debug(); debug(" to ");
     default_layer_state = state;
+    layer_cache_invalidate();
     default_layer_debug(); debug("\n");
     clear_keyboard_but_mods(); // To avoid stuck keys
 }
@@ -117,6 +118,7 @@ void layer_state_set(uint32_t state)
     dprint("layer_state: ");
     layer_debug(); dprint(" to ");
     layer_state = state;
+    layer_cache_invalidate();
     layer_debug(); dprintln();
     clear_keyboard_but_mods(); // To avoid stuck keys
 }
@@ -284,30 +286,91 @@ action_t store_or_get_action(bool pressed, keypos_t key)
 }
 
 
-/** \brief Layer switch get layer
+#ifdef LAYER_CACHE_ENABLE
+/* Resolved layer (and action) for every matrix position. Rows are rebuilt
+ * lazily on the first lookup after the layer state changed.
+ */
+static uint8_t layer_cache_layers[MATRIX_ROWS][MATRIX_COLS];
+#ifdef LAYER_CACHE_ACTIONS
+static action_t layer_cache_actions[MATRIX_ROWS][MATRIX_COLS];
+#endif
+static uint8_t layer_cache_valid_rows[(MATRIX_ROWS + 7) / 8] = {0};
+
+/** \brief Layer cache invalidate
  *
- * FIXME: Needs docs
+ * Must be called whenever the result of action_for_key() may have changed,
+ * layer state changes take care of it themselves.
  */
-int8_t layer_switch_get_layer(keypos_t key)
+void layer_cache_invalidate(void)
 {
-#ifndef NO_ACTION_LAYER
-    action_t action;
-    action.code = ACTION_TRANSPARENT;
+    for (uint8_t i = 0; i < sizeof(layer_cache_valid_rows); i++) {
+        layer_cache_valid_rows[i] = 0;
+    }
+}
+#endif
 
+/** \brief Layer switch resolve
+ *
+ * Walks the active layers from the top and returns the first one where key
+ * isn't transparent, along with its action.
+ */
+static int8_t layer_switch_resolve(keypos_t key, action_t *action)
+{
+#ifndef NO_ACTION_LAYER
     uint32_t layers = layer_state | default_layer_state;
     /* check top layer first */
     for (int8_t i = 31; i >= 0; i--) {
         if (layers & (1UL<<i)) {
-            action = action_for_key(i, key);
-            if (action.code != ACTION_TRANSPARENT) {
+            *action = action_for_key(i, key);
+            if (action->code != ACTION_TRANSPARENT) {
                 return i;
             }
         }
     }
     /* fall back to layer 0 */
+    *action = action_for_key(0, key);
     return 0;
 #else
-    return biton32(default_layer_state);
+    int8_t layer = biton32(default_layer_state);
+    *action = action_for_key(layer, key);
+    return layer;
+#endif
+}
+
+#ifdef LAYER_CACHE_ENABLE
+/** \brief Layer cache fill row
+ *
+ * Makes sure the cache entries of the row of key are up to date.
+ */
+static void layer_cache_fill_row(keypos_t key)
+{
+    const uint8_t row = key.row;
+    if (layer_cache_valid_rows[row / 8] & (1U << (row % 8))) {
+        return;
+    }
+    for (key.col = 0; key.col < MATRIX_COLS; key.col++) {
+        action_t action;
+        layer_cache_layers[row][key.col] = layer_switch_resolve(key, &action);
+#ifdef LAYER_CACHE_ACTIONS
+        layer_cache_actions[row][key.col] = action;
+#endif
+    }
+    layer_cache_valid_rows[row / 8] |= (1U << (row % 8));
+}
+#endif
+
+/** \brief Layer switch get layer
+ *
+ * FIXME: Needs docs
+ */
+int8_t layer_switch_get_layer(keypos_t key)
+{
+#ifdef LAYER_CACHE_ENABLE
+    layer_cache_fill_row(key);
+    return layer_cache_layers[key.row][key.col];
+#else
+    action_t action;
+    return layer_switch_resolve(key, &action);
 #endif
 }
 
@@ -317,5 +380,14 @@ int8_t layer_switch_get_layer(keypos_t key)
  */
 action_t layer_switch_get_action(keypos_t key)
 {
+#if defined(LAYER_CACHE_ENABLE) && defined(LAYER_CACHE_ACTIONS)
+    layer_cache_fill_row(key);
+    return layer_cache_actions[key.row][key.col];
+#elif defined(LAYER_CACHE_ENABLE)
     return action_for_key(layer_switch_get_layer(key), key);
+#else
+    action_t action;
+    layer_switch_resolve(key, &action);
+    return action;
+#endif
 }
@@ -87,6 +87,14 @@ __attribute__((weak))
 uint32_t layer_state_set_kb(uint32_t state);
 #endif
 
+/* resolved layer/action cache, see docs/config_options.md */
+#if !defined(NO_ACTION_LAYER) && (defined(LAYER_CACHE_ACTIONS) || defined(LAYER_CACHE_LAYERS))
+#define LAYER_CACHE_ENABLE
+void layer_cache_invalidate(void);
+#else
+#define layer_cache_invalidate()
+#endif
+
 /* pressed actions cache */
 #if !defined(NO_ACTION_LAYER) && defined(PREVENT_STUCK_MODIFIERS)
 /* The number of bits needed to represent the layer number: log2(32). */
@@ -3,6 +3,7 @@
 #include "action.h"
 #include "action_layer.h"
 #include "action_tapping.h"
+#include "event_queue.h"
 #include "keycode.h"
 #include "timer.h"
 
@@ -18,13 +19,20 @@
 #define IS_TAPPING_PRESSED()    (IS_TAPPING() && tapping_key.event.pressed)
 #define IS_TAPPING_RELEASED()   (IS_TAPPING() && !tapping_key.event.pressed)
 #define IS_TAPPING_KEY(k)       (IS_TAPPING() && KEYEQ(tapping_key.event.key, (k)))
-#define WITHIN_TAPPING_TERM(e)  (TIMER_DIFF_16(e.time, tapping_key.event.time) < TAPPING_TERM)
+#define WITHIN_TAPPING_TERM(e)  (TIMER_DIFF_16(e.time, tapping_key.event.time) < tapping_term)
 
 
 static keyrecord_t tapping_key = {};
-static keyrecord_t waiting_buffer[WAITING_BUFFER_SIZE] = {};
-static uint8_t waiting_buffer_head = 0;
-static uint8_t waiting_buffer_tail = 0;
+#ifdef TAPPING_MODE_PER_KEY
+/* of the current tapping key, settled when it's pressed */
+static uint16_t tapping_term = TAPPING_TERM;
+static uint8_t tapping_mode = TAPPING_DEFAULT_MODE;
+#else
+#   define tapping_term TAPPING_TERM
+#   define tapping_mode TAPPING_DEFAULT_MODE
+#endif
+static keyrecord_t waiting_records[WAITING_BUFFER_SIZE] = {};
+static event_queue_t waiting_buffer = EVENT_QUEUE_INIT(waiting_records);
 
 static bool process_tapping(keyrecord_t *record);
 static bool waiting_buffer_enq(keyrecord_t record);
@@ -36,6 +44,34 @@ static void debug_tapping_key(void);
 static void debug_waiting_buffer(void);
 
 
+#ifdef TAPPING_MODE_PER_KEY
+__attribute__ ((weak))
+uint16_t get_tapping_term(keyrecord_t *record)
+{
+    return TAPPING_TERM;
+}
+
+__attribute__ ((weak))
+uint8_t get_tapping_mode(keyrecord_t *record)
+{
+    return TAPPING_DEFAULT_MODE;
+}
+#endif
+
+/** \brief Start tapping with a new tap key
+ *
+ * Its term and mode are looked up once here, not for every event it waits for.
+ */
+static void tapping_key_start(keyrecord_t *keyp)
+{
+    tapping_key = *keyp;
+#ifdef TAPPING_MODE_PER_KEY
+    tapping_term = get_tapping_term(&tapping_key);
+    tapping_mode = get_tapping_mode(&tapping_key);
+#endif
+}
+
+
 /** \brief Action Tapping Process
  *
  * FIXME: Needs doc
@@ -49,7 +85,7 @@ void action_tapping_process(keyrecord_t record)
     } else {
         if (!waiting_buffer_enq(record)) {
             // clear all in case of overflow.
-            debug("OVERFLOW: CLEAR ALL STATES\n");
+            dprintf("OVERFLOW(%u): CLEAR ALL STATES\n", event_queue_overflows(&waiting_buffer));
             clear_keyboard();
             waiting_buffer_clear();
             tapping_key = (keyrecord_t){};
@@ -57,13 +93,13 @@ void action_tapping_process(keyrecord_t record)
     }
 
     // process waiting_buffer
-    if (!IS_NOEVENT(record.event) && waiting_buffer_head != waiting_buffer_tail) {
+    if (!IS_NOEVENT(record.event) && event_queue_length(&waiting_buffer)) {
         debug("---- action_exec: process waiting_buffer -----\n");
     }
-    for (; waiting_buffer_tail != waiting_buffer_head; waiting_buffer_tail = (waiting_buffer_tail + 1) % WAITING_BUFFER_SIZE) {
-        if (process_tapping(&waiting_buffer[waiting_buffer_tail])) {
-            debug("processed: waiting_buffer["); debug_dec(waiting_buffer_tail); debug("] = ");
-            debug_record(waiting_buffer[waiting_buffer_tail]); debug("\n\n");
+    for (keyrecord_t *waiting; (waiting = event_queue_peek(&waiting_buffer)); event_queue_pop(&waiting_buffer)) {
+        if (process_tapping(waiting)) {
+            debug("processed: waiting_buffer = ");
+            debug_record(*waiting); debug("\n\n");
         } else {
             break;
         }
@@ -74,6 +110,12 @@ void action_tapping_process(keyrecord_t record)
 }
 
 
+uint16_t action_tapping_overflows(void)
+{
+    return event_queue_overflows(&waiting_buffer);
+}
+
+
 /** \brief Tapping
  *
  * Rule: Tap key is typed(pressed and released) within TAPPING_TERM.
@@ -100,12 +142,23 @@ bool process_tapping(keyrecord_t *keyp)
                     // enqueue
                     return false;
                 }
-#if TAPPING_TERM >= 500 || defined PERMISSIVE_HOLD
+                /* Process a key pressed within TAPPING_TERM as a hold
+                 * The other key doesn't wait at all, but a fast roll
+                 * over from the tap key turns it into a hold.
+                 */
+                else if ((tapping_mode & TAPPING_HOLD_ON_OTHER_KEY_PRESS) && IS_PRESSED(event)) {
+                    debug("Tapping: End. No tap. Interfered by pressing key\n");
+                    process_record(&tapping_key);
+                    tapping_key = (keyrecord_t){};
+                    debug_tapping_key();
+                    // enqueue
+                    return false;
+                }
                 /* Process a key typed within TAPPING_TERM
                  * This can register the key before settlement of tapping,
                  * useful for long TAPPING_TERM but may prevent fast typing.
                  */
-                else if (IS_RELEASED(event) && waiting_buffer_typed(event)) {
+                else if ((tapping_mode & TAPPING_PERMISSIVE_HOLD) && IS_RELEASED(event) && waiting_buffer_typed(event)) {
                     debug("Tapping: End. No tap. Interfered by typing key\n");
                     process_record(&tapping_key);
                     tapping_key = (keyrecord_t){};
@@ -113,7 +166,6 @@ bool process_tapping(keyrecord_t *keyp)
                     // enqueue
                     return false;
                 }
-#endif
                 /* Process release event of a key pressed before tapping starts
                  * Without this unexpected repeating will occur with having fast repeating setting
                  * https://github.com/tmk/tmk_keyboard/issues/60
@@ -170,7 +222,7 @@ bool process_tapping(keyrecord_t *keyp)
                     } else {
                         debug("Tapping: Start while last tap(1).\n");
                     }
-                    tapping_key = *keyp;
+                    tapping_key_start(keyp);
                     waiting_buffer_scan_tap();
                     debug_tapping_key();
                     return true;
@@ -214,7 +266,7 @@ bool process_tapping(keyrecord_t *keyp)
                     } else {
                         debug("Tapping: Start while last timeout tap(1).\n");
                     }
-                    tapping_key = *keyp;
+                    tapping_key_start(keyp);
                     waiting_buffer_scan_tap();
                     debug_tapping_key();
                     return true;
@@ -250,7 +302,7 @@ bool process_tapping(keyrecord_t *keyp)
                 } else if (is_tap_key(event.key)) {
                     // Sequential tap can be interfered with other tap key.
                     debug("Tapping: Start with interfering other tap.\n");
-                    tapping_key = *keyp;
+                    tapping_key_start(keyp);
                     waiting_buffer_scan_tap();
                     debug_tapping_key();
                     return true;
@@ -280,7 +332,7 @@ bool process_tapping(keyrecord_t *keyp)
     else {
         if (event.pressed && is_tap_key(event.key)) {
             debug("Tapping: Start(Press tap key).\n");
-            tapping_key = *keyp;
+            tapping_key_start(keyp);
             process_record_tap_hint(&tapping_key);
             waiting_buffer_scan_tap();
             debug_tapping_key();
@@ -303,14 +355,11 @@ bool waiting_buffer_enq(keyrecord_t record)
         return true;
     }
 
-    if ((waiting_buffer_head + 1) % WAITING_BUFFER_SIZE == waiting_buffer_tail) {
+    if (!event_queue_push(&waiting_buffer, record)) {
         debug("waiting_buffer_enq: Over flow.\n");
         return false;
     }
 
-    waiting_buffer[waiting_buffer_head] = record;
-    waiting_buffer_head = (waiting_buffer_head + 1) % WAITING_BUFFER_SIZE;
-
     debug("waiting_buffer_enq: "); debug_waiting_buffer();
     return true;
 }
@@ -321,8 +370,7 @@ bool waiting_buffer_enq(keyrecord_t record)
  */
 void waiting_buffer_clear(void)
 {
-    waiting_buffer_head = 0;
-    waiting_buffer_tail = 0;
+    event_queue_clear(&waiting_buffer);
 }
 
 /** \brief Waiting buffer typed
@@ -331,8 +379,9 @@ void waiting_buffer_clear(void)
  */
 bool waiting_buffer_typed(keyevent_t event)
 {
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (KEYEQ(event.key, waiting_buffer[i].event.key) && event.pressed !=  waiting_buffer[i].event.pressed) {
+    for (uint8_t i = 0; i < event_queue_length(&waiting_buffer); i++) {
+        keyrecord_t *waiting = event_queue_at(&waiting_buffer, i);
+        if (KEYEQ(event.key, waiting->event.key) && event.pressed != waiting->event.pressed) {
             return true;
         }
     }
@@ -346,10 +395,7 @@ bool waiting_buffer_typed(keyevent_t event)
 __attribute__((unused))
 bool waiting_buffer_has_anykey_pressed(void)
 {
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (waiting_buffer[i].event.pressed) return true;
-    }
-    return false;
+    return event_queue_has_pressed(&waiting_buffer);
 }
 
 /** \brief Scan buffer for tapping
@@ -363,12 +409,13 @@ void waiting_buffer_scan_tap(void)
     // invalid state: tapping_key released && tap.count == 0
     if (!tapping_key.event.pressed) return;
 
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        if (IS_TAPPING_KEY(waiting_buffer[i].event.key) &&
-                !waiting_buffer[i].event.pressed &&
-                WITHIN_TAPPING_TERM(waiting_buffer[i].event)) {
+    for (uint8_t i = 0; i < event_queue_length(&waiting_buffer); i++) {
+        keyrecord_t *waiting = event_queue_at(&waiting_buffer, i);
+        if (IS_TAPPING_KEY(waiting->event.key) &&
+                !waiting->event.pressed &&
+                WITHIN_TAPPING_TERM(waiting->event)) {
             tapping_key.tap.count = 1;
-            waiting_buffer[i].tap.count = 1;
+            waiting->tap.count = 1;
             process_record(&tapping_key);
 
             debug("waiting_buffer_scan_tap: found at ["); debug_dec(i); debug("]\n");
@@ -395,8 +442,8 @@ static void debug_tapping_key(void)
 static void debug_waiting_buffer(void)
 {
     debug("{ ");
-    for (uint8_t i = waiting_buffer_tail; i != waiting_buffer_head; i = (i + 1) % WAITING_BUFFER_SIZE) {
-        debug("["); debug_dec(i); debug("]="); debug_record(waiting_buffer[i]); debug(" ");
+    for (uint8_t i = 0; i < event_queue_length(&waiting_buffer); i++) {
+        debug("["); debug_dec(i); debug("]="); debug_record(*event_queue_at(&waiting_buffer, i)); debug(" ");
     }
     debug("}\n");
 }
@@ -31,11 +31,50 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define TAPPING_TOGGLE  5
 #endif
 
+/* a power of two */
 #define WAITING_BUFFER_SIZE 8
 
+/* How a tap key is told apart from a hold, the flags can be combined:
+ *  - HOLD_ON_OTHER_KEY_PRESS: a hold as soon as another key is pressed
+ *  - PERMISSIVE_HOLD: a hold when another key is typed while it's down
+ *  - RETRO_TAP: a tap when released after TAPPING_TERM with nothing in between
+ */
+#define TAPPING_HOLD_ON_OTHER_KEY_PRESS (1 << 0)
+#define TAPPING_PERMISSIVE_HOLD         (1 << 1)
+#define TAPPING_RETRO_TAP               (1 << 2)
+
+/* The mode of every tap key, or of the ones get_tapping_mode() doesn't change */
+#ifdef HOLD_ON_OTHER_KEY_PRESS
+#   define TAPPING_DEFAULT_HOLD_ON_OTHER_KEY_PRESS TAPPING_HOLD_ON_OTHER_KEY_PRESS
+#else
+#   define TAPPING_DEFAULT_HOLD_ON_OTHER_KEY_PRESS 0
+#endif
+#if TAPPING_TERM >= 500 || defined PERMISSIVE_HOLD
+#   define TAPPING_DEFAULT_PERMISSIVE_HOLD TAPPING_PERMISSIVE_HOLD
+#else
+#   define TAPPING_DEFAULT_PERMISSIVE_HOLD 0
+#endif
+#ifdef RETRO_TAPPING
+#   define TAPPING_DEFAULT_RETRO_TAP TAPPING_RETRO_TAP
+#else
+#   define TAPPING_DEFAULT_RETRO_TAP 0
+#endif
+#define TAPPING_DEFAULT_MODE (TAPPING_DEFAULT_HOLD_ON_OTHER_KEY_PRESS | \
+                              TAPPING_DEFAULT_PERMISSIVE_HOLD | \
+                              TAPPING_DEFAULT_RETRO_TAP)
+
 
 #ifndef NO_ACTION_TAPPING
 void action_tapping_process(keyrecord_t record);
+/* How many times the waiting events were lost for lack of room */
+uint16_t action_tapping_overflows(void);
+
+#ifdef TAPPING_MODE_PER_KEY
+/* Asked once when a tap key is pressed, the defaults return TAPPING_TERM
+ * and TAPPING_DEFAULT_MODE */
+uint16_t get_tapping_term(keyrecord_t *record);
+uint8_t get_tapping_mode(keyrecord_t *record);
+#endif
 #endif
 
 #endif
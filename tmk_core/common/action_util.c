@@ -43,6 +43,11 @@ static int8_t cb_count = 0;
 //report_keyboard_t keyboard_report = {};
 report_keyboard_t *keyboard_report = &(report_keyboard_t){};
 
+static bool report_batching = false;
+static bool report_pending = false;
+static report_keyboard_t pending_report;
+static report_keyboard_t sent_report;
+
 extern inline void add_key(uint8_t key);
 extern inline void del_key(uint8_t key);
 extern inline void clear_keys(void);
@@ -156,9 +161,48 @@ void send_keyboard_report(void) {
     }
 
 #endif
+    if (report_batching) {
+        /* Keep merging reports as long as that can't hide a key from the
+         * host: a press in the pending report that was neither sent before
+         * nor is still held, or a release of a key that is pressed again,
+         * has to go out on its own first.
+         */
+        if (report_pending && !is_report_superseded(&pending_report, &sent_report, keyboard_report)) {
+            host_keyboard_send(&pending_report);
+            sent_report = pending_report;
+        }
+        pending_report = *keyboard_report;
+        report_pending = true;
+        return;
+    }
     host_keyboard_send(keyboard_report);
 }
 
+/** \brief Begin keyboard report batch
+ *
+ * Reports produced by send_keyboard_report() are held back and merged until
+ * keyboard_report_batch_end() is called, so that several key events
+ * processed in the same scan result in a single report.
+ */
+void keyboard_report_batch_begin(void)
+{
+    sent_report = *keyboard_report;
+    report_batching = true;
+}
+
+/** \brief End keyboard report batch
+ *
+ * Sends the pending coalesced report, if any.
+ */
+void keyboard_report_batch_end(void)
+{
+    report_batching = false;
+    if (report_pending) {
+        report_pending = false;
+        host_keyboard_send(&pending_report);
+    }
+}
+
 /** \brief Get mods
  *
  * FIXME: needs doc
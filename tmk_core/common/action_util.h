@@ -27,6 +27,8 @@ extern "C" {
 extern report_keyboard_t *keyboard_report;
 
 void send_keyboard_report(void);
+void keyboard_report_batch_begin(void);
+void keyboard_report_batch_end(void);
 
 /* key */
 inline void add_key(uint8_t key) {
@@ -352,57 +352,36 @@ void do_flash_cmd(volatile uint8_t *fstat)
 #elif defined(KL2x) /* chip selection */
 /* Teensy LC (emulated) */
 
+#include "eeprom_log.h"
+
 #define SYMVAL(sym) (uint32_t)(((uint8_t *)&(sym)) - ((uint8_t *)0))
 
 extern uint32_t __eeprom_workarea_start__;
 extern uint32_t __eeprom_workarea_end__;
 
-#define EEPROM_SIZE 128
-
-static uint32_t flashend = 0;
+#define EEPROM_SIZE EEPROM_LOG_SIZE
 
-void eeprom_initialize(void)
+uint32_t eeprom_log_flash_size(void)
 {
-	const uint16_t *p = (uint16_t *)SYMVAL(__eeprom_workarea_start__);
-
-	do {
-		if (*p++ == 0xFFFF) {
-			flashend = (uint32_t)(p - 2);
-			return;
-		}
-	} while (p < (uint16_t *)SYMVAL(__eeprom_workarea_end__));
-	flashend = (uint32_t)((uint16_t *)SYMVAL(__eeprom_workarea_end__) - 1);
+	return SYMVAL(__eeprom_workarea_end__) - SYMVAL(__eeprom_workarea_start__);
 }
 
-uint8_t eeprom_read_byte(const uint8_t *addr)
+uint16_t eeprom_log_flash_read(uint32_t offset)
 {
-	uint32_t offset = (uint32_t)addr;
-	const uint16_t *p = (uint16_t *)SYMVAL(__eeprom_workarea_start__);
-	const uint16_t *end = (const uint16_t *)((uint32_t)flashend);
-	uint16_t val;
-	uint8_t data=0xFF;
-
-	if (!end) {
-		eeprom_initialize();
-		end = (const uint16_t *)((uint32_t)flashend);
-	}
-	if (offset < EEPROM_SIZE) {
-		while (p <= end) {
-			val = *p++;
-			if ((val & 255) == offset) data = val >> 8;
-		}
-	}
-	return data;
+	return *(const uint16_t *)(SYMVAL(__eeprom_workarea_start__) + offset);
 }
 
-static void flash_write(const uint16_t *code, uint32_t addr, uint32_t data)
+static void flash_cmd(uint32_t fccob3, uint32_t fccob7)
 {
 	// with great power comes great responsibility....
+	// the flash can't be read while the command runs, so neither can the code
+	uint16_t do_flash_cmd[] = {
+		0x2380, 0x7003, 0x7803, 0xb25b, 0x2b00, 0xdafb, 0x4770};
 	uint32_t stat;
-	*(uint32_t *)&(FTFA->FCCOB3) = 0x06000000 | (addr & 0x00FFFFFC);
-	*(uint32_t *)&(FTFA->FCCOB7) = data;
+	*(uint32_t *)&(FTFA->FCCOB3) = fccob3;
+	*(uint32_t *)&(FTFA->FCCOB7) = fccob7;
 	__disable_irq();
-	(*((void (*)(volatile uint8_t *))((uint32_t)code | 1)))(&(FTFA->FSTAT));
+	(*((void (*)(volatile uint8_t *))((uint32_t)do_flash_cmd | 1)))(&(FTFA->FSTAT));
 	__enable_irq();
 	stat = FTFA->FSTAT & (FTFA_FSTAT_RDCOLERR|FTFA_FSTAT_ACCERR|FTFA_FSTAT_FPVIOL);
 	if (stat) {
@@ -411,69 +390,16 @@ static void flash_write(const uint16_t *code, uint32_t addr, uint32_t data)
 	MCM->PLACR |= MCM_PLACR_CFCC;
 }
 
-void eeprom_write_byte(uint8_t *addr, uint8_t data)
+void eeprom_log_flash_program(uint32_t offset, uint32_t data)
 {
-	uint32_t offset = (uint32_t)addr;
-	const uint16_t *p, *end = (const uint16_t *)((uint32_t)flashend);
-	uint32_t i, val, flashaddr;
-	uint16_t do_flash_cmd[] = {
-		0x2380, 0x7003, 0x7803, 0xb25b, 0x2b00, 0xdafb, 0x4770};
-	uint8_t buf[EEPROM_SIZE];
+	uint32_t addr = SYMVAL(__eeprom_workarea_start__) + offset;
+	flash_cmd(0x06000000 | (addr & 0x00FFFFFC), data);
+}
 
-	if (offset >= EEPROM_SIZE) return;
-	if (!end) {
-		eeprom_initialize();
-		end = (const uint16_t *)((uint32_t)flashend);
-	}
-	if (++end < (uint16_t *)SYMVAL(__eeprom_workarea_end__)) {
-		val = (data << 8) | offset;
-		flashaddr = (uint32_t)end;
-		flashend = flashaddr;
-		if ((flashaddr & 2) == 0) {
-			val |= 0xFFFF0000;
-		} else {
-			val <<= 16;
-			val |= 0x0000FFFF;
-		}
-		flash_write(do_flash_cmd, flashaddr, val);
-	} else {
-		for (i=0; i < EEPROM_SIZE; i++) {
-			buf[i] = 0xFF;
-		}
-		val = 0;
-		for (p = (uint16_t *)SYMVAL(__eeprom_workarea_start__); p < (uint16_t *)SYMVAL(__eeprom_workarea_end__); p++) {
-			val = *p;
-			if ((val & 255) < EEPROM_SIZE) {
-				buf[val & 255] = val >> 8;
-			}
-		}
-		buf[offset] = data;
-		for (flashaddr=(uint32_t)(uint16_t *)SYMVAL(__eeprom_workarea_start__); flashaddr < (uint32_t)(uint16_t *)SYMVAL(__eeprom_workarea_end__); flashaddr += 1024) {
-			*(uint32_t *)&(FTFA->FCCOB3) = 0x09000000 | flashaddr;
-			__disable_irq();
-			(*((void (*)(volatile uint8_t *))((uint32_t)do_flash_cmd | 1)))(&(FTFA->FSTAT));
-			__enable_irq();
-			val = FTFA->FSTAT & (FTFA_FSTAT_RDCOLERR|FTFA_FSTAT_ACCERR|FTFA_FSTAT_FPVIOL);;
-			if (val) FTFA->FSTAT = val;
-			MCM->PLACR |= MCM_PLACR_CFCC;
-		}
-		flashaddr=(uint32_t)(uint16_t *)SYMVAL(__eeprom_workarea_start__);
-		for (i=0; i < EEPROM_SIZE; i++) {
-			if (buf[i] == 0xFF) continue;
-			if ((flashaddr & 2) == 0) {
-				val = (buf[i] << 8) | i;
-			} else {
-				val = val | (buf[i] << 24) | (i << 16);
-				flash_write(do_flash_cmd, flashaddr, val);
-			}
-			flashaddr += 2;
-		}
-		flashend = flashaddr;
-		if ((flashaddr & 2)) {
-			val |= 0xFFFF0000;
-			flash_write(do_flash_cmd, flashaddr, val);
-		}
-	}
+void eeprom_log_flash_erase(uint32_t offset)
+{
+	uint32_t addr = SYMVAL(__eeprom_workarea_start__) + offset;
+	flash_cmd(0x09000000 | (addr & 0x00FFFFFC), 0);
 }
 
 /*
@@ -492,27 +418,33 @@ void do_flash_cmd(volatile uint8_t *fstat)
    c:	4770      	bx	lr
 */
 
+void eeprom_initialize(void)
+{
+	eeprom_log_init();
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+	return eeprom_log_read_byte((uint32_t)addr);
+}
 
 uint16_t eeprom_read_word(const uint16_t *addr)
 {
-	const uint8_t *p = (const uint8_t *)addr;
-	return eeprom_read_byte(p) | (eeprom_read_byte(p+1) << 8);
+	uint16_t value;
+	eeprom_log_read_block(&value, (uint32_t)addr, sizeof(value));
+	return value;
 }
 
 uint32_t eeprom_read_dword(const uint32_t *addr)
 {
-	const uint8_t *p = (const uint8_t *)addr;
-	return eeprom_read_byte(p) | (eeprom_read_byte(p+1) << 8)
-		| (eeprom_read_byte(p+2) << 16) | (eeprom_read_byte(p+3) << 24);
+	uint32_t value;
+	eeprom_log_read_block(&value, (uint32_t)addr, sizeof(value));
+	return value;
 }
 
 void eeprom_read_block(void *buf, const void *addr, uint32_t len)
 {
-	const uint8_t *p = (const uint8_t *)addr;
-	uint8_t *dest = (uint8_t *)buf;
-	while (len--) {
-		*dest++ = eeprom_read_byte(p++);
-	}
+	eeprom_log_read_block(buf, (uint32_t)addr, len);
 }
 
 int eeprom_is_ready(void)
@@ -520,29 +452,24 @@ int eeprom_is_ready(void)
 	return 1;
 }
 
+void eeprom_write_byte(uint8_t *addr, uint8_t value)
+{
+	eeprom_log_write_block(&value, (uint32_t)addr, 1);
+}
+
 void eeprom_write_word(uint16_t *addr, uint16_t value)
 {
-	uint8_t *p = (uint8_t *)addr;
-	eeprom_write_byte(p++, value);
-	eeprom_write_byte(p, value >> 8);
+	eeprom_log_write_block(&value, (uint32_t)addr, sizeof(value));
 }
 
 void eeprom_write_dword(uint32_t *addr, uint32_t value)
 {
-	uint8_t *p = (uint8_t *)addr;
-	eeprom_write_byte(p++, value);
-	eeprom_write_byte(p++, value >> 8);
-	eeprom_write_byte(p++, value >> 16);
-	eeprom_write_byte(p, value >> 24);
+	eeprom_log_write_block(&value, (uint32_t)addr, sizeof(value));
 }
 
 void eeprom_write_block(const void *buf, void *addr, uint32_t len)
 {
-	uint8_t *p = (uint8_t *)addr;
-	const uint8_t *src = (const uint8_t *)buf;
-	while (len--) {
-		eeprom_write_byte(p++, *src++);
-	}
+	eeprom_log_write_block(buf, (uint32_t)addr, len);
 }
 
 #else
@@ -603,30 +530,21 @@ void eeprom_write_block(const void *buf, void *addr, uint32_t len) {
 }
 
 #endif /* chip selection */
-// The update functions just calls write for now, but could probably be optimized
+// The update functions just call write, which only programs what changed
+// in one go where it can
 
 void eeprom_update_byte(uint8_t *addr, uint8_t value) {
 	eeprom_write_byte(addr, value);
 }
 
 void eeprom_update_word(uint16_t *addr, uint16_t value) {
-	uint8_t *p = (uint8_t *)addr;
-	eeprom_write_byte(p++, value);
-	eeprom_write_byte(p, value >> 8);
+	eeprom_write_word(addr, value);
 }
 
 void eeprom_update_dword(uint32_t *addr, uint32_t value) {
-	uint8_t *p = (uint8_t *)addr;
-	eeprom_write_byte(p++, value);
-	eeprom_write_byte(p++, value >> 8);
-	eeprom_write_byte(p++, value >> 16);
-	eeprom_write_byte(p, value >> 24);
+	eeprom_write_dword(addr, value);
 }
 
 void eeprom_update_block(const void *buf, void *addr, uint32_t len) {
-	uint8_t *p = (uint8_t *)addr;
-	const uint8_t *src = (const uint8_t *)buf;
-	while (len--) {
-		eeprom_write_byte(p++, *src++);
-	}
+	eeprom_write_block(buf, addr, len);
 }
@@ -27,12 +27,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "keyboard.h"
 #include "bootloader.h"
 #include "action_layer.h"
+#include "action_tapping.h"
 #include "action_util.h"
 #include "eeconfig.h"
 #include "sleep_led.h"
 #include "led.h"
 #include "command.h"
 #include "backlight.h"
+#include "instrument.h"
 #include "quantum.h"
 #include "version.h"
 
@@ -170,6 +172,10 @@ static void command_common_help(void)
 #ifdef SLEEP_LED_ENABLE
 		STR(MAGIC_KEY_SLEEP_LED   ) ":	Sleep LED Test\n"
 #endif
+
+#ifdef INSTRUMENT_ENABLE
+		STR(MAGIC_KEY_INSTRUMENT  ) ":	Print and Reset Timings\n"
+#endif
     );
 }
 
@@ -244,6 +250,9 @@ static void print_status(void)
     print_val_hex8(keymap_config.nkro);
 #endif
     print_val_hex32(timer_read32());
+#ifndef NO_ACTION_TAPPING
+    xprintf("waiting_buffer overflows: %u\n", action_tapping_overflows());
+#endif
 
 #ifdef PROTOCOL_PJRC
     print_val_hex8(UDCON);
@@ -322,6 +331,15 @@ static bool command_common(uint8_t code)
             break;
 #endif
 
+#ifdef INSTRUMENT_ENABLE
+
+		// print scan timings and latencies
+        case MAGIC_KC(MAGIC_KEY_INSTRUMENT):
+            instrument_print();
+            instrument_reset();
+            break;
+#endif
+
 #ifdef BOOTMAGIC_ENABLE
 
 		// print stored eeprom config
@@ -0,0 +1,214 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "eeprom_log.h"
+
+/* The first word of a bank, the magic then the generation of the bank.
+ * The one with the highest generation is the active one. The low byte of
+ * the magic is an offset the legacy log never wrote, see replay_legacy(). */
+#define EEPROM_LOG_MAGIC    0xEEA5
+#define EEPROM_LOG_LEGACY_SIZE 128
+#if (EEPROM_LOG_MAGIC & 0xFF) < EEPROM_LOG_LEGACY_SIZE
+#   error "EEPROM_LOG_MAGIC could be the first entry of a legacy log"
+#endif
+#define EEPROM_LOG_HEADER   4
+#define EEPROM_LOG_ERASED   0xFFFF
+
+/* Log entries are the value in the high byte and the offset in the low one */
+#define LOG_ENTRY(offset, value) (((uint16_t)(value) << 8) | (offset))
+
+static uint8_t image[EEPROM_LOG_SIZE];
+static bool ready = false;
+static uint32_t bank_size;
+static uint32_t bank_start;
+static uint16_t generation;
+static uint32_t log_end;
+
+/* Pairs the entries appended to an aligned word into a single program */
+typedef struct {
+    uint32_t end;
+    uint32_t word;
+    bool pending;
+} log_writer_t;
+
+static void log_put(log_writer_t *writer, uint16_t entry)
+{
+    if (writer->end & 2) {
+        if (writer->pending) {
+            eeprom_log_flash_program(writer->end - 2, writer->word & (((uint32_t)entry << 16) | 0xFFFF));
+            writer->pending = false;
+        } else {
+            eeprom_log_flash_program(writer->end - 2, ((uint32_t)entry << 16) | 0xFFFF);
+        }
+    } else {
+        writer->word = 0xFFFF0000 | entry;
+        writer->pending = true;
+    }
+    writer->end += 2;
+}
+
+static void log_flush(log_writer_t *writer)
+{
+    if (writer->pending) {
+        eeprom_log_flash_program(writer->end - 2, writer->word);
+        writer->pending = false;
+    }
+}
+
+static bool read_header(uint32_t bank, uint16_t *bank_generation)
+{
+    if (eeprom_log_flash_read(bank) != EEPROM_LOG_MAGIC) {
+        return false;
+    }
+    *bank_generation = eeprom_log_flash_read(bank + 2);
+    return *bank_generation != EEPROM_LOG_ERASED;
+}
+
+/* Writes the image to the other bank and switches to it */
+static void compact(void)
+{
+    uint32_t target = bank_start ? 0 : bank_size;
+
+    /* from the header page on, the target isn't a valid bank any more */
+    for (uint32_t page = 0; page < bank_size; page += EEPROM_LOG_PAGE_SIZE) {
+        eeprom_log_flash_erase(target + page);
+    }
+
+    log_writer_t writer = { .end = target + EEPROM_LOG_HEADER };
+    for (uint16_t i = 0; i < EEPROM_LOG_SIZE; i++) {
+        if (image[i] != 0xFF) {
+            log_put(&writer, LOG_ENTRY(i, image[i]));
+        }
+    }
+    log_flush(&writer);
+
+    /* the new bank takes over once the header is there */
+    generation++;
+    if (generation == EEPROM_LOG_ERASED) {
+        generation = 0;
+    }
+    eeprom_log_flash_program(target, ((uint32_t)generation << 16) | EEPROM_LOG_MAGIC);
+    bank_start = target;
+    log_end = writer.end;
+}
+
+/* The previous Teensy LC code kept a single log, of the same entries but
+ * without a header, over the whole work area. It read everything up to the
+ * first erased half word, for offsets below 128. */
+static void replay_legacy(void)
+{
+    uint32_t end = bank_size * 2;
+    for (uint32_t offset = 0; offset < end; offset += 2) {
+        uint16_t entry = eeprom_log_flash_read(offset);
+        if (entry == EEPROM_LOG_ERASED) {
+            break;
+        }
+        if ((entry & 0xFF) < EEPROM_LOG_LEGACY_SIZE && (entry & 0xFF) < EEPROM_LOG_SIZE) {
+            image[entry & 0xFF] = entry >> 8;
+        }
+    }
+}
+
+void eeprom_log_init(void)
+{
+    ready = true;
+    bank_size = eeprom_log_flash_size() / 2;
+    for (uint16_t i = 0; i < EEPROM_LOG_SIZE; i++) {
+        image[i] = 0xFF;
+    }
+
+    uint16_t generation0 = 0, generation1 = 0;
+    bool valid0 = read_header(0, &generation0);
+    bool valid1 = read_header(bank_size, &generation1);
+    if (valid0 && valid1) {
+        /* a compaction was cut before the old bank got erased */
+        valid0 = (int16_t)(generation0 - generation1) > 0;
+        valid1 = !valid0;
+    }
+    if (valid0) {
+        bank_start = 0;
+        generation = generation0;
+    } else if (valid1) {
+        bank_start = bank_size;
+        generation = generation1;
+    } else {
+        /* blank, legacy, or a legacy log whose compaction into the second
+         * bank got cut, which stops the log at the erased header. A cut
+         * while the legacy log runs into the second bank loses its end,
+         * as the legacy compaction did. */
+        replay_legacy();
+        bank_start = 0;
+        generation = 0;
+        compact();
+        return;
+    }
+
+    uint32_t end = bank_start + bank_size;
+    for (log_end = bank_start + EEPROM_LOG_HEADER; log_end < end; log_end += 2) {
+        uint16_t entry = eeprom_log_flash_read(log_end);
+        if (entry == EEPROM_LOG_ERASED) {
+            break;
+        }
+        if ((entry & 0xFF) < EEPROM_LOG_SIZE) {
+            image[entry & 0xFF] = entry >> 8;
+        }
+    }
+}
+
+void eeprom_log_read_block(void *buf, uint32_t offset, uint32_t len)
+{
+    uint8_t *dest = (uint8_t *)buf;
+
+    if (!ready) eeprom_log_init();
+    while (len--) {
+        *dest++ = offset < EEPROM_LOG_SIZE ? image[offset] : 0xFF;
+        offset++;
+    }
+}
+
+void eeprom_log_write_block(const void *buf, uint32_t offset, uint32_t len)
+{
+    const uint8_t *src = (const uint8_t *)buf;
+
+    if (!ready) eeprom_log_init();
+    if (offset >= EEPROM_LOG_SIZE) return;
+    if (len > EEPROM_LOG_SIZE - offset) len = EEPROM_LOG_SIZE - offset;
+
+    uint32_t changed = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        changed += image[offset + i] != src[i];
+    }
+    if (!changed) return;
+
+    if (log_end + changed * 2 > bank_start + bank_size) {
+        for (uint32_t i = 0; i < len; i++) {
+            image[offset + i] = src[i];
+        }
+        compact();
+        return;
+    }
+
+    log_writer_t writer = { .end = log_end };
+    for (uint32_t i = 0; i < len; i++) {
+        if (image[offset + i] != src[i]) {
+            image[offset + i] = src[i];
+            log_put(&writer, LOG_ENTRY(offset + i, src[i]));
+        }
+    }
+    log_flush(&writer);
+    log_end = writer.end;
+}
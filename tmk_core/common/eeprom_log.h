@@ -0,0 +1,73 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef EEPROM_LOG_H
+#define EEPROM_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* EEPROM emulated with a log of (offset, value) half words in flash.
+ *
+ * The log is replayed once into a RAM image, which serves every read.
+ * Writes append the bytes that changed. When the log is full, the image is
+ * written to the other bank, which becomes the active one once its header
+ * is programmed, so a power loss at any point keeps either the old or the
+ * new bank complete. A work area without a bank is replayed as the legacy
+ * log of the previous Teensy LC code before it's compacted.
+ */
+
+/* Bytes of emulated EEPROM, at most 255 */
+#ifndef EEPROM_LOG_SIZE
+#   define EEPROM_LOG_SIZE 128
+#endif
+
+/* The flash, provided by the platform. The work area is two banks of
+ * eeprom_log_flash_size() / 2 bytes, each a whole number of erase pages of
+ * EEPROM_LOG_PAGE_SIZE bytes. Offsets are in bytes from its start. */
+#ifndef EEPROM_LOG_PAGE_SIZE
+#   define EEPROM_LOG_PAGE_SIZE 1024
+#endif
+uint32_t eeprom_log_flash_size(void);
+uint16_t eeprom_log_flash_read(uint32_t offset);
+/* A 4 byte aligned word, it can only clear bits */
+void eeprom_log_flash_program(uint32_t offset, uint32_t data);
+/* Sets the page at the offset back to 0xFF */
+void eeprom_log_flash_erase(uint32_t offset);
+
+/* Replays the log, called by the first read or write otherwise */
+void eeprom_log_init(void);
+void eeprom_log_read_block(void *buf, uint32_t offset, uint32_t len);
+/* Only the bytes that changed are written, all in one go */
+void eeprom_log_write_block(const void *buf, uint32_t offset, uint32_t len);
+
+static inline uint8_t eeprom_log_read_byte(uint32_t offset)
+{
+    uint8_t value;
+    eeprom_log_read_block(&value, offset, 1);
+    return value;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,73 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stddef.h>
+#include "event_queue.h"
+
+/* Keeps the compiler from moving the record accesses across the index
+ * updates that publish them to the other side */
+#define EVENT_QUEUE_BARRIER() __asm__ __volatile__ ("" ::: "memory")
+
+bool event_queue_push(event_queue_t *queue, keyrecord_t record)
+{
+    uint8_t head = queue->head;
+    if ((uint8_t)(head - queue->tail) > queue->mask) {
+        queue->overflows++;
+        return false;
+    }
+    queue->records[head & queue->mask] = record;
+    if (record.event.pressed) {
+        queue->pressed_in++;
+    }
+    EVENT_QUEUE_BARRIER();
+    queue->head = head + 1;
+    return true;
+}
+
+keyrecord_t *event_queue_peek(event_queue_t *queue)
+{
+    uint8_t tail = queue->tail;
+    if (tail == queue->head) {
+        return NULL;
+    }
+    EVENT_QUEUE_BARRIER();
+    return &queue->records[tail & queue->mask];
+}
+
+void event_queue_pop(event_queue_t *queue)
+{
+    uint8_t tail = queue->tail;
+    if (tail == queue->head) {
+        return;
+    }
+    if (queue->records[tail & queue->mask].event.pressed) {
+        queue->pressed_out++;
+    }
+    EVENT_QUEUE_BARRIER();
+    queue->tail = tail + 1;
+}
+
+keyrecord_t *event_queue_at(event_queue_t *queue, uint8_t n)
+{
+    return &queue->records[(uint8_t)(queue->tail + n) & queue->mask];
+}
+
+void event_queue_clear(event_queue_t *queue)
+{
+    queue->tail = queue->head;
+    queue->pressed_out = queue->pressed_in;
+}
@@ -0,0 +1,84 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "action.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A FIFO of key events, for the features that hold events back until they
+ * know what they mean. All the operations but event_queue_at() searches
+ * are O(1).
+ *
+ * One side can push from an interrupt while the other one peeks and pops:
+ * the producer only writes head, pressed_in and overflows, the consumer
+ * only tail and pressed_out. event_queue_clear() needs both sides quiet.
+ * The queued events can be changed in place, except for being presses.
+ */
+typedef struct {
+    keyrecord_t *records;
+    uint8_t mask;
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    /* the press events pushed and popped, their difference is the number
+     * of press events in the queue */
+    volatile uint8_t pressed_in;
+    volatile uint8_t pressed_out;
+    volatile uint16_t overflows;
+} event_queue_t;
+
+/* The number of records has to be a power of two, up to 128 */
+#define EVENT_QUEUE_INIT(array) { \
+    .records = (array), \
+    .mask = sizeof(array) / sizeof((array)[0]) - 1 \
+}
+
+/* Returns false and counts an overflow when the queue is full */
+bool event_queue_push(event_queue_t *queue, keyrecord_t record);
+/* The oldest event, or NULL when the queue is empty */
+keyrecord_t *event_queue_peek(event_queue_t *queue);
+void event_queue_pop(event_queue_t *queue);
+/* The n-th oldest event, n has to be less than event_queue_length() */
+keyrecord_t *event_queue_at(event_queue_t *queue, uint8_t n);
+void event_queue_clear(event_queue_t *queue);
+
+static inline uint8_t event_queue_length(const event_queue_t *queue)
+{
+    return (uint8_t)(queue->head - queue->tail);
+}
+
+static inline bool event_queue_has_pressed(const event_queue_t *queue)
+{
+    return queue->pressed_in != queue->pressed_out;
+}
+
+static inline uint16_t event_queue_overflows(const event_queue_t *queue)
+{
+    return queue->overflows;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -21,6 +21,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "host.h"
 #include "util.h"
 #include "debug.h"
+#include "instrument.h"
 
 static host_driver_t *driver;
 static uint16_t last_system_report = 0;
@@ -47,6 +48,7 @@ void host_keyboard_send(report_keyboard_t *report)
 {
     if (!driver) return;
     (*driver->send_keyboard)(report);
+    instrument_keyboard_report();
 
     if (debug_keyboard) {
         dprint("keyboard_report: ");
@@ -0,0 +1,312 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "instrument.h"
+#include "timer.h"
+#include "print.h"
+
+#if defined(__AVR__)
+#   include <avr/io.h>
+#   include <util/atomic.h>
+#   include "avr/timer_avr.h"
+#elif defined(PROTOCOL_CHIBIOS)
+#   include "ch.h"
+#endif
+
+/* A key event older than this doesn't count as the cause of a report */
+#ifndef INSTRUMENT_LATENCY_TIMEOUT
+#   define INSTRUMENT_LATENCY_TIMEOUT 1000
+#endif
+
+static instrument_stat_t stages[INSTRUMENT_STAGES];
+static instrument_stat_t latency;
+static uint16_t latency_buckets[INSTRUMENT_LATENCY_BUCKETS];
+
+static uint32_t task_start;
+static uint32_t stage_start;
+
+static bool key_event_pending;
+static uint32_t key_event_ticks;
+static uint32_t key_event_time;
+
+static uint32_t scan_window;
+static uint16_t scans;
+static uint16_t scan_rate;
+
+/* The ticks are free running, only their differences are converted to us */
+#if defined(__AVR__)
+
+extern volatile uint32_t timer_count;
+
+/* The 1ms timer count extended with timer0, already in us */
+static uint32_t read_ticks(void)
+{
+    uint32_t ms;
+    uint8_t raw;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ms = timer_count;
+        raw = TIMER_RAW;
+        // the compare match interrupt may be pending
+#   ifndef __AVR_ATmega32A__
+        if (TIFR0 & _BV(OCF0A)) {
+#   else
+        if (TIFR & _BV(OCF0)) {
+#   endif
+            ms++;
+            raw = TIMER_RAW;
+        }
+    }
+    return ms * 1000 + (uint32_t)raw * (1000000UL / TIMER_RAW_FREQ);
+}
+
+#   define ticks_to_us(ticks) (ticks)
+
+#elif defined(PROTOCOL_CHIBIOS)
+
+#   if defined(INSTRUMENT_RT_FREQUENCY) && (PORT_SUPPORTS_RT == TRUE)
+/* The realtime counter, running at INSTRUMENT_RT_FREQUENCY (the core clock) */
+static uint32_t read_ticks(void)
+{
+    return chSysGetRealtimeCounterX();
+}
+
+#       define ticks_to_us(ticks) ((ticks) / (INSTRUMENT_RT_FREQUENCY / 1000000))
+#   else
+/* The system tick, CH_CFG_ST_FREQUENCY sets the resolution */
+static uint32_t read_ticks(void)
+{
+    return chVTGetSystemTimeX();
+}
+
+#       define ticks_to_us(ticks) ST2US((systime_t)(ticks))
+#   endif
+
+#else
+
+/* The native test platform, the fake timer only has ms */
+static uint32_t read_ticks(void)
+{
+    return timer_read32() * 1000;
+}
+
+#   define ticks_to_us(ticks) (ticks)
+
+#endif
+
+static void stat_add(instrument_stat_t *stat, uint32_t sample)
+{
+    if (stat->count == 0) {
+        stat->min = sample;
+        stat->max = sample;
+        stat->avg_x8 = sample << 3;
+    } else {
+        if (sample < stat->min) stat->min = sample;
+        if (sample > stat->max) stat->max = sample;
+        stat->avg_x8 += sample - (stat->avg_x8 >> 3);
+    }
+    stat->count++;
+}
+
+static uint8_t latency_bucket(uint32_t us)
+{
+    uint32_t ms = us / 1000;
+    if (ms < 4) {
+        return ms;
+    }
+    uint8_t bucket = 2;
+    while (ms && bucket < INSTRUMENT_LATENCY_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    return ms ? INSTRUMENT_LATENCY_BUCKETS - 1 : bucket - 1;
+}
+
+void instrument_init(void)
+{
+    instrument_reset();
+}
+
+void instrument_reset(void)
+{
+    for (uint8_t i = 0; i < INSTRUMENT_STAGES; i++) {
+        stages[i].count = 0;
+    }
+    latency.count = 0;
+    for (uint8_t i = 0; i < INSTRUMENT_LATENCY_BUCKETS; i++) {
+        latency_buckets[i] = 0;
+    }
+    key_event_pending = false;
+    scan_window = timer_read32();
+    scans = 0;
+    scan_rate = 0;
+}
+
+void instrument_task_begin(void)
+{
+    task_start = read_ticks();
+    stage_start = task_start;
+}
+
+void instrument_stage(instrument_stage_t stage)
+{
+    uint32_t now = read_ticks();
+    stat_add(&stages[stage], ticks_to_us(now - stage_start));
+    stage_start = now;
+}
+
+void instrument_task_end(void)
+{
+    stat_add(&stages[INSTRUMENT_KEYBOARD_TASK], ticks_to_us(read_ticks() - task_start));
+
+    uint32_t now = timer_read32();
+    if (TIMER_DIFF_32(now, scan_window) >= 1000) {
+        scan_rate = scans;
+        scans = 0;
+        scan_window = now;
+    }
+    scans++;
+
+    if (key_event_pending && TIMER_DIFF_32(now, key_event_time) > INSTRUMENT_LATENCY_TIMEOUT) {
+        key_event_pending = false;
+    }
+}
+
+void instrument_key_event(void)
+{
+    // the key was seen by the matrix scan at the start of this task
+    key_event_pending = true;
+    key_event_ticks = task_start;
+    key_event_time = timer_read32();
+}
+
+void instrument_keyboard_report(void)
+{
+    if (!key_event_pending) {
+        return;
+    }
+    key_event_pending = false;
+
+    uint32_t us = ticks_to_us(read_ticks() - key_event_ticks);
+    stat_add(&latency, us);
+    uint8_t bucket = latency_bucket(us);
+    if (latency_buckets[bucket] < UINT16_MAX) {
+        latency_buckets[bucket]++;
+    }
+}
+
+const instrument_stat_t *instrument_get_stage(instrument_stage_t stage)
+{
+    return &stages[stage];
+}
+
+const instrument_stat_t *instrument_get_latency(void)
+{
+    return &latency;
+}
+
+uint16_t instrument_get_latency_bucket(uint8_t bucket)
+{
+    return latency_buckets[bucket];
+}
+
+uint16_t instrument_get_scan_rate(void)
+{
+    return scan_rate;
+}
+
+static void print_stat(const instrument_stat_t *stat)
+{
+    if (stat->count == 0) {
+        print("-\n");
+        return;
+    }
+    xprintf("min %lu avg %lu max %lu us (%lu)\n",
+        (unsigned long)stat->min, (unsigned long)instrument_stat_avg(stat),
+        (unsigned long)stat->max, (unsigned long)stat->count);
+}
+
+void instrument_print(void)
+{
+    print("\n\t- Instrument -\n");
+    xprintf("scans/s: %u\n", scan_rate);
+    print("matrix_scan: ");     print_stat(&stages[INSTRUMENT_MATRIX_SCAN]);
+    print("action_exec: ");     print_stat(&stages[INSTRUMENT_ACTION_EXEC]);
+    print("mouse: ");           print_stat(&stages[INSTRUMENT_MOUSE]);
+    print("serial_link: ");     print_stat(&stages[INSTRUMENT_SERIAL_LINK]);
+    print("visualizer: ");      print_stat(&stages[INSTRUMENT_VISUALIZER]);
+    print("pointing_device: "); print_stat(&stages[INSTRUMENT_POINTING_DEVICE]);
+    print("midi: ");            print_stat(&stages[INSTRUMENT_MIDI]);
+    print("led: ");             print_stat(&stages[INSTRUMENT_LED]);
+    print("keyboard_task: ");   print_stat(&stages[INSTRUMENT_KEYBOARD_TASK]);
+    print("key to report: ");   print_stat(&latency);
+    print("ms: 0 1 2 3 4- 8- 16- 32- 64- 128-\n   ");
+    for (uint8_t i = 0; i < INSTRUMENT_LATENCY_BUCKETS; i++) {
+        xprintf(" %u", latency_buckets[i]);
+    }
+    print("\n");
+}
+
+static uint8_t put_u32(uint8_t *data, uint8_t i, uint32_t value)
+{
+    data[i++] = value & 0xFF;
+    data[i++] = (value >> 8) & 0xFF;
+    data[i++] = (value >> 16) & 0xFF;
+    data[i++] = (value >> 24) & 0xFF;
+    return i;
+}
+
+static void put_stat(uint8_t *data, const instrument_stat_t *stat)
+{
+    uint8_t i = 2;
+    i = put_u32(data, i, stat->count);
+    i = put_u32(data, i, stat->count ? stat->min : 0);
+    i = put_u32(data, i, stat->count ? instrument_stat_avg(stat) : 0);
+    put_u32(data, i, stat->count ? stat->max : 0);
+}
+
+/* The reply overwrites the query, multi byte values are little endian:
+ *  - stage or latency: count, min, avg and max in us, 4 bytes each
+ *  - histogram: one 2 byte count per bucket
+ *  - scan rate: 2 bytes
+ */
+bool instrument_raw_hid_query(uint8_t *data, uint8_t length)
+{
+    if (length < 2 + 4 * 4 || data[0] != INSTRUMENT_RAW_HID_ID) {
+        return false;
+    }
+    uint8_t query = data[1];
+    for (uint8_t i = 2; i < length; i++) {
+        data[i] = 0;
+    }
+    if (query < INSTRUMENT_STAGES) {
+        put_stat(data, &stages[query]);
+    } else if (query == INSTRUMENT_QUERY_LATENCY) {
+        put_stat(data, &latency);
+    } else if (query == INSTRUMENT_QUERY_HISTOGRAM && length >= 2 + 2 * INSTRUMENT_LATENCY_BUCKETS) {
+        for (uint8_t i = 0; i < INSTRUMENT_LATENCY_BUCKETS; i++) {
+            data[2 + 2 * i] = latency_buckets[i] & 0xFF;
+            data[3 + 2 * i] = latency_buckets[i] >> 8;
+        }
+    } else if (query == INSTRUMENT_QUERY_SCAN_RATE) {
+        data[2] = scan_rate & 0xFF;
+        data[3] = scan_rate >> 8;
+    } else if (query == INSTRUMENT_QUERY_RESET) {
+        instrument_reset();
+    } else {
+        data[1] = INSTRUMENT_QUERY_INVALID;
+    }
+    return true;
+}
@@ -0,0 +1,99 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef INSTRUMENT_ENABLE
+
+/* The stages of keyboard_task() that are timed, in the order they run */
+typedef enum {
+    INSTRUMENT_MATRIX_SCAN,
+    INSTRUMENT_ACTION_EXEC,
+    INSTRUMENT_MOUSE,
+    INSTRUMENT_SERIAL_LINK,
+    INSTRUMENT_VISUALIZER,
+    INSTRUMENT_POINTING_DEVICE,
+    INSTRUMENT_MIDI,
+    INSTRUMENT_LED,
+    /* the whole keyboard_task() */
+    INSTRUMENT_KEYBOARD_TASK,
+    INSTRUMENT_STAGES
+} instrument_stage_t;
+
+/* Latency histogram buckets, in ms: 0, 1, 2, 3, 4-7, 8-15, ..., 128 and more */
+#define INSTRUMENT_LATENCY_BUCKETS 10
+
+/* First byte of the raw HID packets handled by instrument_raw_hid_query() */
+#ifndef INSTRUMENT_RAW_HID_ID
+#   define INSTRUMENT_RAW_HID_ID 0xB1
+#endif
+/* Second byte of the query, anything below INSTRUMENT_STAGES selects a stage */
+#define INSTRUMENT_QUERY_LATENCY    0x80
+#define INSTRUMENT_QUERY_HISTOGRAM  0x81
+#define INSTRUMENT_QUERY_SCAN_RATE  0x82
+#define INSTRUMENT_QUERY_RESET      0x83
+#define INSTRUMENT_QUERY_INVALID    0xFF
+
+/* Times are in us, min and max since the last reset, avg is a moving average
+ * over the last 8 or so samples */
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t avg_x8;
+} instrument_stat_t;
+
+#define instrument_stat_avg(stat) ((stat)->avg_x8 >> 3)
+
+void instrument_init(void);
+void instrument_reset(void);
+
+/* Called by keyboard_task(), each stage is timed from the end of the previous one */
+void instrument_task_begin(void);
+void instrument_stage(instrument_stage_t stage);
+void instrument_task_end(void);
+
+/* A key event has been detected in the current keyboard_task() */
+void instrument_key_event(void);
+/* A keyboard report is sent, the time since the last key event goes in the histogram */
+void instrument_keyboard_report(void);
+
+const instrument_stat_t *instrument_get_stage(instrument_stage_t stage);
+const instrument_stat_t *instrument_get_latency(void);
+uint16_t instrument_get_latency_bucket(uint8_t bucket);
+uint16_t instrument_get_scan_rate(void);
+
+void instrument_print(void);
+/* Answers a query sent by the host in place, returns false if the packet
+ * isn't one */
+bool instrument_raw_hid_query(uint8_t *data, uint8_t length);
+
+#else
+
+#define instrument_init()
+#define instrument_task_begin()
+#define instrument_stage(stage)
+#define instrument_task_end()
+#define instrument_key_event()
+#define instrument_keyboard_report()
+
+#endif
+
+#endif
@@ -31,6 +31,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "eeconfig.h"
 #include "backlight.h"
 #include "action_layer.h"
+#include "action_util.h"
+#include "instrument.h"
 #ifdef BOOTMAGIC_ENABLE
 #   include "bootmagic.h"
 #else
@@ -69,6 +71,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef MIDI_ENABLE
 #   include "process_midi.h"
 #endif
+#ifdef SPLIT_EVENTS_ENABLE
+#   include "split_events.h"
+#endif
 
 #ifdef MATRIX_HAS_GHOST
 extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
@@ -181,6 +186,7 @@ void keyboard_init(void) {
 #if defined(NKRO_ENABLE) && defined(FORCE_NKRO)
     keymap_config.nkro = 1;
 #endif
+    instrument_init();
 }
 
 /** \brief Keyboard task: Do keyboard routine jobs
@@ -204,12 +210,18 @@ void keyboard_task(void)
     static uint8_t led_status = 0;
     matrix_row_t matrix_row = 0;
     matrix_row_t matrix_change = 0;
-#ifdef QMK_KEYS_PER_SCAN
+#if defined(QMK_KEYS_PER_SCAN) && !defined(SPLIT_EVENTS_ENABLE)
+    static keyevent_t scan_events[QMK_KEYS_PER_SCAN];
     uint8_t keys_processed = 0;
 #endif
 
+    instrument_task_begin();
+
     matrix_scan();
+    instrument_stage(INSTRUMENT_MATRIX_SCAN);
     if (is_keyboard_master()) {
+        // all the changes found in one scan share the same timestamp
+        const uint16_t scan_time = timer_read() | 1; /* time should not be 0 */
         for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
             matrix_row = matrix_get_row(r);
             matrix_change = matrix_row ^ matrix_prev[r];
@@ -231,32 +243,79 @@ void keyboard_task(void)
                 if (debug_matrix) matrix_print();
                 for (uint8_t c = 0; c < MATRIX_COLS; c++) {
                     if (matrix_change & ((matrix_row_t)1<<c)) {
-                        action_exec((keyevent_t){
+                        keyevent_t event = {
                             .key = (keypos_t){ .row = r, .col = c },
                             .pressed = (matrix_row & ((matrix_row_t)1<<c)),
-                            .time = (timer_read() | 1) /* time should not be 0 */
-                        });
+                            .time = scan_time
+                        };
+#ifdef SPLIT_EVENTS_ENABLE
+                        // when the queue is full, a later scan picks it up
+                        if (!split_events_local(event))
+                            goto MATRIX_DIFF_END;
+#endif
                         // record a processed key
                         matrix_prev[r] ^= ((matrix_row_t)1<<c);
-#ifdef QMK_KEYS_PER_SCAN
-                        // only jump out if we have processed "enough" keys.
+#if defined(SPLIT_EVENTS_ENABLE)
+                        // run along with the other half's, below
+#elif defined(QMK_KEYS_PER_SCAN)
+                        // queue the event, it's executed once the whole matrix has been diffed
+                        scan_events[keys_processed] = event;
+                        // only stop diffing if we have collected "enough" keys.
                         if (++keys_processed >= QMK_KEYS_PER_SCAN)
-#endif
+                            goto MATRIX_DIFF_END;
+#else
                         // process a key per task call
+                        instrument_key_event();
+                        action_exec(event);
                         goto MATRIX_LOOP_END;
+#endif
                     }
                 }
             }
         }
     }
-    // call with pseudo tick event when no real key event.
+#if defined(SPLIT_EVENTS_ENABLE)
+MATRIX_DIFF_END:
+    {
+        // the events of both halves in time order, the local ones wait for
+        // the other half's up to then
+        keyevent_t event;
+        if (split_events_next(&event)) {
+            instrument_key_event();
+#ifdef QMK_KEYS_PER_SCAN
+            // as below, one coalesced report for the events of a scan
+            keyboard_report_batch_begin();
+#endif
+            do {
+                action_exec(event);
+            } while (split_events_next(&event));
 #ifdef QMK_KEYS_PER_SCAN
-    // we can get here with some keys processed now.
-    if (!keys_processed)
+            keyboard_report_batch_end();
+#endif
+            goto MATRIX_LOOP_END;
+        }
+        action_exec(split_events_tick());
+        goto MATRIX_LOOP_END;
+    }
+#elif defined(QMK_KEYS_PER_SCAN)
+MATRIX_DIFF_END:
+    if (keys_processed) {
+        // drain the queued events in matrix order and send a single
+        // coalesced keyboard report for all of them
+        instrument_key_event();
+        keyboard_report_batch_begin();
+        for (uint8_t i = 0; i < keys_processed; i++) {
+            action_exec(scan_events[i]);
+        }
+        keyboard_report_batch_end();
+        goto MATRIX_LOOP_END;
+    }
 #endif
+    // call with pseudo tick event when no real key event.
     action_exec(TICK);
 
 MATRIX_LOOP_END:
+    instrument_stage(INSTRUMENT_ACTION_EXEC);
 
 #ifdef MOUSEKEY_ENABLE
     // mousekey repeat & acceleration
@@ -275,20 +334,28 @@ MATRIX_LOOP_END:
     adb_mouse_task();
 #endif
 
+#if defined(MOUSEKEY_ENABLE) || defined(PS2_MOUSE_ENABLE) || defined(SERIAL_MOUSE_ENABLE) || defined(ADB_MOUSE_ENABLE)
+    instrument_stage(INSTRUMENT_MOUSE);
+#endif
+
 #ifdef SERIAL_LINK_ENABLE
 	serial_link_update();
+    instrument_stage(INSTRUMENT_SERIAL_LINK);
 #endif
 
 #ifdef VISUALIZER_ENABLE
     visualizer_update(default_layer_state, layer_state, visualizer_get_mods(), host_keyboard_leds());
+    instrument_stage(INSTRUMENT_VISUALIZER);
 #endif
 
 #ifdef POINTING_DEVICE_ENABLE
     pointing_device_task();
+    instrument_stage(INSTRUMENT_POINTING_DEVICE);
 #endif
 
 #ifdef MIDI_ENABLE
     midi_task();
+    instrument_stage(INSTRUMENT_MIDI);
 #endif
 
     // update LED
@@ -296,6 +363,9 @@ MATRIX_LOOP_END:
         led_status = host_keyboard_leds();
         keyboard_set_leds(led_status);
     }
+    instrument_stage(INSTRUMENT_LED);
+
+    instrument_task_end();
 }
 
 /** \brief keyboard set leds
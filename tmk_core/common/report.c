@@ -34,6 +34,48 @@ uint8_t has_anykey(report_keyboard_t* keyboard_report)
     return cnt;
 }
 
+static bool has_key_byte(const report_keyboard_t* report, uint8_t key)
+{
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        if (report->keys[i] == key)
+            return true;
+    }
+    return false;
+}
+
+/** \brief is_report_superseded
+ *
+ * Returns true if `report`, sent between `before` and `after`, can be left
+ * out without the host missing a press or a release: every modifier and key
+ * is either as in `before` or already as in `after`.
+ */
+bool is_report_superseded(const report_keyboard_t* report, const report_keyboard_t* before, const report_keyboard_t* after)
+{
+    if ((report->mods ^ before->mods) & (report->mods ^ after->mods)) {
+        return false;
+    }
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keymap_config.nkro) {
+        for (uint8_t i = 0; i < KEYBOARD_REPORT_BITS; i++) {
+            if ((report->nkro.bits[i] ^ before->nkro.bits[i]) & (report->nkro.bits[i] ^ after->nkro.bits[i]))
+                return false;
+        }
+        return true;
+    }
+#endif
+    for (uint8_t i = 0; i < KEYBOARD_REPORT_KEYS; i++) {
+        uint8_t key = report->keys[i];
+        // a press has to still be held, so it isn't missed
+        if (key && !has_key_byte(before, key) && !has_key_byte(after, key))
+            return false;
+        // and a release can't be followed by a press of the same key
+        key = before->keys[i];
+        if (key && !has_key_byte(report, key) && has_key_byte(after, key))
+            return false;
+    }
+    return true;
+}
+
 /** \brief get_first_key
  *
  * FIXME: Needs doc
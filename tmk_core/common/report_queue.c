@@ -0,0 +1,65 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include "report_queue.h"
+
+static uint8_t *slot(report_queue_t *queue, uint8_t n)
+{
+    return queue->slots + (uint16_t)((queue->head + n) & queue->mask) * queue->size;
+}
+
+const void *report_queue_push(report_queue_t *queue, const void *report)
+{
+    if (queue->count == 0) {
+        queue->count = 1;
+        return memcpy(slot(queue, 0), report, queue->size);
+    }
+
+    // the report in flight can't be touched, only the ones after it
+    if (queue->count >= 2) {
+        uint8_t *last = slot(queue, queue->count - 1);
+        if (queue->merge && queue->merge(slot(queue, queue->count - 2), last, report)) {
+            memcpy(last, report, queue->size);
+            queue->merged++;
+            return NULL;
+        }
+        if (queue->count > queue->mask) {
+            memcpy(last, report, queue->size);
+            queue->overflows++;
+            return NULL;
+        }
+    }
+    memcpy(slot(queue, queue->count), report, queue->size);
+    queue->count++;
+    return NULL;
+}
+
+const void *report_queue_sent(report_queue_t *queue)
+{
+    if (queue->count == 0) {
+        return NULL;
+    }
+    queue->head = (queue->head + 1) & queue->mask;
+    queue->count--;
+    return queue->count ? slot(queue, 0) : NULL;
+}
+
+void report_queue_clear(report_queue_t *queue)
+{
+    queue->count = 0;
+}
@@ -0,0 +1,82 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef REPORT_QUEUE_H
+#define REPORT_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The reports waiting for an IN endpoint, so that sending one never waits
+ * for the host to poll the previous one.
+ *
+ * The oldest report is the one being transferred while the queue is busy,
+ * it stays in place until report_queue_sent() so the transfer can read it.
+ * The queue isn't locked, both sides have to run with interrupts off.
+ */
+typedef bool (*report_queue_merge_t)(const void *previous, const void *pending, const void *report);
+
+typedef struct {
+    uint8_t *slots;
+    uint8_t size;
+    uint8_t mask;
+    uint8_t head;
+    uint8_t count;
+    /* A report that comes after `pending` and `previous` replaces `pending`
+     * if merge() returns true, NULL never merges */
+    report_queue_merge_t merge;
+    uint16_t merged;
+    uint16_t overflows;
+} report_queue_t;
+
+/* The number of reports has to be a power of two, at least 2 */
+#define REPORT_QUEUE_INIT(array, merge_fn) { \
+    .slots = (uint8_t *)(array), \
+    .size = sizeof((array)[0]), \
+    .mask = sizeof(array) / sizeof((array)[0]) - 1, \
+    .merge = (merge_fn) \
+}
+
+/* Queues a copy of the report. Returns the report to start sending when the
+ * endpoint was idle, NULL when it goes out after the ones in flight. A full
+ * queue counts an overflow and the newest report replaces the last one. */
+const void *report_queue_push(report_queue_t *queue, const void *report);
+/* The report in flight made it to the host, returns the next one to send
+ * or NULL once the queue is idle */
+const void *report_queue_sent(report_queue_t *queue);
+/* The endpoint was reset, the report in flight is dropped as well */
+void report_queue_clear(report_queue_t *queue);
+
+static inline bool report_queue_busy(const report_queue_t *queue)
+{
+    return queue->count != 0;
+}
+
+static inline uint8_t report_queue_length(const report_queue_t *queue)
+{
+    return queue->count;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
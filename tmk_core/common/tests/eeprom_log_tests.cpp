@@ -0,0 +1,342 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "gtest/gtest.h"
+#include <iostream>
+#include <random>
+#include <vector>
+extern "C" {
+#include "eeprom_log.h"
+#include "flash_sim.h"
+}
+
+class EepromLog : public testing::Test {
+protected:
+    EepromLog() {
+        flash_sim_reset();
+        eeprom_log_init();
+    }
+
+    static void reboot() {
+        flash_sim_power_on();
+        eeprom_log_init();
+    }
+
+    static std::vector<uint8_t> contents() {
+        std::vector<uint8_t> data(EEPROM_LOG_SIZE);
+        eeprom_log_read_block(data.data(), 0, data.size());
+        return data;
+    }
+
+    static void write(uint32_t offset, uint8_t value) {
+        eeprom_log_write_block(&value, offset, 1);
+    }
+};
+
+TEST_F(EepromLog, BlankFlashReadsErased) {
+    for (uint32_t i = 0; i < EEPROM_LOG_SIZE; i++) {
+        EXPECT_EQ(eeprom_log_read_byte(i), 0xFF);
+    }
+    EXPECT_EQ(eeprom_log_read_byte(EEPROM_LOG_SIZE), 0xFF);
+}
+
+TEST_F(EepromLog, WritesSurviveAReboot) {
+    write(0, 0x12);
+    write(5, 0x34);
+    write(0, 0x56);
+    write(EEPROM_LOG_SIZE - 1, 0x00);
+    reboot();
+    EXPECT_EQ(eeprom_log_read_byte(0), 0x56);
+    EXPECT_EQ(eeprom_log_read_byte(5), 0x34);
+    EXPECT_EQ(eeprom_log_read_byte(EEPROM_LOG_SIZE - 1), 0x00);
+    EXPECT_EQ(eeprom_log_read_byte(1), 0xFF);
+}
+
+TEST_F(EepromLog, ReadsDontTouchTheFlash) {
+    write(3, 0x42);
+    uint32_t reads = flash_sim_stats.reads;
+    for (unsigned i = 0; i < 1000; i++) {
+        EXPECT_EQ(eeprom_log_read_byte(3), 0x42);
+    }
+    EXPECT_EQ(flash_sim_stats.reads, reads);
+}
+
+TEST_F(EepromLog, UnchangedWritesArentProgrammed) {
+    uint8_t data[16];
+    for (uint8_t i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+    eeprom_log_write_block(data, 16, sizeof(data));
+    uint32_t programs = flash_sim_stats.programs;
+    eeprom_log_write_block(data, 16, sizeof(data));
+    write(16, 0);
+    EXPECT_EQ(flash_sim_stats.programs, programs);
+}
+
+TEST_F(EepromLog, BlockWritesArePairedInWords) {
+    uint8_t data[32];
+    for (uint8_t i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+    uint32_t programs = flash_sim_stats.programs;
+    eeprom_log_write_block(data, 0, sizeof(data));
+    // the header fills the first word, every following word takes two bytes
+    EXPECT_EQ(flash_sim_stats.programs - programs, sizeof(data) / 2);
+}
+
+TEST_F(EepromLog, CompactionKeepsTheContents) {
+    std::mt19937 rng(1234);
+    std::vector<uint8_t> expected(EEPROM_LOG_SIZE, 0xFF);
+    for (unsigned i = 0; i < 5000; i++) {
+        uint32_t offset = rng() % EEPROM_LOG_SIZE;
+        uint8_t value = rng();
+        write(offset, value);
+        expected[offset] = value;
+    }
+    EXPECT_GT(flash_sim_stats.erases, 4);
+    EXPECT_EQ(contents(), expected);
+    reboot();
+    EXPECT_EQ(contents(), expected);
+}
+
+TEST_F(EepromLog, PowerCutKeepsEveryCompletedWrite) {
+    // Cut the power at every flash operation of a run of block writes, that
+    // goes through a few compactions
+    const unsigned writes = 400;
+    for (uint32_t cut = 0;; cut++) {
+        flash_sim_reset();
+        eeprom_log_init();
+        flash_sim_power_cut_after(cut);
+
+        std::mt19937 rng(cut % 7);
+        std::vector<uint8_t> done(EEPROM_LOG_SIZE, 0xFF);
+        std::vector<uint8_t> in_flight = done;
+        unsigned i;
+        for (i = 0; i < writes && flash_sim_powered(); i++) {
+            uint8_t data[4];
+            uint32_t offset = rng() % (EEPROM_LOG_SIZE - sizeof(data));
+            for (uint8_t j = 0; j < sizeof(data); j++) {
+                data[j] = rng();
+            }
+            done = in_flight;
+            for (uint8_t j = 0; j < sizeof(data); j++) {
+                in_flight[offset + j] = data[j];
+            }
+            eeprom_log_write_block(data, offset, sizeof(data));
+        }
+        if (flash_sim_powered()) {
+            // the whole run completed before the cut
+            reboot();
+            EXPECT_EQ(contents(), in_flight);
+            break;
+        }
+
+        reboot();
+        std::vector<uint8_t> after = contents();
+        for (uint32_t j = 0; j < EEPROM_LOG_SIZE; j++) {
+            EXPECT_TRUE(after[j] == done[j] || after[j] == in_flight[j])
+                << "power cut after " << cut << " operations, byte " << j;
+        }
+        // and it keeps working
+        write(0, 0xA5);
+        reboot();
+        EXPECT_EQ(eeprom_log_read_byte(0), 0xA5);
+        if (HasFailure()) {
+            break;
+        }
+    }
+}
+
+/* The previous Teensy LC code: every read walks the whole log, every byte
+ * is appended even when it's unchanged, and a full log is erased in place */
+class LegacyLog {
+public:
+    LegacyLog() : m_end(0) {}
+
+    uint8_t read(uint32_t offset) {
+        uint8_t data = 0xFF;
+        for (uint32_t p = 0; p < m_end; p += 2) {
+            uint16_t val = eeprom_log_flash_read(p);
+            if ((val & 255) == offset) data = val >> 8;
+        }
+        return data;
+    }
+
+    void write(uint32_t offset, uint8_t data) {
+        if (m_end < FLASH_SIM_SIZE) {
+            uint32_t val = (data << 8) | offset;
+            eeprom_log_flash_program(m_end, m_end & 2 ? (val << 16) | 0xFFFF : val | 0xFFFF0000);
+            m_end += 2;
+            return;
+        }
+        uint8_t buf[EEPROM_LOG_SIZE];
+        for (uint32_t i = 0; i < EEPROM_LOG_SIZE; i++) {
+            buf[i] = read(i);
+        }
+        buf[offset] = data;
+        for (uint32_t page = 0; page < FLASH_SIM_SIZE; page += EEPROM_LOG_PAGE_SIZE) {
+            eeprom_log_flash_erase(page);
+        }
+        m_end = 0;
+        for (uint32_t i = 0; i < EEPROM_LOG_SIZE; i++) {
+            if (buf[i] != 0xFF) write(i, buf[i]);
+        }
+    }
+
+private:
+    uint32_t m_end;
+};
+
+class EepromLogUpgrade : public testing::Test {
+protected:
+    EepromLogUpgrade() : m_expected(EEPROM_LOG_SIZE, 0xFF) {
+        flash_sim_reset();
+    }
+
+    // Random settings written by the previous code, `entries` long
+    void write_legacy(unsigned entries, unsigned seed) {
+        std::mt19937 rng(seed);
+        for (unsigned i = 0; i < entries; i++) {
+            uint32_t offset = rng() % 128;
+            uint8_t value = rng();
+            m_legacy.write(offset, value);
+            m_expected[offset] = value;
+        }
+    }
+
+    static std::vector<uint8_t> contents() {
+        std::vector<uint8_t> data(EEPROM_LOG_SIZE);
+        eeprom_log_read_block(data.data(), 0, data.size());
+        return data;
+    }
+
+    LegacyLog m_legacy;
+    std::vector<uint8_t> m_expected;
+};
+
+TEST_F(EepromLogUpgrade, LegacySettingsAreKept) {
+    write_legacy(300, 1);
+    eeprom_log_init();
+    EXPECT_EQ(contents(), m_expected);
+    uint8_t value = 0x42;
+    eeprom_log_write_block(&value, 7, 1);
+    m_expected[7] = value;
+    flash_sim_power_on();
+    eeprom_log_init();
+    EXPECT_EQ(contents(), m_expected);
+}
+
+TEST_F(EepromLogUpgrade, LegacyLogRunningIntoTheSecondBankIsKept) {
+    write_legacy(700, 2);
+    eeprom_log_init();
+    EXPECT_EQ(contents(), m_expected);
+}
+
+TEST_F(EepromLogUpgrade, LegacyLogAfterALegacyCompactionIsKept) {
+    write_legacy(1100, 3);
+    eeprom_log_init();
+    EXPECT_EQ(contents(), m_expected);
+}
+
+TEST_F(EepromLogUpgrade, LegacyEntryLikeTheOldMagicIsKept) {
+    // offset 0x10 set to 0xEE, then a second entry that looked like a
+    // generation
+    m_legacy.write(0x10, 0xEE);
+    m_legacy.write(0x02, 0x00);
+    m_expected[0x10] = 0xEE;
+    m_expected[0x02] = 0x00;
+    write_legacy(20, 4);
+    eeprom_log_init();
+    EXPECT_EQ(contents(), m_expected);
+}
+
+TEST_F(EepromLogUpgrade, PowerCutWhileUpgradingKeepsTheSettings) {
+    write_legacy(300, 5);
+    std::vector<uint8_t> image;
+    for (uint32_t i = 0; i < FLASH_SIM_SIZE; i += 2) {
+        image.push_back(eeprom_log_flash_read(i));
+        image.push_back(eeprom_log_flash_read(i) >> 8);
+    }
+    for (uint32_t cut = 0;; cut++) {
+        flash_sim_reset();
+        for (uint32_t i = 0; i < FLASH_SIM_SIZE; i += 4) {
+            eeprom_log_flash_program(i, image[i] | image[i + 1] << 8 | image[i + 2] << 16 | (uint32_t)image[i + 3] << 24);
+        }
+        flash_sim_power_cut_after(cut);
+        eeprom_log_init();
+        bool finished = flash_sim_powered();
+        flash_sim_power_on();
+        eeprom_log_init();
+        EXPECT_EQ(contents(), m_expected) << "power cut after " << cut << " operations";
+        if (finished || HasFailure()) {
+            break;
+        }
+    }
+}
+
+TEST_F(EepromLog, Benchmark) {
+    // A keymap's worth of settings saved over and over, as a block of 32 bytes
+    // where only a few change, then all of it read back like at boot
+    const unsigned saves = 200;
+    std::mt19937 rng(42);
+    uint8_t settings[32] = {0};
+
+    flash_sim_reset();
+    LegacyLog legacy;
+    for (unsigned i = 0; i < saves; i++) {
+        settings[rng() % sizeof(settings)] = rng();
+        settings[rng() % sizeof(settings)] = rng();
+        for (uint8_t j = 0; j < sizeof(settings); j++) {
+            legacy.write(j, settings[j]);
+        }
+    }
+    flash_sim_stats_t legacy_writes = flash_sim_stats;
+    for (uint32_t i = 0; i < EEPROM_LOG_SIZE; i++) {
+        legacy.read(i);
+    }
+    uint32_t legacy_reads = flash_sim_stats.reads - legacy_writes.reads;
+
+    flash_sim_reset();
+    rng.seed(42);
+    memset(settings, 0, sizeof(settings));
+    eeprom_log_init();
+    flash_sim_stats = {0, 0, 0};
+    for (unsigned i = 0; i < saves; i++) {
+        settings[rng() % sizeof(settings)] = rng();
+        settings[rng() % sizeof(settings)] = rng();
+        eeprom_log_write_block(settings, 0, sizeof(settings));
+    }
+    flash_sim_stats_t log_writes = flash_sim_stats;
+    eeprom_log_init();
+    for (uint32_t i = 0; i < EEPROM_LOG_SIZE; i++) {
+        eeprom_log_read_byte(i);
+    }
+    uint32_t log_reads = flash_sim_stats.reads - log_writes.reads;
+
+    std::cout << "[ EEPROM   ] " << saves << " saves of " << sizeof(settings) << " bytes" << std::endl;
+    std::cout << "[ EEPROM   ] legacy: " << legacy_writes.programs << " programs, "
+        << legacy_writes.erases << " erases, reading " << EEPROM_LOG_SIZE << " bytes reads "
+        << legacy_reads << " flash half words" << std::endl;
+    std::cout << "[ EEPROM   ] log:    " << log_writes.programs << " programs, "
+        << log_writes.erases << " erases, replay and reading " << EEPROM_LOG_SIZE << " bytes reads "
+        << log_reads << " flash half words" << std::endl;
+
+    EXPECT_LT(log_writes.programs * 4, legacy_writes.programs);
+    EXPECT_LT(log_writes.erases * 4, legacy_writes.erases);
+    EXPECT_LE(log_reads, FLASH_SIM_SIZE / 2 / 2 + 2);
+    EXPECT_GT(legacy_reads, log_reads * 10);
+}
@@ -0,0 +1,105 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include "flash_sim.h"
+#include "eeprom_log.h"
+
+flash_sim_stats_t flash_sim_stats;
+
+static uint8_t flash[FLASH_SIM_SIZE];
+static uint32_t operations_left;
+static int cut_pending;
+static int powered = 1;
+
+void flash_sim_reset(void)
+{
+    memset(flash, 0xFF, sizeof(flash));
+    memset(&flash_sim_stats, 0, sizeof(flash_sim_stats));
+    flash_sim_power_on();
+}
+
+void flash_sim_power_cut_after(uint32_t operations)
+{
+    operations_left = operations;
+    cut_pending = 1;
+}
+
+void flash_sim_power_on(void)
+{
+    cut_pending = 0;
+    powered = 1;
+}
+
+int flash_sim_powered(void)
+{
+    return powered;
+}
+
+/* Returns 0 if the power is already gone, 1 if the operation completes and
+ * 2 if it is the one the power goes in the middle of */
+static int operation(void)
+{
+    if (!powered) {
+        return 0;
+    }
+    if (cut_pending) {
+        if (operations_left == 0) {
+            powered = 0;
+            return 2;
+        }
+        operations_left--;
+    }
+    return 1;
+}
+
+uint32_t eeprom_log_flash_size(void)
+{
+    return FLASH_SIM_SIZE;
+}
+
+uint16_t eeprom_log_flash_read(uint32_t offset)
+{
+    flash_sim_stats.reads++;
+    return flash[offset] | (flash[offset + 1] << 8);
+}
+
+void eeprom_log_flash_program(uint32_t offset, uint32_t data)
+{
+    offset &= ~3;
+    if (operation() != 1) {
+        return;
+    }
+    flash_sim_stats.programs++;
+    for (uint8_t i = 0; i < 4; i++) {
+        flash[offset + i] &= data >> (8 * i);
+    }
+}
+
+void eeprom_log_flash_erase(uint32_t offset)
+{
+    offset -= offset % EEPROM_LOG_PAGE_SIZE;
+    switch (operation()) {
+        case 0:
+            return;
+        case 2:
+            memset(flash + offset, 0xFF, EEPROM_LOG_PAGE_SIZE / 2);
+            return;
+    }
+    flash_sim_stats.erases++;
+    memset(flash + offset, 0xFF, EEPROM_LOG_PAGE_SIZE);
+}
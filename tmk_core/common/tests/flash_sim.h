@@ -0,0 +1,52 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef FLASH_SIM_H
+#define FLASH_SIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A NOR flash behind the eeprom_log_flash_* functions, two 1k pages like the
+ * Teensy LC. Programming can only clear bits, erasing sets a page to 0xFF. */
+#define FLASH_SIM_SIZE 2048
+
+typedef struct {
+    uint32_t reads;
+    uint32_t programs;
+    uint32_t erases;
+} flash_sim_stats_t;
+
+/* Erases everything and clears the stats and the power cut */
+void flash_sim_reset(void);
+extern flash_sim_stats_t flash_sim_stats;
+
+/* The power goes after `operations` more programs or erases. An erase that
+ * gets cut only clears the first half of the page. From then on the flash
+ * ignores programs and erases, until flash_sim_power_on(). */
+void flash_sim_power_cut_after(uint32_t operations);
+void flash_sim_power_on(void);
+int flash_sim_powered(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,22 @@
+# Copyright 2018 QMK
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# The emulated EEPROM of the Teensy LC, on a simulated flash
+eeprom_log_DEFS := -DEEPROM_LOG_PAGE_SIZE=1024
+eeprom_log_INC := $(TMK_PATH)/common $(TMK_PATH)/common/tests
+eeprom_log_SRC := \
+	$(TMK_PATH)/common/tests/eeprom_log_tests.cpp \
+	$(TMK_PATH)/common/tests/flash_sim.c \
+	$(TMK_PATH)/common/eeprom_log.c
@@ -30,6 +30,11 @@
 #include "wait.h"
 #include "usb_descriptor.h"
 #include "usb_driver.h"
+#include "report_queue.h"
+
+#ifdef INSTRUMENT_ENABLE
+  #include "instrument.h"
+#endif
 
 #ifdef NKRO_ENABLE
   #include "keycode_config.h"
@@ -65,6 +70,31 @@ report_mouse_t mouse_report_blank = {0};
 uint8_t extra_report_blank[3] = {0};
 #endif /* EXTRAKEY_ENABLE */
 
+/* Reports waiting for their endpoint, sent from the IN callbacks so that
+ * send_keyboard() and friends never wait for the host */
+#ifndef USB_REPORT_QUEUE_SIZE
+  #define USB_REPORT_QUEUE_SIZE 4
+#endif
+
+static bool keyboard_report_superseded(const void *previous, const void *pending, const void *report) {
+  return is_report_superseded(pending, previous, report);
+}
+
+static report_keyboard_t keyboard_reports[USB_REPORT_QUEUE_SIZE];
+static report_queue_t keyboard_queue = REPORT_QUEUE_INIT(keyboard_reports, keyboard_report_superseded);
+#ifdef NKRO_ENABLE
+static report_keyboard_t nkro_reports[USB_REPORT_QUEUE_SIZE];
+static report_queue_t nkro_queue = REPORT_QUEUE_INIT(nkro_reports, keyboard_report_superseded);
+#endif /* NKRO_ENABLE */
+#ifdef MOUSE_ENABLE
+static report_mouse_t mouse_reports[USB_REPORT_QUEUE_SIZE];
+static report_queue_t mouse_queue = REPORT_QUEUE_INIT(mouse_reports, NULL);
+#endif /* MOUSE_ENABLE */
+#ifdef EXTRAKEY_ENABLE
+static report_extra_t extra_reports[USB_REPORT_QUEUE_SIZE];
+static report_queue_t extra_queue = REPORT_QUEUE_INIT(extra_reports, NULL);
+#endif /* EXTRAKEY_ENABLE */
+
 /* ---------------------------------------------------------
  *            Descriptors and USB driver objects
  * ---------------------------------------------------------
@@ -310,14 +340,18 @@ static void usb_event_cb(USBDriver *usbp, usbevent_t event) {
     osalSysLockFromISR();
     /* Enable the endpoints specified into the configuration. */
     usbInitEndpointI(usbp, KEYBOARD_IN_EPNUM, &kbd_ep_config);
+    report_queue_clear(&keyboard_queue);
 #ifdef MOUSE_ENABLE
     usbInitEndpointI(usbp, MOUSE_IN_EPNUM, &mouse_ep_config);
+    report_queue_clear(&mouse_queue);
 #endif /* MOUSE_ENABLE */
 #ifdef EXTRAKEY_ENABLE
     usbInitEndpointI(usbp, EXTRAKEY_IN_EPNUM, &extra_ep_config);
+    report_queue_clear(&extra_queue);
 #endif /* EXTRAKEY_ENABLE */
 #ifdef NKRO_ENABLE
     usbInitEndpointI(usbp, NKRO_IN_EPNUM, &nkro_ep_config);
+    report_queue_clear(&nkro_queue);
 #endif /* NKRO_ENABLE */
     for (int i=0;i<NUM_USB_DRIVERS;i++) {
       usbInitEndpointI(usbp, drivers.array[i].config.bulk_in, &drivers.array[i].in_ep_config);
@@ -586,23 +620,44 @@ void init_usb_driver(USBDriver *usbp) {
   chVTObjectInit(&keyboard_idle_timer);
 }
 
+/* ---------------------------------------------------------
+ *                  Report queue functions
+ * ---------------------------------------------------------
+ */
+
+/* Queues a report, it is sent right away if the endpoint is idle
+ * (call in locked state) */
+static void queue_report_i(USBDriver *usbp, usbep_t ep, report_queue_t *queue, const void *report, size_t size) {
+  const void *next = report_queue_push(queue, report);
+  if(next) {
+    usbStartTransmitI(usbp, ep, (uint8_t *)next, size);
+  }
+}
+
+/* The report in flight made it IN, start the next one
+ * (called from the IN callbacks, in ISR unlocked state) */
+static void report_sent(USBDriver *usbp, usbep_t ep, report_queue_t *queue, size_t size) {
+  osalSysLockFromISR();
+  const void *next = report_queue_sent(queue);
+  if(next) {
+    usbStartTransmitI(usbp, ep, (uint8_t *)next, size);
+  }
+  osalSysUnlockFromISR();
+}
+
 /* ---------------------------------------------------------
  *                  Keyboard functions
  * ---------------------------------------------------------
  */
 /* keyboard IN callback hander (a kbd report has made it IN) */
 void kbd_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
-  (void)ep;
+  report_sent(usbp, ep, &keyboard_queue, KEYBOARD_EPSIZE);
 }
 
 #ifdef NKRO_ENABLE
 /* nkro IN callback hander (a nkro report has made it IN) */
 void nkro_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
-  (void)ep;
+  report_sent(usbp, ep, &nkro_queue, sizeof(report_keyboard_t));
 }
 #endif /* NKRO_ENABLE */
 
@@ -633,8 +688,8 @@ static void keyboard_idle_timer_cb(void *arg) {
   if(keyboard_idle) {
 #endif /* NKRO_ENABLE */
     /* TODO: are we sure we want the KBD_ENDPOINT? */
-    if(!usbGetTransmitStatusI(usbp, KEYBOARD_IN_EPNUM)) {
-      usbStartTransmitI(usbp, KEYBOARD_IN_EPNUM, (uint8_t *)&keyboard_report_sent, KEYBOARD_EPSIZE);
+    if(!report_queue_busy(&keyboard_queue)) {
+      queue_report_i(usbp, KEYBOARD_IN_EPNUM, &keyboard_queue, &keyboard_report_sent, KEYBOARD_EPSIZE);
     }
     /* rearm the timer */
     chVTSetI(&keyboard_idle_timer, 4*MS2ST(keyboard_idle), keyboard_idle_timer_cb, (void *)usbp);
@@ -650,7 +705,7 @@ uint8_t keyboard_leds(void) {
   return (uint8_t)(keyboard_led_stats & 0xFF);
 }
 
-/* prepare and start sending a report IN
+/* queue a report, the previous ones are sent IN as the host polls
  * not callable from ISR or locked state */
 void send_keyboard(report_keyboard_t *report) {
   osalSysLock();
@@ -658,42 +713,17 @@ void send_keyboard(report_keyboard_t *report) {
     osalSysUnlock();
     return;
   }
-  osalSysUnlock();
 
 #ifdef NKRO_ENABLE
   if(keymap_config.nkro) {  /* NKRO protocol */
-    /* need to wait until the previous packet has made it through */
-    /* can rewrite this using the synchronous API, then would wait
-     * until *after* the packet has been transmitted. I think
-     * this is more efficient */
-    /* busy wait, should be short and not very common */
-    osalSysLock();
-    if(usbGetTransmitStatusI(&USB_DRIVER, NKRO_IN_EPNUM)) {
-      /* Need to either suspend, or loop and call unlock/lock during
-       * every iteration - otherwise the system will remain locked,
-       * no interrupts served, so USB not going through as well.
-       * Note: for suspend, need USB_USE_WAIT == TRUE in halconf.h */
-      osalThreadSuspendS(&(&USB_DRIVER)->epc[NKRO_IN_EPNUM]->in_state->thread);
-    }
-    usbStartTransmitI(&USB_DRIVER, NKRO_IN_EPNUM, (uint8_t *)report, sizeof(report_keyboard_t));
-    osalSysUnlock();
+    queue_report_i(&USB_DRIVER, NKRO_IN_EPNUM, &nkro_queue, report, sizeof(report_keyboard_t));
   } else
 #endif /* NKRO_ENABLE */
   { /* boot protocol */
-    /* need to wait until the previous packet has made it through */
-    /* busy wait, should be short and not very common */
-    osalSysLock();
-    if(usbGetTransmitStatusI(&USB_DRIVER, KEYBOARD_IN_EPNUM)) {
-      /* Need to either suspend, or loop and call unlock/lock during
-       * every iteration - otherwise the system will remain locked,
-       * no interrupts served, so USB not going through as well.
-       * Note: for suspend, need USB_USE_WAIT == TRUE in halconf.h */
-      osalThreadSuspendS(&(&USB_DRIVER)->epc[KEYBOARD_IN_EPNUM]->in_state->thread);
-    }
-    usbStartTransmitI(&USB_DRIVER, KEYBOARD_IN_EPNUM, (uint8_t *)report, KEYBOARD_EPSIZE);
-    osalSysUnlock();
+    queue_report_i(&USB_DRIVER, KEYBOARD_IN_EPNUM, &keyboard_queue, report, KEYBOARD_EPSIZE);
   }
   keyboard_report_sent = *report;
+  osalSysUnlock();
 }
 
 /* ---------------------------------------------------------
@@ -705,8 +735,7 @@ void send_keyboard(report_keyboard_t *report) {
 
 /* mouse IN callback hander (a mouse report has made it IN) */
 void mouse_in_cb(USBDriver *usbp, usbep_t ep) {
-  (void)usbp;
-  (void)ep;
+  report_sent(usbp, ep, &mouse_queue, sizeof(report_mouse_t));
 }
 
 void send_mouse(report_mouse_t *report) {
@@ -715,15 +744,7 @@ void send_mouse(report_mouse_t *report) {
     osalSysUnlock();
     return;
   }
-  osalSysUnlock();
-
-  /* TODO: LUFA manually waits for the endpoint to become ready
-   * for about 10ms for mouse, kbd, system; 1ms for nkro
-   * is this really needed?
-   */
-
-  osalSysLock();
-  usbStartTransmitI(&USB_DRIVER, MOUSE_IN_EPNUM, (uint8_t *)report, sizeof(report_mouse_t));
+  queue_report_i(&USB_DRIVER, MOUSE_IN_EPNUM, &mouse_queue, report, sizeof(report_mouse_t));
   osalSysUnlock();
 }
 
@@ -742,9 +763,7 @@ void send_mouse(report_mouse_t *report) {
 
 /* extrakey IN callback hander */
 void extra_in_cb(USBDriver *usbp, usbep_t ep) {
-  /* STUB */
-  (void)usbp;
-  (void)ep;
+  report_sent(usbp, ep, &extra_queue, sizeof(report_extra_t));
 }
 
 static void send_extra_report(uint8_t report_id, uint16_t data) {
@@ -759,7 +778,7 @@ static void send_extra_report(uint8_t report_id, uint16_t data) {
     .usage = data
   };
 
-  usbStartTransmitI(&USB_DRIVER, EXTRAKEY_IN_EPNUM, (uint8_t *)&report, sizeof(report_extra_t));
+  queue_report_i(&USB_DRIVER, EXTRAKEY_IN_EPNUM, &extra_queue, &report, sizeof(report_extra_t));
   osalSysUnlock();
 }
 
@@ -847,6 +866,12 @@ void raw_hid_task(void) {
   do {
     size_t size = chnReadTimeout(&drivers.raw_driver.driver, buffer, sizeof(buffer), TIME_IMMEDIATE);
     if (size > 0) {
+#ifdef INSTRUMENT_ENABLE
+        if (instrument_raw_hid_query(buffer, size)) {
+            raw_hid_send(buffer, size);
+            continue;
+        }
+#endif
         raw_hid_receive(buffer, size);
     }
   } while(size > 0);
@@ -0,0 +1,63 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef DEFERRED_REPORT_H
+#define DEFERRED_REPORT_H
+
+#include "report_queue.h"
+
+/* USB_DEFERRED_SEND: instead of waiting for the endpoint bank to be free,
+ * send_keyboard() and friends queue the report, and the queue is written
+ * to the bank as soon as the host has polled the previous one.
+ *
+ * Include after the LUFA headers, only the main loop may call these since
+ * they select the endpoint.
+ */
+
+/* Writes the next report if the one in the bank made it to the host */
+static inline void deferred_report_flush(report_queue_t *queue, uint8_t endpoint, uint16_t size)
+{
+    if (!report_queue_busy(queue)) {
+        return;
+    }
+    Endpoint_SelectEndpoint(endpoint);
+    if (!Endpoint_IsReadWriteAllowed()) {
+        return;
+    }
+    const void *next = report_queue_sent(queue);
+    if (next) {
+        Endpoint_Write_Stream_LE(next, size, NULL);
+        Endpoint_ClearIN();
+    }
+}
+
+static inline void deferred_report_send(report_queue_t *queue, uint8_t endpoint, const void *report, uint16_t size)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured) {
+        return;
+    }
+    deferred_report_flush(queue, endpoint, size);
+    // the queue is only idle once the bank is known to be free
+    const void *next = report_queue_push(queue, report);
+    if (next) {
+        Endpoint_SelectEndpoint(endpoint);
+        Endpoint_Write_Stream_LE(next, size, NULL);
+        Endpoint_ClearIN();
+    }
+}
+
+#endif
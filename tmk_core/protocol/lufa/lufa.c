@@ -90,6 +90,10 @@
 	#include "raw_hid.h"
 #endif
 
+#ifdef INSTRUMENT_ENABLE
+	#include "instrument.h"
+#endif
+
 uint8_t keyboard_idle = 0;
 /* 0: Boot Protocol, 1: Report Protocol(default) */
 uint8_t keyboard_protocol = 1;
@@ -97,6 +101,72 @@ static uint8_t keyboard_led_stats = 0;
 
 static report_keyboard_t keyboard_report_sent;
 
+#ifdef USB_DEFERRED_SEND
+#include "deferred_report.h"
+
+/* The report in the endpoint bank and the ones waiting for it */
+#ifndef USB_REPORT_QUEUE_SIZE
+    #define USB_REPORT_QUEUE_SIZE 2
+#endif
+
+static bool keyboard_report_superseded(const void *previous, const void *pending, const void *report)
+{
+    return is_report_superseded(pending, previous, report);
+}
+
+static report_keyboard_t keyboard_reports[USB_REPORT_QUEUE_SIZE];
+static report_queue_t keyboard_queue = REPORT_QUEUE_INIT(keyboard_reports, keyboard_report_superseded);
+#ifdef NKRO_ENABLE
+static report_keyboard_t nkro_reports[USB_REPORT_QUEUE_SIZE];
+static report_queue_t nkro_queue = REPORT_QUEUE_INIT(nkro_reports, keyboard_report_superseded);
+#endif
+#ifdef MOUSE_ENABLE
+static report_mouse_t mouse_reports[USB_REPORT_QUEUE_SIZE];
+static report_queue_t mouse_queue = REPORT_QUEUE_INIT(mouse_reports, NULL);
+#endif
+#ifdef EXTRAKEY_ENABLE
+static report_extra_t extra_reports[USB_REPORT_QUEUE_SIZE];
+static report_queue_t extra_queue = REPORT_QUEUE_INIT(extra_reports, NULL);
+#endif
+
+/** \brief Clear the deferred reports, the endpoints have been reset
+ */
+static void deferred_reports_clear(void)
+{
+    report_queue_clear(&keyboard_queue);
+#ifdef NKRO_ENABLE
+    report_queue_clear(&nkro_queue);
+#endif
+#ifdef MOUSE_ENABLE
+    report_queue_clear(&mouse_queue);
+#endif
+#ifdef EXTRAKEY_ENABLE
+    report_queue_clear(&extra_queue);
+#endif
+}
+
+/** \brief Send the deferred reports whose endpoint is free again
+ *
+ * Called from the main loop
+ */
+static void deferred_reports_task(void)
+{
+    if (USB_DeviceState != DEVICE_STATE_Configured)
+        return;
+
+    deferred_report_flush(&keyboard_queue, KEYBOARD_IN_EPNUM, KEYBOARD_EPSIZE);
+#ifdef NKRO_ENABLE
+    deferred_report_flush(&nkro_queue, NKRO_IN_EPNUM, NKRO_EPSIZE);
+#endif
+#ifdef MOUSE_ENABLE
+    deferred_report_flush(&mouse_queue, MOUSE_IN_EPNUM, sizeof(report_mouse_t));
+#endif
+#ifdef EXTRAKEY_ENABLE
+    deferred_report_flush(&extra_queue, EXTRAKEY_IN_EPNUM, sizeof(report_extra_t));
+#endif
+}
+#endif
+
 /* Host driver */
 static uint8_t keyboard_leds(void);
 static void send_keyboard(report_keyboard_t *report);
@@ -220,6 +290,13 @@ static void raw_hid_task(void)
 
 		if ( data_read )
 		{
+#ifdef INSTRUMENT_ENABLE
+			if ( instrument_raw_hid_query( data, sizeof(data) ) )
+			{
+				raw_hid_send( data, sizeof(data) );
+				return;
+			}
+#endif
 			raw_hid_receive( data, sizeof(data) );
 		}
 	}
@@ -338,6 +415,9 @@ void EVENT_USB_Device_Disconnect(void)
 void EVENT_USB_Device_Reset(void)
 {
     print("[R]");
+#ifdef USB_DEFERRED_SEND
+    deferred_reports_clear();
+#endif
 }
 
 /** \brief Event USB Device Connect
@@ -407,6 +487,10 @@ void EVENT_USB_Device_ConfigurationChanged(void)
 {
     bool ConfigSuccess = true;
 
+#ifdef USB_DEFERRED_SEND
+    deferred_reports_clear();
+#endif
+
     /* Setup Keyboard HID Report Endpoints */
     ConfigSuccess &= ENDPOINT_CONFIG(KEYBOARD_IN_EPNUM, EP_TYPE_INTERRUPT, ENDPOINT_DIR_IN,
                                      KEYBOARD_EPSIZE, ENDPOINT_BANK_SINGLE);
@@ -603,7 +687,9 @@ static uint8_t keyboard_leds(void)
  */
 static void send_keyboard(report_keyboard_t *report)
 {
+#ifndef USB_DEFERRED_SEND
     uint8_t timeout = 255;
+#endif
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -630,6 +716,14 @@ static void send_keyboard(report_keyboard_t *report)
       return;
     }
 
+#ifdef USB_DEFERRED_SEND
+#ifdef NKRO_ENABLE
+    if (keyboard_protocol && keymap_config.nkro)
+        deferred_report_send(&nkro_queue, NKRO_IN_EPNUM, report, NKRO_EPSIZE);
+    else
+#endif
+        deferred_report_send(&keyboard_queue, KEYBOARD_IN_EPNUM, report, KEYBOARD_EPSIZE);
+#else
     /* Select the Keyboard Report Endpoint */
 #ifdef NKRO_ENABLE
     if (keyboard_protocol && keymap_config.nkro) {
@@ -659,6 +753,7 @@ static void send_keyboard(report_keyboard_t *report)
 
     /* Finalize the stream transfer to send the last packet */
     Endpoint_ClearIN();
+#endif
 
     keyboard_report_sent = *report;
 }
@@ -670,7 +765,9 @@ static void send_keyboard(report_keyboard_t *report)
 static void send_mouse(report_mouse_t *report)
 {
 #ifdef MOUSE_ENABLE
+#ifndef USB_DEFERRED_SEND
     uint8_t timeout = 255;
+#endif
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -696,6 +793,9 @@ static void send_mouse(report_mouse_t *report)
       return;
     }
 
+#ifdef USB_DEFERRED_SEND
+    deferred_report_send(&mouse_queue, MOUSE_IN_EPNUM, report, sizeof(report_mouse_t));
+#else
     /* Select the Mouse Report Endpoint */
     Endpoint_SelectEndpoint(MOUSE_IN_EPNUM);
 
@@ -709,6 +809,7 @@ static void send_mouse(report_mouse_t *report)
     /* Finalize the stream transfer to send the last packet */
     Endpoint_ClearIN();
 #endif
+#endif
 }
 
 /** \brief Send System
@@ -717,7 +818,9 @@ static void send_mouse(report_mouse_t *report)
  */
 static void send_system(uint16_t data)
 {
+#ifndef USB_DEFERRED_SEND
     uint8_t timeout = 255;
+#endif
 
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
@@ -726,6 +829,9 @@ static void send_system(uint16_t data)
         .report_id = REPORT_ID_SYSTEM,
         .usage = data - SYSTEM_POWER_DOWN + 1
     };
+#ifdef USB_DEFERRED_SEND
+    deferred_report_send(&extra_queue, EXTRAKEY_IN_EPNUM, &r, sizeof(report_extra_t));
+#else
     Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
 
     /* Check if write ready for a polling interval around 10ms */
@@ -734,6 +840,7 @@ static void send_system(uint16_t data)
 
     Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
     Endpoint_ClearIN();
+#endif
 }
 
 /** \brief Send Consumer
@@ -742,7 +849,9 @@ static void send_system(uint16_t data)
  */
 static void send_consumer(uint16_t data)
 {
+#ifndef USB_DEFERRED_SEND
     uint8_t timeout = 255;
+#endif
     uint8_t where = where_to_send();
 
 #ifdef BLUETOOTH_ENABLE
@@ -785,6 +894,9 @@ static void send_consumer(uint16_t data)
         .report_id = REPORT_ID_CONSUMER,
         .usage = data
     };
+#ifdef USB_DEFERRED_SEND
+    deferred_report_send(&extra_queue, EXTRAKEY_IN_EPNUM, &r, sizeof(report_extra_t));
+#else
     Endpoint_SelectEndpoint(EXTRAKEY_IN_EPNUM);
 
     /* Check if write ready for a polling interval around 10ms */
@@ -793,6 +905,7 @@ static void send_consumer(uint16_t data)
 
     Endpoint_Write_Stream_LE(&r, sizeof(report_extra_t), NULL);
     Endpoint_ClearIN();
+#endif
 }
 
 
@@ -1070,6 +1183,10 @@ int main(void)
 
         keyboard_task();
 
+#ifdef USB_DEFERRED_SEND
+        deferred_reports_task();
+#endif
+
 #ifdef MIDI_ENABLE
         MIDI_Device_USBTask(&USB_MIDI_Interface);
 #endif